@@ -0,0 +1,649 @@
+#include "Benchmark.hpp"
+
+#include <fstream>   // std::ifstream
+#include <sstream>   // std::stringstream
+#include <algorithm> // std::sort std::max std::fill
+#include <cmath>     // std::frexp std::ldexp std::ceil
+#include <cfloat>    // FLT_MIN
+#include <cstdlib>   // strtod
+#include <limits>    // std::numeric_limits
+
+#ifdef _WIN32
+#	define NOMINMAX
+#	include <windows.h>
+#	include <intrin.h>
+#else
+#	include <time.h>
+#endif // _WIN32
+
+namespace bench
+{
+////////////////////////////////////////////////////////////////////////////////
+// Exceptions
+//
+////////////////////////////////////////////////////////////////////////////////
+class _FileNotFoundException : public BenchException
+{
+public:
+	_FileNotFoundException(const std::string& file)
+	{
+		mMessage = "File " + file + " not found.";
+	}
+};
+
+class _JsonSyntaxException : public BenchException
+{
+public:
+	_JsonSyntaxException(size_t position, const std::string& log)
+	{
+		std::stringstream ss;
+		ss << "JSON syntax error at character " << position << ": " << log;
+		mMessage = ss.str();
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Functions implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Get time
+double get_time()
+{
+#ifdef _WIN32
+	__int64 time;
+	__int64 cpuFrequency;
+	QueryPerformanceCounter((LARGE_INTEGER*) &time);
+	QueryPerformanceFrequency((LARGE_INTEGER*) &cpuFrequency);
+	return time / static_cast<double>(cpuFrequency);
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec)/1e9;
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compiler barrier
+void clobber_memory()
+{
+#ifdef _MSC_VER
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : : "memory");
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Ulp error
+double ulp_error(float value, double reference, double scale)
+{
+	// nans and infinites must match exactly
+	if(reference != reference || value != value)
+		return (reference != reference && value != value) ? 0.0 : HUGE_VAL;
+	if(reference == static_cast<double>(value))
+		return 0.0;
+	if(std::abs(reference) > FLT_MAX)
+		return HUGE_VAL;
+
+	// get the ulp at the reference magnitude (24 bits of mantissa)
+	int exponent = 0;
+	double magnitude = std::max(std::max(std::abs(reference), scale),
+	                            static_cast<double>(FLT_MIN));
+	std::frexp(magnitude, &exponent);
+	double ulp = std::ldexp(1.0, exponent - 24);
+
+	return std::abs(static_cast<double>(value) - reference) / ulp;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Median
+double median(const std::vector<double>& samples)
+{
+	if(samples.empty())
+		return 0.0;
+
+	std::vector<double> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+	size_t half = sorted.size() / 2;
+	if(sorted.size() % 2)
+		return sorted[half];
+	return 0.5 * (sorted[half-1] + sorted[half]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Median absolute deviation
+double median_absolute_deviation(const std::vector<double>& samples)
+{
+	double m = median(samples);
+	std::vector<double> deviations(samples.size());
+	for(size_t i=0; i<samples.size(); ++i)
+		deviations[i] = std::abs(samples[i] - m);
+	return median(deviations);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Random implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+Random::Random(uint32_t seed):
+	mState(seed ? seed : 2463534242u)
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Next number
+uint32_t Random::Next()
+{
+	mState ^= mState << 13;
+	mState ^= mState >> 17;
+	mState ^= mState << 5;
+	return mState;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Uniform number in range [min,max]
+float Random::Uniform(float min, float max)
+{
+	// use the 24 upper bits (exactly representable)
+	float u = static_cast<float>(Next() >> 8) / 16777215.0f;
+	return min + (max - min) * u;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Histogram implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+Histogram::Histogram(double resolution, int bucketCount):
+	mBuckets(std::max(bucketCount, 2), 0),
+	mResolution(resolution),
+	mSum(0.0),
+	mMax(0.0),
+	mCount(0)
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Add a sample
+void Histogram::Add(double value)
+{
+	int bucket = 0;
+	if(value >= mResolution)
+	{
+		int exponent = 0;
+		std::frexp(value / mResolution, &exponent); // value/res in [2^(e-1),2^e)
+		bucket = std::min(exponent, static_cast<int>(mBuckets.size()) - 1);
+	}
+	++mBuckets[bucket];
+	++mCount;
+	mSum += value;
+	mMax  = std::max(mMax, value);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Remove all the samples
+void Histogram::Reset()
+{
+	std::fill(mBuckets.begin(), mBuckets.end(), 0);
+	mSum   = 0.0;
+	mMax   = 0.0;
+	mCount = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Percentile (upper bound of the bucket, clamped to the largest sample)
+double Histogram::Percentile(double p) const
+{
+	if(0 == mCount)
+		return 0.0;
+	uint64_t rank = static_cast<uint64_t>(std::ceil(p * mCount));
+	uint64_t sampleCnt = 0;
+	for(int i=0; i<BucketCount(); ++i)
+	{
+		sampleCnt += mBuckets[i];
+		if(sampleCnt >= std::max(rank, uint64_t(1)))
+			return std::min(BucketUpperBound(i), mMax);
+	}
+	return mMax;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Accessors
+uint64_t Histogram::Count() const {return mCount;}
+double Histogram::Sum()     const {return mSum;}
+double Histogram::Mean()    const {return mCount ? mSum / mCount : 0.0;}
+double Histogram::Max()     const {return mMax;}
+int Histogram::BucketCount() const
+{
+	return static_cast<int>(mBuckets.size());
+}
+
+uint64_t Histogram::BucketSampleCount(int i) const
+{
+	return mBuckets[i];
+}
+
+double Histogram::BucketUpperBound(int i) const
+{
+	if(i == BucketCount() - 1)
+		return std::numeric_limits<double>::infinity();
+	return std::ldexp(mResolution, i);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JsonWriter implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+JsonWriter::JsonWriter(std::ostream& stream):
+	mStream(stream),
+	mIsFirst()
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Structure
+void JsonWriter::BeginObject()
+{
+	_Separate();
+	mStream << '{';
+	mIsFirst.push_back(true);
+}
+
+void JsonWriter::BeginObject(const std::string& key)
+{
+	_Key(key);
+	mStream << '{';
+	mIsFirst.push_back(true);
+}
+
+void JsonWriter::EndObject()
+{
+	mIsFirst.pop_back();
+	mStream << '\n' << std::string(mIsFirst.size(), '\t') << '}';
+	if(mIsFirst.empty())
+		mStream << '\n';
+}
+
+void JsonWriter::BeginArray()
+{
+	_Separate();
+	mStream << '[';
+	mIsFirst.push_back(true);
+}
+
+void JsonWriter::BeginArray(const std::string& key)
+{
+	_Key(key);
+	mStream << '[';
+	mIsFirst.push_back(true);
+}
+
+void JsonWriter::EndArray()
+{
+	mIsFirst.pop_back();
+	mStream << ']';
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Members
+void JsonWriter::Write(const std::string& key, double value)
+{
+	_Key(key);
+	_Number(value);
+}
+
+void JsonWriter::Write(const std::string& key, const std::string& value)
+{
+	_Key(key);
+	_String(value);
+}
+
+void JsonWriter::Write(const std::string& key, const char* value)
+{
+	Write(key, std::string(value));
+}
+
+void JsonWriter::Write(const std::string& key, bool value)
+{
+	_Key(key);
+	mStream << (value ? "true" : "false");
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Array elements (written on a single line)
+void JsonWriter::Write(double value)
+{
+	if(!mIsFirst.empty() && !mIsFirst.back())
+		mStream << ", ";
+	if(!mIsFirst.empty())
+		mIsFirst.back() = false;
+	_Number(value);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal manipulation
+void JsonWriter::_Separate()
+{
+	if(mIsFirst.empty())
+		return;
+	if(!mIsFirst.back())
+		mStream << ',';
+	mStream << '\n' << std::string(mIsFirst.size(), '\t');
+	mIsFirst.back() = false;
+}
+
+void JsonWriter::_Key(const std::string& key)
+{
+	_Separate();
+	_String(key);
+	mStream << ": ";
+}
+
+void JsonWriter::_String(const std::string& value)
+{
+	mStream << '"';
+	for(size_t i=0; i<value.size(); ++i)
+	{
+		if(value[i] == '"' || value[i] == '\\')
+			mStream << '\\';
+		mStream << value[i];
+	}
+	mStream << '"';
+}
+
+void JsonWriter::_Number(double value)
+{
+	// JSON has no representation for nans and infinites
+	if(value != value || std::abs(value) > 1.7976931348623157e308)
+	{
+		mStream << "null";
+		return;
+	}
+	// 17 digits: doubles (and floats) survive the round trip
+	std::stringstream ss;
+	ss.precision(17);
+	ss << value;
+	mStream << ss.str();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JsonValue implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Recursive descent parser
+class _JsonParser
+{
+public:
+	explicit _JsonParser(const std::string& text): mText(text), mPos(0) {}
+
+	void ParseDocument(JsonValue& value) throw(BenchException)
+	{
+		_ParseValue(value);
+		_SkipSpaces();
+		if(mPos != mText.size())
+			throw _JsonSyntaxException(mPos, "trailing characters.");
+	}
+
+private:
+	void _SkipSpaces()
+	{
+		while(mPos < mText.size()
+		      && (mText[mPos] == ' '  || mText[mPos] == '\t'
+		      ||  mText[mPos] == '\n' || mText[mPos] == '\r'))
+			++mPos;
+	}
+
+	void _Expect(char c) throw(BenchException)
+	{
+		_SkipSpaces();
+		if(mPos >= mText.size() || mText[mPos] != c)
+			throw _JsonSyntaxException(mPos, std::string("expected ") + c);
+		++mPos;
+	}
+
+	bool _Match(const char* word)
+	{
+		size_t length = std::string(word).size();
+		if(mText.compare(mPos, length, word) != 0)
+			return false;
+		mPos += length;
+		return true;
+	}
+
+	void _ParseString(std::string& str) throw(BenchException)
+	{
+		_Expect('"');
+		str.clear();
+		while(mPos < mText.size() && mText[mPos] != '"')
+		{
+			if(mText[mPos] == '\\' && mPos+1 < mText.size())
+			{
+				++mPos;
+				switch(mText[mPos])
+				{
+				case 'n': str += '\n'; break;
+				case 't': str += '\t'; break;
+				case 'r': str += '\r'; break;
+				default:  str += mText[mPos];
+				}
+			}
+			else
+				str += mText[mPos];
+			++mPos;
+		}
+		if(mPos >= mText.size())
+			throw _JsonSyntaxException(mPos, "unterminated string.");
+		++mPos;
+	}
+
+	void _ParseValue(JsonValue& value) throw(BenchException)
+	{
+		_SkipSpaces();
+		if(mPos >= mText.size())
+			throw _JsonSyntaxException(mPos, "unexpected end of text.");
+
+		char c = mText[mPos];
+		if(c == '{')
+		{
+			value.mType = JsonValue::TYPE_OBJECT;
+			++mPos;
+			_SkipSpaces();
+			if(mPos < mText.size() && mText[mPos] == '}')
+			{
+				++mPos;
+				return;
+			}
+			for(;;)
+			{
+				value.mNames.push_back(std::string());
+				value.mElements.push_back(JsonValue());
+				_ParseString(value.mNames.back());
+				_Expect(':');
+				_ParseValue(value.mElements.back());
+				_SkipSpaces();
+				if(mPos >= mText.size() || mText[mPos] != ',')
+					break;
+				++mPos;
+			}
+			_Expect('}');
+		}
+		else if(c == '[')
+		{
+			value.mType = JsonValue::TYPE_ARRAY;
+			++mPos;
+			_SkipSpaces();
+			if(mPos < mText.size() && mText[mPos] == ']')
+			{
+				++mPos;
+				return;
+			}
+			for(;;)
+			{
+				value.mElements.push_back(JsonValue());
+				_ParseValue(value.mElements.back());
+				_SkipSpaces();
+				if(mPos >= mText.size() || mText[mPos] != ',')
+					break;
+				++mPos;
+			}
+			_Expect(']');
+		}
+		else if(c == '"')
+		{
+			value.mType = JsonValue::TYPE_STRING;
+			_ParseString(value.mString);
+		}
+		else if(_Match("true"))
+		{
+			value.mType    = JsonValue::TYPE_BOOLEAN;
+			value.mBoolean = true;
+		}
+		else if(_Match("false"))
+		{
+			value.mType    = JsonValue::TYPE_BOOLEAN;
+			value.mBoolean = false;
+		}
+		else if(_Match("null"))
+		{
+			value.mType = JsonValue::TYPE_NULL;
+		}
+		else
+		{
+			const char* begin = mText.c_str() + mPos;
+			char* end = NULL;
+			value.mType   = JsonValue::TYPE_NUMBER;
+			value.mNumber = strtod(begin, &end);
+			if(end == begin)
+				throw _JsonSyntaxException(mPos, "invalid value.");
+			mPos += end - begin;
+		}
+	}
+
+	const std::string& mText;
+	size_t mPos;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Null value (returned by failed lookups)
+static const JsonValue& _json_null()
+{
+	static const JsonValue sNull;
+	return sNull;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Factories
+JsonValue JsonValue::Parse(const std::string& text) throw(BenchException)
+{
+	JsonValue value;
+	_JsonParser parser(text);
+	parser.ParseDocument(value);
+	return value;
+}
+
+JsonValue JsonValue::Load(const std::string& filename) throw(BenchException)
+{
+	std::ifstream file(filename.c_str());
+	if(file.fail())
+		throw _FileNotFoundException(filename);
+
+	std::stringstream ss;
+	ss << file.rdbuf();
+	return Parse(ss.str());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+JsonValue::JsonValue():
+	mType(TYPE_NULL),
+	mBoolean(false),
+	mNumber(0.0),
+	mString(),
+	mNames(),
+	mElements()
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Access operators
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	if(index >= mElements.size())
+		return _json_null();
+	return mElements[index];
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const
+{
+	for(size_t i=0; i<mNames.size(); ++i)
+		if(mNames[i] == key)
+			return mElements[i];
+	return _json_null();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Queries
+JsonValue::Type JsonValue::GetType() const {return mType;}
+bool JsonValue::IsNull()             const {return mType == TYPE_NULL;}
+size_t JsonValue::Size()             const {return mElements.size();}
+
+bool JsonValue::HasMember(const std::string& key) const
+{
+	return std::find(mNames.begin(), mNames.end(), key) != mNames.end();
+}
+
+const std::string& JsonValue::MemberName(size_t index) const
+{
+	return mNames[index];
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Accessors
+bool JsonValue::AsBoolean()              const {return mBoolean;}
+double JsonValue::AsNumber()             const
+{
+	// null numbers are written for nans
+	return mType == TYPE_NULL ? std::numeric_limits<double>::quiet_NaN()
+	                          : mNumber;
+}
+const std::string& JsonValue::AsString() const {return mString;}
+
+} // namespace bench
+
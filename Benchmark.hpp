@@ -0,0 +1,203 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    Benchmark.hpp
+// \author  J. Dupuy
+// \brief   Utility functions and classes for benchmarks and accuracy tests.
+//          Does not depend on OpenGL, so it can be used by headless tools.
+//          List of functions/classes
+//          - get_time: monotonic high resolution clock
+//          - clobber_memory: compiler barrier for timing loops
+//          - ulp_error: float error against a double precision reference
+//          - median, median_absolute_deviation: robust statistics
+//          - Random: deterministic pseudo random number generator
+//          - Histogram: log2 bucketed histogram of durations or sizes
+//          - JsonWriter: streams results as JSON
+//          - JsonValue: minimal JSON reader (to load previous results)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <string>   // std::string
+#include <vector>   // std::vector
+#include <ostream>  // std::ostream
+#include <stdint.h> // integers
+
+namespace bench
+{
+	// Benchmark exception
+	class BenchException : public std::exception
+	{
+	public:
+		virtual ~BenchException() throw()  {}
+		const char* what() const throw()   {return mMessage.c_str();}
+	protected:
+		std::string mMessage;
+	};
+
+
+	// Get time, in seconds (monotonic clock)
+	double get_time();
+
+
+	// Forces the compiler to assume memory was read and written
+	// (prevents hoisting pure computations out of timing loops)
+	void clobber_memory();
+
+
+	// Error of a float value against a double precision reference, in units
+	// in the last place. The ulp is taken at max(|reference|, scale), so
+	// that results near zero can be compared to the magnitude of the
+	// whole result.
+	double ulp_error(float value, double reference, double scale);
+
+
+	// Robust statistics
+	double median(const std::vector<double>& samples);
+	double median_absolute_deviation(const std::vector<double>& samples);
+
+
+	// Deterministic random numbers (xorshift32)
+	class Random
+	{
+	public:
+		// Constructors
+		explicit Random(uint32_t seed = 2463534242u);
+
+		// Manipulation
+		uint32_t Next();
+		float Uniform(float min, float max);
+
+	private:
+		// Members
+		uint32_t mState;
+	};
+
+
+	// Histogram with power of two buckets. Bucket 0 holds the values below
+	// the resolution, bucket i>0 the values in [res*2^(i-1), res*2^i), and
+	// the last bucket everything above. Percentiles are bucket upper bounds.
+	class Histogram
+	{
+	public:
+		// Constructors
+		explicit Histogram(double resolution = 1e-6, int bucketCount = 24);
+
+		// Manipulation
+		void Add(double value);
+		void Reset();
+
+		// Queries
+		uint64_t Count()                  const;
+		double Sum()                      const;
+		double Mean()                     const;
+		double Max()                      const;
+		double Percentile(double p)       const; // p in [0,1]
+		int BucketCount()                 const;
+		uint64_t BucketSampleCount(int i) const;
+		double BucketUpperBound(int i)    const; // infinite for the last one
+
+	private:
+		// Members
+		std::vector<uint64_t> mBuckets;
+		double                mResolution;
+		double                mSum;
+		double                mMax;
+		uint64_t              mCount;
+	};
+
+
+	// JSON writer
+	// (objects and arrays must be closed in order)
+	class JsonWriter
+	{
+	public:
+		// Constructors
+		explicit JsonWriter(std::ostream& stream);
+
+		// Structure
+		void BeginObject();
+		void BeginObject(const std::string& key);
+		void EndObject();
+		void BeginArray();
+		void BeginArray(const std::string& key);
+		void EndArray();
+
+		// Members
+		void Write(const std::string& key, double value);
+		void Write(const std::string& key, const std::string& value);
+		void Write(const std::string& key, const char* value);
+		void Write(const std::string& key, bool value);
+
+		// Array elements
+		void Write(double value);
+
+	private:
+		// Internal manipulation
+		void _Separate();
+		void _Key(const std::string& key);
+		void _String(const std::string& value);
+		void _Number(double value);
+
+		// Members
+		std::ostream&     mStream;
+		std::vector<bool> mIsFirst; // one flag per open scope
+	};
+
+
+	// JSON value (read only)
+	class JsonValue
+	{
+	public:
+		// Constants
+		enum Type
+		{
+			TYPE_NULL = 0,
+			TYPE_BOOLEAN,
+			TYPE_NUMBER,
+			TYPE_STRING,
+			TYPE_ARRAY,
+			TYPE_OBJECT
+		};
+
+		// Factories
+		static JsonValue Parse(const std::string& text) throw(BenchException);
+		static JsonValue Load(const std::string& filename)
+		                                                throw(BenchException);
+
+		// Constructors
+		JsonValue();
+
+		// Access operators (return a null value if not found)
+		const JsonValue& operator[](size_t index) const;
+		const JsonValue& operator[](const std::string& key) const;
+
+		// Queries
+		Type GetType()                         const;
+		bool IsNull()                          const;
+		bool HasMember(const std::string& key) const;
+		size_t Size()                          const; // array/object size
+		const std::string& MemberName(size_t index) const;
+
+		// Accessors
+		bool AsBoolean()              const;
+		double AsNumber()             const; // nan if null
+		const std::string& AsString() const;
+
+	private:
+		// Internal parsing
+		friend class _JsonParser;
+
+		// Members
+		Type                     mType;
+		bool                     mBoolean;
+		double                   mNumber;
+		std::string              mString;
+		std::vector<std::string> mNames;    // object member names
+		std::vector<JsonValue>   mElements; // array elements/object members
+	};
+
+} // namespace bench
+
+#endif
+
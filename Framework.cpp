@@ -6,6 +6,7 @@
 #include <sstream> // std::stringstream
 #include <iostream> // std::cerr
 #include <algorithm> // std::min std::max
+#include <cassert> // assert
 
 #ifdef _WIN32
 #	define NOMINMAX
@@ -13,8 +14,18 @@
 #	include <winbase.h>
 #else
 #	include <sys/time.h>
+#	include <pthread.h>
+#	include <sched.h>
+#	include <unistd.h>
+#	include <time.h>
 #endif // _WIN32
 
+#ifdef _MSC_VER
+#	define FW_THREAD_LOCAL __declspec(thread)
+#else
+#	define FW_THREAD_LOCAL __thread
+#endif
+
 namespace fw
 {
 ////////////////////////////////////////////////////////////////////////////////
@@ -75,6 +86,15 @@ public:
 	}
 };
 
+class _ThreadCreationFailedException : public FWException
+{
+public:
+	_ThreadCreationFailedException()
+	{
+		mMessage = "Failed to create a thread.";
+	}
+};
+
 class _InvalidViewportDimensionsException : public FWException
 {
 public:
@@ -185,21 +205,6 @@ static const std::string _gl_error_to_string(GLenum error)
 }
 
 
-////////////////////////////////////////////////////////////////////////////////
-// OpenGL Debug ARB callback
-static GLvoid _gl_debug_message_callback( GLenum source,
-                                          GLenum type,
-                                          GLuint id,
-                                          GLenum severity,
-                                          GLsizei length,
-                                          const GLchar* message,
-                                          GLvoid* userParam )
-{
-	std::cerr << "[DEBUG_OUTPUT] " << message << std::endl;
-	//throw _GLErrorException(message);
-}
-
-
 ////////////////////////////////////////////////////////////////////////////////
 // Functions implementation
 //
@@ -284,6 +289,12 @@ GLvoid build_glsl_program( GLuint program,
 			fsource.insert(posbu, "#define _FRAGMENT_\n");
 			_attach_shader(program, GL_FRAGMENT_SHADER, fsource.data());
 		}
+		if(source.find("_COMPUTE_") != std::string::npos)
+		{
+			std::string csource = source;
+			csource.insert(posbu, "#define _COMPUTE_\n");
+			_attach_shader(program, GL_COMPUTE_SHADER, csource.data());
+		}
 	}
 	catch(FWException& e)
 	{
@@ -292,17 +303,24 @@ GLvoid build_glsl_program( GLuint program,
 
 	// Link program if asked
 	if(GL_TRUE == link)
+		link_glsl_program(program, srcfile);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Link GLSL program
+GLvoid link_glsl_program( GLuint program,
+                          const std::string& name ) throw(FWException)
+{
+	glLinkProgram(program);
+	// check link
+	GLint linkStatus = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+	if(GL_FALSE == linkStatus)
 	{
-		glLinkProgram(program);
-		// check link
-		GLint linkStatus = 0;
-		glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-		if(GL_FALSE == linkStatus)
-		{
-			GLchar logContent[512];
-			glGetProgramInfoLog(program, 512, NULL, logContent);
-			throw _ProgramLinkFailException(srcfile, logContent);
-		}
+		GLchar logContent[512];
+		glGetProgramInfoLog(program, 512, NULL, logContent);
+		throw _ProgramLinkFailException(name, logContent);
 	}
 }
 
@@ -311,14 +329,11 @@ GLvoid build_glsl_program( GLuint program,
 // Check OpenGL error
 GLvoid check_gl_error() throw (FWException)
 {
-	static bool isArbDebugOutputConfigured = false;
-	if(GLEW_ARB_debug_output && !isArbDebugOutputConfigured)
-	{
-		glDebugMessageCallbackARB(
-			reinterpret_cast<GLDEBUGPROCARB>(&_gl_debug_message_callback),
-			NULL );
-		isArbDebugOutputConfigured = true;
-	}
+	if(!DebugOutput::sIsConfigured)
+		DebugOutput::_Configure();
+	if(!DebugOutput::_IsCheckDue())
+		return;
+	DebugOutput::_PrintNewMessages();
 	GLenum error = glGetError();
 	if(GL_NO_ERROR != error)
 	{
@@ -819,6 +834,70 @@ double Timer::Ticks() const
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// GpuTimer implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// GpuTimer Constructor / Destructor
+GpuTimer::GpuTimer() :
+	mActiveQuery(0), mIsTicking(false), mTicks(0.0)
+{
+	glGenQueries(2, mQueries);
+	mIsPending[0] = mIsPending[1] = false;
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(2, mQueries);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GpuTimer::Start
+void GpuTimer::Start()
+{
+	if(mIsTicking)
+		return;
+
+	// read the result of the query before reusing it
+	if(mIsPending[mActiveQuery])
+	{
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(mQueries[mActiveQuery],
+		                      GL_QUERY_RESULT,
+		                      &elapsed);
+		mTicks = double(elapsed) * 1e-9;
+		mIsPending[mActiveQuery] = false;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, mQueries[mActiveQuery]);
+	mIsTicking = true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GpuTimer::Stop
+void GpuTimer::Stop()
+{
+	if(!mIsTicking)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	mIsPending[mActiveQuery] = true;
+	mActiveQuery = 1 - mActiveQuery;
+	mIsTicking   = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GpuTimer::Ticks
+double GpuTimer::Ticks() const
+{
+	return mTicks;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Tga local functions/constants
 //
@@ -1334,6 +1413,29 @@ Tga::~Tga()
 }
 
 
+#if __cplusplus >= 201103L
+////////////////////////////////////////////////////////////////////////////////
+// Move constructor / assignment
+Tga::Tga(Tga&& tga) throw():
+mPixels(NULL),
+mWidth(0), mHeight(0),
+mPixelFormat(PIXEL_FORMAT_UNKNOWN)
+{
+	Swap(tga);
+}
+
+Tga& Tga::operator=(Tga&& tga) throw()
+{
+	if(this != &tga)
+	{
+		_Clear();
+		Swap(tga);
+	}
+	return *this;
+}
+#endif
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Load from file
 void Tga::Load(const std::string& filename) throw(FWException)
@@ -1425,12 +1527,46 @@ void Tga::Load(const std::string& filename) throw(FWException)
 //}
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Release / Adopt / Swap
+GLubyte* Tga::Release() throw()
+{
+	GLubyte* pixels = mPixels;
+	mPixels = NULL;
+	_Clear();
+	return pixels;
+}
+
+void Tga::Adopt(GLubyte* pixels,
+                GLushort width,
+                GLushort height,
+                GLint pixelFormat) throw()
+{
+	_Clear();
+	mPixels      = pixels;
+	mWidth       = width;
+	mHeight      = height;
+	mPixelFormat = pixelFormat;
+}
+
+void Tga::Swap(Tga& tga) throw()
+{
+	std::swap(mPixels, tga.mPixels);
+	std::swap(mWidth, tga.mWidth);
+	std::swap(mHeight, tga.mHeight);
+	std::swap(mPixelFormat, tga.mPixelFormat);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Clear
 void Tga::_Clear()
 {
 	delete[] mPixels;
-	mPixels = NULL;
+	mPixels      = NULL;
+	mWidth       = 0;
+	mHeight      = 0;
+	mPixelFormat = PIXEL_FORMAT_UNKNOWN;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1440,5 +1576,1583 @@ GLushort Tga::Height()   const {return mHeight;}
 GLint Tga::PixelFormat() const {return mPixelFormat;}
 GLubyte* Tga::Pixels()   const {return mPixels;}
 
-} // namespace fw
 
+////////////////////////////////////////////////////////////////////////////////
+// DrawIndirectBatch implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// static data
+PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC DrawIndirectBatch::sMultiDraw = NULL;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+DrawIndirectBatch::DrawIndirectBatch() :
+	mDraws(), mRanges(), mDrawCallCnt(0)
+{}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear
+void DrawIndirectBatch::Clear()
+{
+	mDraws.clear();
+	mRanges.clear();
+	mDrawCallCnt = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Add a draw
+void DrawIndirectBatch::Add(GLuint material,
+                            GLuint first,
+                            GLuint count,
+                            GLuint instanceCount,
+                            GLuint baseInstance)
+{
+	_Draw draw;
+	draw.material              = material;
+	draw.command.count         = count;
+	draw.command.instanceCount = instanceCount;
+	draw.command.first         = first;
+	draw.command.baseInstance  = baseInstance;
+	mDraws.push_back(draw);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Sort and write commands
+bool DrawIndirectBatch::_CompareMaterials(const _Draw& d1, const _Draw& d2)
+{
+	return d1.material < d2.material;
+}
+
+void DrawIndirectBatch::Write(Command* commands)
+{
+	// sort by material (keep submission order within a material)
+	std::stable_sort(mDraws.begin(), mDraws.end(), &_CompareMaterials);
+
+	// write commands and build material ranges
+	mRanges.clear();
+	for(GLsizei i=0; i<GLsizei(mDraws.size()); ++i)
+	{
+		commands[i] = mDraws[i].command;
+		if(mRanges.empty() || mRanges.back().material != mDraws[i].material)
+		{
+			_Range range;
+			range.material = mDraws[i].material;
+			range.first    = i;
+			range.count    = 0;
+			mRanges.push_back(range);
+		}
+		++mRanges.back().count;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Draw a material
+void DrawIndirectBatch::Draw(GLenum mode,
+                             GLsizei materialIndex,
+                             GLintptr commandOffset)
+{
+	const _Range& range = mRanges[materialIndex];
+	GLintptr offset     = commandOffset + range.first*sizeof(Command);
+
+	if(NULL != sMultiDraw)
+	{
+		sMultiDraw(mode, FW_BUFFER_OFFSET(offset), range.count, 0);
+		++mDrawCallCnt;
+	}
+	else for(GLsizei i=0; i<range.count; ++i)
+	{
+		glDrawArraysIndirect(mode, FW_BUFFER_OFFSET(offset+i*sizeof(Command)));
+		++mDrawCallCnt;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Multi draw entry point
+void DrawIndirectBatch::SetMultiDrawFunction(
+                                       PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC f)
+{
+	sMultiDraw = f;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Accessors
+GLsizei DrawIndirectBatch::CommandCount()  const {return mDraws.size();}
+GLsizei DrawIndirectBatch::MaterialCount() const {return mRanges.size();}
+GLsizei DrawIndirectBatch::DrawCount()     const {return mDraws.size();}
+GLsizei DrawIndirectBatch::DrawCallCount() const {return mDrawCallCnt;}
+GLuint DrawIndirectBatch::Material(GLsizei index) const
+{return mRanges[index].material;}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// StateCache implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// unknown state
+static const GLuint _STATE_UNKNOWN = ~GLuint(0);
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+StateCache::StateCache() :
+	mIssuedCnt(0), mElidedCnt(0)
+{
+	Reset();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Reset
+void StateCache::Reset()
+{
+	mProgram            = _STATE_UNKNOWN;
+	mVertexArray        = _STATE_UNKNOWN;
+	mActiveTexture      = _STATE_UNKNOWN;
+	mArrayBuffer        = _STATE_UNKNOWN;
+	mUniformBuffer      = _STATE_UNKNOWN;
+	mDrawIndirectBuffer = _STATE_UNKNOWN;
+	mCopyReadBuffer     = _STATE_UNKNOWN;
+	mCopyWriteBuffer    = _STATE_UNKNOWN;
+	for(GLuint i=0; i<TEXTURE_UNIT_COUNT; ++i)
+		mTextures[i] = _STATE_UNKNOWN;
+}
+
+void StateCache::ResetCounters()
+{
+	mIssuedCnt = 0;
+	mElidedCnt = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Update a state (returns true if the call must be issued)
+bool StateCache::_Update(GLuint& state, GLuint value)
+{
+	if(state == value)
+	{
+		++mElidedCnt;
+		return false;
+	}
+	state = value;
+	++mIssuedCnt;
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Binds
+void StateCache::UseProgram(GLuint program)
+{
+	if(_Update(mProgram, program))
+		glUseProgram(program);
+}
+
+void StateCache::BindVertexArray(GLuint vertexArray)
+{
+	if(_Update(mVertexArray, vertexArray))
+		glBindVertexArray(vertexArray);
+}
+
+void StateCache::ActiveTexture(GLuint unit)
+{
+	if(_Update(mActiveTexture, unit))
+		glActiveTexture(GL_TEXTURE0+unit);
+}
+
+void StateCache::BindTexture(GLuint unit, GLuint texture)
+{
+	if(unit >= TEXTURE_UNIT_COUNT)
+	{
+		ActiveTexture(unit);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		++mIssuedCnt;
+	}
+	else if(texture == mTextures[unit])
+		++mElidedCnt;
+	else
+	{
+		ActiveTexture(unit);
+		_Update(mTextures[unit], texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+	}
+}
+
+GLuint* StateCache::_BufferState(GLenum target)
+{
+	switch(target)
+	{
+		case GL_ARRAY_BUFFER:         return &mArrayBuffer;
+		case GL_UNIFORM_BUFFER:       return &mUniformBuffer;
+		case GL_DRAW_INDIRECT_BUFFER: return &mDrawIndirectBuffer;
+		case GL_COPY_READ_BUFFER:     return &mCopyReadBuffer;
+		case GL_COPY_WRITE_BUFFER:    return &mCopyWriteBuffer;
+		default:                      return NULL;
+	}
+}
+
+void StateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	GLuint* state = _BufferState(target);
+	if(NULL == state)
+	{
+		glBindBuffer(target, buffer);
+		++mIssuedCnt;
+	}
+	else if(_Update(*state, buffer))
+		glBindBuffer(target, buffer);
+}
+
+void StateCache::BindBufferRange(GLenum target,
+                                 GLuint index,
+                                 GLuint buffer,
+                                 GLintptr offset,
+                                 GLsizeiptr size)
+{
+	// also binds the generic binding point
+	glBindBufferRange(target, index, buffer, offset, size);
+	GLuint* state = _BufferState(target);
+	if(NULL != state)
+		*state = buffer;
+	++mIssuedCnt;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Accessors
+GLuint StateCache::IssuedCount() const {return mIssuedCnt;}
+GLuint StateCache::ElidedCount() const {return mElidedCnt;}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// RenderQueue implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Packet constructor
+RenderQueue::Packet::Packet() :
+	program(0), textureUnit(0), texture(0), vertexArray(0), depth(0.0f),
+	mode(GL_TRIANGLES), first(0), count(0), instanceCount(1), baseInstance(0),
+	batch(NULL), batchMaterial(0), indirectBuffer(0), commandOffset(0),
+	transformFeedback(0)
+{}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+RenderQueue::RenderQueue() :
+	mPackets(), mEntries(), mScratch(),
+	mPrograms(), mTextures(), mVertexArrays(),
+	mDrawCallCnt(0)
+{}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear
+void RenderQueue::Clear()
+{
+	mPackets.clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Push
+void RenderQueue::Push(const Packet& packet)
+{
+	mPackets.push_back(packet);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Sort key
+uint64_t RenderQueue::SortKey(GLuint program,
+                              GLuint texture,
+                              GLuint vertexArray,
+                              GLfloat depth)
+{
+	const GLuint   INDEX_MAX = 0xFFF;
+	const GLfloat  DEPTH_MAX = GLfloat((1u << 28) - 1u);
+	assert(program <= INDEX_MAX
+	    && texture <= INDEX_MAX
+	    && vertexArray <= INDEX_MAX);
+	depth = std::min(std::max(depth, 0.0f), 1.0f);
+
+	return uint64_t(std::min(program,     INDEX_MAX)) << 52
+	     | uint64_t(std::min(texture,     INDEX_MAX)) << 40
+	     | uint64_t(std::min(vertexArray, INDEX_MAX)) << 28
+	     | uint64_t(depth * DEPTH_MAX);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Dense index of a name (names must be sorted and hold the name)
+GLuint RenderQueue::_Index(const std::vector<GLuint>& names, GLuint name)
+{
+	return std::lower_bound(names.begin(), names.end(), name) - names.begin();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Sort (LSD radix sort, 8 bits per pass)
+void RenderQueue::_Sort()
+{
+	const GLuint entryCnt = mPackets.size();
+	mEntries.resize(entryCnt);
+	mScratch.resize(entryCnt);
+
+	// map the names to dense indices, so that any name fits in the key
+	mPrograms.resize(entryCnt);
+	mTextures.resize(entryCnt);
+	mVertexArrays.resize(entryCnt);
+	for(GLuint i=0; i<entryCnt; ++i)
+	{
+		mPrograms[i]     = mPackets[i].program;
+		mTextures[i]     = mPackets[i].texture;
+		mVertexArrays[i] = mPackets[i].vertexArray;
+	}
+	std::sort(mPrograms.begin(), mPrograms.end());
+	mPrograms.erase(std::unique(mPrograms.begin(), mPrograms.end()),
+	                mPrograms.end());
+	std::sort(mTextures.begin(), mTextures.end());
+	mTextures.erase(std::unique(mTextures.begin(), mTextures.end()),
+	                mTextures.end());
+	std::sort(mVertexArrays.begin(), mVertexArrays.end());
+	mVertexArrays.erase(std::unique(mVertexArrays.begin(),
+	                                mVertexArrays.end()),
+	                    mVertexArrays.end());
+
+	for(GLuint i=0; i<entryCnt; ++i)
+	{
+		const Packet& packet = mPackets[i];
+		mEntries[i].key    = SortKey(_Index(mPrograms, packet.program),
+		                             _Index(mTextures, packet.texture),
+		                             _Index(mVertexArrays, packet.vertexArray),
+		                             packet.depth);
+		mEntries[i].packet = i;
+	}
+
+	for(GLuint shift=0; shift<64; shift+=8)
+	{
+		// histogram
+		GLuint offsets[256] = {0};
+		for(GLuint i=0; i<entryCnt; ++i)
+			++offsets[(mEntries[i].key >> shift) & 0xFF];
+
+		// skip the pass if all the keys share the same digit
+		if(entryCnt == 0
+		|| offsets[(mEntries[0].key >> shift) & 0xFF] == entryCnt)
+			continue;
+
+		// prefix sum and scatter (stable)
+		GLuint sum = 0;
+		for(GLuint i=0; i<256; ++i)
+		{
+			GLuint count = offsets[i];
+			offsets[i]   = sum;
+			sum         += count;
+		}
+		for(GLuint i=0; i<entryCnt; ++i)
+			mScratch[offsets[(mEntries[i].key >> shift) & 0xFF]++] = mEntries[i];
+		mEntries.swap(mScratch);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Submit
+void RenderQueue::Submit(StateCache& stateCache)
+{
+	_Sort();
+
+	mDrawCallCnt = 0;
+	for(GLuint i=0; i<mEntries.size(); ++i)
+	{
+		const Packet& packet = mPackets[mEntries[i].packet];
+
+		// set state
+		stateCache.UseProgram(packet.program);
+		stateCache.BindTexture(packet.textureUnit, packet.texture);
+		stateCache.BindVertexArray(packet.vertexArray);
+
+		// draw
+		if(0 != packet.transformFeedback)
+		{
+			glDrawTransformFeedbackInstanced(packet.mode,
+			                                 packet.transformFeedback,
+			                                 packet.instanceCount);
+			++mDrawCallCnt;
+		}
+		else if(NULL != packet.batch)
+		{
+			GLsizei callCnt = packet.batch->DrawCallCount();
+			stateCache.BindBuffer(GL_DRAW_INDIRECT_BUFFER, packet.indirectBuffer);
+			packet.batch->Draw(packet.mode,
+			                   packet.batchMaterial,
+			                   packet.commandOffset);
+			mDrawCallCnt += packet.batch->DrawCallCount() - callCnt;
+		}
+		else
+		{
+			glDrawArraysInstancedBaseInstance(packet.mode,
+			                                  packet.first,
+			                                  packet.count,
+			                                  packet.instanceCount,
+			                                  packet.baseInstance);
+			++mDrawCallCnt;
+		}
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Accessors
+GLsizei RenderQueue::PacketCount()   const {return mPackets.size();}
+GLsizei RenderQueue::DrawCallCount() const {return mDrawCallCnt;}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTracker implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTracker Constructor
+MemoryTracker::MemoryTracker() :
+	mCategories(), mObjects(), mIsEvicting(false)
+{}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTracker categories
+GLint MemoryTracker::AddCategory(const std::string& name, size_t budget)
+{
+	_Category category;
+	category.name        = name;
+	category.size        = 0;
+	category.peakSize    = 0;
+	category.budget      = budget;
+	category.objectCnt   = 0;
+	category.evictionCnt = 0;
+	mCategories.push_back(category);
+	return mCategories.size() - 1;
+}
+
+void MemoryTracker::SetBudget(GLint category, size_t budget)
+{
+	mCategories[category].budget = budget;
+	_Evict(category);
+}
+
+void MemoryTracker::AddEvictionCallback(GLint category,
+                                        MemoryTracker::EvictionFunction function,
+                                        void* data)
+{
+	_Callback callback;
+	callback.function = function;
+	callback.data     = data;
+	mCategories[category].callbacks.push_back(callback);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTracker::_Track
+void MemoryTracker::_Track(const MemoryTracker::_Key& key,
+                           GLint category,
+                           size_t size)
+{
+#ifndef NDEBUG
+	assert(category >= 0 && category < GLint(mCategories.size()));
+#endif
+	_Untrack(key);
+	_Object& object = mObjects[key];
+	object.category = category;
+	object.size     = size;
+
+	_Category& data = mCategories[category];
+	data.size     += size;
+	data.peakSize  = std::max(data.peakSize, data.size);
+	++data.objectCnt;
+	_Evict(category);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTracker::_Untrack
+void MemoryTracker::_Untrack(const MemoryTracker::_Key& key)
+{
+	std::map<_Key, _Object>::iterator it = mObjects.find(key);
+	if(it == mObjects.end())
+		return;
+	_Category& data = mCategories[it->second.category];
+	data.size -= it->second.size;
+	--data.objectCnt;
+	mObjects.erase(it);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTracker::_Evict (each callback is called once at most)
+void MemoryTracker::_Evict(GLint category)
+{
+	_Category& data = mCategories[category];
+	if(mIsEvicting || 0 == data.budget || data.size <= data.budget)
+		return;
+	mIsEvicting = true;
+	for(size_t i=0; i<data.callbacks.size() && data.size > data.budget; ++i)
+	{
+		data.callbacks[i].function(category,
+		                           data.size - data.budget,
+		                           data.callbacks[i].data);
+		++data.evictionCnt;
+	}
+	mIsEvicting = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTracker tracking
+void MemoryTracker::Track(GLint category, const void* memory, size_t size)
+{
+	_Track(_Key(KEY_MEMORY, reinterpret_cast<size_t>(memory)), category, size);
+}
+
+void MemoryTracker::Untrack(const void* memory)
+{
+	_Untrack(_Key(KEY_MEMORY, reinterpret_cast<size_t>(memory)));
+}
+
+void MemoryTracker::TrackBuffer(GLint category, GLuint buffer)
+{
+	_Track(_Key(KEY_BUFFER, buffer), category, BufferSize(buffer));
+}
+
+void MemoryTracker::UntrackBuffer(GLuint buffer)
+{
+	_Untrack(_Key(KEY_BUFFER, buffer));
+}
+
+void MemoryTracker::TrackTexture(GLint category, GLenum target, GLuint texture)
+{
+	_Track(_Key(KEY_TEXTURE, texture), category, TextureSize(target, texture));
+}
+
+void MemoryTracker::UntrackTexture(GLuint texture)
+{
+	_Untrack(_Key(KEY_TEXTURE, texture));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTracker queries
+GLint MemoryTracker::CategoryCount() const
+{
+	return mCategories.size();
+}
+
+const std::string& MemoryTracker::CategoryName(GLint category) const
+{
+	return mCategories[category].name;
+}
+
+size_t MemoryTracker::Size(GLint category) const
+{
+	return mCategories[category].size;
+}
+
+size_t MemoryTracker::PeakSize(GLint category) const
+{
+	return mCategories[category].peakSize;
+}
+
+size_t MemoryTracker::Budget(GLint category) const
+{
+	return mCategories[category].budget;
+}
+
+GLint MemoryTracker::ObjectCount(GLint category) const
+{
+	return mCategories[category].objectCnt;
+}
+
+GLint MemoryTracker::EvictionCount(GLint category) const
+{
+	return mCategories[category].evictionCnt;
+}
+
+size_t MemoryTracker::TotalSize() const
+{
+	size_t size = 0;
+	for(size_t i=0; i<mCategories.size(); ++i)
+		size += mCategories[i].size;
+	return size;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTracker::BufferSize
+size_t MemoryTracker::BufferSize(GLuint buffer)
+{
+	GLint binding = 0, size = 0;
+	glGetIntegerv(GL_COPY_READ_BUFFER, &binding);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+	glBindBuffer(GL_COPY_READ_BUFFER, binding);
+	return size;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MemoryTracker::TextureSize (texels are counted at the resolution of their
+// components; buffer textures have no storage of their own)
+size_t MemoryTracker::TextureSize(GLenum target, GLuint texture)
+{
+	GLenum binding = GL_NONE;
+	switch(target)
+	{
+		case GL_TEXTURE_1D:       binding = GL_TEXTURE_BINDING_1D; break;
+		case GL_TEXTURE_2D:       binding = GL_TEXTURE_BINDING_2D; break;
+		case GL_TEXTURE_3D:       binding = GL_TEXTURE_BINDING_3D; break;
+		case GL_TEXTURE_1D_ARRAY: binding = GL_TEXTURE_BINDING_1D_ARRAY; break;
+		case GL_TEXTURE_2D_ARRAY: binding = GL_TEXTURE_BINDING_2D_ARRAY; break;
+		case GL_TEXTURE_RECTANGLE:binding = GL_TEXTURE_BINDING_RECTANGLE;break;
+		case GL_TEXTURE_CUBE_MAP: binding = GL_TEXTURE_BINDING_CUBE_MAP; break;
+		default: return 0;
+	}
+	GLint previous = 0;
+	glGetIntegerv(binding, &previous);
+	glBindTexture(target, texture);
+
+	// cube maps are queried face by face
+	const GLenum COMPONENTS[] = {GL_TEXTURE_RED_SIZE,
+	                             GL_TEXTURE_GREEN_SIZE,
+	                             GL_TEXTURE_BLUE_SIZE,
+	                             GL_TEXTURE_ALPHA_SIZE,
+	                             GL_TEXTURE_DEPTH_SIZE,
+	                             GL_TEXTURE_STENCIL_SIZE};
+	GLint faceCnt   = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+	GLenum face     = target == GL_TEXTURE_CUBE_MAP
+	                ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+	size_t faceSize = 0;
+	for(GLint level=0; level<32; ++level)
+	{
+		GLint width = 0, height = 0, depth = 0, isCompressed = 0;
+		glGetTexLevelParameteriv(face, level, GL_TEXTURE_WIDTH, &width);
+		if(0 == width)
+			break;
+		glGetTexLevelParameteriv(face, level, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(face, level, GL_TEXTURE_DEPTH, &depth);
+		glGetTexLevelParameteriv(face,
+		                         level,
+		                         GL_TEXTURE_COMPRESSED,
+		                         &isCompressed);
+		if(isCompressed)
+		{
+			GLint size = 0;
+			glGetTexLevelParameteriv(face,
+			                         level,
+			                         GL_TEXTURE_COMPRESSED_IMAGE_SIZE,
+			                         &size);
+			faceSize += size;
+			continue;
+		}
+		GLint bitCnt = 0;
+		for(GLint i=0; i<GLint(sizeof(COMPONENTS)/sizeof(COMPONENTS[0])); ++i)
+		{
+			GLint bits = 0;
+			glGetTexLevelParameteriv(face, level, COMPONENTS[i], &bits);
+			bitCnt += bits;
+		}
+		faceSize += size_t(width) * std::max(height, 1) * std::max(depth, 1)
+		          * ((bitCnt + 7) / 8);
+	}
+	glBindTexture(target, previous);
+	return faceSize * faceCnt;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DebugOutput implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+PFNGLDEBUGMESSAGECALLBACKARBPROC DebugOutput::sCallbackFunction = NULL;
+#ifndef NDEBUG
+DebugOutput::Mode DebugOutput::sMode = DebugOutput::MODE_FULL;
+#else
+DebugOutput::Mode DebugOutput::sMode = DebugOutput::MODE_OFF;
+#endif
+GLuint DebugOutput::sPeriod       = 1;
+GLuint DebugOutput::sCallCnt      = 0;
+GLuint DebugOutput::sCheckCnt     = 0;
+bool DebugOutput::sIsConfigured   = false;
+DebugOutput::Message DebugOutput::sMessages[MESSAGE_CAPACITY];
+volatile int32_t DebugOutput::sStates[MESSAGE_CAPACITY];
+volatile int32_t DebugOutput::sCounts[MESSAGE_CAPACITY];
+bool DebugOutput::sIsPrinted[MESSAGE_CAPACITY];
+volatile int32_t DebugOutput::sTotalCnt       = 0;
+volatile int32_t DebugOutput::sPerformanceCnt = 0;
+volatile int32_t DebugOutput::sDroppedCnt     = 0;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DebugOutput::SetCallbackFunction
+void DebugOutput::SetCallbackFunction(PFNGLDEBUGMESSAGECALLBACKARBPROC f)
+{
+	sCallbackFunction = f;
+	sIsConfigured     = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DebugOutput::SetMode
+void DebugOutput::SetMode(DebugOutput::Mode mode, GLuint period)
+{
+	sMode   = mode;
+	sPeriod = std::max(period, GLuint(1));
+	_Configure();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DebugOutput::_Configure (installs the callback, and enables the messages
+// unless the checks are off)
+void DebugOutput::_Configure()
+{
+	GLboolean isEnabled = MODE_OFF != sMode ? GL_TRUE : GL_FALSE;
+	if(NULL != sCallbackFunction)
+	{
+		sCallbackFunction(reinterpret_cast<GLDEBUGPROCARB>(&_Callback), NULL);
+		if(isEnabled)
+			glEnable(GL_DEBUG_OUTPUT);
+		else
+			glDisable(GL_DEBUG_OUTPUT);
+	}
+	else if(GLEW_ARB_debug_output)
+	{
+		glDebugMessageCallbackARB(reinterpret_cast<GLDEBUGPROCARB>(&_Callback),
+		                          NULL);
+		glDebugMessageControlARB(GL_DONT_CARE,
+		                         GL_DONT_CARE,
+		                         GL_DONT_CARE,
+		                         0,
+		                         NULL,
+		                         isEnabled);
+	}
+	sIsConfigured = true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DebugOutput::_IsCheckDue (called once per check_gl_error call)
+bool DebugOutput::_IsCheckDue()
+{
+	bool isDue = MODE_FULL == sMode
+	          || (MODE_SAMPLED == sMode && 0 == sCallCnt % sPeriod);
+	++sCallCnt;
+	sCheckCnt += isDue ? 1 : 0;
+	return isDue;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DebugOutput::_PrintNewMessages (first occurrence of the messages, but the
+// notifications)
+void DebugOutput::_PrintNewMessages()
+{
+	for(GLint i=0; i<MESSAGE_CAPACITY; ++i)
+		if(2 == sStates[i] && !sIsPrinted[i])
+		{
+			memory_barrier();
+			if(GL_DEBUG_SEVERITY_NOTIFICATION != sMessages[i].severity)
+				std::cerr << "[DEBUG_OUTPUT] " << sMessages[i].text
+				          << std::endl;
+			sIsPrinted[i] = true;
+		}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DebugOutput::_Callback (messages are hashed in the table; a free slot is
+// claimed with a compare and exchange, then filled and published)
+void GLAPIENTRY DebugOutput::_Callback(GLenum source,
+                                       GLenum type,
+                                       GLuint id,
+                                       GLenum severity,
+                                       GLsizei,
+                                       const GLchar* message,
+                                       GLvoid*)
+{
+	atomic_add(&sTotalCnt, 1);
+	if(GL_DEBUG_TYPE_PERFORMANCE_ARB == type)
+		atomic_add(&sPerformanceCnt, 1);
+
+	uint32_t hash = id*2654435761u ^ source*40503u ^ type*31u ^ severity;
+	for(GLint i=0; i<MESSAGE_CAPACITY; ++i)
+	{
+		GLint slot = (hash + i) % MESSAGE_CAPACITY;
+		if(0 == sStates[slot] && atomic_compare_exchange(&sStates[slot], 0, 1))
+		{
+			Message& entry = sMessages[slot];
+			entry.source   = source;
+			entry.type     = type;
+			entry.id       = id;
+			entry.severity = severity;
+			GLint length = 0;
+			for(; length < MESSAGE_LENGTH-1 && message[length]; ++length)
+				entry.text[length] = message[length];
+			entry.text[length] = '\0';
+			atomic_add(&sCounts[slot], 1);
+			atomic_add(&sStates[slot], 1); // publish
+			return;
+		}
+		while(1 == sStates[slot]) // being written by another thread
+			Thread::YieldThread();
+		memory_barrier();
+		const Message& entry = sMessages[slot];
+		if(entry.source == source && entry.type == type
+		&& entry.id == id && entry.severity == severity)
+		{
+			atomic_add(&sCounts[slot], 1);
+			return;
+		}
+	}
+	atomic_add(&sDroppedCnt, 1);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DebugOutput queries
+DebugOutput::Mode DebugOutput::GetMode()
+{
+	return sMode;
+}
+
+GLuint DebugOutput::Period()
+{
+	return sPeriod;
+}
+
+bool DebugOutput::IsSupported()
+{
+	return NULL != sCallbackFunction || GLEW_ARB_debug_output;
+}
+
+GLint DebugOutput::MessageCount()
+{
+	GLint messageCnt = 0;
+	for(GLint i=0; i<MESSAGE_CAPACITY; ++i)
+		messageCnt += 2 == sStates[i] ? 1 : 0;
+	return messageCnt;
+}
+
+bool DebugOutput::ReadMessage(GLint index, DebugOutput::Message& message)
+{
+	for(GLint i=0; i<MESSAGE_CAPACITY; ++i)
+		if(2 == sStates[i] && 0 == index--)
+		{
+			memory_barrier();
+			message       = sMessages[i];
+			message.count = sCounts[i];
+			return true;
+		}
+	return false;
+}
+
+GLuint DebugOutput::TotalCount()
+{
+	return sTotalCnt;
+}
+
+GLuint DebugOutput::PerformanceWarningCount()
+{
+	return sPerformanceCnt;
+}
+
+GLuint DebugOutput::DroppedCount()
+{
+	return sDroppedCnt;
+}
+
+GLuint DebugOutput::CheckCount()
+{
+	return sCheckCnt;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Atomic operations
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t atomic_add(volatile int32_t* value, int32_t increment)
+{
+#ifdef _WIN32
+	return InterlockedExchangeAdd(reinterpret_cast<volatile LONG*>(value),
+	                              increment) + increment;
+#else
+	return __sync_add_and_fetch(value, increment);
+#endif
+}
+
+bool atomic_compare_exchange(volatile int32_t* value,
+                             int32_t expected,
+                             int32_t desired)
+{
+#ifdef _WIN32
+	return expected == InterlockedCompareExchange(
+	                       reinterpret_cast<volatile LONG*>(value),
+	                       desired,
+	                       expected);
+#else
+	return __sync_bool_compare_and_swap(value, expected, desired);
+#endif
+}
+
+void memory_barrier()
+{
+#ifdef _WIN32
+	MemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+}
+
+int32_t atomic_load(const volatile int32_t* value)
+{
+#ifdef _WIN32
+	return InterlockedCompareExchange(
+	           const_cast<volatile LONG*>(
+	           reinterpret_cast<const volatile LONG*>(value)),
+	           0,
+	           0);
+#else
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void atomic_store(volatile int32_t* value, int32_t desired)
+{
+#ifdef _WIN32
+	InterlockedExchange(reinterpret_cast<volatile LONG*>(value), desired);
+#else
+	__atomic_store_n(value, desired, __ATOMIC_RELEASE);
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Thread implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Thread local functions
+struct _ThreadStart
+{
+	Thread::Function function;
+	void*            data;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI _thread_main(LPVOID data)
+#else
+static void* _thread_main(void* data)
+#endif
+{
+	_ThreadStart start = *reinterpret_cast<_ThreadStart*>(data);
+	delete reinterpret_cast<_ThreadStart*>(data);
+	start.function(start.data);
+	return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Thread Constructor / Destructor
+Thread::Thread() :
+	mHandle(NULL)
+{}
+
+Thread::~Thread()
+{
+	Join();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Thread::Start
+void Thread::Start(Thread::Function function, void* data) throw(FWException)
+{
+	Join();
+	_ThreadStart* start = new _ThreadStart;
+	start->function = function;
+	start->data     = data;
+#ifdef _WIN32
+	mHandle = CreateThread(NULL, 0, &_thread_main, start, 0, NULL);
+	if(NULL == mHandle)
+#else
+	pthread_t* thread = new pthread_t;
+	if(0 == pthread_create(thread, NULL, &_thread_main, start))
+		mHandle = thread;
+	else
+		delete thread;
+	if(NULL == mHandle)
+#endif
+	{
+		delete start;
+		throw _ThreadCreationFailedException();
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Thread::Join
+void Thread::Join()
+{
+	if(NULL == mHandle)
+		return;
+#ifdef _WIN32
+	WaitForSingleObject(mHandle, INFINITE);
+	CloseHandle(mHandle);
+#else
+	pthread_join(*reinterpret_cast<pthread_t*>(mHandle), NULL);
+	delete reinterpret_cast<pthread_t*>(mHandle);
+#endif
+	mHandle = NULL;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Thread queries
+bool Thread::IsRunning() const
+{
+	return NULL != mHandle;
+}
+
+GLint Thread::HardwareConcurrency()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return std::max(1, GLint(info.dwNumberOfProcessors));
+#else
+	return std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+}
+
+void Thread::YieldThread()
+{
+#ifdef _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+void Thread::SleepThread(double seconds)
+{
+#ifdef _WIN32
+	Sleep(DWORD(seconds*1e3));
+#else
+	usleep(useconds_t(seconds*1e6));
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Signal implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Signal platform data
+struct _SignalData
+{
+#ifdef _WIN32
+	CRITICAL_SECTION   mutex;
+	CONDITION_VARIABLE condition;
+#else
+	pthread_mutex_t    mutex;
+	pthread_cond_t     condition;
+#endif
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Signal Constructor / Destructor
+Signal::Signal() :
+	mHandle(new _SignalData)
+{
+	_SignalData& data = *reinterpret_cast<_SignalData*>(mHandle);
+#ifdef _WIN32
+	InitializeCriticalSection(&data.mutex);
+	InitializeConditionVariable(&data.condition);
+#else
+	pthread_mutex_init(&data.mutex, NULL);
+	pthread_cond_init(&data.condition, NULL);
+#endif
+}
+
+Signal::~Signal()
+{
+	_SignalData& data = *reinterpret_cast<_SignalData*>(mHandle);
+#ifdef _WIN32
+	DeleteCriticalSection(&data.mutex);
+#else
+	pthread_cond_destroy(&data.condition);
+	pthread_mutex_destroy(&data.mutex);
+#endif
+	delete &data;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Signal::Wait
+void Signal::Wait(double timeout)
+{
+	_SignalData& data = *reinterpret_cast<_SignalData*>(mHandle);
+#ifdef _WIN32
+	EnterCriticalSection(&data.mutex);
+	SleepConditionVariableCS(&data.condition, &data.mutex, DWORD(timeout*1e3));
+	LeaveCriticalSection(&data.mutex);
+#else
+	timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	long nanoseconds = long(timeout*1e9);
+	deadline.tv_sec  += nanoseconds / 1000000000;
+	deadline.tv_nsec += nanoseconds % 1000000000;
+	if(deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_nsec -= 1000000000;
+		++deadline.tv_sec;
+	}
+	pthread_mutex_lock(&data.mutex);
+	pthread_cond_timedwait(&data.condition, &data.mutex, &deadline);
+	pthread_mutex_unlock(&data.mutex);
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Signal::Notify
+void Signal::Notify()
+{
+	_SignalData& data = *reinterpret_cast<_SignalData*>(mHandle);
+#ifdef _WIN32
+	EnterCriticalSection(&data.mutex);
+	WakeConditionVariable(&data.condition);
+	LeaveCriticalSection(&data.mutex);
+#else
+	pthread_mutex_lock(&data.mutex);
+	pthread_cond_signal(&data.condition);
+	pthread_mutex_unlock(&data.mutex);
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem local variables/functions
+
+// thread index of the calling thread in the job system it belongs to
+static FW_THREAD_LOCAL const JobSystem* sThreadSystem = NULL;
+static FW_THREAD_LOCAL GLint            sThreadIndex  = -1;
+
+// indices of the deques wrap around
+static inline int32_t _wrap_add(int32_t x, int32_t y)
+{
+	return int32_t(uint32_t(x) + uint32_t(y));
+}
+
+// lock/unlock a spin lock
+static void _lock(volatile int32_t* lock)
+{
+	while(!atomic_compare_exchange(lock, 0, 1))
+		Thread::YieldThread();
+}
+
+static void _unlock(volatile int32_t* lock)
+{
+	atomic_store(lock, 0);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Chase-Lev deque (fixed capacity)
+// The owner pushes and pops at the bottom, thieves steal at the top. Only the
+// last job is disputed with a compare and swap.
+class JobSystem::_Deque
+{
+public:
+	_Deque() : mTop(0), mBottom(0), jobCnt(0), stealCnt(0) {}
+
+	bool Push(const Job& job) // owner only
+	{
+		int32_t b = atomic_load(&mBottom);
+		int32_t t = atomic_load(&mTop);
+		if(_wrap_add(b, -t) >= QUEUE_CAPACITY)
+			return false;
+		mJobs[b & (QUEUE_CAPACITY-1)] = job;
+		atomic_store(&mBottom, _wrap_add(b, 1)); // publishes the job
+		return true;
+	}
+
+	bool Pop(Job& job) // owner only
+	{
+		int32_t b = _wrap_add(atomic_load(&mBottom), -1);
+		atomic_store(&mBottom, b);
+		memory_barrier(); // bottom is published before top is read
+		int32_t t    = atomic_load(&mTop);
+		int32_t size = _wrap_add(b, -t);
+		if(size < 0)
+		{
+			atomic_store(&mBottom, t); // empty
+			return false;
+		}
+		job = mJobs[b & (QUEUE_CAPACITY-1)];
+		if(size > 0)
+			return true;
+
+		// last job: race against the thieves
+		bool isPopped = atomic_compare_exchange(&mTop, t, _wrap_add(t, 1));
+		atomic_store(&mBottom, _wrap_add(t, 1));
+		return isPopped;
+	}
+
+	bool Steal(Job& job) // any thread
+	{
+		int32_t t = atomic_load(&mTop);
+		memory_barrier(); // top is read before bottom
+		int32_t b = atomic_load(&mBottom);
+		if(_wrap_add(b, -t) <= 0)
+			return false;
+		job = mJobs[t & (QUEUE_CAPACITY-1)];
+		return atomic_compare_exchange(&mTop, t, _wrap_add(t, 1));
+	}
+
+private:
+	volatile int32_t mTop;
+	char             _pad0[60];    // top and bottom on different cache lines
+	volatile int32_t mBottom;
+	char             _pad1[60];
+	Job              mJobs[QUEUE_CAPACITY];
+
+public:
+	// counters (written by the owner only)
+	GLuint jobCnt;
+	GLuint stealCnt;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobCounter
+JobCounter::JobCounter() :
+	mValue(0), mLock(0), mDependents()
+{}
+
+GLint JobCounter::Value() const {return mValue;}
+
+// the value is read under the lock: once it is seen at zero, the thread
+// that decremented it does not touch the counter anymore
+bool JobCounter::IsDone() const
+{
+	volatile int32_t* lock = const_cast<volatile int32_t*>(&mLock);
+	_lock(lock);
+	bool isDone = 0 == mValue;
+	_unlock(lock);
+	return isDone;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem Constructor / Destructor
+JobSystem::JobSystem(GLint workerCount) throw(FWException) :
+	mDeques(), mThreads(), mWorkers(), mSignal(),
+	mSleepingCnt(0), mIsRunning(1)
+{
+	if(workerCount < 0)
+		workerCount = Thread::HardwareConcurrency() - 1;
+
+	// the calling thread is thread 0
+	sThreadSystem = this;
+	sThreadIndex  = 0;
+
+	// create all the deques first (the workers steal from any of them),
+	// then start the workers (mDeques and mWorkers are not reallocated
+	// afterwards)
+	for(GLint i=0; i<=workerCount; ++i)
+		mDeques.push_back(new _Deque);
+	mWorkers.resize(workerCount);
+	try
+	{
+		for(GLint i=0; i<workerCount; ++i)
+		{
+			mWorkers[i].system = this;
+			mWorkers[i].index  = i+1;
+			mThreads.push_back(new Thread);
+			mThreads.back()->Start(&JobSystem::_WorkerMain, &mWorkers[i]);
+		}
+	}
+	catch(FWException&)
+	{
+		_Terminate();
+		throw;
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	_Terminate();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem::_Terminate (joins the workers and releases memory)
+void JobSystem::_Terminate()
+{
+	atomic_store(&mIsRunning, 0);
+	for(size_t i=0; i<mThreads.size(); ++i)
+		delete mThreads[i];
+	for(size_t i=0; i<mDeques.size(); ++i)
+		delete mDeques[i];
+	mThreads.clear();
+	mDeques.clear();
+	if(sThreadSystem == this)
+	{
+		sThreadSystem = NULL;
+		sThreadIndex  = -1;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem::_WorkerMain
+void JobSystem::_WorkerMain(void* data)
+{
+	const _Worker& worker = *reinterpret_cast<_Worker*>(data);
+	JobSystem& system     = *worker.system;
+	sThreadSystem = &system;
+	sThreadIndex  = worker.index;
+
+	GLint failureCnt = 0;
+	while(atomic_load(&system.mIsRunning))
+	{
+		Job job;
+		if(system._FindJob(worker.index, job))
+		{
+			system._Execute(worker.index, job);
+			failureCnt = 0;
+		}
+		else if(++failureCnt < SPIN_COUNT)
+			Thread::YieldThread();
+		else
+		{
+			// sleep for at most a millisecond (a missed notification only
+			// delays the worker)
+			atomic_add(&system.mSleepingCnt, 1);
+			system.mSignal.Wait(0.001);
+			atomic_add(&system.mSleepingCnt, -1);
+			failureCnt = 0;
+		}
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem::_ThreadIndex
+GLint JobSystem::_ThreadIndex() const
+{
+	return sThreadSystem == this ? sThreadIndex : -1;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem::_Push (executes the job if it cannot be queued)
+void JobSystem::_Push(const Job& job)
+{
+	GLint thread = _ThreadIndex();
+#ifndef NDEBUG
+	assert(thread >= 0);
+#endif
+	if(thread < 0 || !mDeques[thread]->Push(job))
+	{
+		_Execute(thread, job);
+		return;
+	}
+	if(atomic_load(&mSleepingCnt) > 0)
+		mSignal.Notify();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem::_Execute (schedules the dependents of the counter if it is done)
+void JobSystem::_Execute(GLint thread, const Job& job)
+{
+	job.function(job.data);
+	if(thread >= 0)
+		++mDeques[thread]->jobCnt;
+
+	JobCounter* counter = job.counter;
+	if(NULL == counter)
+		return;
+
+	// the unlock is the last access to the counter (its owner may destroy
+	// it as soon as Wait sees it done)
+	std::vector<Job> dependents;
+	_lock(&counter->mLock);
+	if(0 == atomic_add(&counter->mValue, -1))
+		dependents.swap(counter->mDependents);
+	_unlock(&counter->mLock);
+	for(size_t i=0; i<dependents.size(); ++i)
+		_Push(dependents[i]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem::_FindJob (pop from the own deque, or steal)
+bool JobSystem::_FindJob(GLint thread, Job& job)
+{
+	if(thread >= 0 && mDeques[thread]->Pop(job))
+		return true;
+
+	GLint threadCnt = mDeques.size();
+	for(GLint i=1; i<=threadCnt; ++i)
+	{
+		GLint victim = (thread + i) % threadCnt;
+		if(victim != thread && mDeques[victim]->Steal(job))
+		{
+			if(thread >= 0)
+				++mDeques[thread]->stealCnt;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem::Run
+void JobSystem::Run(JobFunction function,
+                    void* data,
+                    JobCounter* counter,
+                    JobCounter* dependency)
+{
+	Job job;
+	job.function = function;
+	job.data     = data;
+	job.counter  = counter;
+	if(NULL != counter)
+		atomic_add(&counter->mValue, 1);
+
+	// wait for the dependency (the lock orders this test with _Execute)
+	if(NULL != dependency)
+	{
+		_lock(&dependency->mLock);
+		bool isWaiting = 0 != dependency->mValue;
+		if(isWaiting)
+			dependency->mDependents.push_back(job);
+		_unlock(&dependency->mLock);
+		if(isWaiting)
+			return;
+	}
+	_Push(job);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem::Wait
+void JobSystem::Wait(const JobCounter& counter)
+{
+	GLint thread = _ThreadIndex();
+	while(!counter.IsDone())
+	{
+		Job job;
+		if(_FindJob(thread, job))
+			_Execute(thread, job);
+		else
+			Thread::YieldThread();
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem::ParallelFor
+void JobSystem::_RunRange(void* data)
+{
+	const _Range& range = *reinterpret_cast<_Range*>(data);
+	range.function(range.begin, range.end, range.data);
+}
+
+void JobSystem::ParallelFor(GLint begin,
+                            GLint end,
+                            GLint grain,
+                            RangeFunction function,
+                            void* data)
+{
+	if(end <= begin)
+		return;
+	if(grain <= 0)
+		grain = std::max(1, (end - begin) / (4*ThreadCount()));
+	GLint rangeCnt = (end - begin + grain - 1) / grain;
+	if(1 == rangeCnt)
+	{
+		function(begin, end, data);
+		return;
+	}
+
+	// the first ranges are stolen, the last ones are popped by this thread
+	std::vector<_Range> ranges(rangeCnt);
+	JobCounter counter;
+	for(GLint i=0; i<rangeCnt; ++i)
+	{
+		ranges[i].begin    = begin + i*grain;
+		ranges[i].end      = std::min(end, ranges[i].begin + grain);
+		ranges[i].function = function;
+		ranges[i].data     = data;
+		Run(&JobSystem::_RunRange, &ranges[i], &counter);
+	}
+	Wait(counter);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// JobSystem counters
+void JobSystem::ResetCounters()
+{
+	for(size_t i=0; i<mDeques.size(); ++i)
+		mDeques[i]->jobCnt = mDeques[i]->stealCnt = 0;
+}
+
+GLint JobSystem::ThreadCount() const
+{
+	return mDeques.size();
+}
+
+GLuint JobSystem::JobCount() const
+{
+	GLuint jobCnt = 0;
+	for(size_t i=0; i<mDeques.size(); ++i)
+		jobCnt += mDeques[i]->jobCnt;
+	return jobCnt;
+}
+
+GLuint JobSystem::StealCount() const
+{
+	GLuint stealCnt = 0;
+	for(size_t i=0; i<mDeques.size(); ++i)
+		stealCnt += mDeques[i]->stealCnt;
+	return stealCnt;
+}
+
+} // namespace fw
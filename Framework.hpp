@@ -8,11 +8,32 @@
 #define FRAMEWORK_HPP
 
 #include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
 #include "glew.hpp"
 
 // offset for buffer objects
 #define FW_BUFFER_OFFSET(i)    ((char*)NULL + (i))
 
+// GL4.3 compute shaders and shader storage buffers (unknown to GLEW 1.7)
+#ifndef GL_COMPUTE_SHADER
+#	define GL_COMPUTE_SHADER                      0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#	define GL_SHADER_STORAGE_BUFFER               0x90D2
+#	define GL_SHADER_STORAGE_BARRIER_BIT          0x00002000
+#endif
+#ifndef GL_DEBUG_OUTPUT
+#	define GL_DEBUG_OUTPUT                        0x92E0
+#	define GL_DEBUG_SEVERITY_NOTIFICATION         0x826B
+#endif
+#ifndef GL_VERSION_4_3
+typedef void (GLAPIENTRY * PFNGLDISPATCHCOMPUTEPROC) (GLuint numGroupsX,
+                                                      GLuint numGroupsY,
+                                                      GLuint numGroupsZ);
+#endif
+
 namespace fw 
 {
 	// Framework exception
@@ -31,13 +52,23 @@ namespace fw
 
 
 	// Build GLSL program
+	// (stages are enabled by _VERTEX_, _TESS_CONTROL_, _TESS_EVALUATION_, 
+	// _GEOMETRY_, _FRAGMENT_ and _COMPUTE_ sections in the source file)
 	GLvoid build_glsl_program( GLuint program, 
 	                           const std::string& srcfile,
 	                           const std::string& options,
 	                           GLboolean link ) throw(FWException);
 
 
-	// Check OpenGL errors (uses ARB_debug_output if available)
+	// Link GLSL program (e.g. after setting transform feedback varyings)
+	// (name is used in the error message)
+	GLvoid link_glsl_program( GLuint program,
+	                          const std::string& name ) throw(FWException);
+
+
+	// Check OpenGL errors, following the mode of DebugOutput (the first
+	// occurrence of each debug message is printed, and glGetError is called
+	// if the call is checked)
 	// (throws an exception if an error is detected)
 	GLvoid check_gl_error() throw(FWException);
 
@@ -97,6 +128,36 @@ namespace fw
 	};
 
 
+	// GPU timer (GL_TIME_ELAPSED queries, a context must be current)
+	// Results are read two measures late, so the pipeline is not stalled.
+	class GpuTimer
+	{
+	public:
+		// Constructors / Destructor
+		GpuTimer();
+		~GpuTimer();
+
+		// Manipulation
+		void Start();
+		void Stop();
+
+		// Queries
+		double Ticks()   const; // last available measure, in seconds
+
+	private:
+		// Non copyable
+		GpuTimer(const GpuTimer&);
+		GpuTimer& operator=(const GpuTimer&);
+
+		// Members
+		GLuint mQueries[2];
+		bool   mIsPending[2];
+		GLuint mActiveQuery;
+		bool   mIsTicking;
+		double mTicks;
+	};
+
+
 	// Tga image loader
 	class Tga
 	{
@@ -116,10 +177,24 @@ namespace fw
 			// see Load
 		explicit Tga(const std::string& filename) throw(FWException);
 		~Tga();
+#if __cplusplus >= 201103L
+			// the moved image is left empty
+		Tga(Tga&& tga) throw();
+		Tga& operator=(Tga&& tga) throw();
+#endif
 
 		// Manipulation
 			// load from a tga file
 		void Load(const std::string& filename) throw(FWException);
+			// give up the pixels (to be deleted with delete[]); the
+			// image is left empty
+		GLubyte* Release() throw();
+			// take the ownership of pixels allocated with new[]
+		void Adopt(GLubyte* pixels,
+		           GLushort width,
+		           GLushort height,
+		           GLint pixelFormat) throw();
+		void Swap(Tga& tga) throw();
 
 		// Queries
 		GLushort Width()       const;
@@ -149,6 +224,647 @@ namespace fw
 		GLint    mPixelFormat;
 	};
 
+
+	// Indirect draw batch
+	// Collects the draws of a frame and sorts them by material. Each 
+	// material is then drawn with a single multi draw indirect call.
+	// Commands are in the DrawArraysIndirectCommand format (GL4.2, 
+	// with baseInstance), per draw data is fetched with baseInstance.
+	class DrawIndirectBatch
+	{
+	public:
+		// Indirect command
+		struct Command
+		{
+			GLuint count;
+			GLuint instanceCount;
+			GLuint first;
+			GLuint baseInstance;
+		};
+
+		// Constructors / Destructor
+		DrawIndirectBatch();
+
+		// Manipulation
+			// start a new batch (counters are reset)
+		void Clear();
+			// append a draw
+		void Add(GLuint material,
+		         GLuint first,
+		         GLuint count,
+		         GLuint instanceCount,
+		         GLuint baseInstance);
+			// sort the draws by material and write CommandCount() commands
+		void Write(Command* commands);
+			// draw a material (written commands must be bound to 
+			// GL_DRAW_INDIRECT_BUFFER at commandOffset)
+		void Draw(GLenum mode, GLsizei materialIndex, GLintptr commandOffset);
+
+		// Queries
+		GLsizei CommandCount()              const;
+		GLsizei MaterialCount()             const; // valid after Write
+		GLuint  Material(GLsizei index)     const; // valid after Write
+		GLsizei DrawCount()                 const; // draws in the batch
+		GLsizei DrawCallCount()             const; // draw calls issued
+
+		// Multi draw indirect entry point (glMultiDrawArraysIndirect or 
+		// glMultiDrawArraysIndirectAMD). If NULL, each command is issued 
+		// with glDrawArraysIndirect.
+		static void SetMultiDrawFunction(PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC f);
+
+	private:
+		// Internal types
+		struct _Draw
+		{
+			GLuint  material;
+			Command command;
+		};
+		struct _Range
+		{
+			GLuint  material;
+			GLsizei first;
+			GLsizei count;
+		};
+		static bool _CompareMaterials(const _Draw& d1, const _Draw& d2);
+
+		// Members
+		static PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC sMultiDraw;
+		std::vector<_Draw>  mDraws;
+		std::vector<_Range> mRanges;
+		GLsizei mDrawCallCnt;
+	};
+
+
+	// OpenGL state cache
+	// Binds that would not change the state are skipped. The cache must be 
+	// reset whenever the state is modified behind its back (e.g. by a GUI). 
+	// Unknown buffer targets are always issued.
+	class StateCache
+	{
+	public:
+		// Constants
+		enum
+		{
+			TEXTURE_UNIT_COUNT = 16
+		};
+
+		// Constructors / Destructor
+		StateCache();
+
+		// Manipulation
+		void Reset();          // forget the state (next binds are issued)
+		void ResetCounters();
+		void UseProgram(GLuint program);
+		void BindVertexArray(GLuint vertexArray);
+		void ActiveTexture(GLuint unit);                 // unit index
+		void BindTexture(GLuint unit, GLuint texture);   // GL_TEXTURE_2D
+		void BindBuffer(GLenum target, GLuint buffer);
+		void BindBufferRange(GLenum target,              // always issued
+		                     GLuint index,
+		                     GLuint buffer,
+		                     GLintptr offset,
+		                     GLsizeiptr size);
+
+		// Queries
+		GLuint IssuedCount()   const; // state changes sent to OpenGL
+		GLuint ElidedCount()   const; // redundant state changes skipped
+
+	private:
+		// Internal manipulation
+		bool _Update(GLuint& state, GLuint value);
+		GLuint* _BufferState(GLenum target);
+
+		// Members
+		GLuint mProgram;
+		GLuint mVertexArray;
+		GLuint mActiveTexture;
+		GLuint mTextures[TEXTURE_UNIT_COUNT];
+		GLuint mArrayBuffer;
+		GLuint mUniformBuffer;
+		GLuint mDrawIndirectBuffer;
+		GLuint mCopyReadBuffer;
+		GLuint mCopyWriteBuffer;
+		GLuint mIssuedCnt;
+		GLuint mElidedCnt;
+	};
+
+
+	// Render queue
+	// Draw packets are sorted by program, texture, vertex array and depth
+	// (front to back) with a radix sort, and submitted through a state
+	// cache.
+	class RenderQueue
+	{
+	public:
+		// Draw packet
+		class Packet
+		{
+		public:
+			Packet();
+
+			// state
+			GLuint   program;
+			GLuint   textureUnit;
+			GLuint   texture;           // GL_TEXTURE_2D
+			GLuint   vertexArray;
+			GLfloat  depth;             // in [0,1]
+			GLenum   mode;
+			// direct draw (glDrawArraysInstancedBaseInstance)
+			GLint    first;
+			GLsizei  count;
+			GLsizei  instanceCount;
+			GLuint   baseInstance;
+			// indirect draw (if batch is not NULL)
+			DrawIndirectBatch* batch;
+			GLsizei  batchMaterial;     // material index in the batch
+			GLuint   indirectBuffer;
+			GLintptr commandOffset;     // offset of the batch commands
+			// transform feedback draw (if not 0, uses instanceCount)
+			GLuint   transformFeedback;
+		};
+
+		// Constructors / Destructor
+		RenderQueue();
+
+		// Manipulation
+		void Clear();
+		void Push(const Packet& packet);
+		void Submit(StateCache& stateCache); // sort and draw
+
+		// Queries
+		GLsizei PacketCount()   const;
+		GLsizei DrawCallCount() const;    // draw calls of the last Submit
+
+		// Sort key: program (12 bits), texture (12 bits),
+		// vertex array (12 bits), depth (28 bits). The states are the
+		// dense indices of the names in the queue (see Submit), so a
+		// queue can hold up to 4096 distinct names per state (beyond,
+		// asserts in debug builds and shares the last index otherwise)
+		static uint64_t SortKey(GLuint program,
+		                        GLuint texture,
+		                        GLuint vertexArray,
+		                        GLfloat depth);
+
+	private:
+		// Internal types
+		struct _Entry
+		{
+			uint64_t key;
+			GLuint   packet;
+		};
+
+		// Internal manipulation
+		void _Sort();
+		static GLuint _Index(const std::vector<GLuint>& names, GLuint name);
+
+		// Members
+		std::vector<Packet> mPackets;
+		std::vector<_Entry> mEntries;
+		std::vector<_Entry> mScratch;
+		std::vector<GLuint> mPrograms;     // sorted distinct names
+		std::vector<GLuint> mTextures;
+		std::vector<GLuint> mVertexArrays;
+		GLsizei mDrawCallCnt;
+	};
+
+
+	// Memory tracker
+	// Accounts CPU allocations (tagged by the caller) and estimates the
+	// size of GL buffers and textures (mipmaps included), per category.
+	// If the total of a category exceeds its budget, the eviction callbacks
+	// of the category are called until it fits; they should release memory
+	// and update the tracker. The tracker is not thread safe.
+	class MemoryTracker
+	{
+	public:
+		typedef void (*EvictionFunction)(GLint category,
+		                                 size_t excess, // bytes over budget
+		                                 void* data);
+
+		// Constructors / Destructor
+		MemoryTracker();
+
+		// Categories (budget 0: no budget)
+		GLint AddCategory(const std::string& name, size_t budget = 0);
+		void SetBudget(GLint category, size_t budget);
+		void AddEvictionCallback(GLint category,
+		                         EvictionFunction function,
+		                         void* data);
+
+		// Tracking (tracking an object again updates its size)
+		void Track(GLint category, const void* memory, size_t size);
+		void Untrack(const void* memory);
+		void TrackBuffer(GLint category, GLuint buffer);
+		void UntrackBuffer(GLuint buffer);
+		void TrackTexture(GLint category, GLenum target, GLuint texture);
+		void UntrackTexture(GLuint texture);
+
+		// Queries (sizes in bytes)
+		GLint  CategoryCount()                        const;
+		const std::string& CategoryName(GLint category) const;
+		size_t Size(GLint category)                   const;
+		size_t PeakSize(GLint category)               const;
+		size_t Budget(GLint category)                 const;
+		GLint  ObjectCount(GLint category)            const;
+		GLint  EvictionCount(GLint category)          const;
+		size_t TotalSize()                            const;
+
+		// Estimates (a context must be current, bindings are restored)
+		static size_t BufferSize(GLuint buffer);
+		static size_t TextureSize(GLenum target, GLuint texture);
+
+	private:
+		// Internal types
+		enum {KEY_MEMORY = 0, KEY_BUFFER, KEY_TEXTURE};
+		typedef std::pair<GLint, size_t> _Key; // kind and address/name
+		struct _Object
+		{
+			GLint  category;
+			size_t size;
+		};
+		struct _Callback
+		{
+			EvictionFunction function;
+			void*            data;
+		};
+		struct _Category
+		{
+			std::string            name;
+			size_t                 size;
+			size_t                 peakSize;
+			size_t                 budget;
+			GLint                  objectCnt;
+			GLint                  evictionCnt;
+			std::vector<_Callback> callbacks;
+		};
+
+		// Internal manipulation
+		void _Track(const _Key& key, GLint category, size_t size);
+		void _Untrack(const _Key& key);
+		void _Evict(GLint category);
+
+		// Members
+		std::vector<_Category>   mCategories;
+		std::map<_Key, _Object>  mObjects;
+		bool                     mIsEvicting; // callbacks are not nested
+	};
+
+
+	// Policy of check_gl_error, and log of the debug messages. The messages
+	// of KHR_debug (or ARB_debug_output) are written by the callback in a
+	// lock-free table (the driver may call it from its own threads), where
+	// they are counted by source, type, id and severity. Debug builds
+	// check every call, release builds do not check and disable the debug
+	// output by default.
+	class DebugOutput
+	{
+	public:
+		// Constants
+		enum Mode
+		{
+			MODE_OFF = 0, // no check, debug output disabled
+			MODE_SAMPLED, // one check_gl_error call out of Period()
+			MODE_FULL     // every check_gl_error call
+		};
+		enum {MESSAGE_CAPACITY = 128}; // distinct messages
+		enum {MESSAGE_LENGTH   = 256}; // truncated beyond
+
+		// Distinct message
+		struct Message
+		{
+			GLenum source;
+			GLenum type;
+			GLuint id;
+			GLenum severity;
+			GLuint count;
+			char   text[MESSAGE_LENGTH];
+		};
+
+		// Set the KHR_debug (GL4.3) entry point, which is unknown to GLEW
+		// 1.7 (ARB_debug_output is used otherwise)
+		static void SetCallbackFunction(PFNGLDEBUGMESSAGECALLBACKARBPROC f);
+
+		// Manipulation (a context must be current)
+		static void SetMode(Mode mode, GLuint period = 1);
+
+		// Queries
+		static Mode GetMode();
+		static GLuint Period();
+		static bool IsSupported();             // a debug callback exists
+		static GLint MessageCount();           // distinct messages
+		static bool ReadMessage(GLint index, Message& message);
+		static GLuint TotalCount();            // all the messages
+		static GLuint PerformanceWarningCount();
+		static GLuint DroppedCount();          // distinct messages not kept
+		static GLuint CheckCount();            // glGetError calls
+
+	private:
+		// Internal manipulation
+		friend GLvoid check_gl_error() throw(FWException);
+		static void _Configure();
+		static bool _IsCheckDue();
+		static void _PrintNewMessages();
+		static void GLAPIENTRY _Callback(GLenum source,
+		                                 GLenum type,
+		                                 GLuint id,
+		                                 GLenum severity,
+		                                 GLsizei length,
+		                                 const GLchar* message,
+		                                 GLvoid* userParam);
+
+		// Non instantiable
+		DebugOutput();
+
+		// Members
+		static PFNGLDEBUGMESSAGECALLBACKARBPROC sCallbackFunction;
+		static Mode             sMode;
+		static GLuint           sPeriod;
+		static GLuint           sCallCnt;       // check_gl_error calls
+		static GLuint           sCheckCnt;
+		static bool             sIsConfigured;  // callback and mode set
+		static Message          sMessages[MESSAGE_CAPACITY];
+		static volatile int32_t sStates[MESSAGE_CAPACITY]; // 0: free,
+		                                   // 1: written, 2: ready
+		static volatile int32_t sCounts[MESSAGE_CAPACITY];
+		static bool             sIsPrinted[MESSAGE_CAPACITY];
+		static volatile int32_t sTotalCnt;
+		static volatile int32_t sPerformanceCnt;
+		static volatile int32_t sDroppedCnt;
+	};
+
+
+	// Atomic operations (with full memory barriers)
+	int32_t atomic_add(volatile int32_t* value, int32_t increment); // new value
+	bool atomic_compare_exchange(volatile int32_t* value,
+	                             int32_t expected,
+	                             int32_t desired);
+	void memory_barrier();
+	// Atomic load (acquire) and store (release)
+	int32_t atomic_load(const volatile int32_t* value);
+	void atomic_store(volatile int32_t* value, int32_t desired);
+
+
+	// Thread (joined on destruction)
+	class Thread
+	{
+	public:
+		typedef void (*Function)(void* data);
+
+		// Constructors / Destructor
+		Thread();
+		~Thread();
+
+		// Manipulation
+		void Start(Function function, void* data) throw(FWException);
+		void Join();
+
+		// Queries
+		bool IsRunning() const;
+
+		// Platform
+		static GLint HardwareConcurrency(); // logical cores
+		static void  YieldThread();
+		static void  SleepThread(double seconds);
+
+	private:
+		// Non copyable
+		Thread(const Thread&);
+		Thread& operator=(const Thread&);
+
+		// Members
+		void* mHandle; // platform handle (NULL if not running)
+	};
+
+
+	// Signal (condition variable)
+	// Wait returns when the signal is notified or when the timeout expires.
+	// Notifications are lost if no thread is waiting, so waiting threads
+	// must check their condition again when Wait returns.
+	class Signal
+	{
+	public:
+		// Constructors / Destructor
+		Signal();
+		~Signal();
+
+		// Manipulation
+		void Wait(double timeout); // in seconds
+		void Notify();             // wakes up a waiting thread
+
+	private:
+		// Non copyable
+		Signal(const Signal&);
+		Signal& operator=(const Signal&);
+
+		// Members
+		void* mHandle; // platform mutex and condition variable
+	};
+
+
+	// Lock-free triple buffer
+	// A single writer publishes values that a single reader consumes. Both
+	// sides own a buffer, the third one is exchanged atomically, so neither
+	// side ever waits. The reader always gets the latest published value.
+	template<typename T>
+	class TripleBuffer
+	{
+	public:
+		// Constructors / Destructor
+		TripleBuffer();
+
+		// Writer
+		T& WriteBuffer();           // value to publish
+		void Publish();             // WriteBuffer() becomes the latest value
+
+		// Reader
+		bool Update();              // acquire the latest value (true if new)
+		const T& ReadBuffer() const;
+
+	private:
+		// Constants (the exchanged index holds a new value flag)
+		enum {INDEX_MASK = 3, NEW_BIT = 4};
+
+		// Non copyable
+		TripleBuffer(const TripleBuffer&);
+		TripleBuffer& operator=(const TripleBuffer&);
+
+		// Members
+		T                mBuffers[3];
+		int32_t          mWriteIndex; // owned by the writer
+		int32_t          mReadIndex;  // owned by the reader
+		volatile int32_t mSharedIndex;
+	};
+
+
+	// Job
+	// Jobs are plain functions; their data must outlive them.
+	typedef void (*JobFunction)(void* data);
+	typedef void (*RangeFunction)(GLint begin, GLint end, void* data);
+	class JobCounter;
+	struct Job
+	{
+		JobFunction function;
+		void*       data;
+		JobCounter* counter;    // decremented when the job is done
+	};
+
+
+	// Job counter
+	// Counts the unfinished jobs that were run with it. Jobs that depend on
+	// the counter are scheduled when it reaches zero.
+	class JobCounter
+	{
+	public:
+		// Constructors / Destructor
+		JobCounter();
+
+		// Queries
+		GLint Value()   const;
+		bool  IsDone()  const;
+
+	private:
+		friend class JobSystem;
+
+		// Non copyable
+		JobCounter(const JobCounter&);
+		JobCounter& operator=(const JobCounter&);
+
+		// Members
+		volatile int32_t mValue;
+		volatile int32_t mLock;       // protects mDependents and the
+		                              // decrements to zero
+		std::vector<Job> mDependents; // jobs waiting for zero
+	};
+
+
+	// Work-stealing job system
+	// Each thread owns a Chase-Lev deque: it pushes and pops jobs at the
+	// bottom, idle threads steal from the top of the others. The thread that
+	// creates the system participates as thread 0 while it waits. Jobs must
+	// be run from this thread or from jobs.
+	class JobSystem
+	{
+	public:
+		// Constants
+		enum
+		{
+			QUEUE_CAPACITY = 4096, // jobs per thread (power of two)
+			SPIN_COUNT     = 256   // failed steals before a worker sleeps
+		};
+
+		// Constructors / Destructor
+			// workerCount < 0: one worker per additional logical core
+		explicit JobSystem(GLint workerCount = -1) throw(FWException);
+		~JobSystem();
+
+		// Manipulation
+			// schedule a job (if the queue is full, the job is executed
+			// immediately); counter is incremented now, and decremented when
+			// the job is done. If dependency is not NULL, the job is
+			// scheduled once the dependency is done.
+		void Run(JobFunction function,
+		         void* data,
+		         JobCounter* counter = NULL,
+		         JobCounter* dependency = NULL);
+			// execute jobs until the counter is done
+		void Wait(const JobCounter& counter);
+			// call function on ranges of at most grain elements of
+			// [begin, end) and wait (grain 0: four ranges per thread)
+		void ParallelFor(GLint begin,
+		                 GLint end,
+		                 GLint grain,
+		                 RangeFunction function,
+		                 void* data);
+		void ResetCounters(); // the system must be idle
+
+		// Queries
+		GLint  ThreadCount()  const; // workers + the creating thread
+		GLuint JobCount()     const; // jobs executed since ResetCounters
+		GLuint StealCount()   const; // jobs stolen since ResetCounters
+
+	private:
+		// Internal types
+		class _Deque;
+		struct _Worker
+		{
+			JobSystem* system;
+			GLint      index;
+		};
+		struct _Range
+		{
+			GLint         begin;
+			GLint         end;
+			RangeFunction function;
+			void*         data;
+		};
+
+		// Non copyable
+		JobSystem(const JobSystem&);
+		JobSystem& operator=(const JobSystem&);
+
+		// Internal manipulation
+		static void _WorkerMain(void* data);
+		static void _RunRange(void* data);
+		GLint _ThreadIndex() const; // -1 if the thread is not a worker
+		void _Push(const Job& job);
+		void _Execute(GLint thread, const Job& job);
+		bool _FindJob(GLint thread, Job& job);
+		void _Terminate();
+
+		// Members
+		std::vector<_Deque*> mDeques;   // one per thread
+		std::vector<Thread*> mThreads;  // workers
+		std::vector<_Worker> mWorkers;
+		Signal               mSignal;   // wakes up sleeping workers
+		volatile int32_t     mSleepingCnt;
+		volatile int32_t     mIsRunning;
+	};
+
+
+
+	// TripleBuffer implementation
+	template<typename T>
+	TripleBuffer<T>::TripleBuffer() :
+		mWriteIndex(0), mReadIndex(1), mSharedIndex(2)
+	{}
+
+	template<typename T>
+	T& TripleBuffer<T>::WriteBuffer()
+	{
+		return mBuffers[mWriteIndex];
+	}
+
+	template<typename T>
+	void TripleBuffer<T>::Publish()
+	{
+		int32_t shared;
+		do
+			shared = mSharedIndex;
+		while(!atomic_compare_exchange(&mSharedIndex,
+		                               shared,
+		                               mWriteIndex | NEW_BIT));
+		mWriteIndex = shared & INDEX_MASK;
+	}
+
+	template<typename T>
+	bool TripleBuffer<T>::Update()
+	{
+		if(0 == (mSharedIndex & NEW_BIT))
+			return false;
+		int32_t shared;
+		do
+			shared = mSharedIndex;
+		while(!atomic_compare_exchange(&mSharedIndex, shared, mReadIndex));
+		mReadIndex = shared & INDEX_MASK;
+		return true;
+	}
+
+	template<typename T>
+	const T& TripleBuffer<T>::ReadBuffer() const
+	{
+		return mBuffers[mReadIndex];
+	}
+
 } // namespace fw
 
 #endif
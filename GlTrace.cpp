@@ -0,0 +1,487 @@
+// the OpenGL 1.1 pointers are defined here
+#define GLTRACE_NO_REDIRECT
+#include "GlTrace.hpp"
+#include <sstream> // std::stringstream
+
+#ifdef _MSC_VER
+#	define GLTRACE_THREAD_LOCAL __declspec(thread)
+#else
+#	define GLTRACE_THREAD_LOCAL __thread
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Traced functions: GL11 entries are OpenGL 1.1 functions, GLEW entries are
+// loaded by glew (pointer type, return type, name, flags, parameters,
+// arguments)
+#define GLTRACE_ENTRIES(GL11, GLEW) \
+	GL11(PFNGLTRACEBINDTEXTUREPROC, void, BindTexture, 0, \
+	     (GLenum a0, GLuint a1), \
+	     (a0, a1)) \
+	GL11(PFNGLTRACECLEARPROC, void, Clear, 0, \
+	     (GLbitfield a0), \
+	     (a0)) \
+	GL11(PFNGLTRACECLEARCOLORPROC, void, ClearColor, 0, \
+	     (GLclampf a0, GLclampf a1, GLclampf a2, GLclampf a3), \
+	     (a0, a1, a2, a3)) \
+	GL11(PFNGLTRACECOLORMASKPROC, void, ColorMask, 0, \
+	     (GLboolean a0, GLboolean a1, GLboolean a2, GLboolean a3), \
+	     (a0, a1, a2, a3)) \
+	GL11(PFNGLTRACEDELETETEXTURESPROC, void, DeleteTextures, 0, \
+	     (GLsizei a0, const GLuint* a1), \
+	     (a0, a1)) \
+	GL11(PFNGLTRACEDEPTHFUNCPROC, void, DepthFunc, 0, \
+	     (GLenum a0), \
+	     (a0)) \
+	GL11(PFNGLTRACEDISABLEPROC, void, Disable, 0, \
+	     (GLenum a0), \
+	     (a0)) \
+	GL11(PFNGLTRACEENABLEPROC, void, Enable, 0, \
+	     (GLenum a0), \
+	     (a0)) \
+	GL11(PFNGLTRACEFINISHPROC, void, Finish, FLAG_SYNC, \
+	     (void), \
+	     ()) \
+	GL11(PFNGLTRACEFLUSHPROC, void, Flush, 0, \
+	     (void), \
+	     ()) \
+	GL11(PFNGLTRACEGENTEXTURESPROC, void, GenTextures, 0, \
+	     (GLsizei a0, GLuint* a1), \
+	     (a0, a1)) \
+	GL11(PFNGLTRACEGETERRORPROC, GLenum, GetError, FLAG_QUERY, \
+	     (void), \
+	     ()) \
+	GL11(PFNGLTRACEGETINTEGERVPROC, void, GetIntegerv, FLAG_QUERY, \
+	     (GLenum a0, GLint* a1), \
+	     (a0, a1)) \
+	GL11(PFNGLTRACEGETSTRINGPROC, const GLubyte*, GetString, FLAG_QUERY, \
+	     (GLenum a0), \
+	     (a0)) \
+	GL11(PFNGLTRACEGETTEXLEVELPARAMETERIVPROC, void, GetTexLevelParameteriv, FLAG_QUERY, \
+	     (GLenum a0, GLint a1, GLenum a2, GLint* a3), \
+	     (a0, a1, a2, a3)) \
+	GL11(PFNGLTRACEPIXELSTOREIPROC, void, PixelStorei, 0, \
+	     (GLenum a0, GLint a1), \
+	     (a0, a1)) \
+	GL11(PFNGLTRACEREADBUFFERPROC, void, ReadBuffer, 0, \
+	     (GLenum a0), \
+	     (a0)) \
+	GL11(PFNGLTRACEREADPIXELSPROC, void, ReadPixels, FLAG_SYNC, \
+	     (GLint a0, GLint a1, GLsizei a2, GLsizei a3, GLenum a4, GLenum a5, \
+	      GLvoid* a6), \
+	     (a0, a1, a2, a3, a4, a5, a6)) \
+	GL11(PFNGLTRACETEXIMAGE2DPROC, void, TexImage2D, 0, \
+	     (GLenum a0, GLint a1, GLint a2, GLsizei a3, GLsizei a4, GLint a5, \
+	      GLenum a6, GLenum a7, const GLvoid* a8), \
+	     (a0, a1, a2, a3, a4, a5, a6, a7, a8)) \
+	GL11(PFNGLTRACETEXPARAMETERIPROC, void, TexParameteri, 0, \
+	     (GLenum a0, GLenum a1, GLint a2), \
+	     (a0, a1, a2)) \
+	GL11(PFNGLTRACEVIEWPORTPROC, void, Viewport, 0, \
+	     (GLint a0, GLint a1, GLsizei a2, GLsizei a3), \
+	     (a0, a1, a2, a3)) \
+	GLEW(PFNGLACTIVETEXTUREPROC, void, ActiveTexture, 0, \
+	     (GLenum a0), \
+	     (a0)) \
+	GLEW(PFNGLATTACHSHADERPROC, void, AttachShader, 0, \
+	     (GLuint a0, GLuint a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLBEGINQUERYPROC, void, BeginQuery, 0, \
+	     (GLenum a0, GLuint a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLBEGINTRANSFORMFEEDBACKPROC, void, BeginTransformFeedback, 0, \
+	     (GLenum a0), \
+	     (a0)) \
+	GLEW(PFNGLBINDBUFFERPROC, void, BindBuffer, 0, \
+	     (GLenum a0, GLuint a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLBINDBUFFERBASEPROC, void, BindBufferBase, 0, \
+	     (GLenum a0, GLuint a1, GLuint a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLBINDBUFFERRANGEPROC, void, BindBufferRange, 0, \
+	     (GLenum a0, GLuint a1, GLuint a2, GLintptr a3, GLsizeiptr a4), \
+	     (a0, a1, a2, a3, a4)) \
+	GLEW(PFNGLBINDTRANSFORMFEEDBACKPROC, void, BindTransformFeedback, 0, \
+	     (GLenum a0, GLuint a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLBINDVERTEXARRAYPROC, void, BindVertexArray, 0, \
+	     (GLuint a0), \
+	     (a0)) \
+	GLEW(PFNGLBUFFERDATAPROC, void, BufferData, 0, \
+	     (GLenum a0, GLsizeiptr a1, const GLvoid* a2, GLenum a3), \
+	     (a0, a1, a2, a3)) \
+	GLEW(PFNGLBUFFERSUBDATAPROC, void, BufferSubData, 0, \
+	     (GLenum a0, GLintptr a1, GLsizeiptr a2, const GLvoid* a3), \
+	     (a0, a1, a2, a3)) \
+	GLEW(PFNGLCLIENTWAITSYNCPROC, GLenum, ClientWaitSync, FLAG_SYNC, \
+	     (GLsync a0, GLbitfield a1, GLuint64 a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLCOMPILESHADERPROC, void, CompileShader, 0, \
+	     (GLuint a0), \
+	     (a0)) \
+	GLEW(PFNGLCREATEPROGRAMPROC, GLuint, CreateProgram, 0, \
+	     (void), \
+	     ()) \
+	GLEW(PFNGLCREATESHADERPROC, GLuint, CreateShader, 0, \
+	     (GLenum a0), \
+	     (a0)) \
+	GLEW(PFNGLDELETEBUFFERSPROC, void, DeleteBuffers, 0, \
+	     (GLsizei a0, const GLuint* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLDELETEPROGRAMPROC, void, DeleteProgram, 0, \
+	     (GLuint a0), \
+	     (a0)) \
+	GLEW(PFNGLDELETEQUERIESPROC, void, DeleteQueries, 0, \
+	     (GLsizei a0, const GLuint* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLDELETESHADERPROC, void, DeleteShader, 0, \
+	     (GLuint a0), \
+	     (a0)) \
+	GLEW(PFNGLDELETESYNCPROC, void, DeleteSync, 0, \
+	     (GLsync a0), \
+	     (a0)) \
+	GLEW(PFNGLDELETETRANSFORMFEEDBACKSPROC, void, DeleteTransformFeedbacks, 0, \
+	     (GLsizei a0, const GLuint* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLDELETEVERTEXARRAYSPROC, void, DeleteVertexArrays, 0, \
+	     (GLsizei a0, const GLuint* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLDRAWARRAYSINDIRECTPROC, void, DrawArraysIndirect, 0, \
+	     (GLenum a0, const void* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLDRAWARRAYSINSTANCEDBASEINSTANCEPROC, void, DrawArraysInstancedBaseInstance, 0, \
+	     (GLenum a0, GLint a1, GLsizei a2, GLsizei a3, GLuint a4), \
+	     (a0, a1, a2, a3, a4)) \
+	GLEW(PFNGLDRAWTRANSFORMFEEDBACKINSTANCEDPROC, void, DrawTransformFeedbackInstanced, 0, \
+	     (GLenum a0, GLuint a1, GLsizei a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLENABLEVERTEXATTRIBARRAYPROC, void, EnableVertexAttribArray, 0, \
+	     (GLuint a0), \
+	     (a0)) \
+	GLEW(PFNGLENDQUERYPROC, void, EndQuery, 0, \
+	     (GLenum a0), \
+	     (a0)) \
+	GLEW(PFNGLENDTRANSFORMFEEDBACKPROC, void, EndTransformFeedback, 0, \
+	     (void), \
+	     ()) \
+	GLEW(PFNGLFENCESYNCPROC, GLsync, FenceSync, 0, \
+	     (GLenum a0, GLbitfield a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLGENBUFFERSPROC, void, GenBuffers, 0, \
+	     (GLsizei a0, GLuint* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLGENQUERIESPROC, void, GenQueries, 0, \
+	     (GLsizei a0, GLuint* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLGENTRANSFORMFEEDBACKSPROC, void, GenTransformFeedbacks, 0, \
+	     (GLsizei a0, GLuint* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLGENVERTEXARRAYSPROC, void, GenVertexArrays, 0, \
+	     (GLsizei a0, GLuint* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLGENERATEMIPMAPPROC, void, GenerateMipmap, 0, \
+	     (GLenum a0), \
+	     (a0)) \
+	GLEW(PFNGLGETACTIVEUNIFORMBLOCKIVPROC, void, GetActiveUniformBlockiv, FLAG_QUERY, \
+	     (GLuint a0, GLuint a1, GLenum a2, GLint* a3), \
+	     (a0, a1, a2, a3)) \
+	GLEW(PFNGLGETBUFFERPARAMETERIVPROC, void, GetBufferParameteriv, FLAG_QUERY, \
+	     (GLenum a0, GLenum a1, GLint* a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLGETBUFFERSUBDATAPROC, void, GetBufferSubData, FLAG_QUERY|FLAG_SYNC, \
+	     (GLenum a0, GLintptr a1, GLsizeiptr a2, GLvoid* a3), \
+	     (a0, a1, a2, a3)) \
+	GLEW(PFNGLGETPROGRAMINFOLOGPROC, void, GetProgramInfoLog, FLAG_QUERY, \
+	     (GLuint a0, GLsizei a1, GLsizei* a2, GLchar* a3), \
+	     (a0, a1, a2, a3)) \
+	GLEW(PFNGLGETPROGRAMIVPROC, void, GetProgramiv, FLAG_QUERY, \
+	     (GLuint a0, GLenum a1, GLint* a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLGETQUERYOBJECTUI64VPROC, void, GetQueryObjectui64v, FLAG_QUERY|FLAG_SYNC, \
+	     (GLuint a0, GLenum a1, GLuint64* a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLGETSHADERINFOLOGPROC, void, GetShaderInfoLog, FLAG_QUERY, \
+	     (GLuint a0, GLsizei a1, GLsizei* a2, GLchar* a3), \
+	     (a0, a1, a2, a3)) \
+	GLEW(PFNGLGETSHADERIVPROC, void, GetShaderiv, FLAG_QUERY, \
+	     (GLuint a0, GLenum a1, GLint* a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLGETSYNCIVPROC, void, GetSynciv, FLAG_QUERY, \
+	     (GLsync a0, GLenum a1, GLsizei a2, GLsizei* a3, GLint* a4), \
+	     (a0, a1, a2, a3, a4)) \
+	GLEW(PFNGLGETUNIFORMBLOCKINDEXPROC, GLuint, GetUniformBlockIndex, FLAG_QUERY, \
+	     (GLuint a0, const char* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLGETUNIFORMLOCATIONPROC, GLint, GetUniformLocation, FLAG_QUERY, \
+	     (GLuint a0, const GLchar* a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLLINKPROGRAMPROC, void, LinkProgram, 0, \
+	     (GLuint a0), \
+	     (a0)) \
+	GLEW(PFNGLMAPBUFFERRANGEPROC, GLvoid*, MapBufferRange, 0, \
+	     (GLenum a0, GLintptr a1, GLsizeiptr a2, GLbitfield a3), \
+	     (a0, a1, a2, a3)) \
+	GLEW(PFNGLMEMORYBARRIERPROC, void, MemoryBarrier, 0, \
+	     (GLbitfield a0), \
+	     (a0)) \
+	GLEW(PFNGLPROGRAMUNIFORM1IPROC, void, ProgramUniform1i, 0, \
+	     (GLuint a0, GLint a1, GLint a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLPROGRAMUNIFORM1UIPROC, void, ProgramUniform1ui, 0, \
+	     (GLuint a0, GLint a1, GLuint a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLSHADERSOURCEPROC, void, ShaderSource, 0, \
+	     (GLuint a0, GLsizei a1, const GLchar** a2, const GLint* a3), \
+	     (a0, a1, a2, a3)) \
+	GLEW(PFNGLTEXBUFFERPROC, void, TexBuffer, 0, \
+	     (GLenum a0, GLenum a1, GLuint a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLTRANSFORMFEEDBACKVARYINGSPROC, void, TransformFeedbackVaryings, 0, \
+	     (GLuint a0, GLsizei a1, const GLchar** a2, GLenum a3), \
+	     (a0, a1, a2, a3)) \
+	GLEW(PFNGLUNIFORMBLOCKBINDINGPROC, void, UniformBlockBinding, 0, \
+	     (GLuint a0, GLuint a1, GLuint a2), \
+	     (a0, a1, a2)) \
+	GLEW(PFNGLUNMAPBUFFERPROC, GLboolean, UnmapBuffer, 0, \
+	     (GLenum a0), \
+	     (a0)) \
+	GLEW(PFNGLUSEPROGRAMPROC, void, UseProgram, 0, \
+	     (GLuint a0), \
+	     (a0)) \
+	GLEW(PFNGLVERTEXATTRIBDIVISORPROC, void, VertexAttribDivisor, 0, \
+	     (GLuint a0, GLuint a1), \
+	     (a0, a1)) \
+	GLEW(PFNGLVERTEXATTRIBIPOINTERPROC, void, VertexAttribIPointer, 0, \
+	     (GLuint a0, GLint a1, GLenum a2, GLsizei a3, const GLvoid* a4), \
+	     (a0, a1, a2, a3, a4)) \
+	GLEW(PFNGLVERTEXATTRIBPOINTERPROC, void, VertexAttribPointer, 0, \
+	     (GLuint a0, GLint a1, GLenum a2, GLboolean a3, GLsizei a4, \
+	      const GLvoid* a5), \
+	     (a0, a1, a2, a3, a4, a5)) \
+	GLEW(PFNGLWAITSYNCPROC, void, WaitSync, 0, \
+	     (GLsync a0, GLbitfield a1, GLuint64 a2), \
+	     (a0, a1, a2))
+
+
+#define GLTRACE_ENUM(type, ret, name, flags, params, args) ENTRY_##name,
+enum
+{
+	GLTRACE_ENTRIES(GLTRACE_ENUM, GLTRACE_ENUM)
+	ENTRY_MultiDrawArraysIndirect,
+	ENTRY_DispatchCompute,
+	ENTRY_COUNT
+};
+#undef GLTRACE_ENUM
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Global variables
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// OpenGL 1.1 entry points (see glew.hpp)
+#define GLTRACE_POINTER(type, ret, name, flags, params, args) \
+	type __gltrace##name = &gl##name;
+#define GLTRACE_NONE(type, ret, name, flags, params, args)
+GLTRACE_ENTRIES(GLTRACE_POINTER, GLTRACE_NONE)
+#undef GLTRACE_POINTER
+
+// Counters
+static GLTRACE_THREAD_LOCAL bool sIsTracedThread = false;
+static bool     sIsInstalled = false;
+static GLuint   sCallCnts[ENTRY_COUNT];      // current frame
+static GLuint   sLastCallCnts[ENTRY_COUNT];  // last frame
+static uint64_t sTotalCallCnts[ENTRY_COUNT]; // all frames
+static GLuint   sFrameCnt = 0;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Wrappers (forward the call to the original entry point)
+//
+////////////////////////////////////////////////////////////////////////////////
+#define GLTRACE_WRAPPER(type, ret, name, flags, params, args) \
+	static type _original##name = NULL; \
+	static ret GLAPIENTRY _trace##name params \
+	{ \
+		if(sIsTracedThread) \
+			++sCallCnts[ENTRY_##name]; \
+		return _original##name args; \
+	}
+GLTRACE_ENTRIES(GLTRACE_WRAPPER, GLTRACE_WRAPPER)
+GLTRACE_WRAPPER(PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC,
+                void,
+                MultiDrawArraysIndirect,
+                0,
+                (GLenum a0, const void* a1, GLsizei a2, GLsizei a3),
+                (a0, a1, a2, a3))
+GLTRACE_WRAPPER(PFNGLDISPATCHCOMPUTEPROC,
+                void,
+                DispatchCompute,
+                0,
+                (GLuint a0, GLuint a1, GLuint a2),
+                (a0, a1, a2))
+#undef GLTRACE_WRAPPER
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Function names and flags
+#define GLTRACE_ENTRY(type, ret, name, flags, params, args) {"gl" #name, flags},
+const GlTrace::_Entry GlTrace::sEntries[] =
+{
+	GLTRACE_ENTRIES(GLTRACE_ENTRY, GLTRACE_ENTRY)
+	{"glMultiDrawArraysIndirect", 0},
+	{"glDispatchCompute", 0}
+};
+#undef GLTRACE_ENTRY
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GlTrace implementation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Swap the entry points with the wrappers
+void GlTrace::Install()
+{
+	if(sIsInstalled)
+		return;
+#define GLTRACE_INSTALL(prefix, name) \
+	if(NULL != prefix##name) \
+	{ \
+		_original##name = prefix##name; \
+		prefix##name    = &_trace##name; \
+	}
+#define GLTRACE_INSTALL_GL11(type, ret, name, flags, params, args) \
+	GLTRACE_INSTALL(__gltrace, name)
+#define GLTRACE_INSTALL_GLEW(type, ret, name, flags, params, args) \
+	GLTRACE_INSTALL(__glew, name)
+	GLTRACE_ENTRIES(GLTRACE_INSTALL_GL11, GLTRACE_INSTALL_GLEW)
+#undef GLTRACE_INSTALL_GLEW
+#undef GLTRACE_INSTALL_GL11
+#undef GLTRACE_INSTALL
+	sIsTracedThread = true;
+	sIsInstalled    = true;
+	ResetCounters();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Wrap entry points resolved outside of glew (NULL is not wrapped)
+PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC
+GlTrace::TraceMultiDraw(PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC f)
+{
+	if(NULL == f)
+		return NULL;
+	_originalMultiDrawArraysIndirect = f;
+	return &_traceMultiDrawArraysIndirect;
+}
+
+PFNGLDISPATCHCOMPUTEPROC GlTrace::TraceDispatch(PFNGLDISPATCHCOMPUTEPROC f)
+{
+	if(NULL == f)
+		return NULL;
+	_originalDispatchCompute = f;
+	return &_traceDispatchCompute;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Close the frame
+void GlTrace::EndFrame()
+{
+	for(GLint i=0; i<ENTRY_COUNT; ++i)
+	{
+		sLastCallCnts[i]   = sCallCnts[i];
+		sTotalCallCnts[i] += sCallCnts[i];
+		sCallCnts[i]       = 0;
+	}
+	++sFrameCnt;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Drop the counts of the current frame
+void GlTrace::ResetCounters()
+{
+	for(GLint i=0; i<ENTRY_COUNT; ++i)
+		sCallCnts[i] = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Queries
+bool GlTrace::IsInstalled()
+{
+	return sIsInstalled;
+}
+
+GLuint GlTrace::FrameCount()
+{
+	return sFrameCnt;
+}
+
+GLuint GlTrace::CallCount()
+{
+	GLuint callCnt = 0;
+	for(GLint i=0; i<ENTRY_COUNT; ++i)
+		callCnt += sLastCallCnts[i];
+	return callCnt;
+}
+
+GLuint GlTrace::QueryCount()
+{
+	GLuint callCnt = 0;
+	for(GLint i=0; i<ENTRY_COUNT; ++i)
+		if(sEntries[i].flags & FLAG_QUERY)
+			callCnt += sLastCallCnts[i];
+	return callCnt;
+}
+
+GLuint GlTrace::SyncCount()
+{
+	GLuint callCnt = 0;
+	for(GLint i=0; i<ENTRY_COUNT; ++i)
+		if(sEntries[i].flags & FLAG_SYNC)
+			callCnt += sLastCallCnts[i];
+	return callCnt;
+}
+
+std::string GlTrace::FlaggedCalls()
+{
+	std::stringstream calls;
+	for(GLint i=0; i<ENTRY_COUNT; ++i)
+		if(sEntries[i].flags && sLastCallCnts[i])
+		{
+			if(!calls.str().empty())
+				calls << ", ";
+			calls << sEntries[i].name << " x" << sLastCallCnts[i];
+		}
+	return calls.str();
+}
+
+GLint GlTrace::EntryCount()
+{
+	return ENTRY_COUNT;
+}
+
+const char* GlTrace::EntryName(GLint entry)
+{
+	return sEntries[entry].name;
+}
+
+GLint GlTrace::EntryFlags(GLint entry)
+{
+	return sEntries[entry].flags;
+}
+
+GLuint GlTrace::EntryCallCount(GLint entry)
+{
+	return sLastCallCnts[entry];
+}
+
+double GlTrace::EntryMeanCallCount(GLint entry)
+{
+	return sFrameCnt ? double(sTotalCallCnts[entry]) / sFrameCnt : 0.0;
+}
+
@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    GlTrace.hpp
+// \author  J. Dupuy
+// \brief   Counts the OpenGL calls of the render thread, per function and per
+//          frame. Install replaces the entry points loaded by glew, and the
+//          OpenGL 1.1 entry points (called through pointers, see glew.hpp),
+//          with wrappers that count the calls before forwarding them.
+//          Calls that return driver state (glGet*, glIs*) or wait for the
+//          GPU (glFinish, glClientWaitSync, readbacks) are flagged: on the
+//          hot path they are round-trips to the driver.
+//          Calls of other threads, and of libraries with their own loader
+//          (AntTweakBar), are not counted. Entry points resolved outside of
+//          glew must be wrapped explicitly (TraceMultiDraw, TraceDispatch).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GLTRACE_HPP
+#define GLTRACE_HPP
+
+#include "Framework.hpp"
+#include <string> // std::string
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Definition
+class GlTrace
+{
+public:
+	// Flags
+	enum
+	{
+		FLAG_QUERY = 1, // returns driver state
+		FLAG_SYNC  = 2  // waits for the GPU
+	};
+
+	// Manipulation
+	static void Install();       // after glewInit, on the render thread
+	static void EndFrame();      // the counts become those of the last frame
+	static void ResetCounters(); // drops the counts of the current frame
+
+	// Wrappers of entry points resolved outside of glew
+	static PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC
+	TraceMultiDraw(PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC f);
+	static PFNGLDISPATCHCOMPUTEPROC TraceDispatch(PFNGLDISPATCHCOMPUTEPROC f);
+
+	// Queries (of the last frame)
+	static bool IsInstalled();
+	static GLuint FrameCount();
+	static GLuint CallCount();
+	static GLuint QueryCount();
+	static GLuint SyncCount();
+	static std::string FlaggedCalls(); // "glGetError x2, ..." (may be empty)
+
+	// Functions
+	static GLint EntryCount();
+	static const char* EntryName(GLint entry);
+	static GLint EntryFlags(GLint entry);
+	static GLuint EntryCallCount(GLint entry);     // last frame
+	static double EntryMeanCallCount(GLint entry); // per frame, all frames
+
+private:
+	// Internal types
+	struct _Entry
+	{
+		const char* name;
+		GLint       flags;
+	};
+
+	// Static only
+	GlTrace();
+
+	// Members
+	static const _Entry sEntries[];
+};
+
+#endif
+
@@ -0,0 +1,185 @@
+#include "InputLog.hpp"
+#include <cassert> // assert
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants
+//
+////////////////////////////////////////////////////////////////////////////////
+static const uint32_t INPUT_LOG_IDENT   = 'B'|'S'<<8|'I'<<16|'L'<<24;
+static const uint32_t INPUT_LOG_VERSION = 1;
+static const GLint    EVENT_ARG_COUNTS[InputLog::EVENT_TYPE_COUNT] =
+	{0, 3, 4, 2, 4, 2};
+
+enum
+{
+	MODE_CLOSED = 0,
+	MODE_RECORDING,
+	MODE_REPLAYING
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Exceptions
+//
+////////////////////////////////////////////////////////////////////////////////
+class _InputLogFileException : public fw::FWException
+{
+public:
+	_InputLogFileException(const std::string& file)
+	{
+		mMessage = "Could not open input log " + file + ".";
+	}
+};
+
+class _InputLogHeaderException : public fw::FWException
+{
+public:
+	_InputLogHeaderException(const std::string& file)
+	{
+		mMessage = file + " is not an input log (or has a wrong version).";
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+InputLog::InputLog() :
+	mStream(), mMode(MODE_CLOSED), mFrameCnt(0), mEventCnt(0)
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Destructor
+InputLog::~InputLog()
+{
+	Close();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Open a log
+void InputLog::Record(const std::string& filename) throw(fw::FWException)
+{
+	Close();
+	mStream.open(filename.c_str(),
+	             std::fstream::binary | std::fstream::out | std::fstream::trunc);
+	if(!mStream)
+		throw _InputLogFileException(filename);
+	mStream.write(reinterpret_cast<const char*>(&INPUT_LOG_IDENT),
+	              sizeof(uint32_t));
+	mStream.write(reinterpret_cast<const char*>(&INPUT_LOG_VERSION),
+	              sizeof(uint32_t));
+	mMode = MODE_RECORDING;
+}
+
+void InputLog::Replay(const std::string& filename) throw(fw::FWException)
+{
+	Close();
+	mStream.open(filename.c_str(), std::fstream::binary | std::fstream::in);
+	if(!mStream)
+		throw _InputLogFileException(filename);
+	uint32_t header[2] = {0, 0};
+	mStream.read(reinterpret_cast<char*>(header), sizeof(header));
+	if(!mStream || INPUT_LOG_IDENT != header[0]
+	|| INPUT_LOG_VERSION != header[1])
+	{
+		mStream.close();
+		throw _InputLogHeaderException(filename);
+	}
+	mMode = MODE_REPLAYING;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Close the log
+void InputLog::Close()
+{
+	if(MODE_CLOSED == mMode)
+		return;
+	mStream.close();
+	mStream.clear();
+	mMode     = MODE_CLOSED;
+	mFrameCnt = 0;
+	mEventCnt = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Write an event
+void InputLog::Write(const InputLog::Event& event)
+{
+#ifndef NDEBUG
+	assert(MODE_RECORDING == mMode);
+	assert(event.type >= 0 && event.type < EVENT_TYPE_COUNT);
+#endif
+	uint8_t type = event.type;
+	mStream.write(reinterpret_cast<const char*>(&type), sizeof(uint8_t));
+	if(EVENT_FRAME == event.type)
+	{
+		mStream.write(reinterpret_cast<const char*>(&event.dt), sizeof(double));
+		++mFrameCnt;
+	}
+	for(GLint i=0; i<EVENT_ARG_COUNTS[event.type]; ++i)
+	{
+		int16_t arg = event.args[i];
+		mStream.write(reinterpret_cast<const char*>(&arg), sizeof(int16_t));
+	}
+	++mEventCnt;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Read the next event
+bool InputLog::Read(InputLog::Event& event)
+{
+#ifndef NDEBUG
+	assert(MODE_REPLAYING == mMode);
+#endif
+	uint8_t type = EVENT_TYPE_COUNT;
+	if(!mStream.read(reinterpret_cast<char*>(&type), sizeof(uint8_t))
+	|| type >= EVENT_TYPE_COUNT)
+		return false;
+	event.type = type;
+	event.dt   = 0.0;
+	for(GLint i=0; i<ARG_COUNT_MAX; ++i)
+		event.args[i] = 0;
+	if(EVENT_FRAME == event.type)
+		mStream.read(reinterpret_cast<char*>(&event.dt), sizeof(double));
+	for(GLint i=0; i<EVENT_ARG_COUNTS[event.type]; ++i)
+	{
+		int16_t arg = 0;
+		mStream.read(reinterpret_cast<char*>(&arg), sizeof(int16_t));
+		event.args[i] = arg;
+	}
+	if(!mStream) // truncated record
+		return false;
+	mFrameCnt += EVENT_FRAME == event.type ? 1 : 0;
+	++mEventCnt;
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Queries
+bool InputLog::IsRecording() const
+{
+	return MODE_RECORDING == mMode;
+}
+
+bool InputLog::IsReplaying() const
+{
+	return MODE_REPLAYING == mMode;
+}
+
+GLuint InputLog::FrameCount() const
+{
+	return mFrameCnt;
+}
+
+GLuint InputLog::EventCount() const
+{
+	return mEventCnt;
+}
+
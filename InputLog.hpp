@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    InputLog.hpp
+// \author  J. Dupuy
+// \brief   Records the input events and the frame durations of a run to a
+//          binary log, and reads them back in the same order. The log is a
+//          header followed by records: a type byte, then the arguments of
+//          the event (16 bit integers), or the duration of the frame (64 bit
+//          float) for frame records. The events that precede a frame record
+//          were received before that frame was rendered.
+//          The log is written in the byte order of the host.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INPUTLOG_HPP
+#define INPUTLOG_HPP
+
+#include "Framework.hpp"
+#include <string>  // std::string
+#include <fstream> // std::fstream
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Definition
+class InputLog
+{
+public:
+	// Event types (the arguments are those of the glut callbacks)
+	enum EventType
+	{
+		EVENT_FRAME = 0,    // duration of the frame
+		EVENT_KEY_DOWN,     // key, x, y
+		EVENT_MOUSE_BUTTON, // button, state, x, y
+		EVENT_MOUSE_MOTION, // x, y
+		EVENT_MOUSE_WHEEL,  // wheel, direction, x, y
+		EVENT_RESIZE,       // width, height
+		EVENT_TYPE_COUNT
+	};
+	enum {ARG_COUNT_MAX = 4};
+
+	// Event
+	struct Event
+	{
+		GLint  type;
+		GLint  args[ARG_COUNT_MAX];
+		double dt; // seconds (frame events)
+	};
+
+	// Constructors / Destructor
+	InputLog();
+	~InputLog();
+
+	// Manipulation
+	void Record(const std::string& filename) throw(fw::FWException);
+	void Replay(const std::string& filename) throw(fw::FWException);
+	void Close();
+	void Write(const Event& event);   // recording
+	bool Read(Event& event);          // replaying (false at the end)
+
+	// Queries
+	bool   IsRecording() const;
+	bool   IsReplaying() const;
+	GLuint FrameCount()  const; // frame events written or read
+	GLuint EventCount()  const; // all the events written or read
+
+private:
+	// Non copyable
+	InputLog(const InputLog&);
+	InputLog& operator=(const InputLog&);
+
+	// Members
+	std::fstream mStream;
+	GLint        mMode; // 0: closed, 1: recording, 2: replaying
+	GLuint       mFrameCnt;
+	GLuint       mEventCnt;
+};
+
+#endif
+
@@ -1,6 +1,8 @@
 #include "Md2.hpp"
 #include <fstream> // std::ifstream
 #include <cmath>   // modf
+#include <cstdlib> // malloc free
+#include <algorithm> // std::max std::swap
 
 ////////////////////////////////////////////////////////////////////////////////
 // Internal impl
@@ -52,14 +54,8 @@ public:
 		uint8_t n;     // index of the normal
 	};
 
-	// Constructors / Destructor
-	~_Frame()
-	{
-		delete[] vertices;
-	}
-
 	// Members
-	Vertex* vertices;   // vertices of the frame
+	Vertex* vertices;   // vertices of the frame (in the arena)
 #if __WORDSIZE==32
 private:
 	char _reserved[4];
@@ -82,6 +78,30 @@ public:
 	int16_t FrameCount() const {return end-start+1;}
 };
 
+
+////////////////////////////////////////////////////////////////////////////////
+// Md2::_ArenaLayout
+// Offsets of the arrays in the arena. The vertices of the frames are stored
+// back to back, so the keyframes of an animation are adjacent.
+class Md2::_ArenaLayout
+{
+public:
+	// Constructors / Destructor
+	_ArenaLayout(int16_t frameCnt,
+	             int16_t vertexCnt,
+	             int16_t triangleCnt,
+	             int16_t texCoordCnt,
+	             int16_t skinCnt);
+
+	// Members
+	size_t frames;
+	size_t vertices;
+	size_t triangles;
+	size_t texCoords;
+	size_t skins;
+	size_t size;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // File header of an md2 model
 class _Md2Header
@@ -183,6 +203,18 @@ public:
 	}
 };
 
+// Allocation failure exception
+class _AllocationFailedException : public Md2Exception
+{
+public:
+	explicit _AllocationFailedException(const std::string& filename)
+	{
+		mMessage = "The data of the file "
+		         + filename
+		         + " could not be allocated.";
+	}
+};
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // Normal table
@@ -301,10 +333,65 @@ const Md2::_Animation Md2::sAnimations[21] =
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Default allocator (aligned blocks of the heap; the address returned by
+// malloc is stored before the aligned block)
+class _HeapAllocator : public Md2::Allocator
+{
+public:
+	void* Allocate(size_t size, size_t alignment)
+	{
+		char* memory = reinterpret_cast<char*>(malloc(size
+		                                              + alignment
+		                                              + sizeof(void*)));
+		if(NULL == memory)
+			return NULL;
+		size_t address = reinterpret_cast<size_t>(memory + sizeof(void*));
+		address = (address + alignment - 1) & ~(alignment - 1);
+		reinterpret_cast<void**>(address)[-1] = memory;
+		return reinterpret_cast<void*>(address);
+	}
+	void Deallocate(void* memory)
+	{
+		free(reinterpret_cast<void**>(memory)[-1]);
+	}
+};
+static _HeapAllocator _heap_allocator;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Offset of the next array of the arena
+static size_t _arena_align(size_t offset)
+{
+	return (offset + Md2::ARENA_ALIGNMENT - 1) & ~size_t(Md2::ARENA_ALIGNMENT - 1);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Arena layout constructor
+Md2::_ArenaLayout::_ArenaLayout(int16_t frameCnt,
+                                int16_t vertexCnt,
+                                int16_t triangleCnt,
+                                int16_t texCoordCnt,
+                                int16_t skinCnt)
+{
+	frames    = 0;
+	vertices  = _arena_align(frames + sizeof(_Frame)*frameCnt);
+	triangles = _arena_align(vertices
+	                         + sizeof(_Frame::Vertex)*vertexCnt*frameCnt);
+	texCoords = _arena_align(triangles + sizeof(_Triangle)*triangleCnt);
+	skins     = _arena_align(texCoords
+	                         + sizeof(_TexCoord)*std::max<int16_t>(0, texCoordCnt));
+	size      = skins + sizeof(Skin)*std::max<int16_t>(0, skinCnt);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Default constructor
-Md2::Md2():
+Md2::Md2(Md2::Allocator* allocator):
 	mSkins(NULL), mTexCoords(NULL), mTriangles(NULL), mFrames(NULL), 
+	mAllocator(allocator ? allocator : &_heap_allocator), mArena(NULL),
+	mArenaSize(0),
 	mSkinCnt(-1), mTexCoordCnt(-1), mTriangleCnt(-1), mFrameCnt(-1), 
 	mVertexCnt(-1),
 	mSkinWidth(-1), mSkinHeight(-1),
@@ -317,8 +404,11 @@ Md2::Md2():
 
 ////////////////////////////////////////////////////////////////////////////////
 // Overloaded constructor
-Md2::Md2(const std::string& filename) throw(Md2Exception): 
+Md2::Md2(const std::string& filename, 
+         Md2::Allocator* allocator) throw(Md2Exception): 
 	mSkins(NULL), mTexCoords(NULL), mTriangles(NULL), mFrames(NULL), 
+	mAllocator(allocator ? allocator : &_heap_allocator), mArena(NULL),
+	mArenaSize(0),
 	mSkinCnt(-1), mTexCoordCnt(-1), mTriangleCnt(-1), mFrameCnt(-1), 
 	mVertexCnt(-1),
 	mSkinWidth(-1), mSkinHeight(-1),
@@ -339,6 +429,37 @@ Md2::~Md2() throw()
 }
 
 
+#if __cplusplus >= 201103L
+////////////////////////////////////////////////////////////////////////////////
+// Move constructor
+Md2::Md2(Md2&& md2) throw():
+	mSkins(NULL), mTexCoords(NULL), mTriangles(NULL), mFrames(NULL), 
+	mAllocator(md2.mAllocator), mArena(NULL),
+	mArenaSize(0),
+	mSkinCnt(-1), mTexCoordCnt(-1), mTriangleCnt(-1), mFrameCnt(-1), 
+	mVertexCnt(-1),
+	mSkinWidth(-1), mSkinHeight(-1),
+	mActiveAnimation(0), mActiveFrame(0.0f),
+	mSpeed(1.0f), mIsPlaying(true)
+{
+	Swap(md2);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Move assignment
+Md2& Md2::operator=(Md2&& md2) throw()
+{
+	if(this != &md2)
+	{
+		_Clear();
+		Swap(md2);
+	}
+	return *this;
+}
+#endif
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Load from file
 void Md2::Load(const std::string& filename) throw (Md2Exception)
@@ -363,6 +484,14 @@ void Md2::Load(const std::string& filename) throw (Md2Exception)
 	if(header.version!=8)
 		throw _BadVersionException(filename);
 
+	// check the data (the animation table needs the first 198 frames)
+	if(header.triangleCnt <= 0 || header.triangleCnt > 4096)
+		throw _BadTriangleDataException(filename);
+	if(header.frameCnt < 198 || header.frameCnt > 512)
+		throw _BadFrameDataException(filename);
+	if(header.vertexCnt <= 0 || header.vertexCnt > 2048)
+		throw _BadVertexDataException(filename);
+
 	// save information
 	mSkinCnt      = header.skinCnt;
 	mTexCoordCnt  = header.texCoordCnt;
@@ -372,10 +501,24 @@ void Md2::Load(const std::string& filename) throw (Md2Exception)
 	mSkinWidth    = header.skinWidth;
 	mSkinHeight   = header.skinHeight;
 
-	// allocate and read in data
+	// allocate all the arrays at once
+	_ArenaLayout layout(mFrameCnt,
+	                    mVertexCnt,
+	                    mTriangleCnt,
+	                    mTexCoordCnt,
+	                    mSkinCnt);
+	mArena = mAllocator->Allocate(layout.size, ARENA_ALIGNMENT);
+	if(NULL == mArena)
+	{
+		_Clear();
+		throw _AllocationFailedException(filename);
+	}
+	mArenaSize = layout.size;
+	_MapArena();
+
+	// read in data
 	if(0<mSkinCnt)
 	{
-		mSkins = new Skin[mSkinCnt];
 		// read skin data
 		fileStream.seekg( header.skinOffset, std::fstream::beg);
 		fileStream.read(  reinterpret_cast<char*>(mSkins),
@@ -383,37 +526,25 @@ void Md2::Load(const std::string& filename) throw (Md2Exception)
 	}
 	if(0<mTexCoordCnt)
 	{
-		mTexCoords = new _TexCoord[mTexCoordCnt];
 		// read texcoord data
 		fileStream.seekg( header.texCoordOffset, std::fstream::beg);
 		fileStream.read(  reinterpret_cast<char*>(mTexCoords),
 		                  sizeof(Md2::_TexCoord)*mTexCoordCnt);
 	}
-	if(0<mTriangleCnt)
-	{
-		mTriangles = new _Triangle[mTriangleCnt];
-		// read triangles
-		fileStream.seekg( header.triangleOffset, std::fstream::beg);
-		fileStream.read(  reinterpret_cast<char*>(mTriangles),
-		                  sizeof(Md2::_Triangle)*mTriangleCnt);
-	}
-	else
-		throw _BadTriangleDataException(filename);
-	if(198==mFrameCnt)
-		mFrames = new _Frame[mFrameCnt];
-	else
-		throw _BadFrameDataException(filename);
-	if(0<mVertexCnt)
-		for(int32_t i=0; i<mFrameCnt; ++i)
-			mFrames[i].vertices = new _Frame::Vertex[mVertexCnt];
-	else
-		throw _BadVertexDataException(filename);
+	// read triangles
+	fileStream.seekg( header.triangleOffset, std::fstream::beg);
+	fileStream.read(  reinterpret_cast<char*>(mTriangles),
+	                  sizeof(Md2::_Triangle)*mTriangleCnt);
 
 	// read frames
+	_Frame::Vertex* vertices = reinterpret_cast<_Frame::Vertex*>(
+	                               reinterpret_cast<char*>(mArena)
+	                               + layout.vertices);
 	fileStream.seekg(header.frameOffset, std::ifstream::beg);
 	for(int32_t i=0; i<mFrameCnt;++i)
 	{
 		// load frame
+		mFrames[i].vertices = vertices + i*mVertexCnt;
 		fileStream.read(   reinterpret_cast<char*>(&mFrames[i].scale[0]),
 		                    sizeof(float)*3);
 		fileStream.read(   reinterpret_cast<char*>(&mFrames[i].translation[0]),
@@ -429,6 +560,75 @@ void Md2::Load(const std::string& filename) throw (Md2Exception)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Release the data
+Md2::Data Md2::Release() throw()
+{
+	Data data;
+	data.arena         = mArena;
+	data.arenaSize     = mArenaSize;
+	data.allocator     = mAllocator;
+	data.skinCount     = mSkinCnt;
+	data.texCoordCount = mTexCoordCnt;
+	data.triangleCount = mTriangleCnt;
+	data.frameCount    = mFrameCnt;
+	data.vertexCount   = mVertexCnt;
+	data.skinWidth     = mSkinWidth;
+	data.skinHeight    = mSkinHeight;
+
+	// the arena is not freed
+	mArena = NULL;
+	_Clear();
+	return data;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Adopt data (the frames still point to the vertices of the arena)
+void Md2::Adopt(const Md2::Data& data) throw()
+{
+	_Clear();
+	if(NULL == data.arena)
+		return;
+	mArena       = data.arena;
+	mArenaSize   = data.arenaSize;
+	mAllocator   = data.allocator;
+	mSkinCnt     = data.skinCount;
+	mTexCoordCnt = data.texCoordCount;
+	mTriangleCnt = data.triangleCount;
+	mFrameCnt    = data.frameCount;
+	mVertexCnt   = data.vertexCount;
+	mSkinWidth   = data.skinWidth;
+	mSkinHeight  = data.skinHeight;
+	_MapArena();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Swap
+void Md2::Swap(Md2& md2) throw()
+{
+	std::swap(mSkins, md2.mSkins);
+	std::swap(mTexCoords, md2.mTexCoords);
+	std::swap(mTriangles, md2.mTriangles);
+	std::swap(mFrames, md2.mFrames);
+	std::swap(mAllocator, md2.mAllocator);
+	std::swap(mArena, md2.mArena);
+	std::swap(mArenaSize, md2.mArenaSize);
+	std::swap(mSkinCnt, md2.mSkinCnt);
+	std::swap(mTexCoordCnt, md2.mTexCoordCnt);
+	std::swap(mTriangleCnt, md2.mTriangleCnt);
+	std::swap(mFrameCnt, md2.mFrameCnt);
+	std::swap(mVertexCnt, md2.mVertexCnt);
+	std::swap(mSkinWidth, md2.mSkinWidth);
+	std::swap(mSkinHeight, md2.mSkinHeight);
+	std::swap(mActiveAnimation, md2.mActiveAnimation);
+	std::swap(mActiveFrame, md2.mActiveFrame);
+	std::swap(mSpeed, md2.mSpeed);
+	std::swap(mIsPlaying, md2.mIsPlaying);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Play
 void Md2::Play()
@@ -487,6 +687,39 @@ void Md2::Update(float dt)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Set pose
+void Md2::SetActivePose(const Md2::Pose& pose)
+{
+	mActiveAnimation = pose.animation;
+	mActiveFrame     = pose.frame;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Interpolate poses
+Md2::Pose Md2::InterpolatePoses(const Md2::Pose& pose0,
+                                const Md2::Pose& pose1,
+                                float t)
+{
+	if(pose0.animation != pose1.animation)
+		return pose1;
+
+	// unwrap the loop
+	const _Animation& animation = sAnimations[pose1.animation];
+	const float loopLength      = animation.end - animation.start;
+	float frame1 = pose1.frame;
+	if(frame1 < pose0.frame)
+		frame1+= loopLength;
+
+	Md2::Pose pose = pose1;
+	pose.frame = pose0.frame + t*(frame1 - pose0.frame);
+	if(pose.frame >= animation.end)
+		pose.frame-= loopLength;
+	return pose;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Get Vertices
 void Md2::GenVertices(Md2::Vertex* vertices) const
@@ -496,16 +729,12 @@ void Md2::GenVertices(Md2::Vertex* vertices) const
 	Md2::_Frame::Vertex *vertA, *vertB;
 	Md2::_Normal *normA, *normB;
 	Md2::_TexCoord *texCoord;
-	uint16_t nextFrame, index;
+	uint16_t index;
+	int16_t activeFrameIdx, nextFrame;
 	float posA[3], posB[3];
-	float lerp         = std::modf(mActiveFrame, &posA[0]); // &posA[0] is hack!
+	float lerp;
+	ActiveFrames(activeFrameIdx, nextFrame, lerp);
 	float oneMinusLerp = 1.0f - lerp; 
-	int16_t activeFrameIdx = static_cast<int16_t>(mActiveFrame);
-
-	// compute next frame index
-	nextFrame = activeFrameIdx == sAnimations[mActiveAnimation].end 
-	            ? sAnimations[mActiveAnimation].start 
-	            : activeFrameIdx+1;
 
 	// Uncompress the vertices
 	for(uint16_t i=0; i<mTriangleCnt; ++i)
@@ -553,6 +782,119 @@ void Md2::GenVertices(Md2::Vertex* vertices) const
 		}
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Get Vertices with normal indices
+void Md2::GenVertices(Md2::NormalIndexVertex* vertices) const
+{
+	// variables
+	Md2::_Frame *frameA, *frameB;
+	Md2::_Frame::Vertex *vertA, *vertB;
+	Md2::_TexCoord *texCoord;
+	uint16_t index;
+	int16_t activeFrameIdx, nextFrame;
+	float posA[3], posB[3];
+	float lerp;
+	ActiveFrames(activeFrameIdx, nextFrame, lerp);
+	float oneMinusLerp = 1.0f - lerp;
+
+	// Uncompress the vertices
+	frameA = &mFrames[activeFrameIdx];
+	frameB = &mFrames[nextFrame];
+	for(uint16_t i=0; i<mTriangleCnt; ++i)
+		for(uint16_t j=0; j<3; ++j)
+		{
+			// set pointers
+			vertA    = &frameA->vertices[mTriangles[i].iPos[j]];
+			vertB    = &frameB->vertices[mTriangles[i].iPos[j]];
+			texCoord = &mTexCoords[mTriangles[i].iSt[j]];
+			// set index
+			index = i*3+j;
+
+			// Uncompress and interpolate vertex position
+			for(uint16_t k=0; k<3; ++k)
+			{
+				posA[k] = frameA->scale[k] * (&vertA->x)[k]
+				        + frameA->translation[k];
+				posB[k] = frameB->scale[k] * (&vertB->x)[k]
+				        + frameB->translation[k];
+				vertices[index].p[k] = oneMinusLerp * posA[k]
+				                     + lerp * posB[k];
+			}
+
+			// normals are interpolated by the renderer
+			vertices[index].normals = uint32_t(vertA->n)
+			                        | uint32_t(vertB->n) << 8;
+
+			// compute texture coords
+			vertices[index].st[0] = float(texCoord->s) / mSkinWidth;
+			vertices[index].st[1] = 1.0f - float(texCoord->t) / mSkinHeight;
+		}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Get packed data
+void Md2::GenPackedVertices(uint32_t* vertices) const
+{
+	for(int16_t i=0; i<mFrameCnt; ++i)
+		GenPackedFrame(i, vertices + i*mVertexCnt);
+}
+
+void Md2::GenPackedFrame(int16_t frame, uint32_t* vertices) const
+{
+	const Md2::_Frame& keyframe = mFrames[frame];
+	for(int16_t i=0; i<mVertexCnt; ++i)
+		vertices[i] = uint32_t(keyframe.vertices[i].x)
+		            | uint32_t(keyframe.vertices[i].y) << 8
+		            | uint32_t(keyframe.vertices[i].z) << 16
+		            | uint32_t(keyframe.vertices[i].n) << 24;
+}
+
+void Md2::GenFrameTransforms(Md2::FrameTransform* transforms) const
+{
+	for(int16_t i=0; i<mFrameCnt; ++i)
+		GenFrameTransform(i, transforms + i);
+}
+
+void Md2::GenFrameTransform(int16_t frame,
+                            Md2::FrameTransform* transform) const
+{
+	for(int16_t i=0; i<3; ++i)
+	{
+		transform->scale[i]       = mFrames[frame].scale[i];
+		transform->translation[i] = mFrames[frame].translation[i];
+	}
+	transform->scale[3]       = 0.0f;
+	transform->translation[3] = 0.0f;
+}
+
+void Md2::GenCorners(Md2::Corner* corners) const
+{
+	for(uint16_t i=0; i<mTriangleCnt; ++i)
+		for(uint16_t j=0; j<3; ++j)
+		{
+			const Md2::_TexCoord& texCoord = mTexCoords[mTriangles[i].iSt[j]];
+			Md2::Corner& corner = corners[i*3+j];
+
+			// same expressions as GenVertices
+			corner.st[0]     = float(texCoord.s) / mSkinWidth;
+			corner.st[1]     = 1.0f - float(texCoord.t) / mSkinHeight;
+			corner.vertex    = mTriangles[i].iPos[j];
+			corner._reserved = 0;
+		}
+}
+
+void Md2::GenNormals(float* normals)
+{
+	for(int16_t i=0; i<162; ++i)
+	{
+		normals[4*i]   = sNormals[i].x;
+		normals[4*i+1] = sNormals[i].y;
+		normals[4*i+2] = sNormals[i].z;
+		normals[4*i+3] = 0.0f;
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Accessors
 const int16_t Md2::SkinCount()      const {return mSkinCnt;}
@@ -562,17 +904,59 @@ const int16_t Md2::FrameCount()     const {return mFrameCnt;}
 const int16_t Md2::VertexCount()    const {return mVertexCnt;}
 const int16_t Md2::SkinWidth()      const {return mSkinWidth;}
 const int16_t Md2::SkinHeight()     const {return mSkinHeight;}
+size_t Md2::ArenaSize()             const {return mArenaSize;}
 bool Md2::IsPlaying() const {return mIsPlaying;}
 
+Md2::Pose Md2::ActivePose() const
+{
+	Md2::Pose pose;
+	pose.animation = mActiveAnimation;
+	pose.frame     = mActiveFrame;
+	return pose;
+}
+
+void Md2::ActiveFrames(int16_t& frameA, int16_t& frameB, float& lerp) const
+{
+	float frame;
+	lerp   = std::modf(mActiveFrame, &frame);
+	frameA = static_cast<int16_t>(frame);
+
+	// compute next frame index
+	frameB = frameA == sAnimations[mActiveAnimation].end 
+	         ? sAnimations[mActiveAnimation].start 
+	         : frameA+1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Map the arrays of the arena
+void Md2::_MapArena()
+{
+	_ArenaLayout layout(mFrameCnt,
+	                    mVertexCnt,
+	                    mTriangleCnt,
+	                    mTexCoordCnt,
+	                    mSkinCnt);
+	char* arena = reinterpret_cast<char*>(mArena);
+	mFrames     = reinterpret_cast<_Frame*>(arena + layout.frames);
+	mTriangles  = reinterpret_cast<_Triangle*>(arena + layout.triangles);
+	mTexCoords  = 0 < mTexCoordCnt
+	            ? reinterpret_cast<_TexCoord*>(arena + layout.texCoords)
+	            : NULL;
+	mSkins      = 0 < mSkinCnt
+	            ? reinterpret_cast<Skin*>(arena + layout.skins)
+	            : NULL;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Clean
 void Md2::_Clear()
 {
-	delete[] mSkins;
-	delete[] mTexCoords;
-	delete[] mTriangles;
-	delete[] mFrames;
+	if(mArena)
+		mAllocator->Deallocate(mArena);
 
+	mArena      = NULL;
+	mArenaSize  = 0;
 	mSkins      = NULL;
 	mTexCoords  = NULL;
 	mTriangles  = NULL;
@@ -11,6 +11,8 @@
 //          - Maximum number of frames: 512
 //          - Maximum number of skins: 32
 //          - Number of precalculated normal vectors: 162
+//          The animations are those of the 198 frames of the player models,
+//          so models need at least 198 frames (the others are not played).
 //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -18,6 +20,7 @@
 #define MD2_HPP
 
 #include <string>       // std::string / std::exception
+#include <cstddef>      // size_t
 #include <stdint.h>     // integers
 
 
@@ -46,12 +49,69 @@ public:
 		float n[3];  // normal
 		float st[2]; // texture coordinates
 	};
+	// Md2 vertex format for rendering, with normal indices (the normals
+	// of both keyframes are interpolated by the renderer)
+	class NormalIndexVertex
+	{
+	public:
+		float    p[3];    // position
+		uint32_t normals; // normal index of frame a | frame b << 8
+		float    st[2];   // texture coordinates
+	};
+	// Md2 keyframe transform (packed positions are scaled then translated)
+	class FrameTransform
+	{
+	public:
+		float scale[4];       // scale {x,y,z}, w unused
+		float translation[4]; // translation {x,y,z}, w unused
+	};
+	// Md2 triangle corner (unrolled vertex)
+	class Corner
+	{
+	public:
+		float    st[2];       // texture coordinates
+		uint32_t vertex;      // index of the keyframe vertex
+		uint32_t _reserved;
+	};
+	// Md2 animation pose (the state advanced by Update)
+	class Pose
+	{
+	public:
+		int16_t animation; // active animation index
+		float   frame;     // active frame index (fractional)
+	};
 	// Md2 Skin
 	class Skin
 	{
 	public:
 		char name[64]; // name of the skin
 	};
+	// Md2 memory allocator
+	// The data of a model is allocated as a single block (frames are
+	// stored back to back, and each array starts on an aligned address).
+	class Allocator
+	{
+	public:
+		virtual ~Allocator() {}
+		virtual void* Allocate(size_t size, size_t alignment) = 0; // NULL
+		virtual void  Deallocate(void* memory) = 0;                // on error
+	};
+	enum {ARENA_ALIGNMENT = 64}; // alignment of the arrays, in bytes
+	// Md2 model data (see Release and Adopt)
+	class Data
+	{
+	public:
+		void*      arena;         // single block (NULL if not loaded)
+		size_t     arenaSize;     // in bytes
+		Allocator* allocator;     // allocator of the arena
+		int16_t    skinCount;     // counts of the arrays of the arena
+		int16_t    texCoordCount;
+		int16_t    triangleCount;
+		int16_t    frameCount;
+		int16_t    vertexCount;
+		int16_t    skinWidth;
+		int16_t    skinHeight;
+	};
 	enum AnimationName // Md2 animation
 	{
 		ANIMATION_STAND = 0,
@@ -78,22 +138,53 @@ public:
 	};
 
 	// Construtors / Destructors
-	Md2();
-	explicit Md2(const std::string& name) throw(Md2Exception);
+	// (a NULL allocator uses the heap)
+	explicit Md2(Allocator* allocator = NULL);
+	explicit Md2(const std::string& name,
+	             Allocator* allocator = NULL) throw(Md2Exception);
 	~Md2() throw();
+#if __cplusplus >= 201103L
+	// Move (the moved model is left unloaded)
+	Md2(Md2&& md2) throw();
+	Md2& operator=(Md2&& md2) throw();
+#endif
 
 	// Loading
 	void Load(const std::string& filename) throw(Md2Exception);
 
+	// Ownership (the animation state is left as is)
+	Data Release() throw();              // the model is left unloaded
+	void Adopt(const Data& data) throw(); // data returned by Release
+	void Swap(Md2& md2) throw();         // exchange data and animations
+
 	// Animation manipulation
 	void Play();                // play current animation
 	void Pause();               // pause current animation
 	void NextAnimation();       // play next animation
 	void PreviousAnimation();   // play previous animation
 	void Update(float dt);      // update the animation sequence
+	void SetActivePose(const Pose& pose);
+	// Pose between two updates of an animation (loops are unwrapped, a
+	// new animation is not blended); t in [0,1]
+	static Pose InterpolatePoses(const Pose& pose0,
+	                             const Pose& pose1,
+	                             float t);
 
 	// Stream data
 	void GenVertices(Vertex* vertices)        const; // allocated memory
+	void GenVertices(NormalIndexVertex* vertices) const; // allocated memory
+	// Packed data (to decode the vertices on the GPU)
+	// - packed vertices: VertexCount() integers per frame, 
+	//   x | y << 8 | z << 16 | normal << 24
+	// - frame transforms: one transform per frame
+	// - corners: TriangleCount()*3 corners (same order as GenVertices)
+	// - normals: 162 unit vectors {x,y,z,0}
+	void GenPackedVertices(uint32_t* vertices)        const; // all frames
+	void GenPackedFrame(int16_t frame, uint32_t* vertices) const;
+	void GenFrameTransforms(FrameTransform* transforms) const; // all frames
+	void GenFrameTransform(int16_t frame, FrameTransform* transform) const;
+	void GenCorners(Corner* corners)                  const;
+	static void GenNormals(float* normals);
 
 	// Queries
 	const int16_t VertexCount()    const;
@@ -103,7 +194,12 @@ public:
 	const int16_t FrameCount()     const;
 	const int16_t SkinWidth()      const;
 	const int16_t SkinHeight()     const;
+	size_t ArenaSize()             const; // model data, in bytes
 	bool IsPlaying()               const;
+	Pose ActivePose()              const;
+	void ActiveFrames(int16_t& frameA,      // keyframes and interpolation
+	                  int16_t& frameB,      // factor of the animation
+	                  float& lerp)   const; // (lerp in [0,1))
 
 private:
 	// Non copyable
@@ -112,6 +208,7 @@ private:
 
 	// Internal manipulation
 	void _Clear();
+	void _MapArena(); // set the array pointers of the arena
 
 	// Internal types declaration (defined in Md2.cpp)
 	class _TexCoord;
@@ -119,6 +216,7 @@ private:
 	class _Frame;
 	class _Normal;
 	class _Animation;
+	class _ArenaLayout;
 
 	// Members
 	static const _Normal     sNormals[162];    // normal table
@@ -127,9 +225,12 @@ private:
 	_TexCoord*   mTexCoords;              // texture coords array
 	_Triangle*   mTriangles;              // triangles array
 	_Frame*      mFrames;                 // frames array
+	Allocator*   mAllocator;              // allocator of the arena
+	void*        mArena;                  // memory of all the arrays
 #if __WORDSIZE==32
-	char _reserved[16];
+	char _reserved[24];
 #endif
+	uint32_t mArenaSize;      // size of the arena, in bytes
 	int16_t mSkinCnt;         // number of skins
 	int16_t mTexCoordCnt;     // number of texcoords
 	int16_t mTriangleCnt;     // number of triangles
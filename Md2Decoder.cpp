@@ -0,0 +1,189 @@
+#include "Md2Decoder.hpp"
+#include <sstream>  // std::stringstream
+#include <cassert>  // assert
+#include <algorithm>// std::max
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Static members
+PFNGLDISPATCHCOMPUTEPROC Md2Decoder::sDispatch = NULL;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+Md2Decoder::Md2Decoder() throw(fw::FWException) :
+	mProgram(0), mVertexCounts(), mVertexCountMax(0), mResidentSize(0),
+	mDispatchCnt(0)
+{
+	glGenBuffers(BUFFER_COUNT, mBuffers);
+	mProgram = glCreateProgram();
+
+	try
+	{
+		std::stringstream options;
+		options << "#define LOCAL_SIZE " << LOCAL_SIZE;
+		fw::build_glsl_program(mProgram,
+		                       "md2Decode.glsl",
+		                       options.str(),
+		                       GL_TRUE);
+	}
+	catch(fw::FWException&)
+	{
+		glDeleteBuffers(BUFFER_COUNT, mBuffers);
+		glDeleteProgram(mProgram);
+		throw;
+	}
+
+	// the normal table is shared by all the models
+	GLfloat normals[162*4];
+	Md2::GenNormals(normals);
+	_Upload(mBuffers[BUFFER_NORMALS], sizeof(normals), normals);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Destructor
+Md2Decoder::~Md2Decoder()
+{
+	glDeleteBuffers(BUFFER_COUNT, mBuffers);
+	glDeleteProgram(mProgram);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Upload static data
+void Md2Decoder::_Upload(GLuint buffer, GLsizeiptr size, const GLvoid* data)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Load
+void Md2Decoder::Load(const Md2* const* models, GLsizei modelCount)
+{
+#ifndef NDEBUG
+	assert(modelCount > 0);
+#endif
+	std::vector<uint32_t>            vertices;
+	std::vector<Md2::FrameTransform> frames;
+	std::vector<Md2::Corner>         corners;
+	std::vector<_Model>              modelData(modelCount);
+
+	// pack all the models
+	mVertexCounts.resize(modelCount);
+	mVertexCountMax = 0;
+	for(GLsizei i=0; i<modelCount; ++i)
+	{
+		const Md2& md2 = *models[i];
+		_Model& model  = modelData[i];
+		model.firstVertex  = vertices.size();
+		model.firstFrame   = frames.size();
+		model.firstCorner  = corners.size();
+		model.vertexCount  = md2.VertexCount();
+		model.cornerCount  = md2.TriangleCount()*3;
+		model._reserved[0] = model._reserved[1] = model._reserved[2] = 0;
+
+		vertices.resize(vertices.size() + md2.FrameCount()*md2.VertexCount());
+		frames.resize(frames.size() + md2.FrameCount());
+		corners.resize(corners.size() + model.cornerCount);
+		md2.GenPackedVertices(&vertices[model.firstVertex]);
+		md2.GenFrameTransforms(&frames[model.firstFrame]);
+		md2.GenCorners(&corners[model.firstCorner]);
+
+		mVertexCounts[i] = model.cornerCount;
+		mVertexCountMax  = std::max(mVertexCountMax, model.cornerCount);
+	}
+
+	// upload
+	mResidentSize = vertices.size()*sizeof(uint32_t)
+	              + frames.size()*sizeof(Md2::FrameTransform)
+	              + corners.size()*sizeof(Md2::Corner)
+	              + modelData.size()*sizeof(_Model);
+	_Upload(mBuffers[BUFFER_VERTICES],
+	        vertices.size()*sizeof(uint32_t),
+	        &vertices[0]);
+	_Upload(mBuffers[BUFFER_FRAMES],
+	        frames.size()*sizeof(Md2::FrameTransform),
+	        &frames[0]);
+	_Upload(mBuffers[BUFFER_CORNERS],
+	        corners.size()*sizeof(Md2::Corner),
+	        &corners[0]);
+	_Upload(mBuffers[BUFFER_MODELS],
+	        modelData.size()*sizeof(_Model),
+	        &modelData[0]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Decode
+void Md2Decoder::Decode(const Md2Decoder::Instance* instances,
+                        GLsizei instanceCount,
+                        GLuint vertexBuffer,
+                        fw::StateCache& stateCache)
+{
+#ifndef NDEBUG
+	assert(IsSupported());
+	assert(!mVertexCounts.empty());
+#endif
+	mDispatchCnt = 0;
+	if(instanceCount == 0)
+		return;
+
+	// upload the instances (the previous data is orphaned)
+	_Upload(mBuffers[BUFFER_INSTANCES],
+	        instanceCount*sizeof(Instance),
+	        instances);
+
+	// bind the buffers and decode all the instances at once
+	for(GLuint i=0; i<BUFFER_COUNT; ++i)
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, mBuffers[i]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BUFFER_COUNT, vertexBuffer);
+	stateCache.UseProgram(mProgram);
+	sDispatch((mVertexCountMax + LOCAL_SIZE - 1) / LOCAL_SIZE,
+	          instanceCount,
+	          1);
+	++mDispatchCnt;
+
+	// vertices are fetched as attributes afterwards
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Accessors
+GLsizei Md2Decoder::ModelCount() const
+{
+	return mVertexCounts.size();
+}
+
+GLuint Md2Decoder::VertexCount(GLsizei model) const
+{
+	return mVertexCounts[model];
+}
+
+GLsizeiptr Md2Decoder::ResidentSize() const
+{
+	return mResidentSize;
+}
+
+GLsizei Md2Decoder::DispatchCount() const
+{
+	return mDispatchCnt;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Dispatch entry point
+void Md2Decoder::SetDispatchFunction(PFNGLDISPATCHCOMPUTEPROC f)
+{
+	sDispatch = f;
+}
+
+bool Md2Decoder::IsSupported()
+{
+	return NULL != sDispatch;
+}
+
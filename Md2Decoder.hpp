@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    Md2Decoder.hpp
+// \author  Jonathan Dupuy
+// \brief   Decodes animated Md2 models on the GPU (GL4.3 compute shaders).
+//          The keyframes of the models are resident in shader storage
+//          buffers, and a single dispatch interpolates the vertices of all
+//          the instances of a frame. Decoded vertices are written in
+//          Md2::Vertex format, in the same order as Md2::GenVertices, so
+//          they can be drawn (and reused by several passes) like the
+//          vertices streamed by the CPU.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MD2DECODER_HPP
+#define MD2DECODER_HPP
+
+#include <vector>
+#include "Framework.hpp"
+#include "Md2.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Definition
+class Md2Decoder
+{
+public:
+	// Constants
+	enum {LOCAL_SIZE = 64}; // invocations per work group (see md2Decode.glsl)
+
+	// Decoded instance (std430 layout of md2Decode.glsl)
+	struct Instance
+	{
+		GLuint  model;        // model index (order of Load)
+		GLuint  frameA;       // keyframes (see Md2::ActiveFrames)
+		GLuint  frameB;
+		GLuint  firstVertex;  // first output vertex, in Md2::Vertex units
+		GLfloat lerp;         // interpolation factor
+		GLuint  _reserved[3];
+	};
+
+	// Constructors / Destructor (a GL4.3 context must be current)
+	Md2Decoder() throw(fw::FWException);
+	~Md2Decoder();
+
+	// Upload the keyframes of the models (previous models are released)
+	void Load(const Md2* const* models, GLsizei modelCount);
+
+	// Decode the instances in a vertex buffer with a single dispatch, and
+	// make the vertices visible to vertex attribute fetches
+	void Decode(const Instance* instances,
+	            GLsizei instanceCount,
+	            GLuint vertexBuffer,
+	            fw::StateCache& stateCache);
+
+	// Queries
+	GLsizei    ModelCount()                const;
+	GLuint     VertexCount(GLsizei model)  const; // decoded vertices
+	GLsizeiptr ResidentSize()              const; // keyframe data, in bytes
+	GLsizei    DispatchCount()             const; // dispatches issued
+
+	// Dispatch entry point (glDispatchCompute). The decoder is supported
+	// if it is set.
+	static void SetDispatchFunction(PFNGLDISPATCHCOMPUTEPROC f);
+	static bool IsSupported();
+
+private:
+	// Non copyable
+	Md2Decoder(const Md2Decoder&);
+	Md2Decoder& operator=(const Md2Decoder&);
+
+	// Internal types
+	struct _Model
+	{
+		GLuint firstVertex;
+		GLuint firstFrame;
+		GLuint firstCorner;
+		GLuint vertexCount;
+		GLuint cornerCount;
+		GLuint _reserved[3];
+	};
+	enum // storage buffer bindings (the output is bound at BUFFER_COUNT)
+	{
+		BUFFER_VERTICES = 0,
+		BUFFER_FRAMES,
+		BUFFER_CORNERS,
+		BUFFER_NORMALS,
+		BUFFER_MODELS,
+		BUFFER_INSTANCES,
+		BUFFER_COUNT
+	};
+
+	// Internal manipulation
+	void _Upload(GLuint buffer, GLsizeiptr size, const GLvoid* data);
+
+	// Members
+	static PFNGLDISPATCHCOMPUTEPROC sDispatch;
+	GLuint mBuffers[BUFFER_COUNT];
+	GLuint mProgram;
+	std::vector<GLuint> mVertexCounts;  // decoded vertices per model
+	GLuint     mVertexCountMax;
+	GLsizeiptr mResidentSize;
+	GLsizei    mDispatchCnt;
+};
+
+#endif
+
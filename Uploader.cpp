@@ -0,0 +1,398 @@
+#include "Uploader.hpp"
+#include <cassert>  // assert
+
+#ifdef _WIN32
+#	define NOMINMAX
+#	include <windows.h>
+#	include "GL/wglew.h"
+#else
+#	include "GL/glxew.h"
+#endif // _WIN32
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+Uploader::Uploader() throw(fw::FWException) :
+	mSubmittedCnt(0), mProcessedCnt(0), mRetiredCnt(0), mIsRunning(1),
+	mContextStatus(0), mThread(), mSignal(), mClock(), mDevice(NULL),
+	mContext(NULL), mDrawable(0), mBusyTime(0.0), mHandoffTime(0.0)
+{
+	for(GLint i=0; i<QUEUE_CAPACITY; ++i)
+		mRequests[i].fence = NULL;
+	mClock.Start();
+	if(!_CreateContext())
+		return;
+
+	// the worker reports whether it could use the context
+	try
+	{
+		mThread.Start(&Uploader::_WorkerMain, this);
+	}
+	catch(fw::FWException&)
+	{
+		_DestroyContext();
+		throw;
+	}
+	while(0 == mContextStatus)
+		fw::Thread::YieldThread();
+	if(mContextStatus < 0)
+	{
+		mThread.Join();
+		_DestroyContext();
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Destructor (pending uploads are issued first)
+Uploader::~Uploader()
+{
+	mIsRunning = 0;
+	fw::memory_barrier();
+	mSignal.Notify();
+	mThread.Join();
+	_DestroyContext();
+	for(GLint i=0; i<QUEUE_CAPACITY; ++i)
+		if(mRequests[i].fence)
+			glDeleteSync(mRequests[i].fence);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Create a context shared with the current one
+bool Uploader::_CreateContext()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+#ifdef _WIN32
+	HDC   dc    = wglGetCurrentDC();
+	HGLRC share = wglGetCurrentContext();
+	HGLRC context = NULL;
+	if(NULL == dc || NULL == share)
+		return false;
+	if(WGLEW_ARB_create_context)
+	{
+		const int attribs[] = {WGL_CONTEXT_MAJOR_VERSION_ARB, major,
+		                       WGL_CONTEXT_MINOR_VERSION_ARB, minor,
+		                       0};
+		context = wglCreateContextAttribsARB(dc, share, attribs);
+	}
+	else if(NULL != (context = wglCreateContext(dc))
+	        && !wglShareLists(share, context))
+	{
+		wglDeleteContext(context);
+		context = NULL;
+	}
+	mDevice  = dc;
+	mContext = context;
+#else
+	Display*    display  = glXGetCurrentDisplay();
+	GLXContext  share    = glXGetCurrentContext();
+	GLXDrawable drawable = glXGetCurrentDrawable();
+	GLXContext  context  = NULL;
+	if(NULL == display || NULL == share)
+		return false;
+
+	// same framebuffer configuration as the shared context
+	int configId  = 0;
+	int configCnt = 0;
+	glXQueryContext(display, share, GLX_FBCONFIG_ID, &configId);
+	const int configAttribs[] = {GLX_FBCONFIG_ID, configId, None};
+	GLXFBConfig* configs = glXChooseFBConfig(display,
+	                                         DefaultScreen(display),
+	                                         configAttribs,
+	                                         &configCnt);
+	if(NULL == configs)
+		return false;
+	if(configCnt > 0 && GLXEW_ARB_create_context)
+	{
+		const int attribs[] = {GLX_CONTEXT_MAJOR_VERSION_ARB, major,
+		                       GLX_CONTEXT_MINOR_VERSION_ARB, minor,
+		                       None};
+		context = glXCreateContextAttribsARB(display,
+		                                     configs[0],
+		                                     share,
+		                                     True,
+		                                     attribs);
+	}
+	else if(configCnt > 0)
+		context = glXCreateNewContext(display,
+		                              configs[0],
+		                              GLX_RGBA_TYPE,
+		                              share,
+		                              True);
+	XFree(configs);
+	mDevice   = display;
+	mContext  = context;
+	mDrawable = drawable;
+#endif
+	return NULL != mContext;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Make the shared context current (worker thread)
+bool Uploader::_MakeContextCurrent()
+{
+#ifdef _WIN32
+	return TRUE == wglMakeCurrent(reinterpret_cast<HDC>(mDevice),
+	                              reinterpret_cast<HGLRC>(mContext));
+#else
+	return True == glXMakeCurrent(reinterpret_cast<Display*>(mDevice),
+	                              mDrawable,
+	                              reinterpret_cast<GLXContext>(mContext));
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Destroy the shared context (it must not be current)
+void Uploader::_DestroyContext()
+{
+	if(NULL == mContext)
+		return;
+#ifdef _WIN32
+	wglDeleteContext(reinterpret_cast<HGLRC>(mContext));
+#else
+	glXDestroyContext(reinterpret_cast<Display*>(mDevice),
+	                  reinterpret_cast<GLXContext>(mContext));
+#endif
+	mContext = NULL;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Worker thread
+void Uploader::_WorkerMain(void* data)
+{
+	Uploader& uploader = *reinterpret_cast<Uploader*>(data);
+	if(!uploader._MakeContextCurrent())
+	{
+		fw::atomic_add(&uploader.mContextStatus, -1);
+		return;
+	}
+	fw::atomic_add(&uploader.mContextStatus, 1);
+
+	for(;;)
+	{
+		if(uploader.mProcessedCnt != uploader.mSubmittedCnt)
+		{
+			uploader._Process(uploader._Slot(uploader.mProcessedCnt+1));
+			fw::atomic_add(&uploader.mProcessedCnt, 1);
+		}
+		else if(uploader.mIsRunning)
+			uploader.mSignal.Wait(0.01);
+		else
+			break;
+	}
+
+	// release the context
+	glFinish();
+#ifdef _WIN32
+	wglMakeCurrent(NULL, NULL);
+#else
+	glXMakeCurrent(reinterpret_cast<Display*>(uploader.mDevice), None, NULL);
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Issue an upload and its fence (the fence is flushed so that other contexts
+// can wait for it)
+void Uploader::_Process(Uploader::_Request& request)
+{
+	request.startTime = mClock.Ticks();
+	if(request.target == GL_TEXTURE_2D)
+	{
+		glBindTexture(GL_TEXTURE_2D, request.name);
+		glTexImage2D(GL_TEXTURE_2D,
+		             0,
+		             request.internalFormat,
+		             request.width,
+		             request.height,
+		             0,
+		             request.format,
+		             request.type,
+		             request.data);
+		if(request.generateMipmap)
+			glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	else
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, request.name);
+		glBufferSubData(GL_COPY_WRITE_BUFFER,
+		                request.offset,
+		                request.size,
+		                request.data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	request.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+	request.stopTime = mClock.Ticks();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Queue a request (waits if the queue is full)
+Uploader::Ticket Uploader::_Submit(const Uploader::_Request& request)
+{
+	while(mSubmittedCnt - mProcessedCnt >= QUEUE_CAPACITY)
+		fw::Thread::YieldThread();
+	_Retire();
+
+	// the slot of the request QUEUE_CAPACITY uploads ago is reused
+	_Request& slot = _Slot(mSubmittedCnt+1);
+	if(slot.fence)
+		glDeleteSync(slot.fence);
+	slot            = request;
+	slot.fence      = NULL;
+	slot.submitTime = mClock.Ticks();
+
+	if(NULL == mContext)
+	{
+		_Process(slot);
+		fw::atomic_add(&mProcessedCnt, 1);
+		return fw::atomic_add(&mSubmittedCnt, 1);
+	}
+	// objects created by this context (e.g. buffer storage allocated with
+	// glBufferData) are only visible to the worker once it is flushed
+	glFlush();
+	Ticket ticket = fw::atomic_add(&mSubmittedCnt, 1);
+	mSignal.Notify();
+	return ticket;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Accumulate the statistics of the processed requests
+void Uploader::_Retire()
+{
+	int32_t processedCnt = mProcessedCnt;
+	for(; mRetiredCnt != processedCnt; ++mRetiredCnt)
+	{
+		const _Request& request = _Slot(mRetiredCnt+1);
+		mBusyTime    += request.stopTime - request.startTime;
+		mHandoffTime += request.startTime - request.submitTime;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Request slot of a ticket
+Uploader::_Request& Uploader::_Slot(Uploader::Ticket ticket)
+{
+	return mRequests[(ticket-1) % QUEUE_CAPACITY];
+}
+
+bool Uploader::_IsRecycled(Uploader::Ticket ticket) const
+{
+	return mSubmittedCnt - int32_t(ticket) >= QUEUE_CAPACITY;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Uploads
+Uploader::Ticket Uploader::UploadBuffer(GLuint buffer,
+                                        GLintptr offset,
+                                        GLsizeiptr size,
+                                        const GLvoid* data)
+{
+	_Request request;
+	request.target         = GL_COPY_WRITE_BUFFER;
+	request.name           = buffer;
+	request.offset         = offset;
+	request.size           = size;
+	request.internalFormat = 0;
+	request.width          = 0;
+	request.height         = 0;
+	request.format         = GL_NONE;
+	request.type           = GL_NONE;
+	request.data           = data;
+	request.generateMipmap = false;
+	return _Submit(request);
+}
+
+Uploader::Ticket Uploader::UploadTexture2D(GLuint texture,
+                                           GLint internalFormat,
+                                           GLsizei width,
+                                           GLsizei height,
+                                           GLenum format,
+                                           GLenum type,
+                                           const GLvoid* pixels,
+                                           bool generateMipmap)
+{
+	_Request request;
+	request.target         = GL_TEXTURE_2D;
+	request.name           = texture;
+	request.offset         = 0;
+	request.size           = 0;
+	request.internalFormat = internalFormat;
+	request.width          = width;
+	request.height         = height;
+	request.format         = format;
+	request.type           = type;
+	request.data           = pixels;
+	request.generateMipmap = generateMipmap;
+	return _Submit(request);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Completion
+bool Uploader::IsComplete(Uploader::Ticket ticket)
+{
+#ifndef NDEBUG
+	assert(ticket > 0 && int32_t(ticket) <= mSubmittedCnt);
+#endif
+	if(int32_t(ticket) > mProcessedCnt)
+		return false;
+	_Retire();
+	if(_IsRecycled(ticket))
+		return true;
+	GLenum status = glClientWaitSync(_Slot(ticket).fence, 0, 0);
+	return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+void Uploader::Wait(Uploader::Ticket ticket)
+{
+#ifndef NDEBUG
+	assert(ticket > 0 && int32_t(ticket) <= mSubmittedCnt);
+#endif
+	while(int32_t(ticket) > mProcessedCnt)
+		fw::Thread::YieldThread();
+	_Retire();
+	if(!_IsRecycled(ticket))
+		glWaitSync(_Slot(ticket).fence, 0, GL_TIMEOUT_IGNORED);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Accessors
+bool Uploader::IsAsynchronous() const
+{
+	return NULL != mContext;
+}
+
+GLuint Uploader::UploadCount() const
+{
+	return mRetiredCnt;
+}
+
+double Uploader::Utilization() const
+{
+	double time = mClock.Ticks();
+	return time > 0.0 ? mBusyTime / time : 0.0;
+}
+
+double Uploader::HandoffLatency() const
+{
+	return mRetiredCnt ? mHandoffTime / mRetiredCnt : 0.0;
+}
+
+double Uploader::TransferTime() const
+{
+	return mRetiredCnt ? mBusyTime / mRetiredCnt : 0.0;
+}
+
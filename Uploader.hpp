@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    Uploader.hpp
+// \author  Jonathan Dupuy
+// \brief   Uploads buffer and texture data on a worker thread. The worker
+//          owns a GL context shared with the context of the thread that
+//          creates the uploader. Each upload is followed by a fence: the
+//          render thread polls it, or makes its own commands wait for it
+//          (glWaitSync) before the uploaded objects are used.
+//          If no shared context can be created, uploads are executed
+//          immediately by the calling thread (and fenced the same way).
+//          Client memory must remain valid until Wait returns or until
+//          IsComplete returns true. Objects modified by the worker must be
+//          bound again after the wait to see the new data. The calling
+//          context is flushed on each upload, so that the objects it
+//          created are visible to the worker.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef UPLOADER_HPP
+#define UPLOADER_HPP
+
+#include "Framework.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Definition
+class Uploader
+{
+public:
+	// Constants
+	enum {QUEUE_CAPACITY = 64}; // uploads in flight (older tickets are done)
+
+	// Upload identifier (0 is never returned)
+	typedef GLuint Ticket;
+
+	// Constructors / Destructor (the context to share must be current)
+	Uploader() throw(fw::FWException);
+	~Uploader();
+
+	// Manipulation
+		// glBufferSubData (the buffer storage must be allocated)
+	Ticket UploadBuffer(GLuint buffer,
+	                    GLintptr offset,
+	                    GLsizeiptr size,
+	                    const GLvoid* data);
+		// glTexImage2D, followed by glGenerateMipmap if requested
+	Ticket UploadTexture2D(GLuint texture,
+	                       GLint internalFormat,
+	                       GLsizei width,
+	                       GLsizei height,
+	                       GLenum format,
+	                       GLenum type,
+	                       const GLvoid* pixels,
+	                       bool generateMipmap);
+		// poll the fence of the upload (never waits)
+	bool IsComplete(Ticket ticket);
+		// wait until the worker issued the upload, and make the commands
+		// of the current context wait for its fence (on the GPU)
+	void Wait(Ticket ticket);
+
+	// Queries
+	bool   IsAsynchronous() const; // uploads run on the worker thread
+	GLuint UploadCount()    const; // uploads issued by the worker
+	double Utilization()    const; // busy fraction of the worker
+	double HandoffLatency() const; // mean submission to transfer delay (s)
+	double TransferTime()   const; // mean worker time per upload (s)
+
+private:
+	// Internal types
+	struct _Request
+	{
+		GLenum        target;    // GL_TEXTURE_2D or GL_COPY_WRITE_BUFFER
+		GLuint        name;
+		GLintptr      offset;
+		GLsizeiptr    size;
+		GLint         internalFormat;
+		GLsizei       width;
+		GLsizei       height;
+		GLenum        format;
+		GLenum        type;
+		const GLvoid* data;
+		bool          generateMipmap;
+		GLsync        fence;     // set by the worker
+		double        submitTime;
+		double        startTime;
+		double        stopTime;
+	};
+
+	// Non copyable
+	Uploader(const Uploader&);
+	Uploader& operator=(const Uploader&);
+
+	// Internal manipulation
+	static void _WorkerMain(void* data);
+	bool _CreateContext();
+	bool _MakeContextCurrent();
+	void _DestroyContext();
+	Ticket _Submit(const _Request& request);
+	void _Process(_Request& request);
+	void _Retire();
+	_Request& _Slot(Ticket ticket);
+	bool _IsRecycled(Ticket ticket) const;
+
+	// Members
+	_Request         mRequests[QUEUE_CAPACITY];
+	volatile int32_t mSubmittedCnt;  // written by the render thread
+	volatile int32_t mProcessedCnt;  // written by the worker
+	int32_t          mRetiredCnt;    // statistics accumulated
+	volatile int32_t mIsRunning;
+	volatile int32_t mContextStatus; // 0: pending, 1: current, -1: failed
+	fw::Thread       mThread;
+	fw::Signal       mSignal;        // wakes up the worker
+	fw::Timer        mClock;         // shared clock (never stopped)
+	void*            mDevice;        // Display* or HDC
+	void*            mContext;       // GLXContext or HGLRC (NULL: none)
+	unsigned long    mDrawable;      // GLXDrawable (unused on Windows)
+	double           mBusyTime;
+	double           mHandoffTime;
+};
+
+#endif
+
@@ -18,6 +18,93 @@ Affine Affine::Translation(const Vector3& translation)
                   1.0f);
 }
 
+Affine Affine::RotationAboutX(float radians)
+{
+	return Affine(Matrix3x3::RotationAboutX(radians),
+	              Vector3(0,0,0),
+	              1.0f);
+}
+
+Affine Affine::RotationAboutY(float radians)
+{
+	return Affine(Matrix3x3::RotationAboutY(radians),
+	              Vector3(0,0,0),
+	              1.0f);
+}
+
+Affine Affine::RotationAboutZ(float radians)
+{
+	return Affine(Matrix3x3::RotationAboutZ(radians),
+	              Vector3(0,0,0),
+	              1.0f);
+}
+
+Affine Affine::RotationAboutAxis(const Vector3& unitAxis,
+                                 float radians)
+{
+	return Affine(Matrix3x3::RotationAboutAxis(unitAxis, radians),
+	              Vector3(0,0,0),
+	              1.0f);
+}
+
+Affine Affine::Rotation(float yawRadians,
+                        float pitchRadians,
+                        float rollRadians)
+{
+	return Affine(Matrix3x3::Rotation(yawRadians, pitchRadians, rollRadians),
+	              Vector3(0,0,0),
+	              1.0f);
+}
+
+Affine Affine::Scale(float nonZeroFactor)
+{
+#ifndef NDEBUG
+	assert(nonZeroFactor != 0.0f);
+#endif
+	return Affine(Matrix3x3::Diagonal(1,1,1),
+	              Vector3(0,0,0),
+	              nonZeroFactor);
+}
+
+Affine Affine::LookAt(const Vector3& position,
+                      const Vector3& targetPosition,
+                      const Vector3& unitUp)
+{
+	return Affine(Matrix3x3::LookAtRotation(position, targetPosition, unitUp),
+	              position,
+	              1.0f);
+}
+
+Affine Affine::Rotation(const Quaternion& unitRotation)
+{
+	Affine affine(Matrix3x3::Diagonal(1,1,1),
+	              Vector3(0,0,0),
+	              1.0f);
+	affine.mRotationMode = ROTATION_MODE_QUATERNION;
+	affine.SetRotation(unitRotation);
+	return affine;
+}
+
+Affine Affine::Nlerp(const Affine& from, const Affine& to, float t)
+{
+	Affine affine = Rotation(Quaternion::Nlerp(from.GetRotation(),
+	                                           to.GetRotation(),
+	                                           t));
+	affine.SetPosition(from.mPosition + t*(to.mPosition - from.mPosition));
+	affine.SetScale(from.mScale + t*(to.mScale - from.mScale));
+	return affine;
+}
+
+Affine Affine::Slerp(const Affine& from, const Affine& to, float t)
+{
+	Affine affine = Rotation(Quaternion::Slerp(from.GetRotation(),
+	                                           to.GetRotation(),
+	                                           t));
+	affine.SetPosition(from.mPosition + t*(to.mPosition - from.mPosition));
+	affine.SetScale(from.mScale + t*(to.mScale - from.mScale));
+	return affine;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // Explicit constructor
@@ -25,9 +112,15 @@ Affine::Affine(const Matrix3x3& unitAxis,
                const Vector3& position,
                float scale) :
 	mUnitAxis(unitAxis),
+	mRotation(Quaternion::IDENTITY),
 	mPosition(position),
 	mScale(scale),
-	mIsRS(position == Vector3::ZERO)
+	mIsRS(position == Vector3::ZERO),
+	mRotationMode(ROTATION_MODE_MATRIX),
+	mIsAxisValid(true),
+	mVersion(TransformCache::nextVersion()),
+	mTransformVersion(0),
+	mInverseTransformVersion(0)
 {
 //	if(position != Vector3::ZERO)
 //		mIsRS = false;
@@ -41,7 +134,7 @@ bool Affine::operator==(const Affine& affine) const
 
 bool Affine::operator!=(const Affine& affine) const
 {
-	return (   mUnitAxis != affine.mUnitAxis
+	return (   GetUnitAxis() != affine.GetUnitAxis()
 	        || mPosition != affine.mPosition
 	        ||   mScale  != affine.mScale);
 }
@@ -53,39 +146,125 @@ void Affine::TranslateWorld(const Vector3& direction)
 {
 	mPosition += direction;
 	mIsRS     = mPosition == Vector3::ZERO;
+	touch();
 }
 
 void Affine::TranslateLocal(const Vector3& direction)
 {
-	TranslateWorld(mUnitAxis * direction);
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+		TranslateWorld(mRotation * direction);
+	else
+		TranslateWorld(mUnitAxis * direction);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // RotateWorld
 void Affine::RotateAboutWorldX(float radians)
-{ mUnitAxis = Matrix3x3::RotationAboutX(radians) * mUnitAxis; normalizeAxis(); }
+{
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+		RotateWorld(Quaternion::RotationAboutX(radians));
+	else
+	{
+		mUnitAxis = Matrix3x3::RotationAboutX(radians) * mUnitAxis;
+		normalizeAxis();
+		touch();
+	}
+}
 
 void Affine::RotateAboutWorldY(float radians)
-{ mUnitAxis = Matrix3x3::RotationAboutY(radians) * mUnitAxis; normalizeAxis(); }
+{
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+		RotateWorld(Quaternion::RotationAboutY(radians));
+	else
+	{
+		mUnitAxis = Matrix3x3::RotationAboutY(radians) * mUnitAxis;
+		normalizeAxis();
+		touch();
+	}
+}
 
 void Affine::RotateAboutWorldZ(float radians)
-{ mUnitAxis = Matrix3x3::RotationAboutZ(radians) * mUnitAxis; normalizeAxis(); }
+{
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+		RotateWorld(Quaternion::RotationAboutZ(radians));
+	else
+	{
+		mUnitAxis = Matrix3x3::RotationAboutZ(radians) * mUnitAxis;
+		normalizeAxis();
+		touch();
+	}
+}
+
+void Affine::RotateWorld(const Quaternion& unitRotation)
+{
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+	{
+		// renormalizing a quaternion is enough to prevent drift
+		mRotation    = (unitRotation * mRotation).Normalize();
+		mIsAxisValid = false;
+	}
+	else
+	{
+		mUnitAxis = unitRotation.ExtractRotationMatrix() * mUnitAxis;
+		normalizeAxis();
+	}
+	touch();
+}
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // RotateLocal
 void Affine::RotateAboutLocalX(float radians)
-{ mUnitAxis *= Matrix3x3::RotationAboutX(radians);
-  normalizeAxis(); }
+{
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+		RotateLocal(Quaternion::RotationAboutX(radians));
+	else
+	{
+		mUnitAxis *= Matrix3x3::RotationAboutX(radians);
+		normalizeAxis();
+		touch();
+	}
+}
 
 void Affine::RotateAboutLocalY(float radians)
-{ mUnitAxis *= Matrix3x3::RotationAboutY(radians);
-  normalizeAxis(); }
+{
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+		RotateLocal(Quaternion::RotationAboutY(radians));
+	else
+	{
+		mUnitAxis *= Matrix3x3::RotationAboutY(radians);
+		normalizeAxis();
+		touch();
+	}
+}
 
 void Affine::RotateAboutLocalZ(float radians)
-{ mUnitAxis *= Matrix3x3::RotationAboutZ(radians);
-  normalizeAxis(); }
+{
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+		RotateLocal(Quaternion::RotationAboutZ(radians));
+	else
+	{
+		mUnitAxis *= Matrix3x3::RotationAboutZ(radians);
+		normalizeAxis();
+		touch();
+	}
+}
+
+void Affine::RotateLocal(const Quaternion& unitRotation)
+{
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+	{
+		mRotation    = (mRotation * unitRotation).Normalize();
+		mIsAxisValid = false;
+	}
+	else
+	{
+		mUnitAxis *= unitRotation.ExtractRotationMatrix();
+		normalizeAxis();
+	}
+	touch();
+}
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -94,6 +273,12 @@ void Affine::LookAt(const Vector3& targetPos,
                     const Vector3& unitUp)
 {
 	mUnitAxis = Matrix3x3::LookAtRotation(mPosition, targetPos, unitUp);
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+	{
+		mRotation    = Quaternion::RotationMatrix(mUnitAxis);
+		mIsAxisValid = true;
+	}
+	touch();
 }
 
 
@@ -101,80 +286,114 @@ void Affine::LookAt(const Vector3& targetPos,
 // Reset
 void Affine::MakeDefaultAxis()
 {
-	mUnitAxis = Matrix3x3::Diagonal(1,1,1);
+	mUnitAxis    = Matrix3x3::Diagonal(1,1,1);
+	mRotation    = Quaternion::IDENTITY;
+	mIsAxisValid = true;
+	touch();
 }
 
 void Affine::MakeZeroPosition()
 {
 	mIsRS     = true;
 	mPosition = Vector3(0.0f, 0.0f, 0.0f);
+	touch();
 }
 
 void Affine::MakeUnitScale()
 {
 	mScale = 1.0f;
+	touch();
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Matrix extraction
-Matrix4x4 Affine::ExtractTransformMatrix() const
+const Matrix4x4& Affine::ExtractTransformMatrix() const
 {
-	return Matrix4x4(mUnitAxis[0][0]*mScale,
-	                 mUnitAxis[1][0]*mScale,
-	                 mUnitAxis[2][0]*mScale,
-	                 mPosition[0],
-	                 mUnitAxis[0][1]*mScale,
-	                 mUnitAxis[1][1]*mScale,
-	                 mUnitAxis[2][1]*mScale,
-	                 mPosition[1],
-	                 mUnitAxis[0][2]*mScale,
-	                 mUnitAxis[1][2]*mScale,
-	                 mUnitAxis[2][2]*mScale,
-	                 mPosition[2],
-	                 0.0f, 0.0f, 0.0f, 1.0f);
+	if(mTransformVersion == mVersion)
+	{
+		TransformCache::hit();
+		return mTransform;
+	}
+	TransformCache::miss();
+
+	updateAxis();
+	mTransform = Matrix4x4(mUnitAxis[0][0]*mScale,
+	                       mUnitAxis[1][0]*mScale,
+	                       mUnitAxis[2][0]*mScale,
+	                       mPosition[0],
+	                       mUnitAxis[0][1]*mScale,
+	                       mUnitAxis[1][1]*mScale,
+	                       mUnitAxis[2][1]*mScale,
+	                       mPosition[1],
+	                       mUnitAxis[0][2]*mScale,
+	                       mUnitAxis[1][2]*mScale,
+	                       mUnitAxis[2][2]*mScale,
+	                       mPosition[2],
+	                       0.0f, 0.0f, 0.0f, 1.0f);
+	mTransformVersion = mVersion;
+	return mTransform;
 }
 
-Matrix4x4 Affine::ExtractInverseTransformMatrix() const
+const Matrix4x4& Affine::ExtractInverseTransformMatrix() const
 {
+	if(mInverseTransformVersion == mVersion)
+	{
+		TransformCache::hit();
+		return mInverseTransform;
+	}
+	TransformCache::miss();
+
+	updateAxis();
 	if(mIsRS)
 	{
-		// return transpose only
+		// return transpose divided by scale
 		float invScale = 1.0f / mScale;
-		return Matrix4x4(mUnitAxis[0][0]*invScale,
-		                 mUnitAxis[0][1],
-		                 mUnitAxis[0][2],
-		                 0.0f,
-		                 mUnitAxis[1][0],
-		                 mUnitAxis[1][1]*invScale,
-		                 mUnitAxis[1][2],
-		                 0.0f,
-		                 mUnitAxis[2][0],
-		                 mUnitAxis[2][1],
-		                 mUnitAxis[2][2]*invScale,
-		                 0.0f,
-		                 0.0f , 0.0f, 0.0f, 1.0f);
+		mInverseTransform = Matrix4x4(mUnitAxis[0][0]*invScale,
+		                              mUnitAxis[0][1]*invScale,
+		                              mUnitAxis[0][2]*invScale,
+		                              0.0f,
+		                              mUnitAxis[1][0]*invScale,
+		                              mUnitAxis[1][1]*invScale,
+		                              mUnitAxis[1][2]*invScale,
+		                              0.0f,
+		                              mUnitAxis[2][0]*invScale,
+		                              mUnitAxis[2][1]*invScale,
+		                              mUnitAxis[2][2]*invScale,
+		                              0.0f,
+		                              0.0f , 0.0f, 0.0f, 1.0f);
 	}
 	else
 	{
 		// compute full inverse
-		return ExtractTransformMatrix().Inverse();
+		mInverseTransform = ExtractTransformMatrix().Inverse();
 	}
+	mInverseTransformVersion = mVersion;
+	return mInverseTransform;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Axis queries
-const Vector3& Affine::UnitXAxis() const { return mUnitAxis[0]; }
-const Vector3& Affine::UnitYAxis() const { return mUnitAxis[1]; }
-const Vector3& Affine::UnitZAxis() const { return mUnitAxis[2]; }
+const Vector3& Affine::UnitXAxis() const { updateAxis(); return mUnitAxis[0]; }
+const Vector3& Affine::UnitYAxis() const { updateAxis(); return mUnitAxis[1]; }
+const Vector3& Affine::UnitZAxis() const { updateAxis(); return mUnitAxis[2]; }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Accessors
-const Matrix3x3& Affine::GetUnitAxis()  const { return mUnitAxis; }
+const Matrix3x3& Affine::GetUnitAxis()  const { updateAxis(); return mUnitAxis; }
 const Vector3& Affine::GetPosition()    const { return mPosition; }
 float Affine::GetScale()                const { return mScale; }
+Affine::RotationMode Affine::GetRotationMode() const { return mRotationMode; }
+unsigned int Affine::GetVersion()       const { return mVersion; }
+
+Quaternion Affine::GetRotation() const
+{
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+		return mRotation;
+	return Quaternion::RotationMatrix(mUnitAxis);
+}
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -183,6 +402,7 @@ void Affine::SetPosition(const Vector3& position)
 {
 	mPosition = position;
 	mIsRS     = mPosition == Vector3::ZERO;
+	touch();
 }
 
 void Affine::SetScale(float nonZeroScale)
@@ -191,6 +411,34 @@ void Affine::SetScale(float nonZeroScale)
 	assert(nonZeroScale != 0.0f);
 #endif
 	mScale = nonZeroScale;
+	touch();
+}
+
+void Affine::SetRotation(const Quaternion& unitRotation)
+{
+	if(mRotationMode == ROTATION_MODE_QUATERNION)
+	{
+		mRotation    = unitRotation;
+		mIsAxisValid = false;
+	}
+	else
+		mUnitAxis = unitRotation.ExtractRotationMatrix();
+	touch();
+}
+
+void Affine::SetRotationMode(RotationMode mode)
+{
+	if(mode == mRotationMode)
+		return;
+	if(mode == ROTATION_MODE_QUATERNION)
+	{
+		mRotation    = Quaternion::RotationMatrix(mUnitAxis);
+		mIsAxisValid = true;
+	}
+	else
+		updateAxis();
+	mRotationMode = mode;
+	touch();
 }
 
 
@@ -204,3 +452,21 @@ void Affine::normalizeAxis()
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Update Axis (quaternion to matrix conversion)
+void Affine::updateAxis() const
+{
+	if(!mIsAxisValid)
+	{
+		mUnitAxis    = mRotation.ExtractRotationMatrix();
+		mIsAxisValid = true;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Touch (invalidates the cached matrices)
+void Affine::touch()
+{
+	mVersion = TransformCache::nextVersion();
+}
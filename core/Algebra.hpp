@@ -9,6 +9,7 @@
 //          - Matrix2x2: 2x2 square, column major matrix
 //          - Matrix3x3: 3x3 square, column major matrix
 //          - Matrix4x4: 4x4 square, column major matrix
+//          - Quaternion: rotation quaternion (x,y,z vector part, w scalar part)
 //          Notes:
 //          - angles must be provided in radians
 //          - user is encouraged to use bracket operators to access members
@@ -618,6 +619,97 @@ private:
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Quaternion definition
+// Rotations are composed like matrices: (q1*q2) rotates by q2, then by q1.
+class Quaternion
+{
+public:
+	// Factories
+	static Quaternion RotationAboutX(const float& radians);
+	static Quaternion RotationAboutY(const float& radians);
+	static Quaternion RotationAboutZ(const float& radians);
+	static Quaternion Rotation(const float& yaw,
+	                           const float& pitch,
+	                           const float& roll);
+	static Quaternion RotationAboutAxis(const Vector3& unitAxis,
+	                                    const float& radians);
+	static Quaternion VectorRotation(const Vector3& unitFrom,
+	                                 const Vector3& unitTo);
+	static Quaternion RotationMatrix(const Matrix3x3& unitAxis);
+
+	// Factories (continued, shortest path interpolations)
+	static Quaternion Nlerp(const Quaternion& unitFrom,
+	                        const Quaternion& unitTo,
+	                        const float& t);
+	static Quaternion Slerp(const Quaternion& unitFrom,
+	                        const Quaternion& unitTo,
+	                        const float& t);
+
+	// Static manipulation
+	static float DotProduct(const Quaternion& q1, const Quaternion& q2);
+
+	// Constructors
+	Quaternion(const float& x =0,
+	           const float& y =0,
+	           const float& z =0,
+	           const float& w =1);
+	Quaternion(const Vector3& v, const float& w);
+
+	// Access operators
+	const float& operator[](size_t i) const;
+	float& operator[](size_t i);
+
+	// Arithmetic operators
+	Quaternion operator+(const Quaternion& q) const;
+	Quaternion operator-(const Quaternion& q) const;
+	Quaternion operator*(const Quaternion& q) const;
+	Quaternion operator*(const float& s)      const;
+	Vector3    operator*(const Vector3& v)    const; // rotation (unit only)
+	Quaternion operator+() const;
+	Quaternion operator-() const;
+
+	// Assignment operators
+	Quaternion& operator+=(const Quaternion& q);
+	Quaternion& operator-=(const Quaternion& q);
+	Quaternion& operator*=(const Quaternion& q);
+	Quaternion& operator*=(const float& s);
+
+	// Comparison operators
+	bool operator==(const Quaternion& q) const;
+	bool operator!=(const Quaternion& q) const;
+
+	// Queries
+	float Length()         const;
+	float LengthSquared()  const;
+	Quaternion Normalize() const;
+	Quaternion Conjugate() const;
+	Quaternion Inverse()   const;
+
+	// Matrix extraction (unit only)
+	Matrix3x3 ExtractRotationMatrix() const;
+
+	// Mutators
+	void SetX(const float& x);
+	void SetY(const float& y);
+	void SetZ(const float& z);
+	void SetW(const float& w);
+
+	// Accessors
+	const float& GetX() const;
+	const float& GetY() const;
+	const float& GetZ() const;
+	const float& GetW() const;
+
+	// Constants
+	static const Quaternion IDENTITY;
+
+private:
+	// Members
+	float mX, mY, mZ, mW;
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Additionnal operators
 Vector2 operator*(const float& s, const Vector2& v);
@@ -626,6 +718,7 @@ Vector4 operator*(const float& s, const Vector4& v);
 Matrix2x2 operator*(const float& s, const Matrix2x2& m);
 Matrix3x3 operator*(const float& s, const Matrix3x3& m);
 Matrix4x4 operator*(const float& s, const Matrix4x4& m);
+Quaternion operator*(const float& s, const Quaternion& q);
 
 #endif
 
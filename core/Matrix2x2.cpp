@@ -228,8 +228,8 @@ Matrix2x2 Matrix2x2::Transpose() const
 Matrix2x2 Matrix2x2::Adjugate() const
 {
 	// return transpose of cofactors
-	return Matrix2x2( (*this)[1][1], -(*this)[0][1],
-	                 -(*this)[1][0],  (*this)[0][0]);
+	return Matrix2x2( (*this)[1][1], -(*this)[1][0],
+	                 -(*this)[0][1],  (*this)[0][0]);
 }
 
 
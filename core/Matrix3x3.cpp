@@ -163,7 +163,7 @@ Matrix3x3 Matrix3x3::LookAtRotation(const Vector3& eyePos,
 #endif
 	// using OpenGL2.1 SDK (gluLookAt)
 	Vector3 f((targetPos - eyePos).Normalize());
-	Vector3 s(Vector3::CrossProduct(f, unitUpVector));
+	Vector3 s(Vector3::CrossProduct(f, unitUpVector).Normalize());
 	Vector3 u(Vector3::CrossProduct(s, f));
 
 	return Matrix3x3(s[0], u[0], -f[0],
@@ -320,8 +320,8 @@ float Matrix3x3::Determinant() const
 {
 	return (  (*this)[0][0]*( (*this)[1][1]*(*this)[2][2]
 	                         -(*this)[2][1]*(*this)[1][2] )
-	        - (*this)[1][0]*( (*this)[2][1]*(*this)[0][2]
-	                         -(*this)[0][1]*(*this)[2][2] )
+	        - (*this)[1][0]*( (*this)[0][1]*(*this)[2][2]
+	                         -(*this)[2][1]*(*this)[0][2] )
 	        + (*this)[2][0]*( (*this)[0][1]*(*this)[1][2]
 	                         -(*this)[1][1]*(*this)[0][2] ) );
 }
@@ -354,7 +354,7 @@ Matrix3x3 Matrix3x3::Adjugate() const
 {
 	// compute cofactors
 	float c00 = (*this)[1][1] * (*this)[2][2] - (*this)[1][2] * (*this)[2][1];
-	float c10 = (*this)[0][2] * (*this)[2][2] - (*this)[0][1] * (*this)[2][2];
+	float c10 = (*this)[2][1] * (*this)[0][2] - (*this)[0][1] * (*this)[2][2];
 	float c20 = (*this)[0][1] * (*this)[1][2] - (*this)[1][1] * (*this)[0][2];
 	float c01 = (*this)[1][2] * (*this)[2][0] - (*this)[1][0] * (*this)[2][2];
 	float c11 = (*this)[0][0] * (*this)[2][2] - (*this)[0][2] * (*this)[2][0];
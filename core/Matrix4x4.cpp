@@ -190,7 +190,7 @@ Matrix4x4 Matrix4x4::Ortho(const float& left,
                            const float& far)
 {
 #ifndef NDEBUG
-	assert(left != right && bottom != top && near != bottom);
+	assert(left != right && bottom != top && near != far);
 #endif
 	// do some precomputations
 	float oneOverRightMinusLeft = 1.0f/(right - left);
@@ -377,7 +377,7 @@ Matrix4x4 Matrix4x4::operator*(const Matrix4x4& m) const
 	                  +(*this)[2][3]*m[1][2]+(*this)[3][3]*m[1][3],
 	                   (*this)[0][3]*m[2][0]+(*this)[1][3]*m[2][1]
 	                  +(*this)[2][3]*m[2][2]+(*this)[3][3]*m[2][3],
-	                   (*this)[0][3]*m[3][0]+(*this)[1][3]*m[2][1]
+	                   (*this)[0][3]*m[3][0]+(*this)[1][3]*m[3][1]
 	                  +(*this)[2][3]*m[3][2]+(*this)[3][3]*m[3][3]  );
 }
 
@@ -443,7 +443,7 @@ float Matrix4x4::Determinant() const
 {
 	return (  ((*this)[0][0]*(*this)[1][1] - (*this)[1][0]*(*this)[0][1])
 	         *((*this)[2][2]*(*this)[3][3] - (*this)[3][2]*(*this)[2][3])
-	         -((*this)[0][0]*(*this)[2][1] - (*this)[2][0]*(*this)[1][0])
+	         -((*this)[0][0]*(*this)[2][1] - (*this)[2][0]*(*this)[0][1])
 	         *((*this)[1][2]*(*this)[3][3] - (*this)[3][2]*(*this)[1][3])
 	         +((*this)[0][0]*(*this)[3][1] - (*this)[3][0]*(*this)[0][1])
 	         *((*this)[1][2]*(*this)[2][3] - (*this)[2][2]*(*this)[1][3])
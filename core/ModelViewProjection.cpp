@@ -0,0 +1,60 @@
+#include "Transform.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructors
+ModelViewProjection::ModelViewProjection() :
+	mPostTransform(Matrix4x4::Diagonal(1,1,1,1)),
+	mTransform(),
+	mProjectionVersion(0),
+	mModelViewVersion(0)
+{
+}
+
+ModelViewProjection::ModelViewProjection(const Matrix4x4& postTransform) :
+	mPostTransform(postTransform),
+	mTransform(),
+	mProjectionVersion(0),
+	mModelViewVersion(0)
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Matrix extraction
+const Matrix4x4&
+ModelViewProjection::ExtractTransformMatrix(const Projection& projection,
+                                            const Affine& modelView)
+{
+	if(   mProjectionVersion == projection.GetVersion()
+	   && mModelViewVersion  == modelView.GetVersion())
+	{
+		TransformCache::hit();
+		return mTransform;
+	}
+	TransformCache::miss();
+
+	mTransform = projection.ExtractTransformMatrix()
+	           * modelView.ExtractTransformMatrix()
+	           * mPostTransform;
+	mProjectionVersion = projection.GetVersion();
+	mModelViewVersion  = modelView.GetVersion();
+	return mTransform;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Accessors
+const Matrix4x4& ModelViewProjection::GetPostTransform() const
+{
+	return mPostTransform;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Mutators
+void ModelViewProjection::SetPostTransform(const Matrix4x4& postTransform)
+{
+	mPostTransform     = postTransform;
+	mProjectionVersion = 0; // force update
+}
+
@@ -3,6 +3,10 @@
 
 #include "Transform.hpp"
 
+////////////////////////////////////////////////////////////////////////////////
+// Constants
+static const float FIT_TOLERANCE = 1e-6f; // relative aspect error
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // Perspective factory
@@ -97,33 +101,55 @@ Projection::Projection(float left,
 	mTop(top),
 	mNear(near),
 	mFar(far),
-	mType(type)
+	mType(type),
+	mVersion(TransformCache::nextVersion()),
+	mTransformVersion(0),
+	mInverseTransformVersion(0)
 {
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Extract Matrix
-Matrix4x4 Projection::ExtractTransformMatrix() const
+const Matrix4x4& Projection::ExtractTransformMatrix() const
 {
+	if(mTransformVersion == mVersion)
+	{
+		TransformCache::hit();
+		return mTransform;
+	}
+	TransformCache::miss();
+
 	if(mType == PROJECTION_TYPE_PERSPECTIVE)
-		return Matrix4x4::Frustum(mLeft,
-		                          mRight,
-		                          mBottom,
-		                          mTop,
-		                          mNear,
-		                          mFar);
-	return Matrix4x4::Ortho(mLeft,
-		                    mRight,
-		                    mBottom,
-		                    mTop,
-		                    mNear,
-		                    mFar);
+		mTransform = Matrix4x4::Frustum(mLeft,
+		                                mRight,
+		                                mBottom,
+		                                mTop,
+		                                mNear,
+		                                mFar);
+	else
+		mTransform = Matrix4x4::Ortho(mLeft,
+		                              mRight,
+		                              mBottom,
+		                              mTop,
+		                              mNear,
+		                              mFar);
+	mTransformVersion = mVersion;
+	return mTransform;
 }
 
-Matrix4x4 Projection::ExtractInverseTransformMatrix() const
+const Matrix4x4& Projection::ExtractInverseTransformMatrix() const
 {
-	return ExtractTransformMatrix().Inverse();
+	if(mInverseTransformVersion == mVersion)
+	{
+		TransformCache::hit();
+		return mInverseTransform;
+	}
+	TransformCache::miss();
+
+	mInverseTransform        = ExtractTransformMatrix().Inverse();
+	mInverseTransformVersion = mVersion;
+	return mInverseTransform;
 }
 
 
@@ -155,8 +181,12 @@ void Projection::FitHeightToAspect(float aspect)
 	// compute factor
 	float factor        = Aspect()/aspect;
 
+	// keep the version if already fitted, up to rounding (called every frame)
+	if(std::abs(factor - 1.0f) <= FIT_TOLERANCE)
+		return;
 	mBottom *= factor;
 	mTop    *= factor;
+	touch();
 }
 
 void Projection::FitWidthToAspect(float aspect)
@@ -164,8 +194,12 @@ void Projection::FitWidthToAspect(float aspect)
 	// get current aspect
 	float factor        = aspect/Aspect();
 
+	// keep the version if already fitted, up to rounding (called every frame)
+	if(std::abs(factor - 1.0f) <= FIT_TOLERANCE)
+		return;
 	mLeft  *= factor;
 	mRight *= factor;
+	touch();
 }
 
 
@@ -185,6 +219,8 @@ const float& Projection::GetFar() const
 {return mFar;}
 Projection::ProjectionType Projection::GetType() const
 {return mType;}
+unsigned int Projection::GetVersion() const
+{return mVersion;}
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -195,6 +231,7 @@ void Projection::SetLeft(float left)
 	assert(left != mRight);
 #endif
 	mLeft = left;
+	touch();
 }
 
 void Projection::SetRight(float right)
@@ -203,6 +240,7 @@ void Projection::SetRight(float right)
 	assert(right != mLeft);
 #endif
 	mRight = right;
+	touch();
 }
 
 void Projection::SetBottom(float bottom)
@@ -211,6 +249,7 @@ void Projection::SetBottom(float bottom)
 	assert(bottom != mTop);
 #endif
 	mBottom = bottom;
+	touch();
 }
 
 void Projection::SetTop(float top)
@@ -219,6 +258,7 @@ void Projection::SetTop(float top)
 	assert(mBottom != top);
 #endif
 	mTop = top;
+	touch();
 }
 
 void Projection::SetNear(float near)
@@ -229,6 +269,7 @@ void Projection::SetNear(float near)
 		assert(near > 0.0f);
 #endif
 	mNear = near;
+	touch();
 }
 
 void Projection::SetFar(float far)
@@ -239,14 +280,19 @@ void Projection::SetFar(float far)
 		assert(far > 0.0f);
 #endif
 	mFar = far;
+	touch();
 }
 
 void Projection::SetType(Projection::ProjectionType type)
 {
 	mType = type;
+	touch();
 }
 
 
-
-
-
+////////////////////////////////////////////////////////////////////////////////
+// Touch (invalidates the cached matrices)
+void Projection::touch()
+{
+	mVersion = TransformCache::nextVersion();
+}
@@ -0,0 +1,323 @@
+#include <cmath>
+#include <cassert>
+
+#include "Algebra.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants
+const Quaternion Quaternion::IDENTITY(0.0f,0.0f,0.0f,1.0f);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Factories
+Quaternion Quaternion::RotationAboutX(const float& radians)
+{
+	float halfRadians = 0.5f*radians;
+	return Quaternion(std::sin(halfRadians), 0.0f, 0.0f, std::cos(halfRadians));
+}
+
+Quaternion Quaternion::RotationAboutY(const float& radians)
+{
+	float halfRadians = 0.5f*radians;
+	return Quaternion(0.0f, std::sin(halfRadians), 0.0f, std::cos(halfRadians));
+}
+
+Quaternion Quaternion::RotationAboutZ(const float& radians)
+{
+	float halfRadians = 0.5f*radians;
+	return Quaternion(0.0f, 0.0f, std::sin(halfRadians), std::cos(halfRadians));
+}
+
+Quaternion Quaternion::Rotation(const float& yaw,
+                                const float& pitch,
+                                const float& roll)
+{
+	// expansion of RotationAboutX(yaw)*RotationAboutY(pitch)*RotationAboutZ(roll)
+	// (same convention as Matrix3x3::Rotation)
+	float sx = std::sin(0.5f*yaw),   cx = std::cos(0.5f*yaw);
+	float sy = std::sin(0.5f*pitch), cy = std::cos(0.5f*pitch);
+	float sz = std::sin(0.5f*roll),  cz = std::cos(0.5f*roll);
+
+	return Quaternion(sx*cy*cz + cx*sy*sz,
+	                  cx*sy*cz - sx*cy*sz,
+	                  cx*cy*sz + sx*sy*cz,
+	                  cx*cy*cz - sx*sy*sz);
+}
+
+Quaternion Quaternion::RotationAboutAxis(const Vector3& unitAxis,
+                                         const float& radians)
+{
+	float halfRadians = 0.5f*radians;
+	return Quaternion(std::sin(halfRadians)*unitAxis, std::cos(halfRadians));
+}
+
+Quaternion Quaternion::VectorRotation(const Vector3& unitFrom,
+                                      const Vector3& unitTo)
+{
+	// half way quaternion (undefined for opposite vectors)
+	float e = Vector3::DotProduct(unitFrom, unitTo);
+#ifndef NDEBUG
+	assert(e > -1.0f);
+#endif
+	return Quaternion(Vector3::CrossProduct(unitFrom, unitTo),
+	                  1.0f + e).Normalize();
+}
+
+Quaternion Quaternion::RotationMatrix(const Matrix3x3& unitAxis)
+{
+	// Shepperd's method: use the largest diagonal term for stability
+	const Matrix3x3& m = unitAxis;
+	float trace = m[0][0] + m[1][1] + m[2][2];
+	Quaternion q;
+
+	if(trace > 0.0f)
+	{
+		float s = 2.0f*std::sqrt(trace + 1.0f);
+		float invS = 1.0f/s;
+		q = Quaternion((m[1][2] - m[2][1])*invS,
+		               (m[2][0] - m[0][2])*invS,
+		               (m[0][1] - m[1][0])*invS,
+		               0.25f*s);
+	}
+	else if(m[0][0] > m[1][1] && m[0][0] > m[2][2])
+	{
+		float s = 2.0f*std::sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]);
+		float invS = 1.0f/s;
+		q = Quaternion(0.25f*s,
+		               (m[1][0] + m[0][1])*invS,
+		               (m[2][0] + m[0][2])*invS,
+		               (m[1][2] - m[2][1])*invS);
+	}
+	else if(m[1][1] > m[2][2])
+	{
+		float s = 2.0f*std::sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]);
+		float invS = 1.0f/s;
+		q = Quaternion((m[1][0] + m[0][1])*invS,
+		               0.25f*s,
+		               (m[2][1] + m[1][2])*invS,
+		               (m[2][0] - m[0][2])*invS);
+	}
+	else
+	{
+		float s = 2.0f*std::sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]);
+		float invS = 1.0f/s;
+		q = Quaternion((m[2][0] + m[0][2])*invS,
+		               (m[2][1] + m[1][2])*invS,
+		               0.25f*s,
+		               (m[0][1] - m[1][0])*invS);
+	}
+	return q.Normalize();
+}
+
+Quaternion Quaternion::Nlerp(const Quaternion& unitFrom,
+                             const Quaternion& unitTo,
+                             const float& t)
+{
+	float sign = DotProduct(unitFrom, unitTo) < 0.0f ? -1.0f : 1.0f;
+	return ((1.0f-t)*unitFrom + (sign*t)*unitTo).Normalize();
+}
+
+Quaternion Quaternion::Slerp(const Quaternion& unitFrom,
+                             const Quaternion& unitTo,
+                             const float& t)
+{
+	float cosTheta = DotProduct(unitFrom, unitTo);
+	float sign     = 1.0f;
+	if(cosTheta < 0.0f)
+	{
+		cosTheta = -cosTheta;
+		sign     = -1.0f;
+	}
+
+	// fall back to nlerp for close rotations (sin(theta) vanishes)
+	if(cosTheta > 0.9995f)
+		return Nlerp(unitFrom, unitTo, t);
+
+	float theta    = std::acos(cosTheta);
+	float invSin   = 1.0f/std::sin(theta);
+	float fromCoef = std::sin((1.0f-t)*theta)*invSin;
+	float toCoef   = std::sin(t*theta)*invSin*sign;
+	return fromCoef*unitFrom + toCoef*unitTo;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Dot product
+float Quaternion::DotProduct(const Quaternion& q1, const Quaternion& q2)
+{
+	return q1.mX*q2.mX + q1.mY*q2.mY + q1.mZ*q2.mZ + q1.mW*q2.mW;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructors
+Quaternion::Quaternion(const float& x,
+                       const float& y,
+                       const float& z,
+                       const float& w) :
+	mX(x), mY(y), mZ(z), mW(w)
+{
+}
+
+Quaternion::Quaternion(const Vector3& v, const float& w) :
+	mX(v[0]), mY(v[1]), mZ(v[2]), mW(w)
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Length
+float Quaternion::Length() const
+{
+	return std::sqrt(LengthSquared());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Length Squared
+float Quaternion::LengthSquared() const
+{
+	return mX*mX + mY*mY + mZ*mZ + mW*mW;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Normalize
+Quaternion Quaternion::Normalize() const
+{
+	float invLength = 1.0f/Length();
+	return invLength*(*this);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Conjugate
+Quaternion Quaternion::Conjugate() const
+{
+	return Quaternion(-mX, -mY, -mZ, mW);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Inverse
+Quaternion Quaternion::Inverse() const
+{
+	float lengthSquared = LengthSquared();
+#ifndef NDEBUG
+	assert(lengthSquared != 0.0f);
+#endif
+	return (1.0f/lengthSquared)*Conjugate();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Rotation matrix
+Matrix3x3 Quaternion::ExtractRotationMatrix() const
+{
+	float xx = mX*mX, yy = mY*mY, zz = mZ*mZ;
+	float xy = mX*mY, xz = mX*mZ, yz = mY*mZ;
+	float wx = mW*mX, wy = mW*mY, wz = mW*mZ;
+
+	return Matrix3x3(1.0f-2.0f*(yy+zz), 2.0f*(xy-wz),      2.0f*(xz+wy),
+	                 2.0f*(xy+wz),      1.0f-2.0f*(xx+zz), 2.0f*(yz-wx),
+	                 2.0f*(xz-wy),      2.0f*(yz+wx),      1.0f-2.0f*(xx+yy));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Bracket operators
+const float& Quaternion::operator[](size_t i) const
+{
+#ifndef NDEBUG
+	assert(i < 4);
+#endif
+	return (&mX)[i];
+}
+
+float& Quaternion::operator[](size_t i)
+{
+	return const_cast< float& >((static_cast< const Quaternion& >(*this))[i]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Arithmetic operators
+Quaternion Quaternion::operator+(const Quaternion& q) const
+{return Quaternion(mX+q.mX, mY+q.mY, mZ+q.mZ, mW+q.mW);}
+
+Quaternion Quaternion::operator-(const Quaternion& q) const
+{return Quaternion(mX-q.mX, mY-q.mY, mZ-q.mZ, mW-q.mW);}
+
+Quaternion Quaternion::operator*(const Quaternion& q) const
+{
+	return Quaternion(mW*q.mX + mX*q.mW + mY*q.mZ - mZ*q.mY,
+	                  mW*q.mY - mX*q.mZ + mY*q.mW + mZ*q.mX,
+	                  mW*q.mZ + mX*q.mY - mY*q.mX + mZ*q.mW,
+	                  mW*q.mW - mX*q.mX - mY*q.mY - mZ*q.mZ);
+}
+
+Quaternion Quaternion::operator*(const float& s) const
+{return Quaternion(mX*s, mY*s, mZ*s, mW*s);}
+
+Vector3 Quaternion::operator*(const Vector3& v) const
+{
+	// v + w*t + u x t, with t = 2 u x v
+	Vector3 u(mX, mY, mZ);
+	Vector3 t(2.0f*Vector3::CrossProduct(u, v));
+	return v + mW*t + Vector3::CrossProduct(u, t);
+}
+
+Quaternion Quaternion::operator+() const
+{return Quaternion(+mX, +mY, +mZ, +mW);}
+
+Quaternion Quaternion::operator-() const
+{return Quaternion(-mX, -mY, -mZ, -mW);}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Assignment operators
+Quaternion& Quaternion::operator+=(const Quaternion& q)
+{mX+=q.mX; mY+=q.mY; mZ+=q.mZ; mW+=q.mW; return (*this);}
+
+Quaternion& Quaternion::operator-=(const Quaternion& q)
+{mX-=q.mX; mY-=q.mY; mZ-=q.mZ; mW-=q.mW; return (*this);}
+
+Quaternion& Quaternion::operator*=(const Quaternion& q)
+{return ((*this) = (*this)*q);}
+
+Quaternion& Quaternion::operator*=(const float& s)
+{mX*=s; mY*=s; mZ*=s; mW*=s; return (*this);}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Comparison operators
+bool Quaternion::operator==(const Quaternion& q) const
+{ return (q.mX == mX && q.mY == mY && q.mZ == mZ && q.mW == mW); }
+
+bool Quaternion::operator!=(const Quaternion& q) const
+{ return !(q == *this); }
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Accessors
+const float& Quaternion::GetX() const {return mX;}
+const float& Quaternion::GetY() const {return mY;}
+const float& Quaternion::GetZ() const {return mZ;}
+const float& Quaternion::GetW() const {return mW;}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Mutators
+void Quaternion::SetX(const float& x) {mX = x;}
+void Quaternion::SetY(const float& y) {mY = y;}
+void Quaternion::SetZ(const float& z) {mZ = z;}
+void Quaternion::SetW(const float& w) {mW = w;}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Additionnal operators
+Quaternion operator*(const float& s, const Quaternion& q)
+{
+	return Quaternion(s*q[0], s*q[1], s*q[2], s*q[3]);
+}
+
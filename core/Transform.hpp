@@ -5,8 +5,24 @@
 //         least one matrix extraction method.
 //         List of classes
 //         - Affine: allows to build affine transformations in a right handed
-//           cartesian coordinate system.
+//           cartesian coordinate system. Rotations are stored either as a
+//           matrix or as a quaternion (cheaper composition, no drift; the
+//           matrix is only rebuilt when it is queried or extracted).
 //         - Projection: allows to build projections.
+//         - ModelViewProjection: caches the product of a projection and an
+//           affine transformation.
+//         - TransformCache: cache statistics.
+//         Affine and Projection carry a version number, which changes
+//         whenever they are modified. Their extracted matrices are cached,
+//         and only recomputed if the version changed since the last
+//         extraction. Versions are unique across all instances, so that a
+//         product can be keyed on the versions of its operands.
+//         The classes are not thread safe: the version counter and the
+//         cache statistics are shared without synchronization, and the
+//         extractions return references into the caches. They must be
+//         modified and extracted by a single thread (the render thread);
+//         other threads may only read matrices extracted beforehand, while
+//         that thread does not modify or extract the transforms.
 //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -15,11 +31,46 @@
 
 #include "Algebra.hpp"
 
+////////////////////////////////////////////////////////////////////////////////
+// TransformCache definition
+class TransformCache
+{
+public:
+	// Statistics (cumulated over all extractions, not synchronized)
+	static unsigned int HitCount();
+	static unsigned int MissCount();
+	static float HitRate();
+	static void ResetStatistics();
+
+private:
+	friend class Affine;
+	friend class Projection;
+	friend class ModelViewProjection;
+
+	// Internal manipulation
+	static unsigned int nextVersion();
+	static void hit();
+	static void miss();
+
+	// Members
+	static unsigned int sVersionCount;
+	static unsigned int sHitCount;
+	static unsigned int sMissCount;
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Affine definition
 class Affine
 {
 public:
+	// Constants
+	enum RotationMode
+	{
+		ROTATION_MODE_MATRIX = 0,
+		ROTATION_MODE_QUATERNION
+	};
+
 	// Factories
 	static Affine Translation(const Vector3& translation);
 	static Affine RotationAboutX(float radians);
@@ -34,6 +85,11 @@ public:
 	static Affine LookAt(const Vector3& position,
 	                     const Vector3& targetPosition,
 	                     const Vector3& unitUp);
+	static Affine Rotation(const Quaternion& unitRotation);
+
+	// Factories (continued, interpolate position, scale and rotation)
+	static Affine Nlerp(const Affine& from, const Affine& to, float t);
+	static Affine Slerp(const Affine& from, const Affine& to, float t);
 
 	// Comparison operators
 	bool operator==(const Affine& affine) const;
@@ -50,6 +106,8 @@ public:
 	void RotateAboutLocalX(float radians);
 	void RotateAboutLocalY(float radians);
 	void RotateAboutLocalZ(float radians);
+	void RotateWorld(const Quaternion& unitRotation);
+	void RotateLocal(const Quaternion& unitRotation);
 
 	// Look at
 	void LookAt(const Vector3& targetPos,
@@ -60,9 +118,10 @@ public:
 	void MakeZeroPosition();
 	void MakeUnitScale();
 
-	// Matrix extraction
-	Matrix4x4 ExtractTransformMatrix()          const;
-	Matrix4x4 ExtractInverseTransformMatrix()   const;
+	// Matrix extraction (cached; the reference points into the cache,
+	// which the next extraction after a modification overwrites)
+	const Matrix4x4& ExtractTransformMatrix()          const;
+	const Matrix4x4& ExtractInverseTransformMatrix()   const;
 
 	// Axis queries
 	const Vector3& UnitXAxis()      const;
@@ -73,10 +132,15 @@ public:
 	const Matrix3x3& GetUnitAxis()  const;
 	const Vector3& GetPosition()    const;
 	float GetScale()                const;
+	Quaternion GetRotation()        const;
+	RotationMode GetRotationMode()  const;
+	unsigned int GetVersion()       const;
 
 	// Mutators
 	void SetScale(float nonZeroScale);
 	void SetPosition(const Vector3& position);
+	void SetRotation(const Quaternion& unitRotation);
+	void SetRotationMode(RotationMode mode);
 
 	// Constants
 	static const Affine IDENTITY; // neutral transformation
@@ -89,12 +153,22 @@ private:
 
 	// Internal manipulation
 	void normalizeAxis();
+	void updateAxis() const;
+	void touch();
 
 	// Members
-	Matrix3x3 mUnitAxis;      // axis
-	Vector3   mPosition;      // position
-	float     mScale;         // (uniform) scale
-	bool      mIsRS;          // rotation scale only
+	mutable Matrix3x3 mUnitAxis;    // axis
+	Quaternion   mRotation;         // rotation (quaternion mode only)
+	Vector3      mPosition;         // position
+	float        mScale;            // (uniform) scale
+	bool         mIsRS;             // rotation scale only
+	RotationMode mRotationMode;     // rotation storage
+	mutable bool mIsAxisValid;      // axis matches the quaternion
+	unsigned int mVersion;          // changes with every modification
+	mutable Matrix4x4 mTransform;          // cached transform
+	mutable Matrix4x4 mInverseTransform;   // cached inverse transform
+	mutable unsigned int mTransformVersion;        // version of mTransform
+	mutable unsigned int mInverseTransformVersion; // version of the inverse
 };
 
 
@@ -132,9 +206,10 @@ public:
 	void FitHeightToAspect(float aspect);
 	void FitWidthToAspect(float aspect);
 
-	// Matrix extraction
-	Matrix4x4 ExtractTransformMatrix()         const;
-	Matrix4x4 ExtractInverseTransformMatrix()  const;
+	// Matrix extraction (cached; the reference points into the cache,
+	// which the next extraction after a modification overwrites)
+	const Matrix4x4& ExtractTransformMatrix()         const;
+	const Matrix4x4& ExtractInverseTransformMatrix()  const;
 
 	// Queries
 	float Width()          const;
@@ -161,6 +236,7 @@ public:
 	const float& GetNear()   const;
 	const float& GetFar()    const;
 	ProjectionType GetType() const;
+	unsigned int GetVersion() const;
 
 private:
 
@@ -173,6 +249,9 @@ private:
 	           float far,
 	           ProjectionType type);
 
+	// Internal manipulation
+	void touch();
+
 	// Members
 	float mLeft;
 	float mRight;
@@ -181,6 +260,41 @@ private:
 	float mNear;
 	float mFar;
 	ProjectionType mType;
+	unsigned int mVersion;                         // changes with every modification
+	mutable Matrix4x4 mTransform;                  // cached transform
+	mutable Matrix4x4 mInverseTransform;           // cached inverse transform
+	mutable unsigned int mTransformVersion;        // version of mTransform
+	mutable unsigned int mInverseTransformVersion; // version of the inverse
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ModelViewProjection definition: projection * modelView * postTransform,
+// recomputed only if the projection or the modelView changed
+class ModelViewProjection
+{
+public:
+	// Constructors
+	ModelViewProjection();
+	explicit ModelViewProjection(const Matrix4x4& postTransform);
+
+	// Matrix extraction (cached; the reference points into the cache,
+	// which the next extraction after a modification overwrites)
+	const Matrix4x4& ExtractTransformMatrix(const Projection& projection,
+	                                        const Affine& modelView);
+
+	// Accessors
+	const Matrix4x4& GetPostTransform() const;
+
+	// Mutators
+	void SetPostTransform(const Matrix4x4& postTransform);
+
+private:
+	// Members
+	Matrix4x4    mPostTransform;     // constant right hand side
+	Matrix4x4    mTransform;         // cached product
+	unsigned int mProjectionVersion; // version of the projection
+	unsigned int mModelViewVersion;  // version of the modelView
 };
 
 #endif
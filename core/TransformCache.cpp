@@ -0,0 +1,44 @@
+#include "Transform.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// static data (used by a single thread, see Transform.hpp)
+unsigned int TransformCache::sVersionCount = 0;
+unsigned int TransformCache::sHitCount     = 0;
+unsigned int TransformCache::sMissCount    = 0;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Statistics
+unsigned int TransformCache::HitCount()  { return sHitCount; }
+unsigned int TransformCache::MissCount() { return sMissCount; }
+
+float TransformCache::HitRate()
+{
+	unsigned int total = sHitCount + sMissCount;
+	if(total == 0)
+		return 0.0f;
+	return float(sHitCount) / float(total);
+}
+
+void TransformCache::ResetStatistics()
+{
+	sHitCount  = 0;
+	sMissCount = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Next version (0 is reserved for empty caches)
+unsigned int TransformCache::nextVersion()
+{
+	if(++sVersionCount == 0)
+		++sVersionCount;
+	return sVersionCount;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Counters
+void TransformCache::hit()  { ++sHitCount; }
+void TransformCache::miss() { ++sMissCount; }
+
@@ -14,6 +14,83 @@
 
 #include "GL/glew.h"
 
+// OpenGL 1.1 entry points are called through pointers, like the entry points
+// loaded by glew, so that they can be instrumented (see GlTrace.hpp)
+typedef void (GLAPIENTRY * PFNGLTRACEBINDTEXTUREPROC) (GLenum, GLuint);
+typedef void (GLAPIENTRY * PFNGLTRACECLEARPROC) (GLbitfield);
+typedef void (GLAPIENTRY * PFNGLTRACECLEARCOLORPROC) (GLclampf, GLclampf,
+	GLclampf, GLclampf);
+typedef void (GLAPIENTRY * PFNGLTRACECOLORMASKPROC) (GLboolean, GLboolean,
+	GLboolean, GLboolean);
+typedef void (GLAPIENTRY * PFNGLTRACEDELETETEXTURESPROC) (GLsizei,
+	const GLuint*);
+typedef void (GLAPIENTRY * PFNGLTRACEDEPTHFUNCPROC) (GLenum);
+typedef void (GLAPIENTRY * PFNGLTRACEDISABLEPROC) (GLenum);
+typedef void (GLAPIENTRY * PFNGLTRACEENABLEPROC) (GLenum);
+typedef void (GLAPIENTRY * PFNGLTRACEFINISHPROC) (void);
+typedef void (GLAPIENTRY * PFNGLTRACEFLUSHPROC) (void);
+typedef void (GLAPIENTRY * PFNGLTRACEGENTEXTURESPROC) (GLsizei, GLuint*);
+typedef GLenum (GLAPIENTRY * PFNGLTRACEGETERRORPROC) (void);
+typedef void (GLAPIENTRY * PFNGLTRACEGETINTEGERVPROC) (GLenum, GLint*);
+typedef const GLubyte* (GLAPIENTRY * PFNGLTRACEGETSTRINGPROC) (GLenum);
+typedef void (GLAPIENTRY * PFNGLTRACEGETTEXLEVELPARAMETERIVPROC) (GLenum, GLint,
+	GLenum, GLint*);
+typedef void (GLAPIENTRY * PFNGLTRACEPIXELSTOREIPROC) (GLenum, GLint);
+typedef void (GLAPIENTRY * PFNGLTRACEREADBUFFERPROC) (GLenum);
+typedef void (GLAPIENTRY * PFNGLTRACEREADPIXELSPROC) (GLint, GLint, GLsizei,
+	GLsizei, GLenum, GLenum, GLvoid*);
+typedef void (GLAPIENTRY * PFNGLTRACETEXIMAGE2DPROC) (GLenum, GLint, GLint,
+	GLsizei, GLsizei, GLint, GLenum, GLenum, const GLvoid*);
+typedef void (GLAPIENTRY * PFNGLTRACETEXPARAMETERIPROC) (GLenum, GLenum, GLint);
+typedef void (GLAPIENTRY * PFNGLTRACEVIEWPORTPROC) (GLint, GLint, GLsizei,
+	GLsizei);
+
+extern PFNGLTRACEBINDTEXTUREPROC __gltraceBindTexture;
+extern PFNGLTRACECLEARPROC __gltraceClear;
+extern PFNGLTRACECLEARCOLORPROC __gltraceClearColor;
+extern PFNGLTRACECOLORMASKPROC __gltraceColorMask;
+extern PFNGLTRACEDELETETEXTURESPROC __gltraceDeleteTextures;
+extern PFNGLTRACEDEPTHFUNCPROC __gltraceDepthFunc;
+extern PFNGLTRACEDISABLEPROC __gltraceDisable;
+extern PFNGLTRACEENABLEPROC __gltraceEnable;
+extern PFNGLTRACEFINISHPROC __gltraceFinish;
+extern PFNGLTRACEFLUSHPROC __gltraceFlush;
+extern PFNGLTRACEGENTEXTURESPROC __gltraceGenTextures;
+extern PFNGLTRACEGETERRORPROC __gltraceGetError;
+extern PFNGLTRACEGETINTEGERVPROC __gltraceGetIntegerv;
+extern PFNGLTRACEGETSTRINGPROC __gltraceGetString;
+extern PFNGLTRACEGETTEXLEVELPARAMETERIVPROC __gltraceGetTexLevelParameteriv;
+extern PFNGLTRACEPIXELSTOREIPROC __gltracePixelStorei;
+extern PFNGLTRACEREADBUFFERPROC __gltraceReadBuffer;
+extern PFNGLTRACEREADPIXELSPROC __gltraceReadPixels;
+extern PFNGLTRACETEXIMAGE2DPROC __gltraceTexImage2D;
+extern PFNGLTRACETEXPARAMETERIPROC __gltraceTexParameteri;
+extern PFNGLTRACEVIEWPORTPROC __gltraceViewport;
+
+#ifndef GLTRACE_NO_REDIRECT
+#	define glBindTexture GLEW_GET_FUN(__gltraceBindTexture)
+#	define glClear GLEW_GET_FUN(__gltraceClear)
+#	define glClearColor GLEW_GET_FUN(__gltraceClearColor)
+#	define glColorMask GLEW_GET_FUN(__gltraceColorMask)
+#	define glDeleteTextures GLEW_GET_FUN(__gltraceDeleteTextures)
+#	define glDepthFunc GLEW_GET_FUN(__gltraceDepthFunc)
+#	define glDisable GLEW_GET_FUN(__gltraceDisable)
+#	define glEnable GLEW_GET_FUN(__gltraceEnable)
+#	define glFinish GLEW_GET_FUN(__gltraceFinish)
+#	define glFlush GLEW_GET_FUN(__gltraceFlush)
+#	define glGenTextures GLEW_GET_FUN(__gltraceGenTextures)
+#	define glGetError GLEW_GET_FUN(__gltraceGetError)
+#	define glGetIntegerv GLEW_GET_FUN(__gltraceGetIntegerv)
+#	define glGetString GLEW_GET_FUN(__gltraceGetString)
+#	define glGetTexLevelParameteriv GLEW_GET_FUN(__gltraceGetTexLevelParameteriv)
+#	define glPixelStorei GLEW_GET_FUN(__gltracePixelStorei)
+#	define glReadBuffer GLEW_GET_FUN(__gltraceReadBuffer)
+#	define glReadPixels GLEW_GET_FUN(__gltraceReadPixels)
+#	define glTexImage2D GLEW_GET_FUN(__gltraceTexImage2D)
+#	define glTexParameteri GLEW_GET_FUN(__gltraceTexParameteri)
+#	define glViewport GLEW_GET_FUN(__gltraceViewport)
+#endif
+
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -9,6 +9,9 @@
 // GL libraries
 #include "glew.hpp"
 #include "GL/freeglut.h"
+#ifndef _WIN32
+#	include <X11/Xlib.h> // XInitThreads
+#endif
 
 #ifdef _ANT_ENABLE
 #	include "AntTweakBar.h"
@@ -19,12 +22,22 @@
 #include "Transform.hpp"    // Basic transformations
 #include "Framework.hpp"    // utility classes/functions
 #include "Md2.hpp"          // MD2 model loader/player
+#include "Md2Decoder.hpp"   // MD2 GPU decoder
+#include "Uploader.hpp"     // upload thread
+#include "GlTrace.hpp"      // GL call counters
+#include "InputLog.hpp"     // input recording and replay
+#include "Benchmark.hpp"    // JSON report, histograms
 
 // Standard librabries
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <vector>
 #include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -33,24 +46,115 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 // Constants
-const GLuint STREAM_BUFFER_CAPACITY = 8192*1024; // 8MBytes
+const GLuint STREAM_BUFFER_CAPACITY = 8192*1024; // initial size (8MBytes)
+const GLuint STREAM_CAPACITY_MIN    = 256*1024;  // adaptive size bounds
+const GLuint STREAM_CAPACITY_MAX    = 256*1024*1024;
+const GLint STREAM_FRAMES_TARGET    = 3;         // frames held by the ring
+const GLuint STREAM_RESIZE_PERIOD   = 120;       // frames between shrinks
+const GLint INSTANCE_COUNT_MAX      = 128;       // see md2.glsl
+const GLint CHARACTER_COUNT_MAX     = 8;         // animated md2 models
+const GLfloat INSTANCE_SPACING      = 64.0f;     // distance between instances
+const GLint FRAME_FENCE_COUNT       = 4;         // frames the CPU may run ahead
 enum // OpenGLNames
 {
 	// buffers
-	BUFFER_VERTEX_MD2 = 0,
+	BUFFER_STREAM = 0, // vertices, uniforms and draw commands
+	BUFFER_INSTANCE_ID, // instance indices (fetched with baseInstance)
+	BUFFER_CORNERS,     // md2 triangle corners (keyframe streaming)
+	BUFFER_NORMALS,     // md2 normal table (keyframe streaming)
+	BUFFER_CAPTURE,     // captured vertices (transform feedback)
 	BUFFER_COUNT,
 
 	// vertex arrays
 	VERTEX_ARRAY_MD2 = 0,
+	VERTEX_ARRAY_MD2_KEYFRAMES,
+	VERTEX_ARRAY_MD2_NORMAL_INDICES,
+	VERTEX_ARRAY_MD2_CAPTURED,
 	VERTEX_ARRAY_COUNT,
 
-	// textures
+	// textures (and texture units)
 	TEXTURE_SKIN_MD2 = 0,
+	TEXTURE_KEYFRAMES,  // buffer texture of the stream buffer
 	TEXTURE_COUNT,
 
 	// programs
 	PROGRAM_RENDER_MD2 = 0,
-	PROGRAM_COUNT
+	PROGRAM_RENDER_MD2_KEYFRAMES,
+	PROGRAM_RENDER_MD2_NORMAL_INDICES,
+	PROGRAM_RENDER_MD2_CAPTURED,
+	PROGRAM_CAPTURE_MD2,
+	PROGRAM_CAPTURE_MD2_KEYFRAMES,
+	PROGRAM_CAPTURE_MD2_NORMAL_INDICES,
+	PROGRAM_COUNT,
+
+	// transform feedbacks
+	TRANSFORM_FEEDBACK_MD2 = 0,
+	TRANSFORM_FEEDBACK_COUNT,
+
+	// uniform buffer bindings
+	UNIFORM_BINDING_FRAME = 0,
+	UNIFORM_BINDING_INSTANCES,
+	UNIFORM_BINDING_CHARACTERS,
+	UNIFORM_BINDING_NORMALS,
+	UNIFORM_BINDING_COUNT
+};
+enum StreamingMode
+{
+	STREAMING_VERTICES = 0, // decoded vertices (CPU)
+	STREAMING_NORMAL_INDICES, // decoded positions and normal indices (CPU)
+	STREAMING_KEYFRAMES,    // active keyframes (decoded in the vertex shader)
+	STREAMING_COMPUTE,      // resident keyframes (decoded in a compute shader)
+	STREAMING_MODE_COUNT
+};
+enum MemoryCategory // memory tracker categories
+{
+	MEMORY_MODELS = 0,   // md2 arenas
+	MEMORY_IMAGES,       // tga pixels
+	MEMORY_STREAM,       // stream buffer
+	MEMORY_BUFFERS,      // static buffers
+	MEMORY_TEXTURES,     // textures and their mipmaps
+	MEMORY_VERTEX_CACHE, // captured vertices (evicted when over budget)
+	MEMORY_CATEGORY_COUNT
+};
+const char* MEMORY_CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] =
+{
+	"models", "images", "stream", "buffers", "textures", "vertexCache"
+};
+enum Md2ProgramUsage
+{
+	MD2_PROGRAM_RENDER = 0, // decode and render
+	MD2_PROGRAM_CAPTURE,    // decode and capture (transform feedback)
+	MD2_PROGRAM_DRAW_CAPTURED // render captured vertices
+};
+
+// Uniform blocks (std140 layouts of md2.glsl)
+struct FrameBlock
+{
+	GLfloat lightDirection[4]; // unit direction, in model space
+	GLfloat ambient[4];        // ambient term
+	GLuint  counts[4];         // instances per character
+};
+struct InstanceBlock
+{
+	GLfloat modelViewProjection[16];
+	GLfloat animation[4];      // lerp factor, frame a, frame b, character
+};
+struct CharacterBlock
+{
+	Md2::FrameTransform frameA; // transforms of the active keyframes
+	Md2::FrameTransform frameB;
+	GLuint  keyframes[2];       // first packed vertex of frame a and b
+	GLfloat lerp;               // interpolation factor
+	GLfloat _reserved;
+};
+
+// Captured vertex (transform feedback varyings of md2.glsl)
+struct CapturedVertex
+{
+	GLfloat p[3];      // position, in md2 space
+	GLfloat n[3];      // unit normal
+	GLfloat st[2];     // texture coordinates
+	GLuint  character; // character index
 };
 
 // OpenGL objects
@@ -58,20 +162,180 @@ GLuint *buffers      = NULL;
 GLuint *vertexArrays = NULL;
 GLuint *textures     = NULL;
 GLuint *programs     = NULL;
+GLuint *transformFeedbacks = NULL;
+
+// Animated characters (md2 models sharing the same skin)
+struct Character
+{
+	Md2*   md2;               // md2 model and animation
+	GLuint drawOffset;        // first vertex in the stream buffer
+	GLuint keyframeOffset;    // first packed vertex in the stream buffer
+	bool   isVertexDataValid; // false if the vertices were orphaned
+};
 
 // Resources
-Md2* md2 = NULL; // md2 model and texture
+Character characters[CHARACTER_COUNT_MAX];
+
+// Simulation (the animations are stepped at a fixed rate on their own thread,
+// and the renderer interpolates the two latest ticks)
+struct Snapshot
+{
+	Md2::Pose poses[CHARACTER_COUNT_MAX];
+	double    time;     // time of the tick, in seconds
+	GLuint    tick;     // tick index
+	double    stepTime; // simulation time of the tick, in seconds
+};
+fw::Thread simulationThread;
+fw::TripleBuffer<Snapshot> snapshots;     // written by the simulation
+fw::Timer simulationClock;                // shared clock (never stopped)
+Md2 players[CHARACTER_COUNT_MAX];         // animations (not loaded)
+volatile int32_t isSimulationRunning = 0;
+volatile int32_t tickRate            = 20; // ticks per second
+volatile int32_t isAnimationPaused   = 0;
+volatile int32_t nextAnimationCnt    = 0;  // next animation requests
+double simulationTickTime            = 0.0; // time of the last tick
+int32_t simulationRequestCnt         = 0;  // next animation requests applied
+GLuint simulationTick                = 0;  // ticks stepped
+bool isLockstep                      = false; // stepped by the renderer
+double lockstepTime                  = 0.0; // sum of the frame durations
 
 // Tools
 Affine model          = Affine::Translation(Vector3(0,0,-400));
 Projection projection = Projection::Perspective(50.0f, 1.0f, 10.0f, 4000.0f);
+ModelViewProjection modelViewProjection(Matrix4x4(0, 1, 0, 0,  // md2 axis
+                                                  0, 0,-1, 0,  // to GL axis
+                                                  1, 0, 0, 0,
+                                                  0, 0, 0, 1));
 bool mouseLeft  = false;
 bool mouseRight = false;
 
+// Streaming
+GLint uniformBufferAlignment = 256;   // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+GLuint streamOffset          = 0;     // first free byte of the stream buffer
+GLuint streamCapacity        = STREAM_BUFFER_CAPACITY; // current size
+GLuint streamCapacityMax     = STREAM_CAPACITY_MAX; // texture buffer limit
+bool isStreamCapacityAdaptive = true; // resize to hold the frames in flight
+GLint characterCount         = 1;     // number of animated characters
+GLint instanceCount          = 1;     // instances per character
+fw::DrawIndirectBatch drawBatch;      // draws of the frame
+Md2Decoder* md2Decoder       = NULL;  // GPU decoder (NULL if unsupported)
+GLint streamingMode          = STREAMING_VERTICES;
+bool isKeyframeStreamingSupported = false; // buffer texture is large enough
+std::vector<Md2Decoder::Instance> decodeInstances; // GPU decoded characters
+GLint streamedBytes          = 0;     // vertex data uploaded in the frame
+
+// Streaming telemetry (bytes written through the mappings of the stream
+// buffer, space lost to alignment/padding and to orphaning)
+struct StreamCounters
+{
+	StreamCounters() : bytes(0), consumedBytes(0), wastedBytes(0),
+	                   orphanedBytes(0), orphanCnt(0) {}
+	void Add(const StreamCounters& counters)
+	{
+		bytes         += counters.bytes;
+		consumedBytes += counters.consumedBytes;
+		wastedBytes   += counters.wastedBytes;
+		orphanedBytes += counters.orphanedBytes;
+		orphanCnt     += counters.orphanCnt;
+	}
+
+	uint64_t bytes;
+	uint64_t consumedBytes; // space sub-allocated (including padding)
+	uint64_t wastedBytes;
+	uint64_t orphanedBytes; // free space dropped when the buffer is orphaned
+	uint64_t orphanCnt;
+};
+StreamCounters streamFrame;           // counters of the current frame
+StreamCounters streamLastFrame;       // counters of the previous frame
+StreamCounters streamTotal;           // counters of all the frames
+StreamCounters streamWindow;          // counters of the current second
+double streamWindowStart     = -1.0;  // start of the current second
+double streamStartTime       = -1.0;  // first frame
+double streamBytesPerSecond  = 0.0;   // of the last full second
+double streamOrphansPerSecond = 0.0;  // of the last full second
+double streamFenceWaitTime   = 0.0;   // of the previous frame, in seconds
+GLuint streamFrameCnt        = 0;
+GLuint streamReservation     = 0;     // worst case bytes of the last frame
+GLuint streamPeakConsumption = 0;     // bytes per frame, over the period
+GLint streamPeakFramesInFlight = 0;   // over the period
+GLuint streamResizeCnt       = 0;
+bench::Histogram mapLatency;          // glMapBufferRange, in seconds
+bench::Histogram unmapLatency;        // glUnmapBuffer, in seconds
+bench::Histogram fenceWaitTime;       // frame fences, in seconds
+GLsync frameFences[FRAME_FENCE_COUNT]; // fence of the last frames (or NULL)
+
+// Memory
+fw::MemoryTracker memoryTracker;      // CPU and GPU memory per category
+GLint vertexCacheBudget      = 0;     // in KBytes (0: no budget)
+
+// Report
+std::string reportFile;               // JSON report written on exit
+std::string glTraceFile;              // GL calls of each frame (JSON lines)
+std::ofstream glTraceStream;
+
+// Input (the simulation runs in lockstep with the frames when the input is
+// recorded or replayed, or when the frame duration is fixed)
+InputLog inputLog;
+std::string inputRecordFile;
+std::string inputReplayFile;
+double fixedDeltaTime        = 0.0;   // seconds per frame (0: measured)
+
+// GL errors
+const char* GL_ERROR_MODE_NAMES[] = {"off", "sampled", "full"}; // Mode order
+GLint glErrorMode            = fw::DebugOutput::GetMode(); // checks
+GLint glErrorPeriod          = 64;    // calls per check (sampled mode)
+
+// Jobs
+fw::JobSystem* jobSystem     = NULL;  // shared by all the parallel tasks
+Uploader* uploader           = NULL;  // static data uploads
+
+// Rendering
+fw::StateCache stateCache;            // skips redundant binds
+fw::RenderQueue renderQueue;          // sorted draw packets
+bool captureVertices         = false; // decode once, draw every pass
+bool isVertexCacheResident   = false; // captured vertices are allocated
+GLint passCount              = 1;     // render passes (the last one shades)
+fw::GpuTimer* renderTimer    = NULL;  // GPU time of the passes
+
 #ifdef _ANT_ENABLE
 std::string activeAnimation;  // active animation name
 double streamingTime   = 0.0; // streaming time, in ms
 double framesPerSecond = 0.0; // fps
+double ticksPerSecond  = 0.0; // simulation ticks per second
+double tickStepTime    = 0.0; // simulation time per tick, in ms
+float transformCacheHitRate = 0.0f; // matrix cache hits, in percent
+GLint drawCount       = 0;    // draws (= draw calls without batching)
+GLint drawCallCount   = 0;    // draw calls issued
+GLint stateChangeCount = 0;   // state changes issued
+GLint stateElisionCount = 0;  // redundant state changes skipped
+GLint dispatchCount   = 0;    // compute dispatches issued
+double renderTime     = 0.0;  // GPU time of the passes, in ms
+double passTime       = 0.0;  // GPU time per pass, in ms
+GLint uploadCount     = 0;    // uploads issued by the upload thread
+double memorySizes[MEMORY_CATEGORY_COUNT]; // tracked memory, in MBytes
+double memoryTotalSize = 0.0; // in MBytes
+double uploadUtilization = 0.0; // busy time of the upload thread, in percent
+double uploadLatency  = 0.0;  // mean submission to transfer delay, in ms
+double uploadTime     = 0.0;  // mean transfer time, in ms
+double streamKBytesPerFrame = 0.0; // stream buffer bytes written, in KB
+double streamMBytesPerSecond = 0.0; // in MB
+double streamWastedKBytes = 0.0; // alignment and padding of the frame, in KB
+GLint streamOrphanCount = 0;  // orphans since the start
+double streamOrphanRate = 0.0; // orphans per second
+double mapLatencyMedian = 0.0; // in us
+double mapLatencyTail = 0.0;  // 99th percentile, in us
+double unmapLatencyTail = 0.0; // 99th percentile, in us
+double fenceWaitMs    = 0.0;  // CPU blocked on the frame fences, in ms
+GLint streamCapacityKBytes = 0; // current size of the stream buffer
+GLint streamResizeCount = 0;  // resizes since the start
+GLint glCallCount     = 0;    // GL calls of the frame (with --gl-trace)
+GLint glQueryCount    = 0;    // calls returning driver state
+GLint glSyncCount     = 0;    // calls waiting for the GPU
+char glFlaggedCalls[256] = ""; // flagged calls of the frame
+GLint framesInFlight  = 0;    // frames not completed by the GPU
+GLint glPerformanceWarningCount = 0; // debug messages of type performance
+GLint glDebugMessageCount = 0; // distinct debug messages
+GLint glDroppedMessageCount = 0; // distinct messages not kept
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -83,7 +347,8 @@ double framesPerSecond = 0.0; // fps
 #ifdef _ANT_ENABLE
 static void TW_CALL play_next_animation(void *data)
 {
-	md2->NextAnimation();
+	// forwarded to the simulation
+	fw::atomic_add(&nextAnimationCnt, 1);
 }
 
 static void TW_CALL toggle_fullscreen(void *data)
@@ -94,120 +359,1176 @@ static void TW_CALL toggle_fullscreen(void *data)
 
 static void TW_CALL play_pause(void* data)
 {
-	if(md2->IsPlaying())
-		md2->Pause();
-	else
-		md2->Play();
+	// forwarded to the simulation
+	int32_t isPaused = isAnimationPaused;
+	fw::atomic_compare_exchange(&isAnimationPaused, isPaused, !isPaused);
 }
 
 #endif
 
+
+////////////////////////////////////////////////////////////////////////////////
+// Bind a uniform block of a program to a uniform buffer binding
+static void bind_uniform_block(GLuint program,
+                               const std::string& name,
+                               GLuint binding,
+                               GLint dataSize)
+{
+	GLuint index = glGetUniformBlockIndex(program, name.c_str());
+	if(GL_INVALID_INDEX == index)
+		throw std::runtime_error("Uniform block " + name + " not found.");
+
+	// make sure the layout matches the C++ struct
+	GLint size = 0;
+	glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+	if(size != dataSize)
+		throw std::runtime_error("Uniform block " + name + " has wrong size.");
+
+	glUniformBlockBinding(program, index, binding);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Build an md2 program (uniforms are resolved here, once)
+static void build_md2_program(GLuint program,
+                              GLint mode,
+                              GLint usage = MD2_PROGRAM_RENDER)
+{
+	std::stringstream options;
+	options << "#define INSTANCE_COUNT_MAX "  << INSTANCE_COUNT_MAX  << '\n'
+	        << "#define CHARACTER_COUNT_MAX " << CHARACTER_COUNT_MAX << '\n';
+	if(MD2_PROGRAM_DRAW_CAPTURED == usage)
+		options << "#define DRAW_CAPTURED\n";
+	else if(STREAMING_KEYFRAMES == mode)
+		options << "#define STREAM_KEYFRAMES\n";
+	else if(STREAMING_NORMAL_INDICES == mode)
+		options << "#define STREAM_NORMAL_INDICES\n";
+	if(MD2_PROGRAM_CAPTURE == usage)
+		options << "#define CAPTURE_VERTICES\n";
+	fw::build_glsl_program(program,
+	                       "md2.glsl",
+	                       options.str(),
+	                       GL_FALSE);
+	if(MD2_PROGRAM_CAPTURE == usage)
+	{
+		// interleaved in CapturedVertex format
+		const GLchar* varyings[] = {"oCapturePosition",
+		                            "oCaptureNormal",
+		                            "oCaptureTexCoord",
+		                            "oCaptureCharacter"};
+		glTransformFeedbackVaryings(program,
+		                            4,
+		                            varyings,
+		                            GL_INTERLEAVED_ATTRIBS);
+	}
+	fw::link_glsl_program(program, "md2.glsl");
+
+	glProgramUniform1i( program, 
+	                    glGetUniformLocation(program, "sSkin"),
+	                    TEXTURE_SKIN_MD2 );
+	bind_uniform_block(program,
+	                   "FrameBlock",
+	                   UNIFORM_BINDING_FRAME,
+	                   sizeof(FrameBlock));
+	bind_uniform_block(program,
+	                   "InstanceBlock",
+	                   UNIFORM_BINDING_INSTANCES,
+	                   INSTANCE_COUNT_MAX*sizeof(InstanceBlock));
+	if(STREAMING_KEYFRAMES == mode && MD2_PROGRAM_DRAW_CAPTURED != usage)
+		glProgramUniform1i( program,
+		                    glGetUniformLocation(program, "sKeyframes"),
+		                    TEXTURE_KEYFRAMES );
+	if(MD2_PROGRAM_DRAW_CAPTURED == usage
+	|| (STREAMING_KEYFRAMES != mode && STREAMING_NORMAL_INDICES != mode))
+		return;
+
+	bind_uniform_block(program,
+	                   "CharacterBlock",
+	                   UNIFORM_BINDING_CHARACTERS,
+	                   CHARACTER_COUNT_MAX*sizeof(CharacterBlock));
+	bind_uniform_block(program,
+	                   "NormalBlock",
+	                   UNIFORM_BINDING_NORMALS,
+	                   162*4*sizeof(GLfloat));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Set the attributes of the vertices with normal indices (the stream buffer
+// and the vertex array must be bound)
+static void set_normal_index_attributes()
+{
+	typedef Md2::NormalIndexVertex Vertex;
+	glVertexAttribPointer( 0, 3, GL_FLOAT, 0, sizeof(Vertex),
+	                       FW_BUFFER_OFFSET(0) );
+	glVertexAttribIPointer( 1, 1, GL_UNSIGNED_INT, sizeof(Vertex),
+	                        FW_BUFFER_OFFSET(3*sizeof(GLfloat)) );
+	glVertexAttribPointer( 2, 2, GL_FLOAT, 0, sizeof(Vertex),
+	                       FW_BUFFER_OFFSET(3*sizeof(GLfloat)
+	                                        +sizeof(GLuint)) );
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocate new space for the stream buffer
+static void stream_orphan()
+{
+	// allocate new space and reset the vao
+	stateCache.BindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_STREAM]);
+	glBufferData( GL_ARRAY_BUFFER,
+	              streamCapacity,
+	              NULL,
+	              GL_STREAM_DRAW );
+	stateCache.BindVertexArray(vertexArrays[VERTEX_ARRAY_MD2]);
+		glVertexAttribPointer( 0, 3, GL_FLOAT, 0, sizeof(Md2::Vertex),
+		                       FW_BUFFER_OFFSET(0) );
+		glVertexAttribPointer( 1, 3, GL_FLOAT, 0, sizeof(Md2::Vertex),
+		                       FW_BUFFER_OFFSET(3*sizeof(GLfloat)));
+		glVertexAttribPointer( 2, 2, GL_FLOAT, 0, sizeof(Md2::Vertex),
+		                       FW_BUFFER_OFFSET(6*sizeof(GLfloat)));
+	stateCache.BindVertexArray(vertexArrays[VERTEX_ARRAY_MD2_NORMAL_INDICES]);
+		set_normal_index_attributes();
+
+	// reset offset (the vertices must be streamed again)
+	streamOffset = 0;
+	for(GLint i=0; i<CHARACTER_COUNT_MAX; ++i)
+		characters[i].isVertexDataValid = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Resize the stream buffer (the decision is logged)
+static void stream_resize(GLuint capacity, const char* reason)
+{
+	capacity = std::min(std::max(capacity, STREAM_CAPACITY_MIN),
+	                    streamCapacityMax);
+	if(capacity == streamCapacity)
+		return;
+	std::cout << "frame " << streamFrameCnt << ": stream buffer "
+	          << streamCapacity/1024 << " KB -> " << capacity/1024 << " KB ("
+	          << reason << ", peak " << streamPeakConsumption/1024
+	          << " KB per frame, " << streamPeakFramesInFlight
+	          << " frames in flight)" << std::endl;
+	streamCapacity = capacity;
+	++streamResizeCnt;
+	stream_orphan();
+	memoryTracker.UntrackBuffer(buffers[BUFFER_STREAM]);
+	memoryTracker.TrackBuffer(MEMORY_STREAM, buffers[BUFFER_STREAM]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Reserve space in the stream buffer (orphans the buffer if full, and grows
+// it if the reservation can not fit; throws if the maximum capacity is too
+// small)
+static void stream_reserve(GLuint size)
+{
+	streamReservation = size;
+	if(streamOffset + size <= streamCapacity)
+		return;
+	if(size > streamCapacity)
+	{
+		GLuint capacity = streamCapacity;
+		stream_resize(fw::next_power_of_two(size), "reservation");
+		if(size > streamCapacity)
+			throw std::runtime_error("Stream buffer reservation too large.");
+		if(capacity != streamCapacity)
+			return; // orphaned by the resize
+	}
+	++streamFrame.orphanCnt;
+	streamFrame.orphanedBytes += streamCapacity - streamOffset;
+	stream_orphan();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Sub-allocate reserved space from the stream buffer
+static GLuint stream_alloc(GLuint size, GLuint alignment)
+{
+	GLuint offset = (streamOffset + alignment - 1) / alignment * alignment;
+#ifndef NDEBUG
+	assert(offset + size <= streamCapacity);
+#endif
+	streamFrame.consumedBytes += offset + size - streamOffset;
+	streamFrame.wastedBytes   += offset - streamOffset;
+	streamOffset = offset + size;
+	return offset;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Map a range of the stream buffer for writing (timed)
+static GLvoid* stream_map(GLenum target, GLuint offset, GLuint size)
+{
+	stateCache.BindBuffer(target, buffers[BUFFER_STREAM]);
+	double start = bench::get_time();
+	GLvoid* data = glMapBufferRange(target,
+	                                offset,
+	                                size,
+	                                GL_MAP_WRITE_BIT
+	                                |GL_MAP_UNSYNCHRONIZED_BIT);
+	mapLatency.Add(bench::get_time() - start);
+
+	// make sure memory is mapped
+	if(NULL == data)
+		throw std::runtime_error("Failed to map buffer.");
+	streamFrame.bytes += size;
+	return data;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Unmap the stream buffer (timed)
+static void stream_unmap(GLenum target)
+{
+	double start = bench::get_time();
+	glUnmapBuffer(target);
+	unmapLatency.Add(bench::get_time() - start);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Close the telemetry of the frame: the CPU waits for the fence of the frame
+// issued FRAME_FENCE_COUNT frames ago before fencing the current one
+static void stream_end_frame()
+{
+	GLsync& fence = frameFences[streamFrameCnt % FRAME_FENCE_COUNT];
+	double start = bench::get_time();
+	if(NULL != fence)
+	{
+		GLenum status = GL_TIMEOUT_EXPIRED;
+		while(GL_TIMEOUT_EXPIRED == status)
+			status = glClientWaitSync(fence,
+			                          GL_SYNC_FLUSH_COMMANDS_BIT,
+			                          1000000000); // 1s
+		glDeleteSync(fence);
+	}
+	streamFenceWaitTime = bench::get_time() - start;
+	fenceWaitTime.Add(streamFenceWaitTime);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	// accumulate the counters
+	double now = simulationClock.Ticks();
+	if(streamStartTime < 0.0)
+		streamStartTime = streamWindowStart = now;
+	streamTotal.Add(streamFrame);
+	streamWindow.Add(streamFrame);
+	streamLastFrame = streamFrame;
+	streamFrame     = StreamCounters();
+	++streamFrameCnt;
+	if(now - streamWindowStart >= 1.0)
+	{
+		streamBytesPerSecond   = streamWindow.bytes / (now - streamWindowStart);
+		streamOrphansPerSecond = streamWindow.orphanCnt
+		                       / (now - streamWindowStart);
+		streamWindow      = StreamCounters();
+		streamWindowStart = now;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Frames fenced but not completed by the GPU
+static GLint stream_frames_in_flight()
+{
+	GLint frameCnt = 0;
+	for(GLint i=0; i<FRAME_FENCE_COUNT; ++i)
+	{
+		GLint status = GL_SIGNALED;
+		if(NULL != frameFences[i])
+			glGetSynciv(frameFences[i], GL_SYNC_STATUS, 1, NULL, &status);
+		frameCnt += GL_UNSIGNALED == status ? 1 : 0;
+	}
+	return frameCnt;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Adapt the size of the stream buffer between frames, so that it holds the
+// consumption of the frames in flight (at least STREAM_FRAMES_TARGET) and the
+// reservation of a frame: grow as soon as the peak consumption does not fit,
+// shrink at the end of a period if a quarter of the buffer would be enough
+static void stream_adapt_capacity()
+{
+	streamPeakConsumption    = std::max(streamPeakConsumption,
+	                                    GLuint(streamLastFrame.consumedBytes));
+	streamPeakFramesInFlight = std::max(streamPeakFramesInFlight,
+	                                    stream_frames_in_flight());
+	if(!isStreamCapacityAdaptive)
+		return;
+
+	GLint frameCnt = std::max(STREAM_FRAMES_TARGET,
+	                          streamPeakFramesInFlight + 1);
+	GLuint size = std::max(streamPeakConsumption*frameCnt, streamReservation);
+	if(size > streamCapacity)
+		stream_resize(fw::next_power_of_two(size), "grow");
+	else if(0 == streamFrameCnt % STREAM_RESIZE_PERIOD)
+	{
+		if(size <= streamCapacity/4)
+			stream_resize(fw::next_power_of_two(size), "shrink");
+		streamPeakConsumption    = 0;
+		streamPeakFramesInFlight = 0;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Set the per frame constants
+static void set_frame_block(FrameBlock* frame, GLint instancesPerCharacter)
+{
+	Vector3 lightDirection = Vector3(2.0f, 1.0f, 1.0f).Normalize();
+
+	frame->lightDirection[0] = lightDirection[0];
+	frame->lightDirection[1] = lightDirection[1];
+	frame->lightDirection[2] = lightDirection[2];
+	frame->lightDirection[3] = 0.0f;
+	frame->ambient[0]        = 0.0f;
+	frame->ambient[1]        = 0.0f;
+	frame->ambient[2]        = 0.0f;
+	frame->ambient[3]        = 0.0f;
+	frame->counts[0]         = instancesPerCharacter;
+	frame->counts[1]         = 0;
+	frame->counts[2]         = 0;
+	frame->counts[3]         = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Stream the vertices of a character
+static GLuint stream_vertices(Character& character, GLuint vertexDataSize)
+{
+	GLuint vertexOffset = stream_alloc(vertexDataSize, sizeof(Md2::Vertex));
+	GLuint vertexSize   = character.md2->TriangleCount()*3*sizeof(Md2::Vertex);
+
+	// get memory safely (only the vertices are written)
+	Md2::Vertex* vertices = (Md2::Vertex*)
+	                        (stream_map(GL_ARRAY_BUFFER,
+	                                    vertexOffset,
+	                                    vertexSize));
+	streamFrame.wastedBytes += vertexDataSize - vertexSize;
+
+	// set final data
+	character.md2->GenVertices(vertices);
+
+	// unmap buffer
+	stream_unmap(GL_ARRAY_BUFFER);
+
+	// compute draw offset
+	character.drawOffset        = vertexOffset/sizeof(Md2::Vertex);
+	character.isVertexDataValid = true;
+
+	return vertexSize;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Stream the vertices of a character, with normal indices
+static GLuint stream_normal_index_vertices(Character& character,
+                                           GLuint vertexDataSize)
+{
+	typedef Md2::NormalIndexVertex Vertex;
+	GLuint vertexOffset = stream_alloc(vertexDataSize, sizeof(Vertex));
+
+	// get memory safely
+	Vertex* vertices = (Vertex*)
+	                   (stream_map(GL_ARRAY_BUFFER,
+	                               vertexOffset,
+	                               vertexDataSize));
+	character.md2->GenVertices(vertices);
+	stream_unmap(GL_ARRAY_BUFFER);
+
+	// compute draw offset
+	character.drawOffset        = vertexOffset/sizeof(Vertex);
+	character.isVertexDataValid = true;
+
+	return vertexDataSize;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Stream the active keyframes of a character (4 bytes per keyframe vertex)
+static GLuint stream_keyframes(Character& character, GLuint keyframeDataSize)
+{
+	GLuint keyframeOffset = stream_alloc(keyframeDataSize, sizeof(uint32_t));
+	int16_t frameA, frameB;
+	GLfloat lerp;
+
+	// get memory safely
+	uint32_t* keyframes = (uint32_t*)
+	                      (stream_map(GL_ARRAY_BUFFER,
+	                                  keyframeOffset,
+	                                  keyframeDataSize));
+
+	// copy the raw keyframes
+	character.md2->ActiveFrames(frameA, frameB, lerp);
+	character.md2->GenPackedFrame(frameA, keyframes);
+	character.md2->GenPackedFrame(frameB,
+	                              keyframes + character.md2->VertexCount());
+	stream_unmap(GL_ARRAY_BUFFER);
+
+	// corners are static
+	character.drawOffset        = 0;
+	character.keyframeOffset    = keyframeOffset/sizeof(uint32_t);
+	character.isVertexDataValid = true;
+
+	return keyframeDataSize;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Size of the vertex data of a character in the stream buffer
+static GLuint character_data_size(const Character& character)
+{
+	if(STREAMING_KEYFRAMES == streamingMode)
+		return 2*character.md2->VertexCount()*sizeof(uint32_t);
+	if(STREAMING_NORMAL_INDICES == streamingMode)
+		return character.md2->TriangleCount()
+		       *3*sizeof(Md2::NormalIndexVertex);
+	return fw::next_power_of_two(character.md2->TriangleCount()
+	                             *3*sizeof(Md2::Vertex));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Queue the vertices of a character for decoding on the GPU
+static GLuint decode_vertices(Character& character, GLuint vertexDataSize)
+{
+	GLuint vertexOffset = stream_alloc(vertexDataSize, sizeof(Md2::Vertex));
+	Md2Decoder::Instance instance;
+	int16_t frameA, frameB;
+	streamFrame.wastedBytes += vertexDataSize
+	                         - character.md2->TriangleCount()*3
+	                         * sizeof(Md2::Vertex);
+
+	// all the characters share the same model (see on_init)
+	character.md2->ActiveFrames(frameA, frameB, instance.lerp);
+	instance.model       = 0;
+	instance.frameA      = frameA;
+	instance.frameB      = frameB;
+	instance.firstVertex = vertexOffset/sizeof(Md2::Vertex);
+	decodeInstances.push_back(instance);
+
+	// compute draw offset
+	character.drawOffset        = instance.firstVertex;
+	character.isVertexDataValid = true;
+
+	// only the instance is uploaded
+	return sizeof(Md2Decoder::Instance);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Set the per instance constants of a range of characters (instances are
+// laid out on a grid, data is an InstanceBlockJob)
+struct InstanceBlockJob
+{
+	InstanceBlock*   instances;
+	GLint            instancesPerCharacter;
+	const Matrix4x4* modelViewProjection;
+};
+static void set_instance_blocks(GLint begin, GLint end, void* data)
+{
+	const InstanceBlockJob& job = *reinterpret_cast<InstanceBlockJob*>(data);
+	InstanceBlock* instances    = job.instances;
+	const GLint instancesPerCharacter = job.instancesPerCharacter;
+	const Matrix4x4& modelViewProjection = *job.modelViewProjection;
+	const GLint totalCnt  = characterCount*instancesPerCharacter;
+	const GLint columnCnt = GLint(std::ceil(std::sqrt(float(totalCnt))));
+	const GLint rowCnt    = (totalCnt + columnCnt - 1) / columnCnt;
+	for(GLint c=begin; c<end; ++c)
+	{
+		int16_t frameA, frameB;
+		GLfloat lerp;
+		characters[c].md2->ActiveFrames(frameA, frameB, lerp);
+
+		for(GLint j=0; j<instancesPerCharacter; ++j)
+		{
+			// offset in the md2 yz plane (the screen plane)
+			GLint i   = c*instancesPerCharacter + j;
+			GLfloat y = (i % columnCnt - 0.5f*(columnCnt-1)) * INSTANCE_SPACING;
+			GLfloat z = (0.5f*(rowCnt-1) - i / columnCnt) * INSTANCE_SPACING;
+			Matrix4x4 mvp = modelViewProjection
+			              * Matrix4x4::Translation(Vector3(0.0f, y, -z));
+
+			memcpy(instances[i].modelViewProjection, &mvp, sizeof(Matrix4x4));
+			instances[i].animation[0] = lerp;
+			instances[i].animation[1] = frameA;
+			instances[i].animation[2] = frameB;
+			instances[i].animation[3] = c;
+		}
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Set the per character keyframes
+static void set_character_blocks(CharacterBlock* blocks)
+{
+	for(GLint c=0; c<characterCount; ++c)
+	{
+		const Md2& md2 = *characters[c].md2;
+		int16_t frameA, frameB;
+		md2.ActiveFrames(frameA, frameB, blocks[c].lerp);
+		md2.GenFrameTransform(frameA, &blocks[c].frameA);
+		md2.GenFrameTransform(frameB, &blocks[c].frameB);
+		blocks[c].keyframes[0] = characters[c].keyframeOffset;
+		blocks[c].keyframes[1] = characters[c].keyframeOffset
+		                       + md2.VertexCount();
+		blocks[c]._reserved    = 0.0f;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Time of the simulation (the sum of the frame durations in lockstep)
+static double simulation_time()
+{
+	return isLockstep ? lockstepTime : simulationClock.Ticks();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Step the animations and publish a snapshot, if a tick is due at time now
+// (ticks are dropped after a long stall)
+static bool simulation_step(double now)
+{
+	double tickPeriod = 1.0 / std::max(1, int(tickRate));
+	if(now < simulationTickTime + tickPeriod)
+		return false;
+	double stepStart   = simulationClock.Ticks();
+	simulationTickTime = now - simulationTickTime > 0.25
+	                   ? now : simulationTickTime + tickPeriod;
+
+	// apply the requests of the renderer
+	int32_t nextRequestCnt = nextAnimationCnt;
+	for(; simulationRequestCnt != nextRequestCnt; ++simulationRequestCnt)
+		for(GLint i=0; i<CHARACTER_COUNT_MAX; ++i)
+			players[i].NextAnimation();
+	for(GLint i=0; i<CHARACTER_COUNT_MAX; ++i)
+		if(isAnimationPaused)
+			players[i].Pause();
+		else
+			players[i].Play();
+
+	// step
+	Snapshot& snapshot = snapshots.WriteBuffer();
+	for(GLint i=0; i<CHARACTER_COUNT_MAX; ++i)
+	{
+		players[i].Update(tickPeriod);
+		snapshot.poses[i] = players[i].ActivePose();
+	}
+	snapshot.time     = simulationTickTime;
+	snapshot.tick     = ++simulationTick;
+	snapshot.stepTime = simulationClock.Ticks() - stepStart;
+	snapshots.Publish();
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Simulation thread (steps the animations at tickRate, and publishes a
+// snapshot per tick)
+static void run_simulation(void*)
+{
+	while(isSimulationRunning)
+	{
+		double now = simulationClock.Ticks();
+		if(!simulation_step(now))
+			fw::Thread::SleepThread(simulationTickTime
+			                        + 1.0 / std::max(1, int(tickRate))
+			                        - now);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Interpolate the poses of the two latest ticks (the renderer stays one tick
+// behind the simulation)
+static void update_poses()
+{
+	static Snapshot sPrevious, sCurrent;
+	static bool sIsInitialized = false;
+	if(snapshots.Update() || !sIsInitialized)
+	{
+		sPrevious      = sIsInitialized ? sCurrent : snapshots.ReadBuffer();
+		sCurrent       = snapshots.ReadBuffer();
+		sIsInitialized = true;
+	}
+
+	double tickPeriod = 1.0 / std::max(1, int(tickRate));
+	double renderTime = simulation_time() - tickPeriod;
+	double interval   = sCurrent.time - sPrevious.time;
+	float t = interval > 0.0 ? (renderTime - sPrevious.time) / interval : 1.0;
+	t = std::min(1.0f, std::max(0.0f, t));
+	for(GLint i=0; i<CHARACTER_COUNT_MAX; ++i)
+	{
+		Md2::Pose pose = Md2::InterpolatePoses(sPrevious.poses[i],
+		                                       sCurrent.poses[i],
+		                                       t);
+		Md2::Pose activePose = characters[i].md2->ActivePose();
+		if(pose.animation != activePose.animation
+		|| pose.frame != activePose.frame)
+		{
+			characters[i].md2->SetActivePose(pose);
+			characters[i].isVertexDataValid = false;
+		}
+	}
+
+#ifdef _ANT_ENABLE
+	// rates over a second
+	static fw::Timer sRateTimer;
+	static GLuint sRateTick = sCurrent.tick;
+	sRateTimer.Start();
+	if(sRateTimer.Ticks() >= 1.0)
+	{
+		ticksPerSecond = (sCurrent.tick - sRateTick) / sRateTimer.Ticks();
+		sRateTick      = sCurrent.tick;
+		sRateTimer.Stop();
+	}
+	tickStepTime = sCurrent.stepTime*1000.0;
+#endif // _ANT_ENABLE
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Release the captured vertices (eviction callback of the vertex cache)
+static void evict_vertex_cache(GLint, size_t, void*)
+{
+	stateCache.BindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_CAPTURE]);
+	glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_STATIC_DRAW);
+	memoryTracker.UntrackBuffer(buffers[BUFFER_CAPTURE]);
+	isVertexCacheResident = false;
+	captureVertices       = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocate the captured vertices (one copy of each character); the cache is
+// evicted immediately if it does not fit in its budget
+static void allocate_vertex_cache()
+{
+	stateCache.BindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_CAPTURE]);
+	glBufferData(GL_ARRAY_BUFFER,
+	             CHARACTER_COUNT_MAX
+	             * characters[0].md2->TriangleCount()*3
+	             * sizeof(CapturedVertex),
+	             NULL,
+	             GL_STATIC_DRAW);
+	isVertexCacheResident = true;
+	memoryTracker.TrackBuffer(MEMORY_VERTEX_CACHE, buffers[BUFFER_CAPTURE]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Close the GL calls of the frame, and write them as a JSON line (flagged
+// calls are listed separately)
+static void write_gl_trace_frame()
+{
+	GlTrace::EndFrame();
+	if(!glTraceStream.is_open())
+		return;
+	bench::JsonWriter json(glTraceStream);
+	json.BeginObject();
+	json.Write("frame", double(GlTrace::FrameCount()-1));
+	json.Write("calls", double(GlTrace::CallCount()));
+	json.Write("queries", double(GlTrace::QueryCount()));
+	json.Write("syncs", double(GlTrace::SyncCount()));
+	json.BeginObject("counts");
+	for(GLint i=0; i<GlTrace::EntryCount(); ++i)
+		if(GlTrace::EntryCallCount(i))
+			json.Write(GlTrace::EntryName(i),
+			           double(GlTrace::EntryCallCount(i)));
+	json.EndObject();
+	json.BeginObject("flagged");
+	for(GLint i=0; i<GlTrace::EntryCount(); ++i)
+		if(GlTrace::EntryFlags(i) && GlTrace::EntryCallCount(i))
+			json.Write(GlTrace::EntryName(i),
+			           double(GlTrace::EntryCallCount(i)));
+	json.EndObject();
+	json.EndObject();
+	glTraceStream << '\n';
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Write a histogram of durations (in microseconds)
+static void write_histogram(bench::JsonWriter& json,
+                            const std::string& name,
+                            const bench::Histogram& histogram)
+{
+	json.BeginObject(name);
+	json.Write("count", double(histogram.Count()));
+	json.Write("totalUs", histogram.Sum()*1e6);
+	json.Write("meanUs", histogram.Mean()*1e6);
+	json.Write("p50Us", histogram.Percentile(0.5)*1e6);
+	json.Write("p90Us", histogram.Percentile(0.9)*1e6);
+	json.Write("p99Us", histogram.Percentile(0.99)*1e6);
+	json.Write("maxUs", histogram.Max()*1e6);
+	json.BeginArray("buckets"); // upper bounds are 2^i us (the last is open)
+	for(GLint i=0; i<histogram.BucketCount(); ++i)
+		json.Write(double(histogram.BucketSampleCount(i)));
+	json.EndArray();
+	json.EndObject();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GL error check mode of a name (-1 if unknown)
+static GLint gl_error_mode(const std::string& name)
+{
+	for(GLint i=0; i<3; ++i)
+		if(name == GL_ERROR_MODE_NAMES[i])
+			return i;
+	return -1;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Write the JSON report
+static void write_report()
+{
+	std::ofstream stream(reportFile.c_str());
+	if(!stream)
+	{
+		std::cerr << "Could not write " << reportFile << std::endl;
+		return;
+	}
+	bench::JsonWriter json(stream);
+	json.BeginObject();
+	json.BeginObject("input");
+	json.Write("mode", inputLog.IsReplaying() ? "replay"
+	                 : inputLog.IsRecording() ? "record" : "live");
+	json.Write("lockstep", isLockstep);
+	json.Write("fixedDt", fixedDeltaTime);
+	json.Write("frames", double(inputLog.FrameCount()));
+	json.Write("events", double(inputLog.EventCount()));
+	json.EndObject();
+	json.BeginObject("memory");
+	for(GLint i=0; i<memoryTracker.CategoryCount(); ++i)
+	{
+		json.BeginObject(memoryTracker.CategoryName(i));
+		json.Write("bytes", double(memoryTracker.Size(i)));
+		json.Write("peakBytes", double(memoryTracker.PeakSize(i)));
+		json.Write("budgetBytes", double(memoryTracker.Budget(i)));
+		json.Write("objects", double(memoryTracker.ObjectCount(i)));
+		json.Write("evictions", double(memoryTracker.EvictionCount(i)));
+		json.EndObject();
+	}
+	json.Write("totalBytes", double(memoryTracker.TotalSize()));
+	json.EndObject();
+
+	double elapsed = simulationClock.Ticks() - streamStartTime;
+	GLuint frameCnt = std::max(streamFrameCnt, GLuint(1));
+	json.BeginObject("streaming");
+	json.Write("capacityBytes", double(streamCapacity));
+	json.Write("adaptive", isStreamCapacityAdaptive);
+	json.Write("resizes", double(streamResizeCnt));
+	json.Write("mode", double(streamingMode));
+	json.Write("frames", double(streamFrameCnt));
+	json.Write("seconds", streamStartTime < 0.0 ? 0.0 : elapsed);
+	json.Write("bytes", double(streamTotal.bytes));
+	json.Write("bytesPerFrame", double(streamTotal.bytes)/frameCnt);
+	json.Write("bytesPerSecond", streamStartTime < 0.0 || elapsed <= 0.0
+	                             ? 0.0 : streamTotal.bytes/elapsed);
+	json.Write("consumedBytesPerFrame",
+	           double(streamTotal.consumedBytes)/frameCnt);
+	json.Write("wastedBytes", double(streamTotal.wastedBytes));
+	json.Write("wastedBytesPerFrame", double(streamTotal.wastedBytes)/frameCnt);
+	json.Write("orphans", double(streamTotal.orphanCnt));
+	json.Write("orphanedBytes", double(streamTotal.orphanedBytes));
+	write_histogram(json, "mapLatency", mapLatency);
+	write_histogram(json, "unmapLatency", unmapLatency);
+	write_histogram(json, "fenceWait", fenceWaitTime);
+	json.EndObject();
+
+	if(GlTrace::IsInstalled())
+	{
+		json.BeginObject("glCalls"); // mean calls per frame
+		json.Write("frames", double(GlTrace::FrameCount()));
+		for(GLint i=0; i<GlTrace::EntryCount(); ++i)
+			if(GlTrace::EntryMeanCallCount(i) > 0.0)
+				json.Write(GlTrace::EntryName(i),
+				           GlTrace::EntryMeanCallCount(i));
+		json.EndObject();
+	}
+
+	json.BeginObject("debugOutput");
+	json.Write("mode", GL_ERROR_MODE_NAMES[fw::DebugOutput::GetMode()]);
+	json.Write("period", double(fw::DebugOutput::Period()));
+	json.Write("checks", double(fw::DebugOutput::CheckCount()));
+	json.Write("messages", double(fw::DebugOutput::TotalCount()));
+	json.Write("performanceWarnings",
+	           double(fw::DebugOutput::PerformanceWarningCount()));
+	json.Write("dropped", double(fw::DebugOutput::DroppedCount()));
+	json.BeginArray("distinct");
+	fw::DebugOutput::Message message;
+	for(GLint i=0; fw::DebugOutput::ReadMessage(i, message); ++i)
+	{
+		json.BeginObject();
+		json.Write("source", double(message.source));
+		json.Write("type", double(message.type));
+		json.Write("id", double(message.id));
+		json.Write("severity", double(message.severity));
+		json.Write("count", double(message.count));
+		json.Write("text", message.text);
+		json.EndObject();
+	}
+	json.EndArray();
+	json.EndObject();
+	json.EndObject();
+	stream << std::endl;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Capture the decoded vertices of the characters (the first instance of each
+// character is decoded, positions stay in md2 space)
+static GLsizei capture_vertices(GLuint program,
+                                GLuint vertexArray,
+                                GLint instancesPerCharacter)
+{
+	stateCache.UseProgram(program);
+	stateCache.BindVertexArray(vertexArray);
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindTransformFeedback(GL_TRANSFORM_FEEDBACK,
+	                        transformFeedbacks[TRANSFORM_FEEDBACK_MD2]);
+	glBeginTransformFeedback(GL_TRIANGLES);
+	for(GLint c=0; c<characterCount; ++c)
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLES,
+		                                  characters[c].drawOffset,
+		                                  characters[c].md2->TriangleCount()*3,
+		                                  1,
+		                                  c*instancesPerCharacter);
+	glEndTransformFeedback();
+	glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	return characterCount;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // on init cb
 void on_init()
 {
-	// load Md2 model
-	md2 = new Md2("droid.md2");
+	// start the job system (this thread participates)
+	jobSystem = new fw::JobSystem();
+
+	// memory categories
+	for(GLint i=0; i<MEMORY_CATEGORY_COUNT; ++i)
+		memoryTracker.AddCategory(MEMORY_CATEGORY_NAMES[i]);
+	memoryTracker.AddEvictionCallback(MEMORY_VERTEX_CACHE,
+	                                  &evict_vertex_cache,
+	                                  NULL);
+
+	// load Md2 models (each character plays a different animation)
+	for(GLint i=0; i<CHARACTER_COUNT_MAX; ++i)
+	{
+		characters[i].md2               = new Md2("droid.md2");
+		characters[i].drawOffset        = 0;
+		characters[i].keyframeOffset    = 0;
+		characters[i].isVertexDataValid = false;
+		for(GLint j=0; j<i; ++j)
+		{
+			characters[i].md2->NextAnimation();
+			players[i].NextAnimation();
+		}
+		memoryTracker.Track(MEMORY_MODELS,
+		                    characters[i].md2,
+		                    characters[i].md2->ArenaSize());
+	}
+
+	// start the simulation (the first snapshot is published here)
+	Snapshot& snapshot = snapshots.WriteBuffer();
+	simulationClock.Start();
+	for(GLint i=0; i<FRAME_FENCE_COUNT; ++i)
+		frameFences[i] = NULL;
+	for(GLint i=0; i<CHARACTER_COUNT_MAX; ++i)
+		snapshot.poses[i] = players[i].ActivePose();
+	snapshot.time     = simulation_time();
+	snapshot.tick     = 0;
+	snapshot.stepTime = 0.0;
+	snapshots.Publish();
+	simulationTickTime   = snapshot.time;
+	simulationRequestCnt = nextAnimationCnt;
+	isSimulationRunning  = 1;
+	if(!isLockstep)
+		simulationThread.Start(&run_simulation, NULL);
 
 	// alloc names
 	buffers      = new GLuint[BUFFER_COUNT];
 	vertexArrays = new GLuint[VERTEX_ARRAY_COUNT];
 	textures     = new GLuint[TEXTURE_COUNT];
 	programs     = new GLuint[PROGRAM_COUNT];
+	transformFeedbacks = new GLuint[TRANSFORM_FEEDBACK_COUNT];
 
 	// gen names
 	glGenBuffers(BUFFER_COUNT, buffers);
 	glGenVertexArrays(VERTEX_ARRAY_COUNT, vertexArrays);
 	glGenTextures(TEXTURE_COUNT, textures);
+	glGenTransformFeedbacks(TRANSFORM_FEEDBACK_COUNT, transformFeedbacks);
 	for(GLuint i=0; i<PROGRAM_COUNT;++i)
 		programs[i] = glCreateProgram();
 
-	// configure texture
+	// upload the skin on the upload thread
+	std::vector<Uploader::Ticket> uploads;
+	uploader = new Uploader();
 	fw::Tga tga("droid.tga");
-	glActiveTexture(GL_TEXTURE0+TEXTURE_SKIN_MD2);
-	glBindTexture(GL_TEXTURE_2D, textures[TEXTURE_SKIN_MD2]);
-		glTexParameteri( GL_TEXTURE_2D,
-		                 GL_TEXTURE_MAG_FILTER,
-		                 GL_LINEAR );
-		glTexParameteri( GL_TEXTURE_2D,
-		                 GL_TEXTURE_MIN_FILTER,
-		                 GL_LINEAR_MIPMAP_LINEAR );
+	memoryTracker.Track(MEMORY_IMAGES,   // the pixel format is the pixel size
+	                    &tga,
+	                    tga.Width()*tga.Height()*tga.PixelFormat());
+	GLint internalFormat = GL_NONE;
+	GLenum format        = GL_NONE;
 	if(tga.PixelFormat() == fw::Tga::PIXEL_FORMAT_LUMINANCE)
-		glTexImage2D( GL_TEXTURE_2D,
-		              0,
-		              GL_RED,
-		              tga.Width(),
-		              tga.Height(),
-		              0,
-		              GL_RED,
-		              GL_UNSIGNED_BYTE,
-		              tga.Pixels() );
+	{
+		internalFormat = GL_RED;
+		format         = GL_RED;
+	}
 	else if(tga.PixelFormat() == fw::Tga::PIXEL_FORMAT_LUMINANCE_ALPHA)
-		glTexImage2D( GL_TEXTURE_2D,
-		              0,
-		              GL_RG,
-		              tga.Width(),
-		              tga.Height(),
-		              0,
-		              GL_RG,
-		              GL_UNSIGNED_BYTE,
-		              tga.Pixels() );
+	{
+		internalFormat = GL_RG;
+		format         = GL_RG;
+	}
 	else if(tga.PixelFormat() == fw::Tga::PIXEL_FORMAT_BGR)
-		glTexImage2D( GL_TEXTURE_2D,
-		              0,
-		              GL_RGB,
-		              tga.Width(),
-		              tga.Height(),
-		              0,
-		              GL_BGR,
-		              GL_UNSIGNED_BYTE,
-		              tga.Pixels() );
+	{
+		internalFormat = GL_RGB;
+		format         = GL_BGR;
+	}
 	else if(tga.PixelFormat() == fw::Tga::PIXEL_FORMAT_BGRA)
-		glTexImage2D( GL_TEXTURE_2D,
-		              0,
-		              GL_RGBA,
-		              tga.Width(),
-		              tga.Height(),
-		              0,
-		              GL_BGRA,
-		              GL_UNSIGNED_BYTE,
-		              tga.Pixels() );
-	glGenerateMipmap(GL_TEXTURE_2D);
+	{
+		internalFormat = GL_RGBA;
+		format         = GL_BGRA;
+	}
+	if(format != GL_NONE)
+		uploads.push_back(uploader->UploadTexture2D(textures[TEXTURE_SKIN_MD2],
+		                                            internalFormat,
+		                                            tga.Width(),
+		                                            tga.Height(),
+		                                            format,
+		                                            GL_UNSIGNED_BYTE,
+		                                            tga.Pixels(),
+		                                            true));
 
 
 	// configure buffer objects
-	glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_VERTEX_MD2]);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_STREAM]);
 		glBufferData(GL_ARRAY_BUFFER, 
-		             STREAM_BUFFER_CAPACITY,
+		             streamCapacity,
 		             NULL,
 		             GL_STREAM_DRAW);
+	std::vector<GLuint> instanceIds(INSTANCE_COUNT_MAX);
+	for(GLint i=0; i<INSTANCE_COUNT_MAX; ++i)
+		instanceIds[i] = i;
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_INSTANCE_ID]);
+		glBufferData(GL_ARRAY_BUFFER,
+		             INSTANCE_COUNT_MAX*sizeof(GLuint),
+		             NULL,
+		             GL_STATIC_DRAW);
+	uploads.push_back(uploader->UploadBuffer(buffers[BUFFER_INSTANCE_ID],
+	                                         0,
+	                                         INSTANCE_COUNT_MAX*sizeof(GLuint),
+	                                         &instanceIds[0]));
+	// corners and normals of the md2 model (shared by the characters)
+	std::vector<Md2::Corner> corners(characters[0].md2->TriangleCount()*3);
+	characters[0].md2->GenCorners(&corners[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_CORNERS]);
+		glBufferData(GL_ARRAY_BUFFER,
+		             corners.size()*sizeof(Md2::Corner),
+		             NULL,
+		             GL_STATIC_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	uploads.push_back(uploader->UploadBuffer(buffers[BUFFER_CORNERS],
+	                                         0,
+	                                         corners.size()*sizeof(Md2::Corner),
+	                                         &corners[0]));
+	std::vector<GLfloat> normals(162*4);
+	Md2::GenNormals(&normals[0]);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffers[BUFFER_NORMALS]);
+		glBufferData(GL_UNIFORM_BUFFER,
+		             normals.size()*sizeof(GLfloat),
+		             NULL,
+		             GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	uploads.push_back(uploader->UploadBuffer(buffers[BUFFER_NORMALS],
+	                                         0,
+	                                         normals.size()*sizeof(GLfloat),
+	                                         &normals[0]));
+	// captured vertices (one copy of each character)
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_CAPTURE]);
+		glBufferData(GL_ARRAY_BUFFER,
+		             CHARACTER_COUNT_MAX*corners.size()*sizeof(CapturedVertex),
+		             NULL,
+		             GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	isVertexCacheResident = true;
+
+	// the GL commands that follow wait for the uploads (the client data
+	// can be released, and the objects are bound again from now on)
+	for(size_t i=0; i<uploads.size(); ++i)
+		uploader->Wait(uploads[i]);
+	glBindBufferBase(GL_UNIFORM_BUFFER,
+	                 UNIFORM_BINDING_NORMALS,
+	                 buffers[BUFFER_NORMALS]);
+
+	// configure texture
+	glActiveTexture(GL_TEXTURE0+TEXTURE_SKIN_MD2);
+	glBindTexture(GL_TEXTURE_2D, textures[TEXTURE_SKIN_MD2]);
+		glTexParameteri( GL_TEXTURE_2D,
+		                 GL_TEXTURE_MAG_FILTER,
+		                 GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D,
+		                 GL_TEXTURE_MIN_FILTER,
+		                 GL_LINEAR_MIPMAP_LINEAR );
+
+	// account the memory of the objects (the pixels are uploaded)
+	memoryTracker.Untrack(&tga);
+	memoryTracker.TrackBuffer(MEMORY_STREAM, buffers[BUFFER_STREAM]);
+	memoryTracker.TrackBuffer(MEMORY_BUFFERS, buffers[BUFFER_INSTANCE_ID]);
+	memoryTracker.TrackBuffer(MEMORY_BUFFERS, buffers[BUFFER_CORNERS]);
+	memoryTracker.TrackBuffer(MEMORY_BUFFERS, buffers[BUFFER_NORMALS]);
+	memoryTracker.TrackBuffer(MEMORY_VERTEX_CACHE, buffers[BUFFER_CAPTURE]);
+	memoryTracker.TrackTexture(MEMORY_TEXTURES,
+	                           GL_TEXTURE_2D,
+	                           textures[TEXTURE_SKIN_MD2]);
+
+	// configure transform feedbacks
+	glBindTransformFeedback(GL_TRANSFORM_FEEDBACK,
+	                        transformFeedbacks[TRANSFORM_FEEDBACK_MD2]);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER,
+		                 0,
+		                 buffers[BUFFER_CAPTURE]);
+	glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
 
 	// configure vertex arrays
 	glBindVertexArray(vertexArrays[VERTEX_ARRAY_MD2]);
 		glEnableVertexAttribArray(0);
 		glEnableVertexAttribArray(1);
 		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_VERTEX_MD2]);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_STREAM]);
 		glVertexAttribPointer( 0, 3, GL_FLOAT, 0, sizeof(Md2::Vertex),
 		                       FW_BUFFER_OFFSET(0) );
 		glVertexAttribPointer( 1, 3, GL_FLOAT, 0, sizeof(Md2::Vertex),
 		                       FW_BUFFER_OFFSET(3*sizeof(GLfloat)));
 		glVertexAttribPointer( 2, 2, GL_FLOAT, 0, sizeof(Md2::Vertex),
 		                       FW_BUFFER_OFFSET(6*sizeof(GLfloat)));
+		// instance index: baseInstance + gl_InstanceID
+		glEnableVertexAttribArray(3);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_INSTANCE_ID]);
+		glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, FW_BUFFER_OFFSET(0));
+		glVertexAttribDivisor(3, 1);
+	glBindVertexArray(vertexArrays[VERTEX_ARRAY_MD2_NORMAL_INDICES]);
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		glEnableVertexAttribArray(3);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_STREAM]);
+		set_normal_index_attributes();
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_INSTANCE_ID]);
+		glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, FW_BUFFER_OFFSET(0));
+		glVertexAttribDivisor(3, 1);
+	glBindVertexArray(vertexArrays[VERTEX_ARRAY_MD2_KEYFRAMES]);
+		glEnableVertexAttribArray(2);
+		glEnableVertexAttribArray(3);
+		glEnableVertexAttribArray(4);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_CORNERS]);
+		glVertexAttribPointer( 2, 2, GL_FLOAT, 0, sizeof(Md2::Corner),
+		                       FW_BUFFER_OFFSET(0) );
+		glVertexAttribIPointer( 4, 1, GL_UNSIGNED_INT, sizeof(Md2::Corner),
+		                        FW_BUFFER_OFFSET(2*sizeof(GLfloat)) );
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_INSTANCE_ID]);
+		glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, FW_BUFFER_OFFSET(0));
+		glVertexAttribDivisor(3, 1);
+	glBindVertexArray(vertexArrays[VERTEX_ARRAY_MD2_CAPTURED]);
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		glEnableVertexAttribArray(4);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_CAPTURE]);
+		glVertexAttribPointer( 0, 3, GL_FLOAT, 0, sizeof(CapturedVertex),
+		                       FW_BUFFER_OFFSET(0) );
+		glVertexAttribPointer( 1, 3, GL_FLOAT, 0, sizeof(CapturedVertex),
+		                       FW_BUFFER_OFFSET(3*sizeof(GLfloat)) );
+		glVertexAttribPointer( 2, 2, GL_FLOAT, 0, sizeof(CapturedVertex),
+		                       FW_BUFFER_OFFSET(6*sizeof(GLfloat)) );
+		glVertexAttribIPointer( 4, 1, GL_UNSIGNED_INT, sizeof(CapturedVertex),
+		                        FW_BUFFER_OFFSET(8*sizeof(GLfloat)) );
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// keyframes are fetched from the stream buffer
+	GLint textureBufferSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &textureBufferSize);
+	isKeyframeStreamingSupported = GLuint(textureBufferSize)
+	                               >= STREAM_BUFFER_CAPACITY/sizeof(uint32_t);
+	if(isKeyframeStreamingSupported && GLuint(textureBufferSize)
+	                                   < STREAM_CAPACITY_MAX/sizeof(uint32_t))
+		streamCapacityMax = fw::next_power_of_two(textureBufferSize/2+1)
+		                  * sizeof(uint32_t); // largest power of two below
+	glActiveTexture(GL_TEXTURE0+TEXTURE_KEYFRAMES);
+	glBindTexture(GL_TEXTURE_BUFFER, textures[TEXTURE_KEYFRAMES]);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, buffers[BUFFER_STREAM]);
 
 	// configure programs
-	fw::build_glsl_program(programs[PROGRAM_RENDER_MD2],
-	                       "md2.glsl",
-	                       "",
-	                       GL_TRUE);
-	glProgramUniform1i( programs[PROGRAM_RENDER_MD2], 
-	                    glGetUniformLocation( programs[PROGRAM_RENDER_MD2], 
-	                                          "sSkin"),
-	                    TEXTURE_SKIN_MD2 );
+	build_md2_program(programs[PROGRAM_RENDER_MD2], STREAMING_VERTICES);
+	build_md2_program(programs[PROGRAM_RENDER_MD2_NORMAL_INDICES],
+	                  STREAMING_NORMAL_INDICES);
+	if(isKeyframeStreamingSupported)
+		build_md2_program(programs[PROGRAM_RENDER_MD2_KEYFRAMES],
+		                  STREAMING_KEYFRAMES);
+	build_md2_program(programs[PROGRAM_RENDER_MD2_CAPTURED],
+	                  STREAMING_VERTICES,
+	                  MD2_PROGRAM_DRAW_CAPTURED);
+	build_md2_program(programs[PROGRAM_CAPTURE_MD2],
+	                  STREAMING_VERTICES,
+	                  MD2_PROGRAM_CAPTURE);
+	build_md2_program(programs[PROGRAM_CAPTURE_MD2_NORMAL_INDICES],
+	                  STREAMING_NORMAL_INDICES,
+	                  MD2_PROGRAM_CAPTURE);
+	if(isKeyframeStreamingSupported)
+		build_md2_program(programs[PROGRAM_CAPTURE_MD2_KEYFRAMES],
+		                  STREAMING_KEYFRAMES,
+		                  MD2_PROGRAM_CAPTURE);
+
+	// uniform buffer ranges must be aligned
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferAlignment);
+
+	// multi draw indirect (GL4.3 is unknown to GLEW 1.7)
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC multiDraw = NULL;
+	PFNGLDISPATCHCOMPUTEPROC dispatch = NULL;
+	if(major > 4 || (major == 4 && minor >= 3))
+	{
+		multiDraw = reinterpret_cast<PFNGLMULTIDRAWARRAYSINDIRECTAMDPROC>
+		            (glutGetProcAddress("glMultiDrawArraysIndirect"));
+		dispatch  = reinterpret_cast<PFNGLDISPATCHCOMPUTEPROC>
+		            (glutGetProcAddress("glDispatchCompute"));
+	}
+	else if(GLEW_AMD_multi_draw_indirect)
+		multiDraw = glMultiDrawArraysIndirectAMD;
+	if(GlTrace::IsInstalled())
+	{
+		multiDraw = GlTrace::TraceMultiDraw(multiDraw);
+		dispatch  = GlTrace::TraceDispatch(dispatch);
+	}
+	fw::DrawIndirectBatch::SetMultiDrawFunction(multiDraw);
+	Md2Decoder::SetDispatchFunction(dispatch);
+
+	// compute decoder (the characters share the same keyframes)
+	if(Md2Decoder::IsSupported())
+	{
+		md2Decoder = new Md2Decoder();
+		md2Decoder->Load(&characters[0].md2, 1);
+		memoryTracker.Track(MEMORY_BUFFERS,
+		                    md2Decoder,
+		                    md2Decoder->ResidentSize());
+	}
 
+	// passes after the first one pass the depth test on equality
+	renderTimer = new fw::GpuTimer();
 	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
 	glEnable(GL_CULL_FACE);
 	glClearColor(0.13,0.13,0.15,1.0);
 
@@ -219,7 +1540,7 @@ void on_init()
 
 	// Create a new bar
 	TwBar* menuBar = TwNewBar("menu");
-	TwDefine("menu size='250 150'");
+	TwDefine("menu size='250 560'");
 	TwAddButton( menuBar,
 	             "fullscreen",
 	             &toggle_fullscreen,
@@ -245,6 +1566,287 @@ void on_init()
 	            TW_TYPE_DOUBLE,
 	            &framesPerSecond,
 	            "label='frames per second'");
+	TwAddVarRO( menuBar,
+	            "ticks",
+	            TW_TYPE_DOUBLE,
+	            &ticksPerSecond,
+	            "label='simulation ticks per second'");
+	TwAddVarRO( menuBar,
+	            "tickTime",
+	            TW_TYPE_DOUBLE,
+	            &tickStepTime,
+	            "label='simulation time per tick (ms)'");
+	TwAddVarRW( menuBar,
+	            "tickRate",
+	            TW_TYPE_INT32,
+	            const_cast<int32_t*>(&tickRate),
+	            "label='simulation tick rate' min=1 max=240");
+	TwAddVarRO( menuBar,
+	            "cacheHits",
+	            TW_TYPE_FLOAT,
+	            &transformCacheHitRate,
+	            "label='matrix cache hits (%)'");
+	std::stringstream characterOptions;
+	characterOptions << "label='characters' min=1 max=" << CHARACTER_COUNT_MAX;
+	TwAddVarRW( menuBar,
+	            "characters",
+	            TW_TYPE_INT32,
+	            &characterCount,
+	            characterOptions.str().c_str());
+	std::stringstream instanceOptions;
+	instanceOptions << "label='instances per character' min=1 max="
+	                << INSTANCE_COUNT_MAX;
+	TwAddVarRW( menuBar,
+	            "instances",
+	            TW_TYPE_INT32,
+	            &instanceCount,
+	            instanceOptions.str().c_str());
+	TwAddVarRO( menuBar,
+	            "draws",
+	            TW_TYPE_INT32,
+	            &drawCount,
+	            "label='draws (unbatched calls)'");
+	TwAddVarRO( menuBar,
+	            "drawCalls",
+	            TW_TYPE_INT32,
+	            &drawCallCount,
+	            "label='draw calls (batched)'");
+	TwAddVarRO( menuBar,
+	            "stateChanges",
+	            TW_TYPE_INT32,
+	            &stateChangeCount,
+	            "label='state changes issued'");
+	TwAddVarRO( menuBar,
+	            "stateElisions",
+	            TW_TYPE_INT32,
+	            &stateElisionCount,
+	            "label='state changes elided'");
+	std::vector<TwEnumVal> streamingModes;
+	TwEnumVal mode = {STREAMING_VERTICES, "vertices (CPU)"};
+	streamingModes.push_back(mode);
+	mode.Value = STREAMING_NORMAL_INDICES;
+	mode.Label = "normal indices (CPU)";
+	streamingModes.push_back(mode);
+	if(isKeyframeStreamingSupported)
+	{
+		mode.Value = STREAMING_KEYFRAMES;
+		mode.Label = "keyframes (vertex shader)";
+		streamingModes.push_back(mode);
+	}
+	if(NULL != md2Decoder)
+	{
+		mode.Value = STREAMING_COMPUTE;
+		mode.Label = "keyframes (compute shader)";
+		streamingModes.push_back(mode);
+	}
+	TwAddVarRW( menuBar,
+	            "streaming",
+	            TwDefineEnum("StreamingMode",
+	                         &streamingModes[0],
+	                         streamingModes.size()),
+	            &streamingMode,
+	            "label='streaming'");
+	TwAddVarRO( menuBar,
+	            "streamedBytes",
+	            TW_TYPE_INT32,
+	            &streamedBytes,
+	            "label='vertex bytes per frame'");
+	if(NULL != md2Decoder)
+		TwAddVarRO( menuBar,
+		            "dispatches",
+		            TW_TYPE_INT32,
+		            &dispatchCount,
+		            "label='compute dispatches'");
+	TwAddVarRW( menuBar,
+	            "capture",
+	            TW_TYPE_BOOLCPP,
+	            &captureVertices,
+	            "label='capture vertices'");
+	TwAddVarRW( menuBar,
+	            "passes",
+	            TW_TYPE_INT32,
+	            &passCount,
+	            "label='render passes' min=1 max=8");
+	TwAddVarRO( menuBar,
+	            "renderTime",
+	            TW_TYPE_DOUBLE,
+	            &renderTime,
+	            "label='render time (ms)'");
+	TwAddVarRO( menuBar,
+	            "passTime",
+	            TW_TYPE_DOUBLE,
+	            &passTime,
+	            "label='time per pass (ms)'");
+	TwAddVarRO( menuBar,
+	            "streamKBytes",
+	            TW_TYPE_DOUBLE,
+	            &streamKBytesPerFrame,
+	            "label='KB per frame' group=telemetry");
+	TwAddVarRO( menuBar,
+	            "streamMBytesPerSecond",
+	            TW_TYPE_DOUBLE,
+	            &streamMBytesPerSecond,
+	            "label='MB per second' group=telemetry");
+	TwAddVarRO( menuBar,
+	            "streamWasted",
+	            TW_TYPE_DOUBLE,
+	            &streamWastedKBytes,
+	            "label='wasted KB per frame' group=telemetry "
+	            "help='alignment and padding'");
+	TwAddVarRO( menuBar,
+	            "streamOrphans",
+	            TW_TYPE_INT32,
+	            &streamOrphanCount,
+	            "label='orphans' group=telemetry");
+	TwAddVarRO( menuBar,
+	            "streamOrphanRate",
+	            TW_TYPE_DOUBLE,
+	            &streamOrphanRate,
+	            "label='orphans per second' group=telemetry");
+	TwAddVarRO( menuBar,
+	            "mapLatencyMedian",
+	            TW_TYPE_DOUBLE,
+	            &mapLatencyMedian,
+	            "label='map p50 (us)' group=telemetry");
+	TwAddVarRO( menuBar,
+	            "mapLatencyTail",
+	            TW_TYPE_DOUBLE,
+	            &mapLatencyTail,
+	            "label='map p99 (us)' group=telemetry");
+	TwAddVarRO( menuBar,
+	            "unmapLatencyTail",
+	            TW_TYPE_DOUBLE,
+	            &unmapLatencyTail,
+	            "label='unmap p99 (us)' group=telemetry");
+	TwAddVarRO( menuBar,
+	            "fenceWait",
+	            TW_TYPE_DOUBLE,
+	            &fenceWaitMs,
+	            "label='fence wait (ms)' group=telemetry");
+	TwAddVarRO( menuBar,
+	            "framesInFlight",
+	            TW_TYPE_INT32,
+	            &framesInFlight,
+	            "label='frames in flight' group=telemetry");
+	TwAddVarRW( menuBar,
+	            "streamAdaptive",
+	            TW_TYPE_BOOLCPP,
+	            &isStreamCapacityAdaptive,
+	            "label='adaptive capacity' group=telemetry");
+	TwAddVarRO( menuBar,
+	            "streamCapacity",
+	            TW_TYPE_INT32,
+	            &streamCapacityKBytes,
+	            "label='capacity (KB)' group=telemetry");
+	TwAddVarRO( menuBar,
+	            "streamResizes",
+	            TW_TYPE_INT32,
+	            &streamResizeCount,
+	            "label='resizes' group=telemetry");
+	TwDefine("menu/telemetry opened=false");
+	if(GlTrace::IsInstalled())
+	{
+		TwAddVarRO( menuBar,
+		            "glCalls",
+		            TW_TYPE_INT32,
+		            &glCallCount,
+		            "label='calls per frame' group=glCalls");
+		TwAddVarRO( menuBar,
+		            "glQueries",
+		            TW_TYPE_INT32,
+		            &glQueryCount,
+		            "label='queries (glGet*)' group=glCalls");
+		TwAddVarRO( menuBar,
+		            "glSyncs",
+		            TW_TYPE_INT32,
+		            &glSyncCount,
+		            "label='synchronizations' group=glCalls");
+		TwAddVarRO( menuBar,
+		            "glFlagged",
+		            TW_TYPE_CSSTRING(sizeof(glFlaggedCalls)),
+		            glFlaggedCalls,
+		            "label='flagged' group=glCalls");
+		TwDefine("menu/glCalls label='GL calls' opened=false");
+	}
+	if(fw::DebugOutput::IsSupported())
+	{
+		TwEnumVal errorModes[] = {
+			{fw::DebugOutput::MODE_OFF,     "off"},
+			{fw::DebugOutput::MODE_SAMPLED, "sampled"},
+			{fw::DebugOutput::MODE_FULL,    "full"}
+		};
+		TwAddVarRW( menuBar,
+		            "glErrorMode",
+		            TwDefineEnum("GlErrorMode", errorModes, 3),
+		            &glErrorMode,
+		            "label='checks' group=debugOutput");
+		TwAddVarRW( menuBar,
+		            "glErrorPeriod",
+		            TW_TYPE_INT32,
+		            &glErrorPeriod,
+		            "label='calls per sampled check' min=1 "
+		            "group=debugOutput");
+		TwAddVarRO( menuBar,
+		            "glPerformanceWarnings",
+		            TW_TYPE_INT32,
+		            &glPerformanceWarningCount,
+		            "label='performance warnings' group=debugOutput");
+		TwAddVarRO( menuBar,
+		            "glDebugMessages",
+		            TW_TYPE_INT32,
+		            &glDebugMessageCount,
+		            "label='distinct messages' group=debugOutput");
+		TwAddVarRO( menuBar,
+		            "glDroppedMessages",
+		            TW_TYPE_INT32,
+		            &glDroppedMessageCount,
+		            "label='dropped messages' group=debugOutput");
+		TwDefine("menu/debugOutput label='debug output' opened=false");
+	}
+	TwAddVarRW( menuBar,
+	            "vertexCacheBudget",
+	            TW_TYPE_INT32,
+	            &vertexCacheBudget,
+	            "label='vertex cache budget (KB)' min=0 step=256 "
+	            "group=memory help='0: no budget'");
+	for(GLint i=0; i<MEMORY_CATEGORY_COUNT; ++i)
+	{
+		std::stringstream options;
+		options << "label='" << MEMORY_CATEGORY_NAMES[i]
+		        << " (MB)' group=memory";
+		TwAddVarRO( menuBar,
+		            (std::string("memory_") + MEMORY_CATEGORY_NAMES[i]).c_str(),
+		            TW_TYPE_DOUBLE,
+		            &memorySizes[i],
+		            options.str().c_str());
+	}
+	TwAddVarRO( menuBar,
+	            "memoryTotal",
+	            TW_TYPE_DOUBLE,
+	            &memoryTotalSize,
+	            "label='total (MB)' group=memory");
+	TwDefine("menu/memory opened=false");
+	TwAddVarRO( menuBar,
+	            "uploads",
+	            TW_TYPE_INT32,
+	            &uploadCount,
+	            uploader->IsAsynchronous() ? "label='uploads (thread)'"
+	                                       : "label='uploads (synchronous)'");
+	TwAddVarRO( menuBar,
+	            "uploadUtilization",
+	            TW_TYPE_DOUBLE,
+	            &uploadUtilization,
+	            "label='upload thread busy (%)'");
+	TwAddVarRO( menuBar,
+	            "uploadLatency",
+	            TW_TYPE_DOUBLE,
+	            &uploadLatency,
+	            "label='upload handoff latency (ms)'");
+	TwAddVarRO( menuBar,
+	            "uploadTime",
+	            TW_TYPE_DOUBLE,
+	            &uploadTime,
+	            "label='upload transfer time (ms)'");
 #endif // _ANT_ENABLE
 
 	fw::check_gl_error();
@@ -255,12 +1857,28 @@ void on_init()
 // on clean cb
 void on_clean()
 {
-	delete md2;
+	isSimulationRunning = 0;
+	simulationThread.Join();
+
+	if(!reportFile.empty())
+		write_report();
+	inputLog.Close();
+
+	for(GLint i=0; i<CHARACTER_COUNT_MAX; ++i)
+		delete characters[i].md2;
+	delete md2Decoder;
+	delete renderTimer;
+	delete uploader;
+	delete jobSystem;
+	for(GLint i=0; i<FRAME_FENCE_COUNT; ++i)
+		if(NULL != frameFences[i])
+			glDeleteSync(frameFences[i]);
 
 	// delete objects
 	glDeleteBuffers(BUFFER_COUNT, buffers);
 	glDeleteVertexArrays(VERTEX_ARRAY_COUNT, vertexArrays);
 	glDeleteTextures(TEXTURE_COUNT, textures);
+	glDeleteTransformFeedbacks(TRANSFORM_FEEDBACK_COUNT, transformFeedbacks);
 	for(GLuint i=0; i<PROGRAM_COUNT;++i)
 		glDeleteProgram(programs[i]);
 
@@ -269,6 +1887,7 @@ void on_clean()
 	delete[] vertexArrays;
 	delete[] textures;
 	delete[] programs;
+	delete[] transformFeedbacks;
 
 #ifdef _ANT_ENABLE
 	TwTerminate();
@@ -278,6 +1897,71 @@ void on_clean()
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Input callbacks (replayed by lockstep_frame)
+void on_key_down(GLubyte key, GLint x, GLint y);
+void on_mouse_button(GLint button, GLint state, GLint x, GLint y);
+void on_mouse_motion(GLint x, GLint y);
+void on_mouse_wheel(GLint wheel, GLint direction, GLint x, GLint y);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Step the lockstep simulation by a frame (the logged events of the frame are
+// replayed first, and the end of the log ends the run)
+static void lockstep_frame(double measuredDt)
+{
+	double dt = measuredDt;
+	if(inputLog.IsReplaying())
+	{
+		static bool sIsReplayDone = false;
+		InputLog::Event event;
+		bool isFrameRead = false;
+		while(!sIsReplayDone && !isFrameRead && inputLog.Read(event))
+		{
+			const GLint* args = event.args;
+			switch(event.type)
+			{
+			case InputLog::EVENT_FRAME:
+				dt          = event.dt;
+				isFrameRead = true;
+				break;
+			case InputLog::EVENT_KEY_DOWN:
+				on_key_down(args[0], args[1], args[2]);
+				break;
+			case InputLog::EVENT_MOUSE_BUTTON:
+				on_mouse_button(args[0], args[1], args[2], args[3]);
+				break;
+			case InputLog::EVENT_MOUSE_MOTION:
+				on_mouse_motion(args[0], args[1]);
+				break;
+			case InputLog::EVENT_MOUSE_WHEEL:
+				on_mouse_wheel(args[0], args[1], args[2], args[3]);
+				break;
+			case InputLog::EVENT_RESIZE:
+				glutReshapeWindow(args[0], args[1]);
+				break;
+			}
+		}
+		if(!isFrameRead && !sIsReplayDone)
+		{
+			std::cout << "Replayed " << inputLog.FrameCount() << " frames"
+			          << std::endl;
+			sIsReplayDone = true;
+			glutLeaveMainLoop();
+		}
+	}
+	if(fixedDeltaTime > 0.0)
+		dt = fixedDeltaTime;
+	if(inputLog.IsRecording())
+	{
+		InputLog::Event event = {InputLog::EVENT_FRAME, {0, 0, 0, 0}, dt};
+		inputLog.Write(event);
+	}
+	lockstepTime += dt;
+	while(simulation_step(lockstepTime));
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // on update cb
 void on_update()
@@ -290,14 +1974,21 @@ void on_update()
 	// stop the timer during update
 	deltaTimer.Stop();
 
+	// step the simulation by the duration of the last frame (lockstep)
+	static double sFrameTime = simulationClock.Ticks();
+	double frameTime = simulationClock.Ticks();
+	if(isLockstep)
+		lockstep_frame(frameTime - sFrameTime);
+	sFrameTime = frameTime;
+
 	// set viewport
 	glViewport(0,0,windowWidth, windowHeight);
 
 	// clear back buffer
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// update md2 animation
-	md2->Update(deltaTimer.Ticks());
+	// get the md2 animations from the simulation
+	update_poses();
 
 #ifdef _ANT_ENABLE
 	// Bench stream
@@ -307,100 +1998,276 @@ void on_update()
 	framesPerSecond = 1.0/deltaTimer.Ticks();
 #endif // _ANT_ENABLE
 
-	// stream vertices (if necessary)
-	static GLuint streamOffset = 0;
-	static GLuint drawOffset   = 0;
-	if(md2->IsPlaying())
-	{
-		// bind the buffer
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_VERTEX_MD2]);
-		// orphan the buffer if full
-		GLuint streamDataSize = fw::next_power_of_two(md2->TriangleCount()
-		                                              *3*sizeof(Md2::Vertex));
-		if(streamOffset + streamDataSize > STREAM_BUFFER_CAPACITY)
-		{
-			// allocate new space and reset the vao
-			glBufferData( GL_ARRAY_BUFFER,
-			              STREAM_BUFFER_CAPACITY,
-			              NULL,
-			              GL_STREAM_DRAW );
-			glBindVertexArray(vertexArrays[VERTEX_ARRAY_MD2]);
-				glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_VERTEX_MD2]);
-				glVertexAttribPointer( 0, 3, GL_FLOAT, 0, sizeof(Md2::Vertex),
-				                       FW_BUFFER_OFFSET(0) );
-				glVertexAttribPointer( 1, 3, GL_FLOAT, 0, sizeof(Md2::Vertex),
-				                       FW_BUFFER_OFFSET(3*sizeof(GLfloat)));
-				glVertexAttribPointer( 2, 2, GL_FLOAT, 0, sizeof(Md2::Vertex),
-				                       FW_BUFFER_OFFSET(6*sizeof(GLfloat)));
-			glBindVertexArray(0);
-			// reset offset
-			streamOffset = 0;
-		}
-
-		// get memory safely
-		Md2::Vertex* vertices = (Md2::Vertex*)
-		                        (glMapBufferRange(GL_ARRAY_BUFFER, 
-		                                          streamOffset, 
-		                                          streamDataSize, 
-		                                          GL_MAP_WRITE_BIT
-		                                          |GL_MAP_UNSYNCHRONIZED_BIT));
-
-		// make sure memory is mapped
-		if(NULL == vertices)
-			throw std::runtime_error("Failed to map buffer.");
+	// update transformations
+	projection.FitHeightToAspect(float(windowWidth)/float(windowHeight));
 
-		// set final data
-		md2->GenVertices(vertices);
+	const Matrix4x4& mvp = modelViewProjection.ExtractTransformMatrix(projection,
+	                                                                  model);
+#ifdef _ANT_ENABLE
+	transformCacheHitRate = TransformCache::HitRate()*100.0f;
+#endif // _ANT_ENABLE
 
-		// unmap buffer
-		glUnmapBuffer(GL_ARRAY_BUFFER);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// instances are shared by the characters
+	GLint instancesPerCharacter = std::min(instanceCount,
+	                                       INSTANCE_COUNT_MAX/characterCount);
 
-		// compute draw offset
-		drawOffset = streamOffset/sizeof(Md2::Vertex);
+	// vertex data must be streamed again if the streaming mode changes
+	static GLint sStreamingMode = streamingMode;
+	if(sStreamingMode != streamingMode)
+	{
+		for(GLint i=0; i<CHARACTER_COUNT_MAX; ++i)
+			characters[i].isVertexDataValid = false;
+		sStreamingMode = streamingMode;
+	}
 
-		// increment offset
-		streamOffset += streamDataSize;
+	// reserve memory for the frame (worst case alignment)
+	GLuint vertexDataSize    = 0;
+	for(GLint i=0; i<characterCount; ++i)
+		vertexDataSize += character_data_size(characters[i]);
+	GLuint frameBlockSize    = sizeof(FrameBlock);
+	GLuint characterBlockSize = CHARACTER_COUNT_MAX*sizeof(CharacterBlock);
+	GLuint instanceBlockSize = INSTANCE_COUNT_MAX*sizeof(InstanceBlock);
+	GLuint commandDataSize   = characterCount
+	                         * sizeof(fw::DrawIndirectBatch::Command);
+	stream_reserve( vertexDataSize
+	              + frameBlockSize
+	              + characterBlockSize
+	              + instanceBlockSize
+	              + commandDataSize
+	              + (characterCount+4)*std::max(GLuint(uniformBufferAlignment),
+	                                            GLuint(sizeof(Md2::Vertex))) );
+
+	// stream (or decode) vertices if necessary and collect the draws
+	drawBatch.Clear();
+	decodeInstances.clear();
+	streamedBytes = 0;
+	for(GLint i=0; i<characterCount; ++i)
+	{
+		Character& character = characters[i];
+		GLuint characterDataSize = character_data_size(character);
+		if(!character.isVertexDataValid)
+		{
+			if(STREAMING_KEYFRAMES == streamingMode)
+				streamedBytes += stream_keyframes(character,
+				                                  characterDataSize);
+			else if(STREAMING_NORMAL_INDICES == streamingMode)
+				streamedBytes += stream_normal_index_vertices(character,
+				                                              characterDataSize);
+			else if(STREAMING_COMPUTE == streamingMode)
+				streamedBytes += decode_vertices(character, characterDataSize);
+			else
+				streamedBytes += stream_vertices(character, characterDataSize);
+		}
+		drawBatch.Add(textures[TEXTURE_SKIN_MD2],
+		              character.drawOffset,
+		              character.md2->TriangleCount()*3,
+		              instancesPerCharacter,
+		              i*instancesPerCharacter);
 	}
 
+	// decode all the characters at once
+	if(!decodeInstances.empty())
+		md2Decoder->Decode(&decodeInstances[0],
+		                   decodeInstances.size(),
+		                   buffers[BUFFER_STREAM],
+		                   stateCache);
+
+	// stream uniforms (a single upload for the frame and all the instances)
+	GLuint frameOffset     = stream_alloc(frameBlockSize,
+	                                      uniformBufferAlignment);
+	GLuint characterOffset = stream_alloc(characterBlockSize,
+	                                      uniformBufferAlignment);
+	GLuint instanceOffset  = stream_alloc(instanceBlockSize,
+	                                      uniformBufferAlignment);
+	GLuint uniformDataSize = instanceOffset - frameOffset
+	                       + characterCount*instancesPerCharacter
+	                       * sizeof(InstanceBlock);
+	GLubyte* uniforms = (GLubyte*)
+	                    (stream_map(GL_UNIFORM_BUFFER,
+	                                frameOffset,
+	                                uniformDataSize));
+	streamFrame.wastedBytes += (CHARACTER_COUNT_MAX - characterCount)
+	                         * sizeof(CharacterBlock)
+	                         + (INSTANCE_COUNT_MAX
+	                         - characterCount*instancesPerCharacter)
+	                         * sizeof(InstanceBlock);
+
+	set_frame_block(reinterpret_cast<FrameBlock*>(uniforms),
+	                instancesPerCharacter);
+	set_character_blocks(reinterpret_cast<CharacterBlock*>
+	                     (uniforms + characterOffset - frameOffset));
+	InstanceBlockJob instanceBlockJob;
+	instanceBlockJob.instances = reinterpret_cast<InstanceBlock*>
+	                             (uniforms + instanceOffset - frameOffset);
+	instanceBlockJob.instancesPerCharacter = instancesPerCharacter;
+	instanceBlockJob.modelViewProjection   = &mvp;
+	jobSystem->ParallelFor(0,
+	                       characterCount,
+	                       1,
+	                       &set_instance_blocks,
+	                       &instanceBlockJob);
+
+	stream_unmap(GL_UNIFORM_BUFFER);
+	stateCache.BindBufferRange(GL_UNIFORM_BUFFER,
+	                           UNIFORM_BINDING_FRAME,
+	                           buffers[BUFFER_STREAM],
+	                           frameOffset,
+	                           frameBlockSize);
+	stateCache.BindBufferRange(GL_UNIFORM_BUFFER,
+	                           UNIFORM_BINDING_CHARACTERS,
+	                           buffers[BUFFER_STREAM],
+	                           characterOffset,
+	                           characterBlockSize);
+	stateCache.BindBufferRange(GL_UNIFORM_BUFFER,
+	                           UNIFORM_BINDING_INSTANCES,
+	                           buffers[BUFFER_STREAM],
+	                           instanceOffset,
+	                           instanceBlockSize);
+
+	// stream draw commands
+	GLuint commandOffset = stream_alloc(commandDataSize, sizeof(GLuint));
+	typedef fw::DrawIndirectBatch::Command Command;
+	Command* commands = (Command*)
+	                    (stream_map(GL_DRAW_INDIRECT_BUFFER,
+	                                commandOffset,
+	                                commandDataSize));
+	drawBatch.Write(commands);
+	stream_unmap(GL_DRAW_INDIRECT_BUFFER);
+
 #ifdef _ANT_ENABLE
 	// End bench
 	streamTimer.Stop();
 	streamingTime = streamTimer.Ticks()*1000.0; // convert to milliseconds
 #endif // _ANT_ENABLE
 
-	// update transformations
-	projection.FitHeightToAspect(float(windowWidth)/float(windowHeight));
+	// programs of the streaming mode
+	GLuint renderProgram  = programs[PROGRAM_RENDER_MD2];
+	GLuint captureProgram = programs[PROGRAM_CAPTURE_MD2];
+	GLuint vertexArray    = vertexArrays[VERTEX_ARRAY_MD2];
+	if(STREAMING_KEYFRAMES == streamingMode)
+	{
+		renderProgram  = programs[PROGRAM_RENDER_MD2_KEYFRAMES];
+		captureProgram = programs[PROGRAM_CAPTURE_MD2_KEYFRAMES];
+		vertexArray    = vertexArrays[VERTEX_ARRAY_MD2_KEYFRAMES];
+	}
+	else if(STREAMING_NORMAL_INDICES == streamingMode)
+	{
+		renderProgram  = programs[PROGRAM_RENDER_MD2_NORMAL_INDICES];
+		captureProgram = programs[PROGRAM_CAPTURE_MD2_NORMAL_INDICES];
+		vertexArray    = vertexArrays[VERTEX_ARRAY_MD2_NORMAL_INDICES];
+	}
 
-	Matrix4x4 mvp = projection.ExtractTransformMatrix()
-	              * model.ExtractTransformMatrix()
-	              * Matrix4x4(0, 1, 0, 0,
-	                          0, 0,-1, 0,
-	                          1, 0, 0, 0,
-	                          0, 0, 0, 1);
-
-	glProgramUniformMatrix4fv(programs[PROGRAM_RENDER_MD2],
-	                          glGetUniformLocation(programs[PROGRAM_RENDER_MD2],
-	                                         "uModelViewProjection"),
-	                          1,
-	                          0,
-	                          reinterpret_cast<float*>(&mvp));
-
-	// render the model
-	glUseProgram(programs[PROGRAM_RENDER_MD2]);
-	glBindVertexArray(vertexArrays[VERTEX_ARRAY_MD2]);
-	glDrawArrays( GL_TRIANGLES,
-	              drawOffset,
-	              md2->TriangleCount()*3);
+	// render the characters (one packet per material, or a single packet
+	// drawing the captured vertices)
+	renderQueue.Clear();
+	GLsizei captureDrawCnt = 0;
+	static GLint sVertexCacheBudget = 0;
+	if(sVertexCacheBudget != vertexCacheBudget)
+	{
+		sVertexCacheBudget = vertexCacheBudget;
+		memoryTracker.SetBudget(MEMORY_VERTEX_CACHE, vertexCacheBudget*1024);
+	}
+	static GLint sGlErrorMode = glErrorMode, sGlErrorPeriod = glErrorPeriod;
+	if(sGlErrorMode != glErrorMode || sGlErrorPeriod != glErrorPeriod)
+	{
+		sGlErrorMode   = glErrorMode;
+		sGlErrorPeriod = glErrorPeriod;
+		fw::DebugOutput::SetMode(fw::DebugOutput::Mode(glErrorMode),
+		                         glErrorPeriod);
+	}
+	if(captureVertices && !isVertexCacheResident)
+		allocate_vertex_cache(); // evicted again if it does not fit
+	if(captureVertices)
+	{
+		captureDrawCnt = capture_vertices(captureProgram,
+		                                  vertexArray,
+		                                  instancesPerCharacter);
+
+		fw::RenderQueue::Packet packet;
+		packet.program           = programs[PROGRAM_RENDER_MD2_CAPTURED];
+		packet.textureUnit       = TEXTURE_SKIN_MD2;
+		packet.texture           = textures[TEXTURE_SKIN_MD2];
+		packet.vertexArray       = vertexArrays[VERTEX_ARRAY_MD2_CAPTURED];
+		packet.mode              = GL_TRIANGLES;
+		packet.instanceCount     = instancesPerCharacter;
+		packet.transformFeedback = transformFeedbacks[TRANSFORM_FEEDBACK_MD2];
+		renderQueue.Push(packet);
+	}
+	else for(GLsizei i=0; i<drawBatch.MaterialCount(); ++i)
+	{
+		fw::RenderQueue::Packet packet;
+		packet.program        = renderProgram;
+		packet.textureUnit    = TEXTURE_SKIN_MD2;
+		packet.texture        = drawBatch.Material(i);
+		packet.vertexArray    = vertexArray;
+		packet.mode           = GL_TRIANGLES;
+		packet.batch          = &drawBatch;
+		packet.batchMaterial  = i;
+		packet.indirectBuffer = buffers[BUFFER_STREAM];
+		packet.commandOffset  = commandOffset;
+		renderQueue.Push(packet);
+	}
 
-	// back to default vertex array
-	glBindVertexArray(0);
+	// all the passes but the last one only write depth
+	GLsizei passDrawCallCnt = 0;
+	renderTimer->Start();
+	for(GLint i=0; i<passCount; ++i)
+	{
+		GLboolean isShadingPass = i == passCount-1 ? GL_TRUE : GL_FALSE;
+		glColorMask(isShadingPass, isShadingPass, isShadingPass, isShadingPass);
+		renderQueue.Submit(stateCache);
+		passDrawCallCnt += renderQueue.DrawCallCount();
+	}
+	renderTimer->Stop();
+	stream_end_frame();
+	stream_adapt_capacity();
 
 #ifdef _ANT_ENABLE
+	drawCount         = drawBatch.DrawCount();
+	drawCallCount     = captureDrawCnt + passDrawCallCnt;
+	renderTime        = renderTimer->Ticks()*1000.0;
+	passTime          = renderTime/passCount;
+	stateChangeCount  = stateCache.IssuedCount();
+	stateElisionCount = stateCache.ElidedCount();
+	dispatchCount     = decodeInstances.empty() ? 0
+	                  : md2Decoder->DispatchCount();
+	stateCache.ResetCounters();
+	for(GLint i=0; i<MEMORY_CATEGORY_COUNT; ++i)
+		memorySizes[i]  = memoryTracker.Size(i)/1048576.0;
+	memoryTotalSize   = memoryTracker.TotalSize()/1048576.0;
+	uploadCount       = uploader->UploadCount();
+	uploadUtilization = uploader->Utilization()*100.0;
+	uploadLatency     = uploader->HandoffLatency()*1000.0;
+	uploadTime        = uploader->TransferTime()*1000.0;
+	glCallCount       = GlTrace::CallCount();
+	glQueryCount      = GlTrace::QueryCount();
+	glSyncCount       = GlTrace::SyncCount();
+	strncpy(glFlaggedCalls,
+	        GlTrace::FlaggedCalls().c_str(),
+	        sizeof(glFlaggedCalls)-1);
+	streamKBytesPerFrame   = streamLastFrame.bytes/1024.0;
+	streamMBytesPerSecond  = streamBytesPerSecond/1048576.0;
+	streamWastedKBytes     = streamLastFrame.wastedBytes/1024.0;
+	streamOrphanCount      = streamTotal.orphanCnt;
+	streamOrphanRate       = streamOrphansPerSecond;
+	mapLatencyMedian       = mapLatency.Percentile(0.5)*1e6;
+	mapLatencyTail         = mapLatency.Percentile(0.99)*1e6;
+	unmapLatencyTail       = unmapLatency.Percentile(0.99)*1e6;
+	fenceWaitMs            = streamFenceWaitTime*1000.0;
+	streamCapacityKBytes   = streamCapacity/1024;
+	streamResizeCount      = streamResizeCnt;
+	framesInFlight         = stream_frames_in_flight();
+	glPerformanceWarningCount = fw::DebugOutput::PerformanceWarningCount();
+	glDebugMessageCount    = fw::DebugOutput::MessageCount();
+	glDroppedMessageCount  = fw::DebugOutput::DroppedCount();
 	TwDraw();
+	// ant modifies the GL state behind the cache
+	stateCache.Reset();
 #endif // _ANT_ENABLE
 
 	fw::check_gl_error();
+	if(GlTrace::IsInstalled())
+		write_gl_trace_frame();
 
 	glutSwapBuffers();
 	// restart timer
@@ -503,6 +2370,57 @@ void on_mouse_wheel(GLint wheel, GLint direction, GLint x, GLint y)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Input of glut (the events are recorded, or dropped when the log drives the
+// callbacks)
+static bool record_input(GLint type,
+                         GLint arg0,
+                         GLint arg1,
+                         GLint arg2 = 0,
+                         GLint arg3 = 0)
+{
+	if(inputLog.IsReplaying())
+		return false;
+	if(inputLog.IsRecording())
+	{
+		InputLog::Event event = {type, {arg0, arg1, arg2, arg3}, 0.0};
+		inputLog.Write(event);
+	}
+	return true;
+}
+
+static void input_key_down(GLubyte key, GLint x, GLint y)
+{
+	if(record_input(InputLog::EVENT_KEY_DOWN, key, x, y))
+		on_key_down(key, x, y);
+}
+
+static void input_mouse_button(GLint button, GLint state, GLint x, GLint y)
+{
+	if(record_input(InputLog::EVENT_MOUSE_BUTTON, button, state, x, y))
+		on_mouse_button(button, state, x, y);
+}
+
+static void input_mouse_motion(GLint x, GLint y)
+{
+	if(record_input(InputLog::EVENT_MOUSE_MOTION, x, y))
+		on_mouse_motion(x, y);
+}
+
+static void input_mouse_wheel(GLint wheel, GLint direction, GLint x, GLint y)
+{
+	if(record_input(InputLog::EVENT_MOUSE_WHEEL, wheel, direction, x, y))
+		on_mouse_wheel(wheel, direction, x, y);
+}
+
+static void input_resize(GLint w, GLint h)
+{
+	// replayed resizes come back through glut
+	record_input(InputLog::EVENT_RESIZE, w, h);
+	on_resize(w, h);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Main
 //
@@ -512,8 +2430,50 @@ int main(int argc, char** argv)
 	const GLuint CONTEXT_MAJOR = 4;
 	const GLuint CONTEXT_MINOR = 1;
 
-	// init glut
+	// Xlib is used by the upload thread
+#ifndef _WIN32
+	XInitThreads();
+#endif
+
+	// init glut (consumes the glut arguments)
 	glutInit(&argc, argv);
+
+	// parse arguments
+	for(GLint i=1; i<argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if(arg == "--json" && i+1 < argc)
+			reportFile = argv[++i];
+		else if(arg == "--gl-trace" && i+1 < argc)
+			glTraceFile = argv[++i];
+		else if(arg == "--gl-errors" && i+1 < argc
+		        && gl_error_mode(argv[i+1]) >= 0)
+		{
+			glErrorMode = gl_error_mode(argv[++i]);
+			if(fw::DebugOutput::MODE_SAMPLED == glErrorMode
+			&& i+1 < argc && atoi(argv[i+1]) > 0)
+				glErrorPeriod = atoi(argv[++i]);
+		}
+		else if(arg == "--record" && i+1 < argc && inputReplayFile.empty())
+			inputRecordFile = argv[++i];
+		else if(arg == "--replay" && i+1 < argc && inputRecordFile.empty())
+			inputReplayFile = argv[++i];
+		else if(arg == "--fixed-dt" && i+1 < argc && atof(argv[i+1]) > 0.0)
+			fixedDeltaTime = atof(argv[++i]);
+		else
+		{
+			std::cerr << "usage: " << argv[0]
+			          << " [--json file] [--gl-trace file]"
+			          << " [--gl-errors off|full|sampled [n]]"
+			          << " [--record file | --replay file] [--fixed-dt s]"
+			          << std::endl;
+			return 1;
+		}
+	}
+	isLockstep = !inputRecordFile.empty()
+	          || !inputReplayFile.empty()
+	          || fixedDeltaTime > 0.0;
+
 	glutInitContextVersion(CONTEXT_MAJOR ,CONTEXT_MINOR);
 #ifdef _ANT_ENABLE
 	glutInitContextFlags(GLUT_DEBUG);
@@ -543,21 +2503,48 @@ int main(int argc, char** argv)
 	// glewInit generates an INVALID_ENUM error for some reason...
 	glGetError();
 
+	// debug output (KHR_debug is unknown to GLEW 1.7)
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if(major > 4 || (major == 4 && minor >= 3))
+		fw::DebugOutput::SetCallbackFunction(
+		    reinterpret_cast<PFNGLDEBUGMESSAGECALLBACKARBPROC>
+		    (glutGetProcAddress("glDebugMessageCallback")));
+	fw::DebugOutput::SetMode(fw::DebugOutput::Mode(glErrorMode),
+	                         glErrorPeriod);
+
+	// count the GL calls of the frames
+	if(!glTraceFile.empty())
+	{
+		GlTrace::Install();
+		glTraceStream.open(glTraceFile.c_str());
+		if(!glTraceStream)
+			std::cerr << "Could not write " << glTraceFile << std::endl;
+	}
+
 	// set callbacks
 	glutCloseFunc(&on_clean);
-	glutReshapeFunc(&on_resize);
+	glutReshapeFunc(&input_resize);
 	glutDisplayFunc(&on_update);
-	glutKeyboardFunc(&on_key_down);
-	glutMouseFunc(&on_mouse_button);
-	glutPassiveMotionFunc(&on_mouse_motion);
-	glutMotionFunc(&on_mouse_motion);
-	glutMouseWheelFunc(&on_mouse_wheel);
+	glutKeyboardFunc(&input_key_down);
+	glutMouseFunc(&input_mouse_button);
+	glutPassiveMotionFunc(&input_mouse_motion);
+	glutMotionFunc(&input_mouse_motion);
+	glutMouseWheelFunc(&input_mouse_wheel);
 
 	// run
 	try
 	{
+		// open the input log
+		if(!inputRecordFile.empty())
+			inputLog.Record(inputRecordFile);
+		else if(!inputReplayFile.empty())
+			inputLog.Replay(inputReplayFile);
+
 		// run demo
 		on_init();
+		GlTrace::ResetCounters(); // frames start after the initialization
 		glutMainLoop();
 	}
 	catch(std::exception& e)
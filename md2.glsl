@@ -1,21 +1,144 @@
 #version 420 core
 
+// INSTANCE_COUNT_MAX and CHARACTER_COUNT_MAX must be defined by the 
+// application. If STREAM_KEYFRAMES is defined, the vertices are decoded from
+// the two active keyframes of the characters. If STREAM_NORMAL_INDICES is
+// defined, the vertices hold the normal indices of both keyframes.
+// If CAPTURE_VERTICES is defined, the decoded vertices are also output for
+// transform feedback. If DRAW_CAPTURED is defined, the vertices are the
+// captured ones (drawn with glDrawTransformFeedbackInstanced).
+#if defined(STREAM_KEYFRAMES) || defined(STREAM_NORMAL_INDICES)
+#	define STREAM_NORMAL_TABLE
+#endif
+
+// per frame constants (std140)
+layout(std140) uniform FrameBlock
+{
+	vec4 uLightDirection; // xyz: unit direction, in model space
+	vec4 uAmbient;        // rgb: ambient term
+	uvec4 uCounts;        // x: instances per character
+};
+
+// per instance constants (std140)
+struct Instance
+{
+	mat4 modelViewProjection;
+	vec4 animation;       // x: lerp factor, y: frame a, z: frame b,
+	                      // w: character index
+};
+layout(std140) uniform InstanceBlock
+{
+	Instance uInstances[INSTANCE_COUNT_MAX];
+};
+
+#ifdef STREAM_NORMAL_TABLE
+// per character keyframes (std140)
+struct Character
+{
+	vec4  scaleA;         // xyz: scale of frame a
+	vec4  translationA;   // xyz: translation of frame a
+	vec4  scaleB;         // xyz: scale of frame b
+	vec4  translationB;   // xyz: translation of frame b
+	uvec2 keyframes;      // first packed vertex of frame a and b
+	float lerp;           // interpolation factor
+};
+layout(std140) uniform CharacterBlock
+{
+	Character uCharacters[CHARACTER_COUNT_MAX];
+};
+
+// md2 normal table (std140)
+layout(std140) uniform NormalBlock
+{
+	vec4 uNormals[162];   // xyz: unit normal
+};
+#endif // STREAM_NORMAL_TABLE
+
 #ifdef _VERTEX_
 
+#ifdef STREAM_KEYFRAMES
+uniform usamplerBuffer sKeyframes; // x | y << 8 | z << 16 | normal << 24
+
+layout(location=2)  in vec2 iTexCoord;
+layout(location=3)  in uint iInstance; // baseInstance + gl_InstanceID
+layout(location=4)  in uint iVertex;   // index of the keyframe vertex
+#elif defined(STREAM_NORMAL_INDICES)
+layout(location=0)  in vec3 iPosition;
+layout(location=1)  in uint iNormals;  // normal a | normal b << 8
+layout(location=2)  in vec2 iTexCoord;
+layout(location=3)  in uint iInstance; // baseInstance + gl_InstanceID
+#elif defined(DRAW_CAPTURED)
+layout(location=0)  in vec3 iPosition;
+layout(location=1)  in vec3 iNormal;
+layout(location=2)  in vec2 iTexCoord;
+layout(location=4)  in uint iCharacter;
+#else
 layout(location=0)  in vec3 iPosition;
 layout(location=1)  in vec3 iNormal;
 layout(location=2)  in vec2 iTexCoord;
+layout(location=3)  in uint iInstance; // baseInstance + gl_InstanceID
+#endif // STREAM_KEYFRAMES
 
 layout(location=0)  out vec3 oNormal;
 layout(location=1)  out vec2 oTexCoord;
 
-uniform mat4 uModelViewProjection;
+#ifdef CAPTURE_VERTICES
+// transform feedback varyings (decoded vertex and its character)
+out vec3 oCapturePosition;
+out vec3 oCaptureNormal;
+out vec2 oCaptureTexCoord;
+flat out uint oCaptureCharacter;
+#endif // CAPTURE_VERTICES
+
+#ifdef STREAM_KEYFRAMES
+vec3 dequantize(uint vertex, vec3 scale, vec3 translation)
+{
+	return scale * vec3(vertex & 0xFFu,
+	                    vertex >> 8 & 0xFFu,
+	                    vertex >> 16 & 0xFFu)
+	     + translation;
+}
+#endif // STREAM_KEYFRAMES
 
 void main()
 {
-	oNormal       = normalize(iNormal);
+#ifdef DRAW_CAPTURED
+	uint instance = iCharacter*uCounts.x + uint(gl_InstanceID);
+#else
+	uint instance = iInstance;
+#endif // DRAW_CAPTURED
+
+#ifdef STREAM_KEYFRAMES
+	Character c = uCharacters[uint(uInstances[instance].animation.w)];
+	uint vertA  = texelFetch(sKeyframes, int(c.keyframes.x + iVertex)).r;
+	uint vertB  = texelFetch(sKeyframes, int(c.keyframes.y + iVertex)).r;
+	vec3 posA   = dequantize(vertA, c.scaleA.xyz, c.translationA.xyz);
+	vec3 posB   = dequantize(vertB, c.scaleB.xyz, c.translationB.xyz);
+	vec3 position = mix(posA, posB, c.lerp);
+	vec3 normal   = mix(uNormals[vertA >> 24].xyz, uNormals[vertB >> 24].xyz,
+	                    c.lerp);
+#elif defined(STREAM_NORMAL_INDICES)
+	Character c   = uCharacters[uint(uInstances[instance].animation.w)];
+	vec3 position = iPosition;
+	vec3 normal   = mix(uNormals[iNormals & 0xFFu].xyz,
+	                    uNormals[iNormals >> 8 & 0xFFu].xyz,
+	                    c.lerp);
+#else
+	vec3 position = iPosition;
+	vec3 normal   = iNormal;
+#endif // STREAM_KEYFRAMES
+
+	oNormal       = normalize(normal); // nlerp
 	oTexCoord     = iTexCoord;
-	gl_Position   = uModelViewProjection * vec4(iPosition, 1.0);
+	gl_Position   = uInstances[instance].modelViewProjection
+	              * vec4(position, 1.0);
+
+#ifdef CAPTURE_VERTICES
+	oCapturePosition  = position;
+	oCaptureNormal    = oNormal;
+	oCaptureTexCoord  = iTexCoord;
+	oCaptureCharacter = uint(uInstances[instance].animation.w);
+#endif // CAPTURE_VERTICES
 }
 
 #endif // _VERTEX_
@@ -32,8 +155,8 @@ layout(location=0)  out vec4 oColor;
 void main()
 {
 	vec3 N = normalize(iNormal);
-	vec3 L = normalize(vec3(2.0,1.0,1.0));
-	oColor = max(0.0, dot(N, L)) * texture(sSkin, iTexCoord);
+	vec3 L = uLightDirection.xyz;
+	oColor = (uAmbient + max(0.0, dot(N, L))) * texture(sSkin, iTexCoord);
 //	oColor.rgb = abs(N);
 }
 
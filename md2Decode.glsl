@@ -0,0 +1,117 @@
+#version 430 core
+
+// LOCAL_SIZE must be defined by the application
+
+// keyframe data (std430 layouts of Md2 and Md2Decoder)
+struct Frame
+{
+	vec4 scale;           // xyz: scale
+	vec4 translation;     // xyz: translation
+};
+struct Corner
+{
+	vec2 st;              // texture coordinates
+	uint vertex;          // index of the keyframe vertex
+	uint reserved;
+};
+struct Model
+{
+	uint firstVertex;     // first packed vertex
+	uint firstFrame;      // first frame transform
+	uint firstCorner;     // first corner
+	uint vertexCount;     // packed vertices per frame
+	uint cornerCount;     // decoded vertices
+	uint reserved[3];
+};
+struct Instance
+{
+	uint  model;          // model index
+	uint  frameA;         // first keyframe
+	uint  frameB;         // second keyframe
+	uint  firstVertex;    // first output vertex
+	float lerp;           // interpolation factor
+	uint  reserved[3];
+};
+
+layout(std430, binding=0) readonly buffer VertexBuffer
+{
+	uint uVertices[];     // x | y << 8 | z << 16 | normal << 24
+};
+layout(std430, binding=1) readonly buffer FrameBuffer
+{
+	Frame uFrames[];
+};
+layout(std430, binding=2) readonly buffer CornerBuffer
+{
+	Corner uCorners[];
+};
+layout(std430, binding=3) readonly buffer NormalBuffer
+{
+	vec4 uNormals[];      // xyz: unit normal
+};
+layout(std430, binding=4) readonly buffer ModelBuffer
+{
+	Model uModels[];
+};
+layout(std430, binding=5) readonly buffer InstanceBuffer
+{
+	Instance uInstances[];
+};
+layout(std430, binding=6) writeonly buffer OutputBuffer
+{
+	float oVertices[];    // Md2::Vertex: position, normal, texcoords
+};
+
+#ifdef _COMPUTE_
+
+// one invocation per decoded vertex, one row of work groups per instance
+layout(local_size_x=LOCAL_SIZE) in;
+
+void main()
+{
+	Instance instance = uInstances[gl_WorkGroupID.y];
+	Model model       = uModels[instance.model];
+	uint corner       = gl_GlobalInvocationID.x;
+	if(corner >= model.cornerCount)
+		return;
+
+	// fetch
+	Corner c   = uCorners[model.firstCorner + corner];
+	Frame fa   = uFrames[model.firstFrame + instance.frameA];
+	Frame fb   = uFrames[model.firstFrame + instance.frameB];
+	uint vertA = uVertices[model.firstVertex
+	                       + instance.frameA*model.vertexCount
+	                       + c.vertex];
+	uint vertB = uVertices[model.firstVertex
+	                       + instance.frameB*model.vertexCount
+	                       + c.vertex];
+
+	// uncompress and interpolate (same expressions as Md2::GenVertices)
+	float lerp         = instance.lerp;
+	float oneMinusLerp = 1.0 - lerp;
+	precise vec3 posA  = fa.scale.xyz * vec3(vertA & 0xFFu,
+	                                         vertA >> 8 & 0xFFu,
+	                                         vertA >> 16 & 0xFFu)
+	                   + fa.translation.xyz;
+	precise vec3 posB  = fb.scale.xyz * vec3(vertB & 0xFFu,
+	                                         vertB >> 8 & 0xFFu,
+	                                         vertB >> 16 & 0xFFu)
+	                   + fb.translation.xyz;
+	precise vec3 p     = oneMinusLerp * posA + lerp * posB;
+	precise vec3 n     = oneMinusLerp * uNormals[vertA >> 24].xyz
+	                   + lerp * uNormals[vertB >> 24].xyz;
+
+	// store
+	uint o = (instance.firstVertex + corner) * 8u;
+	oVertices[o]   = p.x;
+	oVertices[o+1] = p.y;
+	oVertices[o+2] = p.z;
+	oVertices[o+3] = n.x;
+	oVertices[o+4] = n.y;
+	oVertices[o+5] = n.z;
+	oVertices[o+6] = c.st.x;
+	oVertices[o+7] = c.st.y;
+}
+
+#endif // _COMPUTE_
+
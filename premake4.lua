@@ -33,7 +33,7 @@ solution "OpenGL"
 -- Linux x86 platform gmake
 		configuration {"linux", "gmake", "x32"}
 			linkoptions {
-			"-Wl,-rpath,./lib/linux/lin32 -L./lib/linux/lin32 -lGLEW -lglut -lAntTweakBar"
+			"-Wl,-rpath,./lib/linux/lin32 -L./lib/linux/lin32 -lGLEW -lglut -lAntTweakBar -lX11 -lpthread"
 			}
 			libdirs {
 			"lib/linux/lin32"
@@ -42,7 +42,7 @@ solution "OpenGL"
 -- Linux x64 platform gmake
 		configuration {"linux", "gmake", "x64"}
 			linkoptions {
-			"-Wl,-rpath,./lib/linux/lin64 -L./lib/linux/lin64 -lGLEW -lglut -lAntTweakBar"
+			"-Wl,-rpath,./lib/linux/lin64 -L./lib/linux/lin64 -lGLEW -lglut -lAntTweakBar -lX11 -lpthread"
 			}
 			libdirs {
 			"lib/linux/lin64"
@@ -70,3 +70,203 @@ solution "OpenGL"
 --			}
 
 
+
+-- ---------------------------------------------------------
+-- Core library accuracy tests and benchmarks (no OpenGL)
+	project "coreBench"
+		basedir "./"
+		language "C++"
+		location "./"
+		kind "ConsoleApp"
+		files { "tools/coreBench.cpp", "Benchmark.hpp", "Benchmark.cpp" }
+		files { "core/*.cpp" }
+		includedirs {
+		"core",
+		"./"
+		}
+		objdir "obj/coreBench"
+
+-- Debug configurations
+		configuration {"debug"}
+			defines {"DEBUG"}
+			flags {"Symbols", "ExtraWarnings"}
+
+-- Release configurations
+		configuration {"release"}
+			defines {"NDEBUG"}
+			flags {"Optimize"}
+
+
+
+-- ---------------------------------------------------------
+-- Performance regression harness (no OpenGL)
+	project "perfHarness"
+		basedir "./"
+		language "C++"
+		location "./"
+		kind "ConsoleApp"
+		files { "tools/perfHarness.cpp", "Benchmark.hpp", "Benchmark.cpp" }
+		files { "Md2.hpp", "Md2.cpp" }
+		files { "core/*.cpp" }
+		includedirs {
+		"core",
+		"./"
+		}
+		objdir "obj/perfHarness"
+
+-- Debug configurations
+		configuration {"debug"}
+			defines {"DEBUG"}
+			flags {"Symbols", "ExtraWarnings"}
+
+-- Release configurations
+		configuration {"release"}
+			defines {"NDEBUG"}
+			flags {"Optimize"}
+
+
+
+-- ---------------------------------------------------------
+-- Synthetic md2 models and size sweep (no OpenGL)
+	project "md2Synth"
+		basedir "./"
+		language "C++"
+		location "./"
+		kind "ConsoleApp"
+		files { "tools/md2Synth.cpp", "Benchmark.hpp", "Benchmark.cpp" }
+		files { "Md2.hpp", "Md2.cpp" }
+		includedirs {
+		"./"
+		}
+		objdir "obj/md2Synth"
+
+-- Debug configurations
+		configuration {"debug"}
+			defines {"DEBUG"}
+			flags {"Symbols", "ExtraWarnings"}
+
+-- Release configurations
+		configuration {"release"}
+			defines {"NDEBUG"}
+			flags {"Optimize"}
+
+
+
+-- ---------------------------------------------------------
+-- Streaming strategy matrix (requires a GL4.3 context)
+	project "streamBench"
+		basedir "./"
+		language "C++"
+		location "./"
+		kind "ConsoleApp"
+		files { "tools/streamBench.cpp", "Benchmark.hpp", "Benchmark.cpp" }
+		files { "Framework.hpp", "Framework.cpp" }
+		files { "GlTrace.hpp", "GlTrace.cpp" }
+		includedirs {
+		"include",
+		"./"
+		}
+		objdir "obj/streamBench"
+
+-- Debug configurations
+		configuration {"debug"}
+			defines {"DEBUG"}
+			flags {"Symbols", "ExtraWarnings"}
+
+-- Release configurations
+		configuration {"release"}
+			defines {"NDEBUG"}
+			flags {"Optimize"}
+
+-- Linux x86 platform gmake
+		configuration {"linux", "gmake", "x32"}
+			linkoptions {
+			"-Wl,-rpath,./lib/linux/lin32 -L./lib/linux/lin32 -lGLEW -lglut -lpthread"
+			}
+
+-- Linux x64 platform gmake
+		configuration {"linux", "gmake", "x64"}
+			linkoptions {
+			"-Wl,-rpath,./lib/linux/lin64 -L./lib/linux/lin64 -lGLEW -lglut -lpthread"
+			}
+
+
+
+-- ---------------------------------------------------------
+-- Md2 GPU decoder validation (requires a GL4.3 context)
+	project "md2DecodeCheck"
+		basedir "./"
+		language "C++"
+		location "./"
+		kind "ConsoleApp"
+		files { "tools/md2DecodeCheck.cpp", "Benchmark.hpp", "Benchmark.cpp" }
+		files { "Framework.hpp", "Framework.cpp", "Md2.hpp", "Md2.cpp" }
+		files { "GlTrace.hpp", "GlTrace.cpp" }
+		files { "Md2Decoder.hpp", "Md2Decoder.cpp" }
+		includedirs {
+		"include",
+		"./"
+		}
+		objdir "obj/md2DecodeCheck"
+
+-- Debug configurations
+		configuration {"debug"}
+			defines {"DEBUG"}
+			flags {"Symbols", "ExtraWarnings"}
+
+-- Release configurations
+		configuration {"release"}
+			defines {"NDEBUG"}
+			flags {"Optimize"}
+
+-- Linux x86 platform gmake
+		configuration {"linux", "gmake", "x32"}
+			linkoptions {
+			"-Wl,-rpath,./lib/linux/lin32 -L./lib/linux/lin32 -lGLEW -lglut -lpthread"
+			}
+
+-- Linux x64 platform gmake
+		configuration {"linux", "gmake", "x64"}
+			linkoptions {
+			"-Wl,-rpath,./lib/linux/lin64 -L./lib/linux/lin64 -lGLEW -lglut -lpthread"
+			}
+
+
+
+-- ---------------------------------------------------------
+-- Job system overhead and scaling benchmark (no OpenGL context)
+	project "jobBench"
+		basedir "./"
+		language "C++"
+		location "./"
+		kind "ConsoleApp"
+		files { "tools/jobBench.cpp", "Benchmark.hpp", "Benchmark.cpp" }
+		files { "Framework.hpp", "Framework.cpp" }
+		files { "GlTrace.hpp", "GlTrace.cpp" }
+		includedirs {
+		"include",
+		"./"
+		}
+		objdir "obj/jobBench"
+
+-- Debug configurations
+		configuration {"debug"}
+			defines {"DEBUG"}
+			flags {"Symbols", "ExtraWarnings"}
+
+-- Release configurations
+		configuration {"release"}
+			defines {"NDEBUG"}
+			flags {"Optimize"}
+
+-- Linux x86 platform gmake
+		configuration {"linux", "gmake", "x32"}
+			linkoptions {
+			"-Wl,-rpath,./lib/linux/lin32 -L./lib/linux/lin32 -lGLEW -lpthread"
+			}
+
+-- Linux x64 platform gmake
+		configuration {"linux", "gmake", "x64"}
+			linkoptions {
+			"-Wl,-rpath,./lib/linux/lin64 -L./lib/linux/lin64 -lGLEW -lpthread"
+			}
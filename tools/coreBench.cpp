@@ -0,0 +1,2128 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    coreBench.cpp
+// \author  J. Dupuy
+// \brief   Accuracy tests and microbenchmarks for the core library.
+//          Every operation of Algebra.hpp and Transform.hpp is evaluated on a
+//          set of random inputs and compared against a double precision
+//          reference. Errors are reported in ULPs (taken at the magnitude of
+//          the largest output of the operation), timings in ns/op (including
+//          the construction of the operands from raw floats).
+//          Batched rotation updates of Affine instances (matrix and
+//          quaternion modes) are timed in ns/instance, along with the
+//          orthogonality drift of the axis after many updates. Batches
+//          where few instances move measure the cached matrix extraction.
+//          Usage: coreBench [options]
+//          --json <file>     write the results as JSON
+//          --compare <file>  compare outputs and timings against the JSON
+//                            file of a previous run (e.g. the scalar
+//                            baseline when testing SIMD or inline variants)
+//          --filter <str>    only run operations whose name contains str
+//          --repeat <n>      timing repetitions per trial (default 64)
+//          The program returns 1 if an operation exceeds its error bound, or
+//          if its outputs do not match the baseline.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Algebra.hpp"
+#include "Transform.hpp"
+#include "Benchmark.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants
+//
+////////////////////////////////////////////////////////////////////////////////
+
+const int OPERAND_A          = 0;    // first operand (vector/matrix)
+const int OPERAND_B          = 16;   // second operand (vector/matrix)
+const int OPERAND_C          = 32;   // third operand or scalars
+const int INPUT_SIZE         = 48;   // floats per input sample
+const int OUTPUT_SIZE        = 16;   // floats per output sample
+const int SAMPLE_COUNT       = 1024; // input samples per operation
+const int CHECK_SAMPLE_COUNT = 8;    // outputs saved for comparisons
+const int TIMING_TRIAL_COUNT = 5;    // median is reported
+const int BATCH_SIZE         = 1024; // instances per rotation batch
+const int DRIFT_UPDATE_COUNT = 100000; // updates before measuring drift
+const size_t SPARSE_UPDATE_PERIOD = 16; // one in n instances is updated
+
+const float PI = 3.14159265358979f;
+
+// error bounds, in ulps
+const double ULP_EXACT       = 0.0;   // no rounding
+const double ULP_ROUNDED     = 2.0;   // a few correctly rounded ops
+const double ULP_LIBM        = 2.0;   // transcendental functions
+const double ULP_SUM         = 4.0;   // dot products, lengths, products
+const double ULP_TRIGONOMETRY= 16.0;  // products of sines and cosines
+const double ULP_COMPOSITE   = 32.0;  // transformations, determinants
+const double ULP_INVERSE     = 64.0;  // inverses, adjugates
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Load / store helpers (matrices are column major)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+inline void load(const float* in, Vector2& v)
+{ v = Vector2(in[0], in[1]); }
+
+inline void load(const float* in, Vector3& v)
+{ v = Vector3(in[0], in[1], in[2]); }
+
+inline void load(const float* in, Vector4& v)
+{ v = Vector4(in[0], in[1], in[2], in[3]); }
+
+inline void load(const float* in, Matrix2x2& m)
+{ m = Matrix2x2(Vector2(in[0], in[1]), Vector2(in[2], in[3])); }
+
+inline void load(const float* in, Matrix3x3& m)
+{ m = Matrix3x3(Vector3(in[0], in[1], in[2]),
+                Vector3(in[3], in[4], in[5]),
+                Vector3(in[6], in[7], in[8])); }
+
+inline void load(const float* in, Matrix4x4& m)
+{ m = Matrix4x4(Vector4(in[0],  in[1],  in[2],  in[3]),
+                Vector4(in[4],  in[5],  in[6],  in[7]),
+                Vector4(in[8],  in[9],  in[10], in[11]),
+                Vector4(in[12], in[13], in[14], in[15])); }
+
+inline void load(const float* in, Quaternion& q)
+{ q = Quaternion(in[0], in[1], in[2], in[3]); }
+
+template<class T> inline T load_as(const float* in)
+{ T t; load(in, t); return t; }
+
+inline void store(float f, float* out)
+{ out[0] = f; }
+
+inline void store(bool b, float* out)
+{ out[0] = b ? 1.0f : 0.0f; }
+
+inline void store(const Vector2& v, float* out)
+{ out[0] = v[0]; out[1] = v[1]; }
+
+inline void store(const Vector3& v, float* out)
+{ out[0] = v[0]; out[1] = v[1]; out[2] = v[2]; }
+
+inline void store(const Vector4& v, float* out)
+{ out[0] = v[0]; out[1] = v[1]; out[2] = v[2]; out[3] = v[3]; }
+
+inline void store(const Matrix2x2& m, float* out)
+{ store(m[0], out); store(m[1], out+2); }
+
+inline void store(const Matrix3x3& m, float* out)
+{ store(m[0], out); store(m[1], out+3); store(m[2], out+6); }
+
+inline void store(const Matrix4x4& m, float* out)
+{ store(m[0], out); store(m[1], out+4); store(m[2], out+8); store(m[3], out+12); }
+
+inline void store(const Quaternion& q, float* out)
+{ out[0] = q[0]; out[1] = q[1]; out[2] = q[2]; out[3] = q[3]; }
+
+// number of floats of a type
+template<class T> struct Size;
+template<> struct Size<Vector2>   { enum { VALUE = 2 }; };
+template<> struct Size<Vector3>   { enum { VALUE = 3 }; };
+template<> struct Size<Vector4>   { enum { VALUE = 4 }; };
+template<> struct Size<Matrix2x2> { enum { VALUE = 4 }; };
+template<> struct Size<Matrix3x3> { enum { VALUE = 9 }; };
+template<> struct Size<Matrix4x4> { enum { VALUE = 16 }; };
+template<> struct Size<Quaternion> { enum { VALUE = 4 }; };
+
+// column type of a matrix
+template<class M> struct Column;
+template<> struct Column<Matrix2x2> { typedef Vector2 Type; };
+template<> struct Column<Matrix3x3> { typedef Vector3 Type; };
+template<> struct Column<Matrix4x4> { typedef Vector4 Type; };
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Input generators
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// operands in [-1,1], scalars in [-pi,pi]
+static void gen_signed(bench::Random& r, float* in)
+{
+	for(int i=0; i<OPERAND_C; ++i)
+		in[i] = r.Uniform(-1.0f, 1.0f);
+	for(int i=OPERAND_C; i<INPUT_SIZE; ++i)
+		in[i] = r.Uniform(-PI, PI);
+}
+
+// everything in [0.25,4]
+static void gen_positive(bench::Random& r, float* in)
+{
+	for(int i=0; i<INPUT_SIZE; ++i)
+		in[i] = r.Uniform(0.25f, 4.0f);
+}
+
+// positive bases, signed exponents
+static void gen_pow(bench::Random& r, float* in)
+{
+	gen_positive(r, in);
+	for(int i=OPERAND_B; i<OPERAND_C; ++i)
+		in[i] = r.Uniform(-2.0f, 2.0f);
+}
+
+// values in [-4,4] (several integers for ceil/floor/frac)
+static void gen_wide(bench::Random& r, float* in)
+{
+	for(int i=0; i<INPUT_SIZE; ++i)
+		in[i] = r.Uniform(-4.0f, 4.0f);
+}
+
+// second operand equals the first one half of the time
+template<int N> void gen_equal(bench::Random& r, float* in)
+{
+	gen_signed(r, in);
+	if(r.Next() & 1)
+		for(int i=0; i<N; ++i)
+			in[OPERAND_B+i] = in[OPERAND_A+i];
+}
+
+// random unit vector
+static void random_unit(bench::Random& r, int n, float* v)
+{
+	double length = 0.0;
+	do
+	{
+		length = 0.0;
+		for(int i=0; i<n; ++i)
+		{
+			v[i] = r.Uniform(-1.0f, 1.0f);
+			length += double(v[i]) * double(v[i]);
+		}
+	} while(length < 0.01 || length > 1.0);
+	length = std::sqrt(length);
+	for(int i=0; i<n; ++i)
+		v[i] = float(v[i] / length);
+}
+
+// unit vectors for the first two operands, eta/angle in [0.5,1.5]
+template<int N> void gen_unit(bench::Random& r, float* in)
+{
+	gen_signed(r, in);
+	random_unit(r, N, in+OPERAND_A);
+	random_unit(r, N, in+OPERAND_B);
+	in[OPERAND_C] = r.Uniform(0.5f, 1.5f);
+}
+
+// unit vectors at most 120 degrees apart (VectorRotation is ill
+// conditioned for opposite vectors)
+static void gen_unit_pair(bench::Random& r, float* in)
+{
+	double e = -1.0;
+	while(e < -0.5)
+	{
+		gen_unit<3>(r, in);
+		e = 0.0;
+		for(int i=0; i<3; ++i)
+			e += double(in[OPERAND_A+i]) * double(in[OPERAND_B+i]);
+	}
+}
+
+// diagonally dominant matrices (zero half of the time for operand A if
+// singular is set)
+template<int D, bool SINGULAR> void gen_invertible(bench::Random& r, float* in)
+{
+	gen_signed(r, in);
+	for(int c=0; c<D; ++c)
+	{
+		in[OPERAND_A + c*D + c] += 3.0f;
+		in[OPERAND_B + c*D + c] += 3.0f;
+	}
+	if(SINGULAR && (r.Next() & 1))
+		for(int i=0; i<D*D; ++i)
+			in[OPERAND_A+i] = 0.0f;
+}
+
+// eye position, target position, unit up vector
+static void gen_look_at(bench::Random& r, float* in)
+{
+	gen_signed(r, in);
+	for(int i=0; i<3; ++i)
+	{
+		in[OPERAND_A+i] *= 10.0f;
+		in[OPERAND_B+i] = in[OPERAND_B+i] * 10.0f + 25.0f;
+	}
+	random_unit(r, 3, in+OPERAND_C);
+}
+
+// left, right, bottom, top, near, far, fovy, aspect, new aspect
+static void gen_projection(bench::Random& r, float* in)
+{
+	gen_signed(r, in);
+	in[OPERAND_C+0] = r.Uniform(-2.0f, -0.5f);
+	in[OPERAND_C+1] = r.Uniform( 0.5f,  2.0f);
+	in[OPERAND_C+2] = r.Uniform(-2.0f, -0.5f);
+	in[OPERAND_C+3] = r.Uniform( 0.5f,  2.0f);
+	in[OPERAND_C+4] = r.Uniform( 0.1f,  1.0f);
+	in[OPERAND_C+5] = r.Uniform(10.0f, 100.0f);
+	in[OPERAND_C+6] = r.Uniform( 0.5f,  2.0f);
+	in[OPERAND_C+7] = r.Uniform( 0.5f,  2.0f);
+	in[OPERAND_C+8] = r.Uniform( 0.5f,  2.0f);
+	for(int i=0; i<6; ++i)
+		in[OPERAND_B+i] = in[OPERAND_C+i] * r.Uniform(1.1f, 1.5f);
+}
+
+// affine transformation: yaw, pitch, roll, position, scale. The operand B
+// holds a direction/target (0..3) and a unit vector (4..7), the C operand an
+// angle (4), a second scale (5), an equality flag (6) and an interpolation
+// parameter (7).
+static void gen_affine(bench::Random& r, float* in)
+{
+	gen_signed(r, in);
+	for(int i=0; i<3; ++i)
+	{
+		in[OPERAND_A+i] *= 10.0f;
+		in[OPERAND_B+i] = in[OPERAND_B+i] * 10.0f + 25.0f;
+	}
+	random_unit(r, 3, in+OPERAND_B+4);
+	in[OPERAND_C+3] = r.Uniform(0.5f, 2.0f);
+	in[OPERAND_C+5] = r.Uniform(0.5f, 2.0f);
+	in[OPERAND_C+6] = float(r.Next() & 1);
+	in[OPERAND_C+7] = r.Uniform(0.0f, 1.0f);
+}
+
+// unit quaternions and an interpolation parameter in [0,1]
+static void gen_quaternions(bench::Random& r, float* in)
+{
+	gen_unit<4>(r, in);
+	in[OPERAND_C] = r.Uniform(0.0f, 1.0f);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Double precision reference implementations (column major)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+template<int D> void ref_matrix_product(const double* a,
+                                        const double* b,
+                                        double* out)
+{
+	for(int c=0; c<D; ++c)
+		for(int r=0; r<D; ++r)
+		{
+			out[c*D+r] = 0.0;
+			for(int k=0; k<D; ++k)
+				out[c*D+r] += a[k*D+r] * b[c*D+k];
+		}
+}
+
+template<int D> void ref_matrix_vector(const double* m,
+                                       const double* v,
+                                       double* out)
+{
+	for(int r=0; r<D; ++r)
+	{
+		out[r] = 0.0;
+		for(int k=0; k<D; ++k)
+			out[r] += m[k*D+r] * v[k];
+	}
+}
+
+template<int D> void ref_transpose(const double* m, double* out)
+{
+	for(int c=0; c<D; ++c)
+		for(int r=0; r<D; ++r)
+			out[c*D+r] = m[r*D+c];
+}
+
+// Gauss-Jordan elimination with partial pivoting, returns the determinant
+template<int D> double ref_inverse(const double* m, double* out)
+{
+	double a[D][2*D];
+	double det = 1.0;
+	for(int r=0; r<D; ++r)
+		for(int c=0; c<D; ++c)
+		{
+			a[r][c]   = m[c*D+r];
+			a[r][D+c] = r == c ? 1.0 : 0.0;
+		}
+	for(int c=0; c<D; ++c)
+	{
+		int pivot = c;
+		for(int r=c+1; r<D; ++r)
+			if(std::abs(a[r][c]) > std::abs(a[pivot][c]))
+				pivot = r;
+		if(a[pivot][c] == 0.0)
+			return 0.0;
+		if(pivot != c)
+		{
+			for(int k=0; k<2*D; ++k)
+				std::swap(a[pivot][k], a[c][k]);
+			det = -det;
+		}
+		det *= a[c][c];
+		double invPivot = 1.0 / a[c][c];
+		for(int k=0; k<2*D; ++k)
+			a[c][k] *= invPivot;
+		for(int r=0; r<D; ++r)
+			if(r != c)
+			{
+				double f = a[r][c];
+				for(int k=0; k<2*D; ++k)
+					a[r][k] -= f * a[c][k];
+			}
+	}
+	if(out)
+		for(int r=0; r<D; ++r)
+			for(int c=0; c<D; ++c)
+				out[c*D+r] = a[r][D+c];
+	return det;
+}
+
+template<int D> double ref_determinant(const double* m)
+{
+	return ref_inverse<D>(m, NULL);
+}
+
+static void ref_identity(int d, double* out)
+{
+	for(int c=0; c<d; ++c)
+		for(int r=0; r<d; ++r)
+			out[c*d+r] = r == c ? 1.0 : 0.0;
+}
+
+void ref_rotation_x(double a, double* out)
+{
+	ref_identity(3, out);
+	out[4] = std::cos(a); out[5] = std::sin(a);
+	out[7] =-std::sin(a); out[8] = std::cos(a);
+}
+
+void ref_rotation_y(double a, double* out)
+{
+	ref_identity(3, out);
+	out[0] = std::cos(a); out[2] =-std::sin(a);
+	out[6] = std::sin(a); out[8] = std::cos(a);
+}
+
+void ref_rotation_z(double a, double* out)
+{
+	ref_identity(3, out);
+	out[0] = std::cos(a); out[1] = std::sin(a);
+	out[3] =-std::sin(a); out[4] = std::cos(a);
+}
+
+// Rx(yaw) * Ry(pitch) * Rz(roll)
+static void ref_rotation(double yaw, double pitch, double roll, double* out)
+{
+	double x[9], y[9], z[9], xy[9];
+	ref_rotation_x(yaw, x);
+	ref_rotation_y(pitch, y);
+	ref_rotation_z(roll, z);
+	ref_matrix_product<3>(x, y, xy);
+	ref_matrix_product<3>(xy, z, out);
+}
+
+// Rodrigues' formula
+static void ref_rotation_axis(const double* u, double a, double* out)
+{
+	double c = std::cos(a), s = std::sin(a);
+	for(int col=0; col<3; ++col)
+		for(int row=0; row<3; ++row)
+			out[col*3+row] = u[row]*u[col]*(1.0-c) + (row == col ? c : 0.0);
+	out[1] += u[2]*s; out[2] -= u[1]*s;
+	out[3] -= u[2]*s; out[5] += u[0]*s;
+	out[6] += u[1]*s; out[7] -= u[0]*s;
+}
+
+static void ref_cross(const double* u, const double* v, double* out)
+{
+	out[0] = u[1]*v[2] - u[2]*v[1];
+	out[1] = u[2]*v[0] - u[0]*v[2];
+	out[2] = u[0]*v[1] - u[1]*v[0];
+}
+
+static void ref_normalize(int n, const double* v, double* out)
+{
+	double length = 0.0;
+	for(int i=0; i<n; ++i)
+		length += v[i]*v[i];
+	length = std::sqrt(length);
+	for(int i=0; i<n; ++i)
+		out[i] = v[i] / length;
+}
+
+// gluLookAt rotation: columns are side, up and -forward
+static void ref_look_at_rotation(const double* eye,
+                                 const double* target,
+                                 const double* up,
+                                 double* out)
+{
+	double f[3], s[3], u[3];
+	for(int i=0; i<3; ++i)
+		f[i] = target[i] - eye[i];
+	ref_normalize(3, f, f);
+	ref_cross(f, up, s);
+	ref_normalize(3, s, s);
+	ref_cross(s, f, u);
+	for(int i=0; i<3; ++i)
+	{
+		out[0+i] = s[i];
+		out[3+i] = u[i];
+		out[6+i] =-f[i];
+	}
+}
+
+// 4x4 affine matrix from a rotation/scale and a translation
+static void ref_affine(const double* r3x3, double s, const double* t, double* out)
+{
+	ref_identity(4, out);
+	for(int c=0; c<3; ++c)
+	{
+		for(int r=0; r<3; ++r)
+			out[c*4+r] = r3x3[c*3+r] * s;
+		out[12+c] = t ? t[c] : 0.0;
+	}
+}
+
+static void ref_frustum(double l, double r, double b, double t,
+                        double n, double f, double* out)
+{
+	for(int i=0; i<16; ++i)
+		out[i] = 0.0;
+	out[0]  = 2.0*n/(r-l);
+	out[5]  = 2.0*n/(t-b);
+	out[8]  = (r+l)/(r-l);
+	out[9]  = (t+b)/(t-b);
+	out[10] =-(f+n)/(f-n);
+	out[11] =-1.0;
+	out[14] =-2.0*f*n/(f-n);
+}
+
+static void ref_ortho(double l, double r, double b, double t,
+                      double n, double f, double* out)
+{
+	ref_identity(4, out);
+	out[0]  = 2.0/(r-l);
+	out[5]  = 2.0/(t-b);
+	out[10] =-2.0/(f-n);
+	out[12] =-(r+l)/(r-l);
+	out[13] =-(t+b)/(t-b);
+	out[14] =-(f+n)/(f-n);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Kernels (float, tested) and references (double)
+// Kernels have external linkage: they are used as template arguments.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Arithmetic
+template<class T> void k_add(const float* in, float* out)
+{ store(load_as<T>(in) + load_as<T>(in+OPERAND_B), out); }
+template<class T> void k_sub(const float* in, float* out)
+{ store(load_as<T>(in) - load_as<T>(in+OPERAND_B), out); }
+template<class T> void k_pos(const float* in, float* out)
+{ store(+load_as<T>(in), out); }
+template<class T> void k_neg(const float* in, float* out)
+{ store(-load_as<T>(in), out); }
+template<class T> void k_scalar_mul(const float* in, float* out)
+{ store(in[OPERAND_C] * load_as<T>(in), out); }
+template<class T> void k_mul_scalar(const float* in, float* out)
+{ store(load_as<T>(in) * in[OPERAND_C], out); }
+template<class T> void k_div_scalar(const float* in, float* out)
+{ store(load_as<T>(in) / in[OPERAND_C], out); }
+template<class T> void k_add_assign(const float* in, float* out)
+{ T t = load_as<T>(in); t += load_as<T>(in+OPERAND_B); store(t, out); }
+template<class T> void k_sub_assign(const float* in, float* out)
+{ T t = load_as<T>(in); t -= load_as<T>(in+OPERAND_B); store(t, out); }
+template<class T> void k_mul_assign_scalar(const float* in, float* out)
+{ T t = load_as<T>(in); t *= in[OPERAND_C]; store(t, out); }
+template<class T> void k_div_assign_scalar(const float* in, float* out)
+{ T t = load_as<T>(in); t /= in[OPERAND_C]; store(t, out); }
+template<class T> void k_equal(const float* in, float* out)
+{ store(load_as<T>(in) == load_as<T>(in+OPERAND_B), out); }
+template<class T> void k_not_equal(const float* in, float* out)
+{ store(load_as<T>(in) != load_as<T>(in+OPERAND_B), out); }
+
+template<int N> void r_add(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = in[i] + in[OPERAND_B+i]; }
+template<int N> void r_sub(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = in[i] - in[OPERAND_B+i]; }
+template<int N> void r_pos(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = in[i]; }
+template<int N> void r_neg(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = -in[i]; }
+template<int N> void r_scalar_mul(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = in[OPERAND_C] * in[i]; }
+template<int N> void r_div_scalar(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = in[i] / in[OPERAND_C]; }
+template<int N> void r_equal(const double* in, double* out)
+{
+	out[0] = 1.0;
+	for(int i=0; i<N; ++i)
+		if(in[i] != in[OPERAND_B+i])
+			out[0] = 0.0;
+}
+template<int N> void r_not_equal(const double* in, double* out)
+{ r_equal<N>(in, out); out[0] = 1.0 - out[0]; }
+
+// Component wise factories
+template<class T> void k_comp_mult(const float* in, float* out)
+{ store(T::CompMult(load_as<T>(in), load_as<T>(in+OPERAND_B)), out); }
+template<class T> void k_comp_div(const float* in, float* out)
+{ store(T::CompDiv(load_as<T>(in), load_as<T>(in+OPERAND_B)), out); }
+template<class T> void k_comp_pow(const float* in, float* out)
+{ store(T::CompPow(load_as<T>(in), load_as<T>(in+OPERAND_B)), out); }
+template<class T> void k_comp_min(const float* in, float* out)
+{ store(T::CompMin(load_as<T>(in), load_as<T>(in+OPERAND_B)), out); }
+template<class T> void k_comp_max(const float* in, float* out)
+{ store(T::CompMax(load_as<T>(in), load_as<T>(in+OPERAND_B)), out); }
+template<class T> void k_comp_clamp(const float* in, float* out)
+{ store(T::CompClamp(load_as<T>(in),
+                     load_as<T>(in+OPERAND_B),
+                     load_as<T>(in+OPERAND_C)), out); }
+
+template<int N> void r_comp_mult(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = in[i] * in[OPERAND_B+i]; }
+template<int N> void r_comp_div(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = in[i] / in[OPERAND_B+i]; }
+template<int N> void r_comp_pow(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = std::pow(in[i], in[OPERAND_B+i]); }
+template<int N> void r_comp_min(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = std::min(in[i], in[OPERAND_B+i]); }
+template<int N> void r_comp_max(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = std::max(in[i], in[OPERAND_B+i]); }
+template<int N> void r_comp_clamp(const double* in, double* out)
+{
+	for(int i=0; i<N; ++i)
+		out[i] = std::min(std::max(in[i], in[OPERAND_B+i]), in[OPERAND_C+i]);
+}
+
+// Per component queries
+template<class T> void k_sign(const float* in, float* out)
+{ store(load_as<T>(in).Sign(), out); }
+template<class T> void k_abs(const float* in, float* out)
+{ store(load_as<T>(in).Abs(), out); }
+template<class T> void k_sqr(const float* in, float* out)
+{ store(load_as<T>(in).Sqr(), out); }
+template<class T> void k_sqrt(const float* in, float* out)
+{ store(load_as<T>(in).Sqrt(), out); }
+template<class T> void k_exp(const float* in, float* out)
+{ store(load_as<T>(in).Exp(), out); }
+template<class T> void k_log(const float* in, float* out)
+{ store(load_as<T>(in).Log(), out); }
+template<class T> void k_log10(const float* in, float* out)
+{ store(load_as<T>(in).Log10(), out); }
+template<class T> void k_ceil(const float* in, float* out)
+{ store(load_as<T>(in).Ceil(), out); }
+template<class T> void k_floor(const float* in, float* out)
+{ store(load_as<T>(in).Floor(), out); }
+template<class T> void k_frac(const float* in, float* out)
+{ store(load_as<T>(in).Frac(), out); }
+
+template<int N> void r_sign(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = double((in[i] > 0) - (in[i] < 0)); }
+template<int N> void r_abs(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = std::abs(in[i]); }
+template<int N> void r_sqr(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = in[i] * in[i]; }
+template<int N> void r_sqrt(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = std::sqrt(in[i]); }
+template<int N> void r_exp(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = std::exp(in[i]); }
+template<int N> void r_log(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = std::log(in[i]); }
+template<int N> void r_log10(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = std::log10(in[i]); }
+template<int N> void r_ceil(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = std::ceil(in[i]); }
+template<int N> void r_floor(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = std::floor(in[i]); }
+template<int N> void r_frac(const double* in, double* out)
+{ for(int i=0; i<N; ++i) out[i] = in[i] - std::floor(in[i]); }
+
+// Vector queries
+template<class V> void k_dot(const float* in, float* out)
+{ store(V::DotProduct(load_as<V>(in), load_as<V>(in+OPERAND_B)), out); }
+template<class V> void k_length(const float* in, float* out)
+{ store(load_as<V>(in).Length(), out); }
+template<class V> void k_length_squared(const float* in, float* out)
+{ store(load_as<V>(in).LengthSquared(), out); }
+template<class V> void k_normalize(const float* in, float* out)
+{ store(load_as<V>(in).Normalize(), out); }
+template<class V> void k_reflect(const float* in, float* out)
+{ store(V::Reflect(load_as<V>(in), load_as<V>(in+OPERAND_B)), out); }
+template<class V> void k_refract(const float* in, float* out)
+{ store(V::Refract(load_as<V>(in), load_as<V>(in+OPERAND_B), in[OPERAND_C]),
+        out); }
+void k_cross(const float* in, float* out)
+{ store(Vector3::CrossProduct(load_as<Vector3>(in),
+                              load_as<Vector3>(in+OPERAND_B)), out); }
+
+template<int N> void r_dot(const double* in, double* out)
+{ out[0] = 0.0; for(int i=0; i<N; ++i) out[0] += in[i] * in[OPERAND_B+i]; }
+template<int N> void r_length(const double* in, double* out)
+{ r_dot<N>(in, out); out[0] = std::sqrt(out[0]); }
+template<int N> void r_length_squared(const double* in, double* out)
+{ out[0] = 0.0; for(int i=0; i<N; ++i) out[0] += in[i] * in[i]; }
+template<int N> void r_normalize(const double* in, double* out)
+{ ref_normalize(N, in, out); }
+template<int N> void r_reflect(const double* in, double* out)
+{
+	double d = 0.0;
+	for(int i=0; i<N; ++i)
+		d += in[i] * in[OPERAND_B+i];
+	for(int i=0; i<N; ++i)
+		out[i] = in[i] - 2.0 * d * in[OPERAND_B+i];
+}
+template<int N> void r_refract(const double* in, double* out)
+{
+	double d = 0.0, eta = in[OPERAND_C];
+	for(int i=0; i<N; ++i)
+		d += in[i] * in[OPERAND_B+i];
+	double k = 1.0 - eta * eta * (1.0 - d * d);
+	for(int i=0; i<N; ++i)
+		out[i] = k < 0.0 ? 0.0
+		       : eta * in[i] - (eta * d + std::sqrt(k)) * in[OPERAND_B+i];
+}
+void r_cross(const double* in, double* out)
+{ ref_cross(in, in+OPERAND_B, out); }
+
+// Length is tested against the length of the first operand
+template<int N> void r_length_a(const double* in, double* out)
+{ r_length_squared<N>(in, out); out[0] = std::sqrt(out[0]); }
+
+// Matrix arithmetic
+template<class M> void k_matrix_vector(const float* in, float* out)
+{ typedef typename Column<M>::Type V;
+  store(load_as<M>(in) * load_as<V>(in+OPERAND_B), out); }
+template<class M> void k_matrix_product(const float* in, float* out)
+{ store(load_as<M>(in) * load_as<M>(in+OPERAND_B), out); }
+template<class M> void k_matrix_product_assign(const float* in, float* out)
+{ M m = load_as<M>(in); m *= load_as<M>(in+OPERAND_B); store(m, out); }
+template<class M> void k_is_invertible(const float* in, float* out)
+{ store(load_as<M>(in).IsInvertible(), out); }
+template<class M> void k_determinant(const float* in, float* out)
+{ store(load_as<M>(in).Determinant(), out); }
+template<class M> void k_inverse(const float* in, float* out)
+{ store(load_as<M>(in).Inverse(), out); }
+template<class M> void k_transpose(const float* in, float* out)
+{ store(load_as<M>(in).Transpose(), out); }
+template<class M> void k_adjugate(const float* in, float* out)
+{ store(load_as<M>(in).Adjugate(), out); }
+
+template<int D> void r_matrix_vector(const double* in, double* out)
+{ ref_matrix_vector<D>(in, in+OPERAND_B, out); }
+template<int D> void r_matrix_product(const double* in, double* out)
+{ ref_matrix_product<D>(in, in+OPERAND_B, out); }
+template<int D> void r_is_invertible(const double* in, double* out)
+{ out[0] = ref_determinant<D>(in) != 0.0 ? 1.0 : 0.0; }
+template<int D> void r_determinant(const double* in, double* out)
+{ out[0] = ref_determinant<D>(in); }
+template<int D> void r_inverse(const double* in, double* out)
+{ ref_inverse<D>(in, out); }
+template<int D> void r_transpose(const double* in, double* out)
+{ ref_transpose<D>(in, out); }
+template<int D> void r_adjugate(const double* in, double* out)
+{
+	double det = ref_inverse<D>(in, out);
+	for(int i=0; i<D*D; ++i)
+		out[i] *= det;
+}
+
+// Matrix factories
+template<class M> void k_outer_product(const float* in, float* out)
+{ typedef typename Column<M>::Type V;
+  store(M::OuterProduct(load_as<V>(in), load_as<V>(in+OPERAND_B)), out); }
+void k_diagonal2(const float* in, float* out)
+{ store(Matrix2x2::Diagonal(in[0], in[1]), out); }
+void k_diagonal3(const float* in, float* out)
+{ store(Matrix3x3::Diagonal(in[0], in[1], in[2]), out); }
+void k_diagonal4(const float* in, float* out)
+{ store(Matrix4x4::Diagonal(in[0], in[1], in[2], in[3]), out); }
+void k_scale2(const float* in, float* out)
+{ store(Matrix2x2::Scale(in[0], in[1]), out); }
+void k_scale3(const float* in, float* out)
+{ store(Matrix3x3::Scale(in[0], in[1], in[2]), out); }
+void k_scale4(const float* in, float* out)
+{ store(Matrix4x4::Scale(in[0], in[1], in[2]), out); }
+void k_rotation2(const float* in, float* out)
+{ store(Matrix2x2::Rotation(in[OPERAND_C]), out); }
+template<class M> void k_rotation_x(const float* in, float* out)
+{ store(M::RotationAboutX(in[OPERAND_C]), out); }
+template<class M> void k_rotation_y(const float* in, float* out)
+{ store(M::RotationAboutY(in[OPERAND_C]), out); }
+template<class M> void k_rotation_z(const float* in, float* out)
+{ store(M::RotationAboutZ(in[OPERAND_C]), out); }
+template<class M> void k_rotation(const float* in, float* out)
+{ store(M::Rotation(in[OPERAND_C], in[OPERAND_C+1], in[OPERAND_C+2]), out); }
+template<class M> void k_rotation_axis(const float* in, float* out)
+{ store(M::RotationAboutAxis(load_as<Vector3>(in), in[OPERAND_C]), out); }
+template<class M> void k_vector_rotation(const float* in, float* out)
+{ store(M::VectorRotation(load_as<Vector3>(in),
+                          load_as<Vector3>(in+OPERAND_B)), out); }
+template<class M> void k_look_at_rotation(const float* in, float* out)
+{ store(M::LookAtRotation(load_as<Vector3>(in),
+                          load_as<Vector3>(in+OPERAND_B),
+                          load_as<Vector3>(in+OPERAND_C)), out); }
+void k_translation(const float* in, float* out)
+{ store(Matrix4x4::Translation(load_as<Vector3>(in)), out); }
+void k_look_at(const float* in, float* out)
+{ store(Matrix4x4::LookAt(load_as<Vector3>(in),
+                          load_as<Vector3>(in+OPERAND_B),
+                          load_as<Vector3>(in+OPERAND_C)), out); }
+void k_ortho(const float* in, float* out)
+{ const float* p = in+OPERAND_C;
+  store(Matrix4x4::Ortho(p[0], p[1], p[2], p[3], p[4], p[5]), out); }
+void k_frustum(const float* in, float* out)
+{ const float* p = in+OPERAND_C;
+  store(Matrix4x4::Frustum(p[0], p[1], p[2], p[3], p[4], p[5]), out); }
+void k_perspective(const float* in, float* out)
+{ const float* p = in+OPERAND_C;
+  store(Matrix4x4::Perspective(p[6], p[7], p[4], p[5]), out); }
+
+template<int D> void r_outer_product(const double* in, double* out)
+{
+	for(int c=0; c<D; ++c)
+		for(int r=0; r<D; ++r)
+			out[c*D+r] = in[r] * in[OPERAND_B+c];
+}
+template<int D> void r_diagonal(const double* in, double* out)
+{
+	ref_identity(D, out);
+	for(int i=0; i<D; ++i)
+		out[i*D+i] = in[i];
+}
+void r_scale4(const double* in, double* out)
+{ ref_identity(4, out); out[0] = in[0]; out[5] = in[1]; out[10] = in[2]; }
+void r_rotation2(const double* in, double* out)
+{
+	double a = in[OPERAND_C];
+	out[0] = std::cos(a); out[1] = std::sin(a);
+	out[2] =-std::sin(a); out[3] = std::cos(a);
+}
+
+// 3x3 references, embedded in 4x4 matrices if D==4
+template<int D> void r_embed(const double* m3, double* out)
+{
+	if(D == 3)
+		for(int i=0; i<9; ++i)
+			out[i] = m3[i];
+	else
+		ref_affine(m3, 1.0, NULL, out);
+}
+template<int D> void r_rotation_x(const double* in, double* out)
+{ double m[9]; ref_rotation_x(in[OPERAND_C], m); r_embed<D>(m, out); }
+template<int D> void r_rotation_y(const double* in, double* out)
+{ double m[9]; ref_rotation_y(in[OPERAND_C], m); r_embed<D>(m, out); }
+template<int D> void r_rotation_z(const double* in, double* out)
+{ double m[9]; ref_rotation_z(in[OPERAND_C], m); r_embed<D>(m, out); }
+template<int D> void r_rotation(const double* in, double* out)
+{
+	double m[9];
+	ref_rotation(in[OPERAND_C], in[OPERAND_C+1], in[OPERAND_C+2], m);
+	r_embed<D>(m, out);
+}
+template<int D> void r_rotation_axis(const double* in, double* out)
+{ double m[9]; ref_rotation_axis(in, in[OPERAND_C], m); r_embed<D>(m, out); }
+template<int D> void r_vector_rotation(const double* in, double* out)
+{
+	// rotation about from x to, of angle acos(from.to)
+	double axis[3], m[9];
+	double e = in[0]*in[OPERAND_B+0] + in[1]*in[OPERAND_B+1]
+	         + in[2]*in[OPERAND_B+2];
+	ref_cross(in, in+OPERAND_B, axis);
+	ref_normalize(3, axis, axis);
+	ref_rotation_axis(axis, std::acos(std::max(-1.0, std::min(1.0, e))), m);
+	r_embed<D>(m, out);
+}
+template<int D> void r_look_at_rotation(const double* in, double* out)
+{
+	double m[9];
+	ref_look_at_rotation(in, in+OPERAND_B, in+OPERAND_C, m);
+	r_embed<D>(m, out);
+}
+void r_translation(const double* in, double* out)
+{ double i3[9]; ref_identity(3, i3); ref_affine(i3, 1.0, in, out); }
+void r_look_at(const double* in, double* out)
+{
+	// view matrix: inverse of the camera transformation
+	double m[9], camera[16];
+	ref_look_at_rotation(in, in+OPERAND_B, in+OPERAND_C, m);
+	ref_affine(m, 1.0, in, camera);
+	ref_inverse<4>(camera, out);
+}
+void r_ortho(const double* in, double* out)
+{ const double* p = in+OPERAND_C;
+  ref_ortho(p[0], p[1], p[2], p[3], p[4], p[5], out); }
+void r_frustum(const double* in, double* out)
+{ const double* p = in+OPERAND_C;
+  ref_frustum(p[0], p[1], p[2], p[3], p[4], p[5], out); }
+void r_perspective(const double* in, double* out)
+{
+	const double* p = in+OPERAND_C;
+	double top = std::tan(p[6]*0.5) * p[4];
+	ref_frustum(-top*p[7], top*p[7], -top, top, p[4], p[5], out);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Affine kernels: the fixture is Rotation(yaw,pitch,roll) with a position
+// and a scale (see gen_affine)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+inline Affine affine_fixture(const float* in)
+{
+	Affine affine = Affine::Rotation(in[OPERAND_C],
+	                                 in[OPERAND_C+1],
+	                                 in[OPERAND_C+2]);
+	affine.SetPosition(load_as<Vector3>(in));
+	affine.SetScale(in[OPERAND_C+3]);
+	return affine;
+}
+
+static void ref_affine_fixture(const double* in,
+                               double* r3x3,
+                               double* position,
+                               double* scale)
+{
+	ref_rotation(in[OPERAND_C], in[OPERAND_C+1], in[OPERAND_C+2], r3x3);
+	for(int i=0; i<3; ++i)
+		position[i] = in[i];
+	*scale = in[OPERAND_C+3];
+}
+
+void k_affine_translation(const float* in, float* out)
+{ store(Affine::Translation(load_as<Vector3>(in)).ExtractTransformMatrix(),
+        out); }
+void k_affine_rotation_x(const float* in, float* out)
+{ store(Affine::RotationAboutX(in[OPERAND_C+4]).ExtractTransformMatrix(),
+        out); }
+void k_affine_rotation_y(const float* in, float* out)
+{ store(Affine::RotationAboutY(in[OPERAND_C+4]).ExtractTransformMatrix(),
+        out); }
+void k_affine_rotation_z(const float* in, float* out)
+{ store(Affine::RotationAboutZ(in[OPERAND_C+4]).ExtractTransformMatrix(),
+        out); }
+void k_affine_rotation_axis(const float* in, float* out)
+{ store(Affine::RotationAboutAxis(load_as<Vector3>(in+OPERAND_B+4),
+                                  in[OPERAND_C+4]).ExtractTransformMatrix(),
+        out); }
+void k_affine_rotation(const float* in, float* out)
+{ store(Affine::Rotation(in[OPERAND_C],
+                         in[OPERAND_C+1],
+                         in[OPERAND_C+2]).ExtractTransformMatrix(), out); }
+void k_affine_scale(const float* in, float* out)
+{ store(Affine::Scale(in[OPERAND_C+3]).ExtractTransformMatrix(), out); }
+void k_affine_look_at_factory(const float* in, float* out)
+{ store(Affine::LookAt(load_as<Vector3>(in),
+                       load_as<Vector3>(in+OPERAND_B),
+                       load_as<Vector3>(in+OPERAND_B+4))
+                       .ExtractTransformMatrix(), out); }
+void k_affine_translate_world(const float* in, float* out)
+{ Affine a = affine_fixture(in);
+  a.TranslateWorld(load_as<Vector3>(in+OPERAND_B));
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_translate_local(const float* in, float* out)
+{ Affine a = affine_fixture(in);
+  a.TranslateLocal(load_as<Vector3>(in+OPERAND_B));
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_rotate_world_x(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.RotateAboutWorldX(in[OPERAND_C+4]);
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_rotate_world_y(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.RotateAboutWorldY(in[OPERAND_C+4]);
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_rotate_world_z(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.RotateAboutWorldZ(in[OPERAND_C+4]);
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_rotate_local_x(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.RotateAboutLocalX(in[OPERAND_C+4]);
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_rotate_local_y(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.RotateAboutLocalY(in[OPERAND_C+4]);
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_rotate_local_z(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.RotateAboutLocalZ(in[OPERAND_C+4]);
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_look_at(const float* in, float* out)
+{ Affine a = affine_fixture(in);
+  a.LookAt(load_as<Vector3>(in+OPERAND_B), load_as<Vector3>(in+OPERAND_B+4));
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_make_default_axis(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.MakeDefaultAxis();
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_make_zero_position(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.MakeZeroPosition();
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_make_unit_scale(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.MakeUnitScale();
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_set_position(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.SetPosition(load_as<Vector3>(in+OPERAND_B));
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_set_scale(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.SetScale(in[OPERAND_C+5]);
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_extract(const float* in, float* out)
+{ store(affine_fixture(in).ExtractTransformMatrix(), out); }
+void k_affine_extract_inverse(const float* in, float* out)
+{ store(affine_fixture(in).ExtractInverseTransformMatrix(), out); }
+void k_affine_extract_inverse_rs(const float* in, float* out)
+{ Affine a = affine_fixture(in); a.MakeZeroPosition();
+  store(a.ExtractInverseTransformMatrix(), out); }
+void k_affine_equal(const float* in, float* out)
+{ Affine a = affine_fixture(in), b = affine_fixture(in);
+  if(in[OPERAND_C+6] == 0.0f) b.SetScale(in[OPERAND_C+5]);
+  store(a == b, out); }
+void k_affine_not_equal(const float* in, float* out)
+{ Affine a = affine_fixture(in), b = affine_fixture(in);
+  if(in[OPERAND_C+6] == 0.0f) b.SetScale(in[OPERAND_C+5]);
+  store(a != b, out); }
+void k_affine_accessors(const float* in, float* out)
+{ Affine a = affine_fixture(in);
+  store(a.UnitXAxis(), out); store(a.UnitYAxis(), out+3);
+  store(a.UnitZAxis(), out+6); store(a.GetPosition(), out+9);
+  store(a.GetScale(), out+12); }
+
+// references
+static void ref_affine_matrix(const double* r3x3,
+                              const double* position,
+                              double scale,
+                              double* out)
+{ ref_affine(r3x3, scale, position, out); }
+
+void r_affine_translation(const double* in, double* out)
+{ r_translation(in, out); }
+void r_affine_rotation_x(const double* in, double* out)
+{ double m[9]; ref_rotation_x(in[OPERAND_C+4], m); ref_affine(m, 1.0, NULL, out); }
+void r_affine_rotation_y(const double* in, double* out)
+{ double m[9]; ref_rotation_y(in[OPERAND_C+4], m); ref_affine(m, 1.0, NULL, out); }
+void r_affine_rotation_z(const double* in, double* out)
+{ double m[9]; ref_rotation_z(in[OPERAND_C+4], m); ref_affine(m, 1.0, NULL, out); }
+void r_affine_rotation_axis(const double* in, double* out)
+{ double m[9]; ref_rotation_axis(in+OPERAND_B+4, in[OPERAND_C+4], m);
+  ref_affine(m, 1.0, NULL, out); }
+void r_affine_rotation(const double* in, double* out)
+{ double m[9]; ref_rotation(in[OPERAND_C], in[OPERAND_C+1], in[OPERAND_C+2], m);
+  ref_affine(m, 1.0, NULL, out); }
+void r_affine_scale(const double* in, double* out)
+{ double m[9]; ref_identity(3, m); ref_affine(m, in[OPERAND_C+3], NULL, out); }
+void r_affine_look_at_factory(const double* in, double* out)
+{ double m[9]; ref_look_at_rotation(in, in+OPERAND_B, in+OPERAND_B+4, m);
+  ref_affine(m, 1.0, in, out); }
+void r_affine_translate_world(const double* in, double* out)
+{
+	double r[9], p[3], s;
+	ref_affine_fixture(in, r, p, &s);
+	for(int i=0; i<3; ++i)
+		p[i] += in[OPERAND_B+i];
+	ref_affine_matrix(r, p, s, out);
+}
+void r_affine_translate_local(const double* in, double* out)
+{
+	double r[9], p[3], s, d[3];
+	ref_affine_fixture(in, r, p, &s);
+	ref_matrix_vector<3>(r, in+OPERAND_B, d);
+	for(int i=0; i<3; ++i)
+		p[i] += d[i];
+	ref_affine_matrix(r, p, s, out);
+}
+template<void (*ROTATION)(double, double*), bool WORLD>
+void r_affine_rotate(const double* in, double* out)
+{
+	double r[9], p[3], s, rotation[9], result[9];
+	ref_affine_fixture(in, r, p, &s);
+	ROTATION(in[OPERAND_C+4], rotation);
+	if(WORLD)
+		ref_matrix_product<3>(rotation, r, result);
+	else
+		ref_matrix_product<3>(r, rotation, result);
+	ref_affine_matrix(result, p, s, out);
+}
+void r_affine_look_at(const double* in, double* out)
+{
+	double r[9], p[3], s;
+	ref_affine_fixture(in, r, p, &s);
+	ref_look_at_rotation(p, in+OPERAND_B, in+OPERAND_B+4, r);
+	ref_affine_matrix(r, p, s, out);
+}
+void r_affine_make_default_axis(const double* in, double* out)
+{
+	double r[9], p[3], s;
+	ref_affine_fixture(in, r, p, &s);
+	ref_identity(3, r);
+	ref_affine_matrix(r, p, s, out);
+}
+void r_affine_make_zero_position(const double* in, double* out)
+{
+	double r[9], p[3], s;
+	ref_affine_fixture(in, r, p, &s);
+	ref_affine_matrix(r, NULL, s, out);
+}
+void r_affine_make_unit_scale(const double* in, double* out)
+{
+	double r[9], p[3], s;
+	ref_affine_fixture(in, r, p, &s);
+	ref_affine_matrix(r, p, 1.0, out);
+}
+void r_affine_set_position(const double* in, double* out)
+{
+	double r[9], p[3], s;
+	ref_affine_fixture(in, r, p, &s);
+	ref_affine_matrix(r, in+OPERAND_B, s, out);
+}
+void r_affine_set_scale(const double* in, double* out)
+{
+	double r[9], p[3], s;
+	ref_affine_fixture(in, r, p, &s);
+	ref_affine_matrix(r, p, in[OPERAND_C+5], out);
+}
+void r_affine_extract(const double* in, double* out)
+{
+	double r[9], p[3], s;
+	ref_affine_fixture(in, r, p, &s);
+	ref_affine_matrix(r, p, s, out);
+}
+void r_affine_extract_inverse(const double* in, double* out)
+{
+	double m[16];
+	r_affine_extract(in, m);
+	ref_inverse<4>(m, out);
+}
+void r_affine_extract_inverse_rs(const double* in, double* out)
+{
+	double m[16];
+	r_affine_make_zero_position(in, m);
+	ref_inverse<4>(m, out);
+}
+void r_affine_equal(const double* in, double* out)
+{ out[0] = in[OPERAND_C+6] != 0.0 || in[OPERAND_C+5] == in[OPERAND_C+3]; }
+void r_affine_not_equal(const double* in, double* out)
+{ r_affine_equal(in, out); out[0] = 1.0 - out[0]; }
+void r_affine_accessors(const double* in, double* out)
+{
+	double r[9], p[3], s;
+	ref_affine_fixture(in, r, p, &s);
+	for(int i=0; i<9; ++i)
+		out[i] = r[i];
+	for(int i=0; i<3; ++i)
+		out[9+i] = p[i];
+	out[12] = s;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Quaternion kernels ((x,y,z,w) in the first operands)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void ref_quaternion_product(const double* a, const double* b, double* out)
+{
+	out[0] = a[3]*b[0] + a[0]*b[3] + a[1]*b[2] - a[2]*b[1];
+	out[1] = a[3]*b[1] - a[0]*b[2] + a[1]*b[3] + a[2]*b[0];
+	out[2] = a[3]*b[2] + a[0]*b[1] - a[1]*b[0] + a[2]*b[3];
+	out[3] = a[3]*b[3] - a[0]*b[0] - a[1]*b[1] - a[2]*b[2];
+}
+
+// rotation matrix of a (not necessarily unit) quaternion
+static void ref_quaternion_matrix(const double* q, double* out)
+{
+	double n[4];
+	ref_normalize(4, q, n);
+	double x = n[0], y = n[1], z = n[2], w = n[3];
+	out[0] = 1.0-2.0*(y*y+z*z); out[1] = 2.0*(x*y+w*z);     out[2] = 2.0*(x*z-w*y);
+	out[3] = 2.0*(x*y-w*z);     out[4] = 1.0-2.0*(x*x+z*z); out[5] = 2.0*(y*z+w*x);
+	out[6] = 2.0*(x*z+w*y);     out[7] = 2.0*(y*z-w*x);     out[8] = 1.0-2.0*(x*x+y*y);
+}
+
+static void ref_quaternion_axis(const double* unitAxis, double a, double* out)
+{
+	for(int i=0; i<3; ++i)
+		out[i] = unitAxis[i] * std::sin(0.5*a);
+	out[3] = std::cos(0.5*a);
+}
+
+// Rx(yaw) * Ry(pitch) * Rz(roll)
+static void ref_quaternion_rotation(double yaw, double pitch, double roll,
+                                    double* out)
+{
+	const double x[3] = {1,0,0}, y[3] = {0,1,0}, z[3] = {0,0,1};
+	double qx[4], qy[4], qz[4], qxy[4];
+	ref_quaternion_axis(x, yaw, qx);
+	ref_quaternion_axis(y, pitch, qy);
+	ref_quaternion_axis(z, roll, qz);
+	ref_quaternion_product(qx, qy, qxy);
+	ref_quaternion_product(qxy, qz, out);
+}
+
+// shortest path interpolations
+static void ref_nlerp(const double* q1, const double* q2, double t, double* out)
+{
+	double d = 0.0;
+	for(int i=0; i<4; ++i)
+		d += q1[i]*q2[i];
+	for(int i=0; i<4; ++i)
+		out[i] = (1.0-t)*q1[i] + (d < 0.0 ? -t : t)*q2[i];
+	ref_normalize(4, out, out);
+}
+
+static void ref_slerp(const double* q1, const double* q2, double t, double* out)
+{
+	double d = 0.0, sign = 1.0;
+	for(int i=0; i<4; ++i)
+		d += q1[i]*q2[i];
+	if(d < 0.0)
+	{
+		d    = -d;
+		sign = -1.0;
+	}
+	double theta = std::acos(std::min(1.0, d));
+	if(theta < 1e-6)
+	{
+		ref_nlerp(q1, q2, t, out);
+		return;
+	}
+	double s1 = std::sin((1.0-t)*theta) / std::sin(theta);
+	double s2 = std::sin(t*theta) / std::sin(theta) * sign;
+	for(int i=0; i<4; ++i)
+		out[i] = s1*q1[i] + s2*q2[i];
+}
+
+template<class M> void k_quaternion_rotation_x(const float* in, float* out)
+{ store(Quaternion::RotationAboutX(in[OPERAND_C]).ExtractRotationMatrix(), out); }
+template<class M> void k_quaternion_rotation_y(const float* in, float* out)
+{ store(Quaternion::RotationAboutY(in[OPERAND_C]).ExtractRotationMatrix(), out); }
+template<class M> void k_quaternion_rotation_z(const float* in, float* out)
+{ store(Quaternion::RotationAboutZ(in[OPERAND_C]).ExtractRotationMatrix(), out); }
+void k_quaternion_rotation(const float* in, float* out)
+{ store(Quaternion::Rotation(in[OPERAND_C],
+                             in[OPERAND_C+1],
+                             in[OPERAND_C+2]).ExtractRotationMatrix(), out); }
+void k_quaternion_rotation_axis(const float* in, float* out)
+{ store(Quaternion::RotationAboutAxis(load_as<Vector3>(in), in[OPERAND_C])
+        .ExtractRotationMatrix(), out); }
+void k_quaternion_vector_rotation(const float* in, float* out)
+{ store(Quaternion::VectorRotation(load_as<Vector3>(in),
+                                   load_as<Vector3>(in+OPERAND_B))
+        .ExtractRotationMatrix(), out); }
+void k_quaternion_rotation_matrix(const float* in, float* out)
+{ Matrix3x3 m = Matrix3x3::Rotation(in[OPERAND_C],
+                                    in[OPERAND_C+1],
+                                    in[OPERAND_C+2]);
+  store(Quaternion::RotationMatrix(m).ExtractRotationMatrix(), out); }
+void k_quaternion_extract(const float* in, float* out)
+{ store(load_as<Quaternion>(in).ExtractRotationMatrix(), out); }
+void k_quaternion_product(const float* in, float* out)
+{ store(load_as<Quaternion>(in) * load_as<Quaternion>(in+OPERAND_B), out); }
+void k_quaternion_product_assign(const float* in, float* out)
+{ Quaternion q = load_as<Quaternion>(in); q *= load_as<Quaternion>(in+OPERAND_B);
+  store(q, out); }
+void k_quaternion_rotate_vector(const float* in, float* out)
+{ store(load_as<Quaternion>(in) * load_as<Vector3>(in+OPERAND_B), out); }
+void k_quaternion_dot(const float* in, float* out)
+{ store(Quaternion::DotProduct(load_as<Quaternion>(in),
+                               load_as<Quaternion>(in+OPERAND_B)), out); }
+void k_quaternion_length(const float* in, float* out)
+{ store(load_as<Quaternion>(in).Length(), out); }
+void k_quaternion_normalize(const float* in, float* out)
+{ store(load_as<Quaternion>(in).Normalize(), out); }
+void k_quaternion_conjugate(const float* in, float* out)
+{ store(load_as<Quaternion>(in).Conjugate(), out); }
+void k_quaternion_inverse(const float* in, float* out)
+{ store(load_as<Quaternion>(in).Inverse(), out); }
+void k_quaternion_nlerp(const float* in, float* out)
+{ store(Quaternion::Nlerp(load_as<Quaternion>(in),
+                          load_as<Quaternion>(in+OPERAND_B),
+                          in[OPERAND_C]), out); }
+void k_quaternion_slerp(const float* in, float* out)
+{ store(Quaternion::Slerp(load_as<Quaternion>(in),
+                          load_as<Quaternion>(in+OPERAND_B),
+                          in[OPERAND_C]), out); }
+
+void r_quaternion_rotation(const double* in, double* out)
+{ double q[4]; ref_quaternion_rotation(in[OPERAND_C], in[OPERAND_C+1],
+                                       in[OPERAND_C+2], q);
+  ref_quaternion_matrix(q, out); }
+void r_quaternion_extract(const double* in, double* out)
+{ ref_quaternion_matrix(in, out); }
+void r_quaternion_product(const double* in, double* out)
+{ ref_quaternion_product(in, in+OPERAND_B, out); }
+void r_quaternion_rotate_vector(const double* in, double* out)
+{ double m[9]; ref_quaternion_matrix(in, m);
+  ref_matrix_vector<3>(m, in+OPERAND_B, out); }
+void r_quaternion_conjugate(const double* in, double* out)
+{ out[0] = -in[0]; out[1] = -in[1]; out[2] = -in[2]; out[3] = in[3]; }
+void r_quaternion_inverse(const double* in, double* out)
+{
+	double lengthSquared = 0.0;
+	r_quaternion_conjugate(in, out);
+	for(int i=0; i<4; ++i)
+		lengthSquared += in[i]*in[i];
+	for(int i=0; i<4; ++i)
+		out[i] /= lengthSquared;
+}
+void r_quaternion_nlerp(const double* in, double* out)
+{ ref_nlerp(in, in+OPERAND_B, in[OPERAND_C], out); }
+void r_quaternion_slerp(const double* in, double* out)
+{ ref_slerp(in, in+OPERAND_B, in[OPERAND_C], out); }
+
+// Affine transformations in quaternion mode
+inline Affine affine_quaternion_fixture(const float* in)
+{
+	Affine affine = affine_fixture(in);
+	affine.SetRotationMode(Affine::ROTATION_MODE_QUATERNION);
+	return affine;
+}
+
+void k_affine_quaternion_rotate_world_x(const float* in, float* out)
+{ Affine a = affine_quaternion_fixture(in); a.RotateAboutWorldX(in[OPERAND_C+4]);
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_quaternion_rotate_local_y(const float* in, float* out)
+{ Affine a = affine_quaternion_fixture(in); a.RotateAboutLocalY(in[OPERAND_C+4]);
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_quaternion_translate_local(const float* in, float* out)
+{ Affine a = affine_quaternion_fixture(in);
+  a.TranslateLocal(load_as<Vector3>(in+OPERAND_B));
+  store(a.ExtractTransformMatrix(), out); }
+void k_affine_quaternion_extract(const float* in, float* out)
+{ store(affine_quaternion_fixture(in).ExtractTransformMatrix(), out); }
+void k_affine_quaternion_extract_inverse(const float* in, float* out)
+{ store(affine_quaternion_fixture(in).ExtractInverseTransformMatrix(), out); }
+void k_affine_quaternion_rotation(const float* in, float* out)
+{ store(Affine::Rotation(Quaternion::Rotation(in[OPERAND_C],
+                                              in[OPERAND_C+1],
+                                              in[OPERAND_C+2]))
+        .ExtractTransformMatrix(), out); }
+template<bool SLERP> void k_affine_interpolate(const float* in, float* out)
+{
+	Affine to = Affine::RotationAboutAxis(load_as<Vector3>(in+OPERAND_B+4),
+	                                      in[OPERAND_C+4]);
+	to.SetPosition(load_as<Vector3>(in+OPERAND_B));
+	to.SetScale(in[OPERAND_C+5]);
+	if(SLERP)
+		store(Affine::Slerp(affine_fixture(in), to, in[OPERAND_C+7])
+		      .ExtractTransformMatrix(), out);
+	else
+		store(Affine::Nlerp(affine_fixture(in), to, in[OPERAND_C+7])
+		      .ExtractTransformMatrix(), out);
+}
+
+template<bool SLERP> void r_affine_interpolate(const double* in, double* out)
+{
+	double from[4], to[4], q[4], m[9], p[3];
+	double t = in[OPERAND_C+7];
+	ref_quaternion_rotation(in[OPERAND_C], in[OPERAND_C+1], in[OPERAND_C+2],
+	                        from);
+	ref_quaternion_axis(in+OPERAND_B+4, in[OPERAND_C+4], to);
+	if(SLERP)
+		ref_slerp(from, to, t, q);
+	else
+		ref_nlerp(from, to, t, q);
+	ref_quaternion_matrix(q, m);
+	for(int i=0; i<3; ++i)
+		p[i] = in[i] + t*(in[OPERAND_B+i] - in[i]);
+	ref_affine(m, in[OPERAND_C+3] + t*(in[OPERAND_C+5] - in[OPERAND_C+3]),
+	           p, out);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Projection kernels (parameters are generated by gen_projection)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+inline Projection frustum_fixture(const float* in)
+{ const float* p = in+OPERAND_C;
+  return Projection::Frustum(p[0], p[1], p[2], p[3], p[4], p[5]); }
+
+inline void store(const Projection& p, float* out)
+{
+	out[0] = p.GetLeft();   out[1] = p.GetRight();
+	out[2] = p.GetBottom(); out[3] = p.GetTop();
+	out[4] = p.GetNear();   out[5] = p.GetFar();
+}
+
+void k_projection_frustum(const float* in, float* out)
+{ store(frustum_fixture(in).ExtractTransformMatrix(), out); }
+void k_projection_orthographic(const float* in, float* out)
+{ const float* p = in+OPERAND_C;
+  store(Projection::Orthographic(p[0], p[1], p[2], p[3], p[4], p[5])
+        .ExtractTransformMatrix(), out); }
+void k_projection_perspective(const float* in, float* out)
+{ const float* p = in+OPERAND_C;
+  store(Projection::Perspective(p[6], p[7], p[4], p[5])
+        .ExtractTransformMatrix(), out); }
+void k_projection_extract_inverse(const float* in, float* out)
+{ store(frustum_fixture(in).ExtractInverseTransformMatrix(), out); }
+void k_projection_extract_inverse_ortho(const float* in, float* out)
+{ const float* p = in+OPERAND_C;
+  store(Projection::Orthographic(p[0], p[1], p[2], p[3], p[4], p[5])
+        .ExtractInverseTransformMatrix(), out); }
+void k_projection_fit_height(const float* in, float* out)
+{ Projection p = frustum_fixture(in); p.FitHeightToAspect(in[OPERAND_C+8]);
+  store(p, out); }
+void k_projection_fit_width(const float* in, float* out)
+{ Projection p = frustum_fixture(in); p.FitWidthToAspect(in[OPERAND_C+8]);
+  store(p, out); }
+void k_projection_queries(const float* in, float* out)
+{ Projection p = frustum_fixture(in);
+  out[0] = p.Width(); out[1] = p.Height(); out[2] = p.Depth();
+  out[3] = p.Aspect(); out[4] = p.IsPerspective();
+  out[5] = p.IsOrthographic(); }
+void k_projection_mutators(const float* in, float* out)
+{ Projection p = frustum_fixture(in);
+  const float* q = in+OPERAND_B;
+  p.SetFar(q[5]); p.SetNear(q[4]); p.SetLeft(q[0]); p.SetRight(q[1]);
+  p.SetBottom(q[2]); p.SetTop(q[3]); p.SetType(Projection::PROJECTION_TYPE_ORTHOGRAPHIC);
+  store(p.ExtractTransformMatrix(), out); }
+
+void r_projection_extract_inverse(const double* in, double* out)
+{ double m[16]; r_frustum(in, m); ref_inverse<4>(m, out); }
+void r_projection_extract_inverse_ortho(const double* in, double* out)
+{ double m[16]; r_ortho(in, m); ref_inverse<4>(m, out); }
+void r_projection_fit_height(const double* in, double* out)
+{
+	const double* p = in+OPERAND_C;
+	double factor = ((p[1]-p[0]) / (p[3]-p[2])) / p[8];
+	out[0] = p[0];        out[1] = p[1];
+	out[2] = p[2]*factor; out[3] = p[3]*factor;
+	out[4] = p[4];        out[5] = p[5];
+}
+void r_projection_fit_width(const double* in, double* out)
+{
+	const double* p = in+OPERAND_C;
+	double factor = p[8] / ((p[1]-p[0]) / (p[3]-p[2]));
+	out[0] = p[0]*factor; out[1] = p[1]*factor;
+	out[2] = p[2];        out[3] = p[3];
+	out[4] = p[4];        out[5] = p[5];
+}
+void r_projection_queries(const double* in, double* out)
+{
+	const double* p = in+OPERAND_C;
+	out[0] = p[1]-p[0]; out[1] = p[3]-p[2]; out[2] = p[5]-p[4];
+	out[3] = out[0]/out[1]; out[4] = 1.0; out[5] = 0.0;
+}
+void r_projection_mutators(const double* in, double* out)
+{ const double* q = in+OPERAND_B; ref_ortho(q[0], q[1], q[2], q[3], q[4], q[5], out); }
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Operation table
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef void (*Generator)(bench::Random&, float*);
+typedef void (*Kernel)(const float*, float*);
+typedef void (*Reference)(const double*, double*);
+typedef double (*Timing)(const float*, float*, int);
+
+// Times a kernel over all samples (the kernel is inlined in the loop)
+template<Kernel KERNEL>
+double time_kernel(const float* inputs, float* outputs, int repeatCnt)
+{
+	double start = bench::get_time();
+	for(int r=0; r<repeatCnt; ++r)
+	{
+		for(int i=0; i<SAMPLE_COUNT; ++i)
+			KERNEL(inputs + i*INPUT_SIZE, outputs + i*OUTPUT_SIZE);
+		bench::clobber_memory();
+	}
+	return (bench::get_time() - start) * 1e9
+	       / (double(repeatCnt) * SAMPLE_COUNT);
+}
+
+// Magnitude at which ulps are taken: largest result, or product of the
+// largest components of the two operands (for sums that may cancel)
+enum Scale
+{
+	SCALE_RESULT = 0,
+	SCALE_OPERANDS
+};
+
+struct Operation
+{
+	const char* name;
+	Generator   generate;
+	Kernel      kernel;
+	Timing      time;
+	Reference   reference;
+	int         outputCnt;
+	double      ulpBound;
+	Scale       scale;
+};
+
+#define OPERATION(name, generator, kernel, reference, outputs, ulps) \
+	{name, generator, &kernel, &time_kernel< &kernel >, reference, outputs, \
+	 ulps, SCALE_RESULT}
+#define OPERATION_OPERANDS(name, generator, kernel, reference, outputs, ulps) \
+	{name, generator, &kernel, &time_kernel< &kernel >, reference, outputs, \
+	 ulps, SCALE_OPERANDS}
+
+// Operations common to vectors and matrices
+#define COMMON_OPERATIONS(T, N) \
+	OPERATION(#T "::operator+",    gen_signed,  k_add<T>, r_add<N>, N, ULP_ROUNDED), \
+	OPERATION(#T "::operator-",    gen_signed,  k_sub<T>, r_sub<N>, N, ULP_ROUNDED), \
+	OPERATION(#T "::operator+()",  gen_signed,  k_pos<T>, r_pos<N>, N, ULP_EXACT), \
+	OPERATION(#T "::operator-()",  gen_signed,  k_neg<T>, r_neg<N>, N, ULP_EXACT), \
+	OPERATION(#T "::operator==",   gen_equal<N>, k_equal<T>, r_equal<N>, 1, ULP_EXACT), \
+	OPERATION(#T "::operator!=",   gen_equal<N>, k_not_equal<T>, r_not_equal<N>, 1, ULP_EXACT), \
+	OPERATION(#T "::operator+=",   gen_signed,  k_add_assign<T>, r_add<N>, N, ULP_ROUNDED), \
+	OPERATION(#T "::operator-=",   gen_signed,  k_sub_assign<T>, r_sub<N>, N, ULP_ROUNDED), \
+	OPERATION("operator*(float," #T ")", gen_signed, k_scalar_mul<T>, r_scalar_mul<N>, N, ULP_ROUNDED), \
+	OPERATION(#T "::CompMult",     gen_signed,  k_comp_mult<T>, r_comp_mult<N>, N, ULP_ROUNDED), \
+	OPERATION(#T "::CompDiv",      gen_positive, k_comp_div<T>, r_comp_div<N>, N, ULP_ROUNDED), \
+	OPERATION(#T "::CompPow",      gen_pow,     k_comp_pow<T>, r_comp_pow<N>, N, ULP_LIBM), \
+	OPERATION(#T "::CompMin",      gen_signed,  k_comp_min<T>, r_comp_min<N>, N, ULP_EXACT), \
+	OPERATION(#T "::CompMax",      gen_signed,  k_comp_max<T>, r_comp_max<N>, N, ULP_EXACT), \
+	OPERATION(#T "::CompClamp",    gen_signed,  k_comp_clamp<T>, r_comp_clamp<N>, N, ULP_EXACT), \
+	OPERATION(#T "::Sign",         gen_signed,  k_sign<T>,  r_sign<N>,  N, ULP_EXACT), \
+	OPERATION(#T "::Abs",          gen_signed,  k_abs<T>,   r_abs<N>,   N, ULP_EXACT), \
+	OPERATION(#T "::Sqr",          gen_signed,  k_sqr<T>,   r_sqr<N>,   N, ULP_ROUNDED), \
+	OPERATION(#T "::Sqrt",         gen_positive, k_sqrt<T>, r_sqrt<N>,  N, ULP_ROUNDED), \
+	OPERATION(#T "::Exp",          gen_signed,  k_exp<T>,   r_exp<N>,   N, ULP_LIBM), \
+	OPERATION(#T "::Log",          gen_positive, k_log<T>,  r_log<N>,   N, ULP_LIBM), \
+	OPERATION(#T "::Log10",        gen_positive, k_log10<T>, r_log10<N>, N, ULP_LIBM), \
+	OPERATION(#T "::Ceil",         gen_wide,    k_ceil<T>,  r_ceil<N>,  N, ULP_EXACT), \
+	OPERATION(#T "::Floor",        gen_wide,    k_floor<T>, r_floor<N>, N, ULP_EXACT), \
+	OPERATION(#T "::Frac",         gen_wide,    k_frac<T>,  r_frac<N>,  N, ULP_ROUNDED)
+
+// Vector operations
+#define VECTOR_OPERATIONS(V, N) \
+	COMMON_OPERATIONS(V, N), \
+	OPERATION(#V "::operator*",    gen_signed,  k_mul_scalar<V>, r_scalar_mul<N>, N, ULP_ROUNDED), \
+	OPERATION(#V "::operator/",    gen_signed,  k_div_scalar<V>, r_div_scalar<N>, N, ULP_ROUNDED), \
+	OPERATION(#V "::operator*=",   gen_signed,  k_mul_assign_scalar<V>, r_scalar_mul<N>, N, ULP_ROUNDED), \
+	OPERATION(#V "::operator/=",   gen_signed,  k_div_assign_scalar<V>, r_div_scalar<N>, N, ULP_ROUNDED), \
+	OPERATION_OPERANDS(#V "::DotProduct",   gen_signed,  k_dot<V>, r_dot<N>, 1, ULP_SUM), \
+	OPERATION(#V "::Length",       gen_signed,  k_length<V>, r_length_a<N>, 1, ULP_SUM), \
+	OPERATION(#V "::LengthSquared", gen_signed, k_length_squared<V>, r_length_squared<N>, 1, ULP_SUM), \
+	OPERATION(#V "::Normalize",    gen_signed,  k_normalize<V>, r_normalize<N>, N, ULP_SUM)
+
+// Matrix operations
+#define MATRIX_OPERATIONS(M, D) \
+	COMMON_OPERATIONS(M, D*D), \
+	OPERATION_OPERANDS(#M "::operator*(" #M ")", gen_signed, k_matrix_product<M>, r_matrix_product<D>, D*D, ULP_SUM), \
+	OPERATION_OPERANDS(#M "::operator*=",   gen_signed,  k_matrix_product_assign<M>, r_matrix_product<D>, D*D, ULP_SUM), \
+	OPERATION_OPERANDS(#M "::operator*(Vector)", gen_signed, k_matrix_vector<M>, r_matrix_vector<D>, D, ULP_SUM), \
+	OPERATION(#M "::OuterProduct", gen_signed,  k_outer_product<M>, r_outer_product<D>, D*D, ULP_ROUNDED), \
+	OPERATION(#M "::IsInvertible", (gen_invertible<D, true>), k_is_invertible<M>, r_is_invertible<D>, 1, ULP_EXACT), \
+	OPERATION(#M "::Determinant",  (gen_invertible<D, false>), k_determinant<M>, r_determinant<D>, 1, ULP_COMPOSITE), \
+	OPERATION(#M "::Inverse",      (gen_invertible<D, false>), k_inverse<M>, r_inverse<D>, D*D, ULP_INVERSE), \
+	OPERATION(#M "::Transpose",    gen_signed,  k_transpose<M>, r_transpose<D>, D*D, ULP_EXACT), \
+	OPERATION(#M "::Adjugate",     (gen_invertible<D, false>), k_adjugate<M>, r_adjugate<D>, D*D, ULP_INVERSE), \
+	OPERATION(#M "::Diagonal",     gen_signed,  k_diagonal##D, r_diagonal<D>, D*D, ULP_EXACT)
+
+// Rotation factories (3x3 and 4x4)
+#define ROTATION_OPERATIONS(M, D) \
+	OPERATION(#M "::RotationAboutX", gen_signed, k_rotation_x<M>, r_rotation_x<D>, D*D, ULP_TRIGONOMETRY), \
+	OPERATION(#M "::RotationAboutY", gen_signed, k_rotation_y<M>, r_rotation_y<D>, D*D, ULP_TRIGONOMETRY), \
+	OPERATION(#M "::RotationAboutZ", gen_signed, k_rotation_z<M>, r_rotation_z<D>, D*D, ULP_TRIGONOMETRY), \
+	OPERATION(#M "::Rotation",       gen_signed, k_rotation<M>,   r_rotation<D>,   D*D, ULP_TRIGONOMETRY), \
+	OPERATION(#M "::RotationAboutAxis", gen_unit<3>, k_rotation_axis<M>, r_rotation_axis<D>, D*D, ULP_TRIGONOMETRY), \
+	OPERATION(#M "::VectorRotation", gen_unit_pair, k_vector_rotation<M>, r_vector_rotation<D>, D*D, ULP_COMPOSITE), \
+	OPERATION(#M "::LookAtRotation", gen_look_at, k_look_at_rotation<M>, r_look_at_rotation<D>, D*D, ULP_COMPOSITE)
+
+static const Operation sOperations[] =
+{
+	VECTOR_OPERATIONS(Vector2, 2),
+	OPERATION_OPERANDS("Vector2::Reflect", gen_unit<2>, k_reflect<Vector2>, r_reflect<2>, 2, ULP_SUM),
+	OPERATION_OPERANDS("Vector2::Refract", gen_unit<2>, k_refract<Vector2>, r_refract<2>, 2, ULP_COMPOSITE),
+	VECTOR_OPERATIONS(Vector3, 3),
+	OPERATION_OPERANDS("Vector3::Reflect", gen_unit<3>, k_reflect<Vector3>, r_reflect<3>, 3, ULP_SUM),
+	OPERATION_OPERANDS("Vector3::Refract", gen_unit<3>, k_refract<Vector3>, r_refract<3>, 3, ULP_COMPOSITE),
+	OPERATION_OPERANDS("Vector3::CrossProduct", gen_signed, k_cross, r_cross, 3, ULP_SUM),
+	VECTOR_OPERATIONS(Vector4, 4),
+
+	MATRIX_OPERATIONS(Matrix2x2, 2),
+	OPERATION("Matrix2x2::Scale",    gen_signed, k_scale2, r_diagonal<2>, 4, ULP_EXACT),
+	OPERATION("Matrix2x2::Rotation", gen_signed, k_rotation2, r_rotation2, 4, ULP_TRIGONOMETRY),
+
+	MATRIX_OPERATIONS(Matrix3x3, 3),
+	ROTATION_OPERATIONS(Matrix3x3, 3),
+	OPERATION("Matrix3x3::Scale",    gen_signed, k_scale3, r_diagonal<3>, 9, ULP_EXACT),
+
+	MATRIX_OPERATIONS(Matrix4x4, 4),
+	ROTATION_OPERATIONS(Matrix4x4, 4),
+	OPERATION("Matrix4x4::Scale",       gen_signed,     k_scale4,      r_scale4,      16, ULP_EXACT),
+	OPERATION("Matrix4x4::Translation", gen_signed,     k_translation, r_translation, 16, ULP_EXACT),
+	OPERATION("Matrix4x4::LookAt",      gen_look_at,    k_look_at,     r_look_at,     16, ULP_COMPOSITE),
+	OPERATION("Matrix4x4::Ortho",       gen_projection, k_ortho,       r_ortho,       16, ULP_SUM),
+	OPERATION("Matrix4x4::Frustum",     gen_projection, k_frustum,     r_frustum,     16, ULP_SUM),
+	OPERATION("Matrix4x4::Perspective", gen_projection, k_perspective, r_perspective, 16, ULP_TRIGONOMETRY),
+
+	OPERATION("Affine::Translation",       gen_affine, k_affine_translation,     r_affine_translation,     16, ULP_EXACT),
+	OPERATION("Affine::RotationAboutX",    gen_affine, k_affine_rotation_x,      r_affine_rotation_x,      16, ULP_TRIGONOMETRY),
+	OPERATION("Affine::RotationAboutY",    gen_affine, k_affine_rotation_y,      r_affine_rotation_y,      16, ULP_TRIGONOMETRY),
+	OPERATION("Affine::RotationAboutZ",    gen_affine, k_affine_rotation_z,      r_affine_rotation_z,      16, ULP_TRIGONOMETRY),
+	OPERATION("Affine::RotationAboutAxis", gen_affine, k_affine_rotation_axis,   r_affine_rotation_axis,   16, ULP_TRIGONOMETRY),
+	OPERATION("Affine::Rotation",          gen_affine, k_affine_rotation,        r_affine_rotation,        16, ULP_TRIGONOMETRY),
+	OPERATION("Affine::Scale",             gen_affine, k_affine_scale,           r_affine_scale,           16, ULP_EXACT),
+	OPERATION("Affine::LookAt (factory)",  gen_affine, k_affine_look_at_factory, r_affine_look_at_factory, 16, ULP_COMPOSITE),
+	OPERATION("Affine::TranslateWorld",    gen_affine, k_affine_translate_world, r_affine_translate_world, 16, ULP_COMPOSITE),
+	OPERATION("Affine::TranslateLocal",    gen_affine, k_affine_translate_local, r_affine_translate_local, 16, ULP_COMPOSITE),
+	OPERATION("Affine::RotateAboutWorldX", gen_affine, k_affine_rotate_world_x, (r_affine_rotate<ref_rotation_x, true>),  16, ULP_COMPOSITE),
+	OPERATION("Affine::RotateAboutWorldY", gen_affine, k_affine_rotate_world_y, (r_affine_rotate<ref_rotation_y, true>),  16, ULP_COMPOSITE),
+	OPERATION("Affine::RotateAboutWorldZ", gen_affine, k_affine_rotate_world_z, (r_affine_rotate<ref_rotation_z, true>),  16, ULP_COMPOSITE),
+	OPERATION("Affine::RotateAboutLocalX", gen_affine, k_affine_rotate_local_x, (r_affine_rotate<ref_rotation_x, false>), 16, ULP_COMPOSITE),
+	OPERATION("Affine::RotateAboutLocalY", gen_affine, k_affine_rotate_local_y, (r_affine_rotate<ref_rotation_y, false>), 16, ULP_COMPOSITE),
+	OPERATION("Affine::RotateAboutLocalZ", gen_affine, k_affine_rotate_local_z, (r_affine_rotate<ref_rotation_z, false>), 16, ULP_COMPOSITE),
+	OPERATION("Affine::LookAt",            gen_affine, k_affine_look_at,           r_affine_look_at,           16, ULP_COMPOSITE),
+	OPERATION("Affine::MakeDefaultAxis",   gen_affine, k_affine_make_default_axis, r_affine_make_default_axis, 16, ULP_COMPOSITE),
+	OPERATION("Affine::MakeZeroPosition",  gen_affine, k_affine_make_zero_position, r_affine_make_zero_position, 16, ULP_COMPOSITE),
+	OPERATION("Affine::MakeUnitScale",     gen_affine, k_affine_make_unit_scale,   r_affine_make_unit_scale,   16, ULP_COMPOSITE),
+	OPERATION("Affine::SetPosition",       gen_affine, k_affine_set_position,      r_affine_set_position,      16, ULP_COMPOSITE),
+	OPERATION("Affine::SetScale",          gen_affine, k_affine_set_scale,         r_affine_set_scale,         16, ULP_COMPOSITE),
+	OPERATION("Affine::ExtractTransformMatrix", gen_affine, k_affine_extract,      r_affine_extract,           16, ULP_COMPOSITE),
+	OPERATION("Affine::ExtractInverseTransformMatrix", gen_affine, k_affine_extract_inverse, r_affine_extract_inverse, 16, ULP_INVERSE),
+	OPERATION("Affine::ExtractInverseTransformMatrix (rotation/scale)", gen_affine, k_affine_extract_inverse_rs, r_affine_extract_inverse_rs, 16, ULP_COMPOSITE),
+	OPERATION("Affine::operator==",        gen_affine, k_affine_equal,     r_affine_equal,     1,  ULP_EXACT),
+	OPERATION("Affine::operator!=",        gen_affine, k_affine_not_equal, r_affine_not_equal, 1,  ULP_EXACT),
+	OPERATION("Affine::Accessors",         gen_affine, k_affine_accessors, r_affine_accessors, 13, ULP_COMPOSITE),
+
+	OPERATION("Projection::Frustum",      gen_projection, k_projection_frustum,      r_frustum,     16, ULP_SUM),
+	OPERATION("Projection::Orthographic", gen_projection, k_projection_orthographic, r_ortho,       16, ULP_SUM),
+	OPERATION("Projection::Perspective",  gen_projection, k_projection_perspective,  r_perspective, 16, ULP_TRIGONOMETRY),
+	OPERATION("Projection::ExtractInverseTransformMatrix", gen_projection, k_projection_extract_inverse, r_projection_extract_inverse, 16, ULP_INVERSE),
+	OPERATION("Projection::ExtractInverseTransformMatrix (orthographic)", gen_projection, k_projection_extract_inverse_ortho, r_projection_extract_inverse_ortho, 16, ULP_INVERSE),
+	OPERATION("Projection::FitHeightToAspect", gen_projection, k_projection_fit_height, r_projection_fit_height, 6, ULP_SUM),
+	OPERATION("Projection::FitWidthToAspect",  gen_projection, k_projection_fit_width,  r_projection_fit_width,  6, ULP_SUM),
+	OPERATION("Projection::Queries",      gen_projection, k_projection_queries,      r_projection_queries,  6, ULP_SUM),
+	OPERATION("Projection::Mutators",     gen_projection, k_projection_mutators,     r_projection_mutators, 16, ULP_SUM),
+
+	OPERATION("Quaternion::operator+",    gen_signed, k_add<Quaternion>, r_add<4>, 4, ULP_ROUNDED),
+	OPERATION("Quaternion::operator-",    gen_signed, k_sub<Quaternion>, r_sub<4>, 4, ULP_ROUNDED),
+	OPERATION("Quaternion::operator+()",  gen_signed, k_pos<Quaternion>, r_pos<4>, 4, ULP_EXACT),
+	OPERATION("Quaternion::operator-()",  gen_signed, k_neg<Quaternion>, r_neg<4>, 4, ULP_EXACT),
+	OPERATION("Quaternion::operator==",   gen_equal<4>, k_equal<Quaternion>, r_equal<4>, 1, ULP_EXACT),
+	OPERATION("Quaternion::operator!=",   gen_equal<4>, k_not_equal<Quaternion>, r_not_equal<4>, 1, ULP_EXACT),
+	OPERATION("Quaternion::operator+=",   gen_signed, k_add_assign<Quaternion>, r_add<4>, 4, ULP_ROUNDED),
+	OPERATION("Quaternion::operator-=",   gen_signed, k_sub_assign<Quaternion>, r_sub<4>, 4, ULP_ROUNDED),
+	OPERATION("Quaternion::operator*(float)", gen_signed, k_mul_scalar<Quaternion>, r_scalar_mul<4>, 4, ULP_ROUNDED),
+	OPERATION("Quaternion::operator*=(float)", gen_signed, k_mul_assign_scalar<Quaternion>, r_scalar_mul<4>, 4, ULP_ROUNDED),
+	OPERATION("operator*(float,Quaternion)", gen_signed, k_scalar_mul<Quaternion>, r_scalar_mul<4>, 4, ULP_ROUNDED),
+	OPERATION_OPERANDS("Quaternion::operator*(Quaternion)", gen_signed, k_quaternion_product, r_quaternion_product, 4, ULP_SUM),
+	OPERATION_OPERANDS("Quaternion::operator*=", gen_signed, k_quaternion_product_assign, r_quaternion_product, 4, ULP_SUM),
+	OPERATION_OPERANDS("Quaternion::operator*(Vector3)", gen_quaternions, k_quaternion_rotate_vector, r_quaternion_rotate_vector, 3, ULP_COMPOSITE),
+	OPERATION_OPERANDS("Quaternion::DotProduct", gen_signed, k_quaternion_dot, r_dot<4>, 1, ULP_SUM),
+	OPERATION("Quaternion::Length",       gen_signed, k_quaternion_length,    r_length_a<4>,  1, ULP_SUM),
+	OPERATION("Quaternion::Normalize",    gen_signed, k_quaternion_normalize, r_normalize<4>, 4, ULP_SUM),
+	OPERATION("Quaternion::Conjugate",    gen_signed, k_quaternion_conjugate, r_quaternion_conjugate, 4, ULP_EXACT),
+	OPERATION("Quaternion::Inverse",      gen_signed, k_quaternion_inverse,   r_quaternion_inverse,   4, ULP_SUM),
+	OPERATION("Quaternion::ExtractRotationMatrix", gen_quaternions, k_quaternion_extract, r_quaternion_extract, 9, ULP_SUM),
+	OPERATION("Quaternion::RotationAboutX", gen_signed, k_quaternion_rotation_x<Matrix3x3>, r_rotation_x<3>, 9, ULP_TRIGONOMETRY),
+	OPERATION("Quaternion::RotationAboutY", gen_signed, k_quaternion_rotation_y<Matrix3x3>, r_rotation_y<3>, 9, ULP_TRIGONOMETRY),
+	OPERATION("Quaternion::RotationAboutZ", gen_signed, k_quaternion_rotation_z<Matrix3x3>, r_rotation_z<3>, 9, ULP_TRIGONOMETRY),
+	OPERATION("Quaternion::Rotation",     gen_signed,    k_quaternion_rotation,        r_quaternion_rotation, 9, ULP_TRIGONOMETRY),
+	OPERATION("Quaternion::RotationAboutAxis", gen_unit<3>, k_quaternion_rotation_axis, r_rotation_axis<3>, 9, ULP_TRIGONOMETRY),
+	OPERATION("Quaternion::VectorRotation", gen_unit_pair, k_quaternion_vector_rotation, r_vector_rotation<3>, 9, ULP_COMPOSITE),
+	OPERATION("Quaternion::RotationMatrix", gen_signed,  k_quaternion_rotation_matrix, r_quaternion_rotation, 9, ULP_COMPOSITE),
+	OPERATION("Quaternion::Nlerp",        gen_quaternions, k_quaternion_nlerp, r_quaternion_nlerp, 4, ULP_SUM),
+	OPERATION("Quaternion::Slerp",        gen_quaternions, k_quaternion_slerp, r_quaternion_slerp, 4, ULP_COMPOSITE),
+
+	OPERATION("Affine::Rotation(Quaternion)", gen_affine, k_affine_quaternion_rotation, r_affine_rotation, 16, ULP_TRIGONOMETRY),
+	OPERATION("Affine::RotateAboutWorldX (quaternion)", gen_affine, k_affine_quaternion_rotate_world_x, (r_affine_rotate<ref_rotation_x, true>),  16, ULP_COMPOSITE),
+	OPERATION("Affine::RotateAboutLocalY (quaternion)", gen_affine, k_affine_quaternion_rotate_local_y, (r_affine_rotate<ref_rotation_y, false>), 16, ULP_COMPOSITE),
+	OPERATION("Affine::TranslateLocal (quaternion)", gen_affine, k_affine_quaternion_translate_local, r_affine_translate_local, 16, ULP_COMPOSITE),
+	OPERATION("Affine::ExtractTransformMatrix (quaternion)", gen_affine, k_affine_quaternion_extract, r_affine_extract, 16, ULP_COMPOSITE),
+	OPERATION("Affine::ExtractInverseTransformMatrix (quaternion)", gen_affine, k_affine_quaternion_extract_inverse, r_affine_extract_inverse, 16, ULP_INVERSE),
+	OPERATION("Affine::Nlerp", gen_affine, k_affine_interpolate<false>, r_affine_interpolate<false>, 16, ULP_COMPOSITE),
+	OPERATION("Affine::Slerp", gen_affine, k_affine_interpolate<true>,  r_affine_interpolate<true>,  16, ULP_COMPOSITE)
+};
+
+static const int OPERATION_COUNT = sizeof(sOperations) / sizeof(Operation);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Results
+//
+////////////////////////////////////////////////////////////////////////////////
+
+struct Result
+{
+	const Operation*   operation;
+	double             nsPerOp;
+	double             maxUlp;
+	double             meanUlp;
+	bool               passed;
+	std::vector<float> outputs;  // outputs of the first samples
+	// comparison with a baseline
+	bool               hasBaseline;
+	double             baselineNsPerOp;
+	double             baselineMaxUlp; // max error against baseline outputs
+	bool               matchesBaseline;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Largest absolute value of an array
+template<typename T> double max_magnitude(const T* values, int count)
+{
+	double m = 0.0;
+	for(int i=0; i<count; ++i)
+		if(std::abs(double(values[i])) > m)
+			m = std::abs(double(values[i]));
+	return m;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Run an operation
+static Result run_operation(const Operation& op, int repeatCnt)
+{
+	Result result;
+	std::vector<float>  inputs(SAMPLE_COUNT*INPUT_SIZE);
+	std::vector<float>  outputs(SAMPLE_COUNT*OUTPUT_SIZE, 0.0f);
+	std::vector<double> timings(TIMING_TRIAL_COUNT);
+	double dinputs[INPUT_SIZE], reference[OUTPUT_SIZE];
+
+	// generate inputs (same seed for every run)
+	bench::Random random;
+	for(int i=0; i<SAMPLE_COUNT; ++i)
+		op.generate(random, &inputs[i*INPUT_SIZE]);
+
+	// accuracy
+	result.operation = &op;
+	result.maxUlp    = 0.0;
+	result.meanUlp   = 0.0;
+	for(int i=0; i<SAMPLE_COUNT; ++i)
+	{
+		const float* in = &inputs[i*INPUT_SIZE];
+		float* out      = &outputs[i*OUTPUT_SIZE];
+		for(int j=0; j<INPUT_SIZE; ++j)
+			dinputs[j] = in[j];
+		op.kernel(in, out);
+		op.reference(dinputs, reference);
+
+		double scale = max_magnitude(reference, op.outputCnt);
+		if(op.scale == SCALE_OPERANDS)
+			scale = std::max(scale, max_magnitude(in+OPERAND_A, OPERAND_B)
+			                      * max_magnitude(in+OPERAND_B, OPERAND_B));
+		for(int j=0; j<op.outputCnt; ++j)
+		{
+			double error = bench::ulp_error(out[j], reference[j], scale);
+			result.maxUlp   = std::max(result.maxUlp, error);
+			result.meanUlp += error;
+		}
+	}
+	result.meanUlp /= double(SAMPLE_COUNT * op.outputCnt);
+	result.passed   = result.maxUlp <= op.ulpBound;
+
+	// save the first outputs
+	for(int i=0; i<CHECK_SAMPLE_COUNT; ++i)
+		for(int j=0; j<op.outputCnt; ++j)
+			result.outputs.push_back(outputs[i*OUTPUT_SIZE+j]);
+
+	// timings
+	for(int i=0; i<TIMING_TRIAL_COUNT; ++i)
+		timings[i] = op.time(&inputs[0], &outputs[0], repeatCnt);
+	result.nsPerOp = bench::median(timings);
+
+	result.hasBaseline     = false;
+	result.baselineNsPerOp = 0.0;
+	result.baselineMaxUlp  = 0.0;
+	result.matchesBaseline = true;
+	return result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compare with a baseline
+static void compare(Result& result, const bench::JsonValue& baseline)
+{
+	const Operation& op = *result.operation;
+	for(size_t i=0; i<baseline.Size(); ++i)
+	{
+		const bench::JsonValue& entry = baseline[i];
+		if(entry["name"].AsString() != op.name)
+			continue;
+
+		const bench::JsonValue& outputs = entry["outputs"];
+		result.hasBaseline     = true;
+		result.baselineNsPerOp = entry["nsPerOp"].AsNumber();
+		result.matchesBaseline = outputs.Size() == result.outputs.size();
+		if(!result.matchesBaseline)
+			return;
+
+		for(int s=0; s<CHECK_SAMPLE_COUNT; ++s)
+		{
+			std::vector<double> expected(op.outputCnt);
+			for(int j=0; j<op.outputCnt; ++j)
+				expected[j] = outputs[s*op.outputCnt+j].AsNumber();
+			double scale = max_magnitude(&expected[0], op.outputCnt);
+			for(int j=0; j<op.outputCnt; ++j)
+			{
+				double error = bench::ulp_error(result.outputs[s*op.outputCnt+j],
+				                                expected[j],
+				                                scale);
+				result.baselineMaxUlp = std::max(result.baselineMaxUlp, error);
+			}
+		}
+		result.matchesBaseline = result.baselineMaxUlp <= op.ulpBound;
+		return;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Batched rotation updates (per instance orientation updates)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef void (*BatchUpdate)(std::vector<Affine>& affines,
+                            const std::vector<float>& radians,
+                            std::vector<Matrix4x4>& matrices);
+
+void b_rotate_local(std::vector<Affine>& affines,
+                    const std::vector<float>& radians,
+                    std::vector<Matrix4x4>&)
+{
+	for(size_t i=0; i<affines.size(); ++i)
+		affines[i].RotateAboutLocalY(radians[i]);
+}
+
+void b_rotate_world_local(std::vector<Affine>& affines,
+                          const std::vector<float>& radians,
+                          std::vector<Matrix4x4>&)
+{
+	for(size_t i=0; i<affines.size(); ++i)
+	{
+		affines[i].RotateAboutWorldX(radians[i]);
+		affines[i].RotateAboutLocalZ(radians[i]);
+	}
+}
+
+void b_rotate_extract(std::vector<Affine>& affines,
+                      const std::vector<float>& radians,
+                      std::vector<Matrix4x4>& matrices)
+{
+	for(size_t i=0; i<affines.size(); ++i)
+	{
+		affines[i].RotateAboutLocalY(radians[i]);
+		matrices[i] = affines[i].ExtractTransformMatrix();
+	}
+}
+
+void b_rotate_sparse_extract(std::vector<Affine>& affines,
+                             const std::vector<float>& radians,
+                             std::vector<Matrix4x4>& matrices)
+{
+	// mostly static instances: the cached matrices are reused
+	for(size_t i=0; i<affines.size(); ++i)
+	{
+		if(i % SPARSE_UPDATE_PERIOD == 0)
+			affines[i].RotateAboutLocalY(radians[i]);
+		matrices[i] = affines[i].ExtractTransformMatrix();
+	}
+}
+
+struct Batch
+{
+	const char*          name;
+	Affine::RotationMode mode;
+	BatchUpdate          update;
+};
+
+static const Batch sBatches[] =
+{
+	{"Batch::RotateAboutLocalY (matrix)",
+	 Affine::ROTATION_MODE_MATRIX,     b_rotate_local},
+	{"Batch::RotateAboutLocalY (quaternion)",
+	 Affine::ROTATION_MODE_QUATERNION, b_rotate_local},
+	{"Batch::RotateAboutWorldX+LocalZ (matrix)",
+	 Affine::ROTATION_MODE_MATRIX,     b_rotate_world_local},
+	{"Batch::RotateAboutWorldX+LocalZ (quaternion)",
+	 Affine::ROTATION_MODE_QUATERNION, b_rotate_world_local},
+	{"Batch::RotateAboutLocalY+Extract (matrix)",
+	 Affine::ROTATION_MODE_MATRIX,     b_rotate_extract},
+	{"Batch::RotateAboutLocalY+Extract (quaternion)",
+	 Affine::ROTATION_MODE_QUATERNION, b_rotate_extract},
+	{"Batch::RotateAboutLocalY(1/16)+Extract (matrix)",
+	 Affine::ROTATION_MODE_MATRIX,     b_rotate_sparse_extract},
+	{"Batch::RotateAboutLocalY(1/16)+Extract (quaternion)",
+	 Affine::ROTATION_MODE_QUATERNION, b_rotate_sparse_extract}
+};
+
+static const int BATCH_COUNT = sizeof(sBatches) / sizeof(Batch);
+
+struct BatchResult
+{
+	const Batch* batch;
+	double       nsPerInstance;
+	double       drift;  // max |transpose(R)*R - I| after many updates
+	bool         hasBaseline;
+	double       baselineNsPerInstance;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Orthogonality error of a rotation matrix
+static double orthogonality_error(const Matrix3x3& m)
+{
+	double error = 0.0;
+	for(int i=0; i<3; ++i)
+		for(int j=0; j<3; ++j)
+		{
+			double d = 0.0;
+			for(int k=0; k<3; ++k)
+				d += double(m[i][k]) * double(m[j][k]);
+			error = std::max(error, std::abs(d - (i == j ? 1.0 : 0.0)));
+		}
+	return error;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Run a batch
+static BatchResult run_batch(const Batch& batch, int repeatCnt)
+{
+	BatchResult result;
+	std::vector<Affine>    affines;
+	std::vector<float>     radians(BATCH_SIZE);
+	std::vector<Matrix4x4> matrices(BATCH_SIZE);
+	std::vector<double>    timings(TIMING_TRIAL_COUNT);
+	bench::Random random;
+
+	affines.reserve(BATCH_SIZE);
+	for(int i=0; i<BATCH_SIZE; ++i)
+	{
+		Affine affine = Affine::Rotation(random.Uniform(-PI, PI),
+		                                 random.Uniform(-PI, PI),
+		                                 random.Uniform(-PI, PI));
+		affine.SetPosition(Vector3(random.Uniform(-10.0f, 10.0f),
+		                           random.Uniform(-10.0f, 10.0f),
+		                           random.Uniform(-10.0f, 10.0f)));
+		affine.SetRotationMode(batch.mode);
+		affines.push_back(affine);
+		radians[i] = random.Uniform(-0.1f, 0.1f);
+	}
+
+	// timings
+	for(int t=0; t<TIMING_TRIAL_COUNT; ++t)
+	{
+		double start = bench::get_time();
+		for(int r=0; r<repeatCnt; ++r)
+		{
+			batch.update(affines, radians, matrices);
+			bench::clobber_memory();
+		}
+		timings[t] = (bench::get_time() - start) * 1e9
+		             / (double(repeatCnt) * BATCH_SIZE);
+	}
+	result.batch         = &batch;
+	result.nsPerInstance = bench::median(timings);
+
+	// drift of a single instance
+	std::vector<Affine> single(1, affines[0]);
+	std::vector<float>  angle(1, radians[0]);
+	for(int i=0; i<DRIFT_UPDATE_COUNT; ++i)
+		batch.update(single, angle, matrices);
+	result.drift = orthogonality_error(single[0].GetUnitAxis());
+
+	result.hasBaseline           = false;
+	result.baselineNsPerInstance = 0.0;
+	return result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compare a batch with a baseline
+static void compare(BatchResult& result, const bench::JsonValue& baseline)
+{
+	for(size_t i=0; i<baseline.Size(); ++i)
+		if(baseline[i]["name"].AsString() == result.batch->name)
+		{
+			result.hasBaseline           = true;
+			result.baselineNsPerInstance = baseline[i]["nsPerInstance"].AsNumber();
+			return;
+		}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Write the results as JSON
+static void write_json(std::ostream& stream,
+                       const std::vector<Result>& results,
+                       const std::vector<BatchResult>& batchResults,
+                       int repeatCnt)
+{
+	bench::JsonWriter json(stream);
+	json.BeginObject();
+	json.Write("tool", "coreBench");
+	json.Write("sampleCount", double(SAMPLE_COUNT));
+	json.Write("repeatCount", double(repeatCnt));
+	json.Write("checkSampleCount", double(CHECK_SAMPLE_COUNT));
+	json.BeginArray("operations");
+	for(size_t i=0; i<results.size(); ++i)
+	{
+		const Result& r = results[i];
+		json.BeginObject();
+		json.Write("name", r.operation->name);
+		json.Write("nsPerOp", r.nsPerOp);
+		json.Write("maxUlp", r.maxUlp);
+		json.Write("meanUlp", r.meanUlp);
+		json.Write("ulpBound", r.operation->ulpBound);
+		json.Write("passed", r.passed);
+		if(r.hasBaseline)
+		{
+			json.Write("baselineNsPerOp", r.baselineNsPerOp);
+			json.Write("speedup", r.baselineNsPerOp / r.nsPerOp);
+			json.Write("baselineMaxUlp", r.baselineMaxUlp);
+			json.Write("matchesBaseline", r.matchesBaseline);
+		}
+		json.BeginArray("outputs");
+		for(size_t j=0; j<r.outputs.size(); ++j)
+			json.Write(r.outputs[j]);
+		json.EndArray();
+		json.EndObject();
+	}
+	json.EndArray();
+	json.Write("batchSize", double(BATCH_SIZE));
+	json.BeginArray("batches");
+	for(size_t i=0; i<batchResults.size(); ++i)
+	{
+		const BatchResult& r = batchResults[i];
+		json.BeginObject();
+		json.Write("name", r.batch->name);
+		json.Write("nsPerInstance", r.nsPerInstance);
+		json.Write("drift", r.drift);
+		if(r.hasBaseline)
+		{
+			json.Write("baselineNsPerInstance", r.baselineNsPerInstance);
+			json.Write("speedup", r.baselineNsPerInstance / r.nsPerInstance);
+		}
+		json.EndObject();
+	}
+	json.EndArray();
+	json.EndObject();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+//
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	std::string jsonFile, compareFile, filter;
+	int repeatCnt = 64;
+
+	// parse arguments
+	for(int i=1; i<argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if(arg == "--json" && i+1 < argc)
+			jsonFile = argv[++i];
+		else if(arg == "--compare" && i+1 < argc)
+			compareFile = argv[++i];
+		else if(arg == "--filter" && i+1 < argc)
+			filter = argv[++i];
+		else if(arg == "--repeat" && i+1 < argc)
+			repeatCnt = std::max(1, atoi(argv[++i]));
+		else
+		{
+			std::cerr << "usage: " << argv[0]
+			          << " [--json file] [--compare file]"
+			          << " [--filter string] [--repeat n]" << std::endl;
+			return 1;
+		}
+	}
+
+	try
+	{
+		// load baseline
+		bench::JsonValue baseline;
+		if(!compareFile.empty())
+			baseline = bench::JsonValue::Load(compareFile);
+
+		// run
+		std::vector<Result> results;
+		int failureCnt = 0;
+		for(int i=0; i<OPERATION_COUNT; ++i)
+		{
+			const Operation& op = sOperations[i];
+			if(!filter.empty() && std::string(op.name).find(filter)
+			                      == std::string::npos)
+				continue;
+
+			Result result = run_operation(op, repeatCnt);
+			if(!compareFile.empty())
+				compare(result, baseline["operations"]);
+			results.push_back(result);
+
+			bool failed = !result.passed || !result.matchesBaseline;
+			failureCnt += failed ? 1 : 0;
+
+			char line[256];
+			sprintf(line, "%-64s %10.2f ns %12.2f ulp (<= %6.1f)",
+			        op.name, result.nsPerOp, result.maxUlp, op.ulpBound);
+			std::cout << line;
+			if(result.hasBaseline)
+			{
+				sprintf(line, "  x%5.2f vs baseline (%.2f ulp)",
+				        result.baselineNsPerOp / result.nsPerOp,
+				        result.baselineMaxUlp);
+				std::cout << line;
+			}
+			std::cout << (failed ? "  FAILED" : "") << std::endl;
+		}
+
+		// batched rotations
+		std::vector<BatchResult> batchResults;
+		for(int i=0; i<BATCH_COUNT; ++i)
+		{
+			const Batch& batch = sBatches[i];
+			if(!filter.empty() && std::string(batch.name).find(filter)
+			                      == std::string::npos)
+				continue;
+
+			BatchResult result = run_batch(batch, repeatCnt);
+			if(!compareFile.empty())
+				compare(result, baseline["batches"]);
+			batchResults.push_back(result);
+
+			char line[256];
+			sprintf(line, "%-64s %10.2f ns/instance  drift %.2e",
+			        batch.name, result.nsPerInstance, result.drift);
+			std::cout << line;
+			if(result.hasBaseline)
+			{
+				sprintf(line, "  x%5.2f vs baseline",
+				        result.baselineNsPerInstance / result.nsPerInstance);
+				std::cout << line;
+			}
+			std::cout << std::endl;
+		}
+
+		// export
+		if(!jsonFile.empty())
+		{
+			std::ofstream file(jsonFile.c_str());
+			if(!file)
+			{
+				std::cerr << "Could not open " << jsonFile << std::endl;
+				return 1;
+			}
+			write_json(file, results, batchResults, repeatCnt);
+		}
+
+		std::cout << results.size() << " operations, "
+		          << batchResults.size() << " batches, "
+		          << failureCnt << " failed." << std::endl;
+		return failureCnt ? 1 : 0;
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Fatal exception: " << e.what() << std::endl;
+		return 1;
+	}
+}
+
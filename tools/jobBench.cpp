@@ -0,0 +1,242 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    jobBench.cpp
+// \author  J. Dupuy
+// \brief   Measures the overhead and the scaling of fw::JobSystem.
+//          For each thread count, three workloads are timed:
+//          - empty: batches of empty jobs run and waited for by the main
+//            thread (scheduler overhead, in ns/job)
+//          - chain: jobs that each depend on the counter of the previous
+//            one (dependency latency, in us/job)
+//          - parallel_for: a compute loop split with several grain sizes
+//            (in ms, with the speedup over a plain loop)
+//          Timings are the median of several trials.
+//          Usage: jobBench [options]
+//          --threads <n>     maximum thread count (default: logical cores)
+//          --trials <n>      trials per measure (default 9)
+//          --json <file>     write the results as JSON
+//          No OpenGL context is created.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Framework.hpp"
+#include "Benchmark.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants
+//
+////////////////////////////////////////////////////////////////////////////////
+
+const int EMPTY_JOB_COUNT   = 4000;     // jobs per batch (fits in a deque)
+const int CHAIN_JOB_COUNT   = 1000;     // jobs per dependency chain
+const int LOOP_ELEMENT_COUNT = 1 << 20; // parallel_for elements
+const int LOOP_GRAINS[]     = {64, 1024, 16384, 0}; // 0: automatic
+const int LOOP_GRAIN_COUNT  = sizeof(LOOP_GRAINS) / sizeof(LOOP_GRAINS[0]);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Workloads
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void empty_job(void*)
+{
+	bench::clobber_memory();
+}
+
+// a few flops per element
+static void loop_range(GLint begin, GLint end, void* data)
+{
+	float* values = reinterpret_cast<float*>(data);
+	for(GLint i=begin; i<end; ++i)
+	{
+		float x = values[i];
+		for(int j=0; j<8; ++j)
+			x = std::sqrt(x*x + 1.0f) - 0.5f;
+		values[i] = x;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Timed measures (median of the trials, in seconds)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static double time_empty(fw::JobSystem& jobs, int trialCnt)
+{
+	std::vector<double> samples;
+	for(int t=0; t<trialCnt; ++t)
+	{
+		fw::JobCounter counter;
+		double start = bench::get_time();
+		for(int i=0; i<EMPTY_JOB_COUNT; ++i)
+			jobs.Run(&empty_job, NULL, &counter);
+		jobs.Wait(counter);
+		samples.push_back(bench::get_time() - start);
+	}
+	return bench::median(samples);
+}
+
+static double time_chain(fw::JobSystem& jobs, int trialCnt)
+{
+	std::vector<double> samples;
+	for(int t=0; t<trialCnt; ++t)
+	{
+		fw::JobCounter* counters = new fw::JobCounter[CHAIN_JOB_COUNT];
+		double start = bench::get_time();
+		jobs.Run(&empty_job, NULL, &counters[0]);
+		for(int i=1; i<CHAIN_JOB_COUNT; ++i)
+			jobs.Run(&empty_job, NULL, &counters[i], &counters[i-1]);
+		jobs.Wait(counters[CHAIN_JOB_COUNT-1]);
+		samples.push_back(bench::get_time() - start);
+		delete[] counters;
+	}
+	return bench::median(samples);
+}
+
+static double time_loop(fw::JobSystem* jobs, int grain, int trialCnt)
+{
+	std::vector<float> values(LOOP_ELEMENT_COUNT);
+	std::vector<double> samples;
+	for(int t=0; t<trialCnt; ++t)
+	{
+		std::fill(values.begin(), values.end(), 1.0f);
+		double start = bench::get_time();
+		if(NULL == jobs)
+			loop_range(0, LOOP_ELEMENT_COUNT, &values[0]);
+		else
+			jobs->ParallelFor(0,
+			                  LOOP_ELEMENT_COUNT,
+			                  grain,
+			                  &loop_range,
+			                  &values[0]);
+		samples.push_back(bench::get_time() - start);
+		bench::clobber_memory();
+	}
+	return bench::median(samples);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+//
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	std::string jsonFile;
+	int threadCntMax = fw::Thread::HardwareConcurrency();
+	int trialCnt     = 9;
+
+	// parse arguments
+	for(int i=1; i<argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if(arg == "--threads" && i+1 < argc)
+			threadCntMax = std::max(1, atoi(argv[++i]));
+		else if(arg == "--trials" && i+1 < argc)
+			trialCnt = std::max(1, atoi(argv[++i]));
+		else if(arg == "--json" && i+1 < argc)
+			jsonFile = argv[++i];
+		else
+		{
+			std::cerr << "usage: " << argv[0]
+			          << " [--threads n] [--trials n] [--json file]"
+			          << std::endl;
+			return 1;
+		}
+	}
+
+	try
+	{
+		// reference loop
+		double serialTime = time_loop(NULL, 0, trialCnt);
+		char line[256];
+		sprintf(line, "serial loop: %.3f ms (%d elements)",
+		        serialTime*1e3, LOOP_ELEMENT_COUNT);
+		std::cout << line << std::endl;
+		sprintf(line, "%8s %12s %12s", "threads", "empty ns", "chain us");
+		std::cout << line;
+		for(int g=0; g<LOOP_GRAIN_COUNT; ++g)
+		{
+			char header[32];
+			if(LOOP_GRAINS[g])
+				sprintf(header, "grain %d", LOOP_GRAINS[g]);
+			else
+				sprintf(header, "grain auto");
+			sprintf(line, " %19s", header);
+			std::cout << line;
+		}
+		sprintf(line, " %8s", "steals");
+		std::cout << line << std::endl;
+
+		std::ofstream jsonStream;
+		if(!jsonFile.empty())
+			jsonStream.open(jsonFile.c_str());
+		bench::JsonWriter json(jsonStream);
+		json.BeginObject();
+		json.Write("serialLoopMs", serialTime*1e3);
+		json.BeginArray("threads");
+
+		// powers of two, and the maximum
+		for(int threadCnt=1; ; threadCnt = std::min(threadCnt*2, threadCntMax))
+		{
+			fw::JobSystem jobs(threadCnt-1);
+			double emptyTime = time_empty(jobs, trialCnt);
+			double chainTime = time_chain(jobs, trialCnt);
+			sprintf(line, "%8d %12.1f %12.2f",
+			        threadCnt,
+			        emptyTime*1e9/EMPTY_JOB_COUNT,
+			        chainTime*1e6/CHAIN_JOB_COUNT);
+			std::cout << line;
+
+			json.BeginObject();
+			json.Write("threadCount", double(threadCnt));
+			json.Write("emptyJobNs", emptyTime*1e9/EMPTY_JOB_COUNT);
+			json.Write("chainJobUs", chainTime*1e6/CHAIN_JOB_COUNT);
+			json.BeginArray("loops");
+			jobs.ResetCounters();
+			for(int g=0; g<LOOP_GRAIN_COUNT; ++g)
+			{
+				double loopTime = time_loop(&jobs, LOOP_GRAINS[g], trialCnt);
+				sprintf(line, " %8.3f ms x%6.2f",
+				        loopTime*1e3, serialTime/loopTime);
+				std::cout << line;
+
+				json.BeginObject();
+				json.Write("grain", double(LOOP_GRAINS[g]));
+				json.Write("ms", loopTime*1e3);
+				json.Write("speedup", serialTime/loopTime);
+				json.EndObject();
+			}
+			json.EndArray();
+			GLuint jobCnt = jobs.JobCount();
+			double stealRate = jobCnt ? 100.0*jobs.StealCount()/jobCnt : 0.0;
+			sprintf(line, " %7.1f%%", stealRate);
+			std::cout << line << std::endl;
+			json.Write("loopStealPercent", stealRate);
+			json.EndObject();
+
+			if(threadCnt == threadCntMax)
+				break;
+		}
+		json.EndArray();
+		json.EndObject();
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Fatal exception: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
@@ -0,0 +1,893 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    md2DecodeCheck.cpp
+// \author  J. Dupuy
+// \brief   Validates the vertex generation paths of Md2 models against the
+//          scalar Md2::GenVertices (the golden output). Every keyframe pair
+//          of every animation is sampled at several lerp values, and each
+//          path generates all the samples:
+//          normal_index      GenVertices with normal indices (the normals
+//                            are interpolated as the renderer does)
+//          packed            CPU decode of the packed keyframes, frame
+//                            transforms, corners and normal table
+//          threaded          GenVertices from concurrent jobs
+//          keyframes_tf      md2.glsl keyframe decoding, captured with
+//                            transform feedback
+//          normal_indices_tf md2.glsl normal index decoding, captured with
+//                            transform feedback
+//          compute           Md2Decoder, read back from its storage buffer
+//          Each attribute has a tolerance per path, in ULPs (taken at the
+//          magnitude of the largest position of the model for the
+//          positions) or absolute; the normals of the shader paths are
+//          normalized (nlerp) and compared to the normalized reference.
+//          A summary of the first mismatches is printed on failure.
+//          Runs on any GL4.3 implementation (including Mesa llvmpipe,
+//          e.g. LIBGL_ALWAYS_SOFTWARE=1).
+//          Usage: md2DecodeCheck [options]
+//          --model <file>    md2 model (default droid.md2)
+//          --lerps <n>       lerp values per keyframe pair (default 4)
+//          --variant <str>   only run the given path
+//          The program returns 1 if a component exceeds its tolerance.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "glew.hpp"
+#include "GL/freeglut.h"
+#include "Framework.hpp"
+#include "Md2.hpp"
+#include "Md2Decoder.hpp"
+#include "Benchmark.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants
+//
+////////////////////////////////////////////////////////////////////////////////
+
+enum
+{
+	TOLERANCE_ULP = 0,
+	TOLERANCE_ABSOLUTE
+};
+
+const GLint MISMATCH_DUMP_COUNT = 8; // mismatches printed per path
+const char* ATTRIBUTE_NAMES[]   = {"position", "normal", "texcoord"};
+const char  COMPONENT_NAMES[]   = {'x', 'y', 'z'};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Tolerance of an attribute
+struct Tolerance
+{
+	GLint  type;
+	double bound;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Sample (pose of the model)
+struct Sample
+{
+	Md2::Pose pose;
+	int16_t   frameA;
+	int16_t   frameB;
+	float     lerp;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Shared data of the paths
+struct Fixture
+{
+	std::string         modelFile;
+	Md2                 md2;
+	std::vector<Sample> samples;
+	GLuint              cornerCnt;  // vertices per sample
+	fw::JobSystem*      jobSystem;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Mismatching component
+struct Mismatch
+{
+	size_t vertex;     // index in the generated vertices
+	GLint  attribute;
+	GLint  component;
+	float  value;
+	double reference;
+	double error;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Errors of the components of a vertex attribute
+struct Error
+{
+	Error() : maxError(0.0), failureCnt(0) {}
+	void Add(float value,
+	         double reference,
+	         double scale,
+	         const Tolerance& tolerance,
+	         Mismatch& mismatch)
+	{
+		double error = TOLERANCE_ULP == tolerance.type
+		             ? bench::ulp_error(value, reference, scale)
+		             : std::abs(value - reference);
+		maxError     = std::max(maxError, error);
+		mismatch.value     = value;
+		mismatch.reference = reference;
+		mismatch.error     = error;
+		failureCnt += error > tolerance.bound ? 1 : 0;
+	}
+
+	double maxError;
+	int    failureCnt;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Vertex generation path
+typedef bool (*VariantFunction)(Fixture& fixture,
+                                std::vector<Md2::Vertex>& vertices);
+struct Variant
+{
+	const char*     name;
+	VariantFunction function;    // false if the path is not supported
+	Tolerance       tolerances[3]; // position, normal, texcoord
+	bool            isNormalized;  // normals are unit vectors
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Uniform blocks of md2.glsl (std140, one instance and one character)
+struct FrameBlock
+{
+	GLfloat lightDirection[4];
+	GLfloat ambient[4];
+	GLuint  counts[4];
+};
+struct InstanceBlock
+{
+	GLfloat modelViewProjection[16];
+	GLfloat animation[4];      // lerp factor, frame a, frame b, character
+};
+struct CharacterBlock
+{
+	Md2::FrameTransform frameA;
+	Md2::FrameTransform frameB;
+	GLuint  keyframes[2];
+	GLfloat lerp;
+	GLfloat _reserved;
+};
+
+// Captured vertex (transform feedback varyings of md2.glsl)
+struct CapturedVertex
+{
+	GLfloat p[3];
+	GLfloat n[3];
+	GLfloat st[2];
+	GLuint  character;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Functions
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Sample every keyframe pair of every animation
+static void gen_samples(Fixture& fixture, GLint lerpCnt)
+{
+	Md2& md2 = fixture.md2;
+	for(int16_t i=0; i<Md2::ANIMATION_BOOM; ++i)
+	{
+		// first frame of the animation
+		Md2::Pose pose;
+		pose.animation = (i + Md2::ANIMATION_BOOM - 1) % Md2::ANIMATION_BOOM;
+		pose.frame     = 0.0f;
+		md2.SetActivePose(pose);
+		md2.NextAnimation();
+		const float start = md2.ActivePose().frame;
+
+		// frame pairs, up to the one that loops
+		Sample sample;
+		sample.frameB = -1;
+		for(float frame=start; sample.frameB != start; frame+= 1.0f)
+			for(GLint j=0; j<lerpCnt; ++j)
+			{
+				sample.pose.animation = i;
+				sample.pose.frame     = frame + float(j)/lerpCnt;
+				md2.SetActivePose(sample.pose);
+				md2.ActiveFrames(sample.frameA, sample.frameB, sample.lerp);
+				fixture.samples.push_back(sample);
+			}
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Reference (scalar GenVertices)
+static void gen_reference(Fixture& fixture, std::vector<Md2::Vertex>& vertices)
+{
+	vertices.resize(fixture.samples.size()*fixture.cornerCnt);
+	for(size_t i=0; i<fixture.samples.size(); ++i)
+	{
+		fixture.md2.SetActivePose(fixture.samples[i].pose);
+		fixture.md2.GenVertices(&vertices[i*fixture.cornerCnt]);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Normal indices (interpolated as by the renderer, without normalization)
+static bool gen_normal_index(Fixture& fixture,
+                             std::vector<Md2::Vertex>& vertices)
+{
+	std::vector<float> normals(4*162);
+	std::vector<Md2::NormalIndexVertex> indexed(fixture.cornerCnt);
+	Md2::GenNormals(&normals[0]);
+	vertices.resize(fixture.samples.size()*fixture.cornerCnt);
+	for(size_t i=0; i<fixture.samples.size(); ++i)
+	{
+		const Sample& sample = fixture.samples[i];
+		const float oneMinusLerp = 1.0f - sample.lerp;
+		fixture.md2.SetActivePose(sample.pose);
+		fixture.md2.GenVertices(&indexed[0]);
+		for(GLuint j=0; j<fixture.cornerCnt; ++j)
+		{
+			Md2::Vertex& vertex = vertices[i*fixture.cornerCnt + j];
+			const float* normalA = &normals[4*(indexed[j].normals & 0xFF)];
+			const float* normalB = &normals[4*(indexed[j].normals >> 8 & 0xFF)];
+			for(int k=0; k<3; ++k)
+			{
+				vertex.p[k] = indexed[j].p[k];
+				vertex.n[k] = oneMinusLerp * normalA[k]
+				            + sample.lerp * normalB[k];
+			}
+			vertex.st[0] = indexed[j].st[0];
+			vertex.st[1] = indexed[j].st[1];
+		}
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CPU decode of the packed data (the inputs of the GPU paths)
+static bool gen_packed(Fixture& fixture, std::vector<Md2::Vertex>& vertices)
+{
+	const Md2& md2 = fixture.md2;
+	std::vector<uint32_t> packed(md2.FrameCount()*md2.VertexCount());
+	std::vector<Md2::FrameTransform> transforms(md2.FrameCount());
+	std::vector<Md2::Corner> corners(fixture.cornerCnt);
+	std::vector<float> normals(4*162);
+	md2.GenPackedVertices(&packed[0]);
+	md2.GenFrameTransforms(&transforms[0]);
+	md2.GenCorners(&corners[0]);
+	Md2::GenNormals(&normals[0]);
+
+	vertices.resize(fixture.samples.size()*fixture.cornerCnt);
+	for(size_t i=0; i<fixture.samples.size(); ++i)
+	{
+		const Sample& sample = fixture.samples[i];
+		const float oneMinusLerp = 1.0f - sample.lerp;
+		const Md2::FrameTransform& transformA = transforms[sample.frameA];
+		const Md2::FrameTransform& transformB = transforms[sample.frameB];
+		for(GLuint j=0; j<fixture.cornerCnt; ++j)
+		{
+			Md2::Vertex& vertex = vertices[i*fixture.cornerCnt + j];
+			uint32_t vertA = packed[sample.frameA*md2.VertexCount()
+			                        + corners[j].vertex];
+			uint32_t vertB = packed[sample.frameB*md2.VertexCount()
+			                        + corners[j].vertex];
+			const float* normalA = &normals[4*(vertA >> 24)];
+			const float* normalB = &normals[4*(vertB >> 24)];
+			for(int k=0; k<3; ++k)
+			{
+				float posA = transformA.scale[k] * float(vertA >> 8*k & 0xFF)
+				           + transformA.translation[k];
+				float posB = transformB.scale[k] * float(vertB >> 8*k & 0xFF)
+				           + transformB.translation[k];
+				vertex.p[k] = oneMinusLerp * posA + sample.lerp * posB;
+				vertex.n[k] = oneMinusLerp * normalA[k]
+				            + sample.lerp * normalB[k];
+			}
+			vertex.st[0] = corners[j].st[0];
+			vertex.st[1] = corners[j].st[1];
+		}
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GenVertices from concurrent jobs (one model per range)
+struct ThreadedJob
+{
+	const Fixture*     fixture;
+	std::vector<Md2*>* models;
+	GLint              grain;
+	Md2::Vertex*       vertices;
+};
+static void gen_threaded_range(GLint begin, GLint end, void* data)
+{
+	ThreadedJob* job = reinterpret_cast<ThreadedJob*>(data);
+	Md2* md2 = (*job->models)[begin/job->grain];
+	for(GLint i=begin; i<end; ++i)
+	{
+		md2->SetActivePose(job->fixture->samples[i].pose);
+		md2->GenVertices(job->vertices + i*job->fixture->cornerCnt);
+	}
+}
+static bool gen_threaded(Fixture& fixture, std::vector<Md2::Vertex>& vertices)
+{
+	const GLint sampleCnt = fixture.samples.size();
+	const GLint threadCnt = fixture.jobSystem->ThreadCount();
+	std::vector<Md2*> models(threadCnt, NULL);
+	ThreadedJob job;
+	job.fixture = &fixture;
+	job.models  = &models;
+	job.grain   = (sampleCnt + threadCnt - 1) / threadCnt;
+	vertices.resize(sampleCnt*fixture.cornerCnt);
+	job.vertices = &vertices[0];
+	try
+	{
+		for(GLint i=0; i<threadCnt; ++i)
+			models[i] = new Md2(fixture.modelFile);
+		fixture.jobSystem->ParallelFor(0,
+		                               sampleCnt,
+		                               job.grain,
+		                               &gen_threaded_range,
+		                               &job);
+	}
+	catch(...)
+	{
+		for(GLint i=0; i<threadCnt; ++i)
+			delete models[i];
+		throw;
+	}
+	for(GLint i=0; i<threadCnt; ++i)
+		delete models[i];
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Bind a uniform block of md2.glsl (inactive blocks are skipped)
+static void bind_uniform_block(GLuint program,
+                               const std::string& name,
+                               GLuint binding,
+                               GLuint buffer,
+                               GLint dataSize)
+{
+	GLuint index = glGetUniformBlockIndex(program, name.c_str());
+	if(GL_INVALID_INDEX == index)
+		return;
+
+	// make sure the layout matches the C++ struct
+	GLint size = 0;
+	glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+	if(size != dataSize)
+		throw std::runtime_error("Uniform block " + name + " has wrong size.");
+
+	glUniformBlockBinding(program, index, binding);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// md2.glsl paths, captured with transform feedback
+enum
+{
+	BUFFER_FRAME = 0,
+	BUFFER_INSTANCE,
+	BUFFER_CHARACTER,
+	BUFFER_NORMAL,
+	BUFFER_KEYFRAMES,
+	BUFFER_VERTICES,
+	BUFFER_CAPTURE,
+	BUFFER_COUNT
+};
+static void gen_captured(Fixture& fixture,
+                         std::vector<Md2::Vertex>& vertices,
+                         bool isKeyframes)
+{
+	const Md2& md2 = fixture.md2;
+	const GLuint cornerCnt = fixture.cornerCnt;
+	GLuint buffers[BUFFER_COUNT];
+	GLuint vertexArray = 0, texture = 0;
+	GLuint program = glCreateProgram();
+	glGenBuffers(BUFFER_COUNT, buffers);
+	glGenVertexArrays(1, &vertexArray);
+	glGenTextures(1, &texture);
+
+	// build the program
+	std::stringstream options;
+	options << "#define INSTANCE_COUNT_MAX 1\n"
+	        << "#define CHARACTER_COUNT_MAX 1\n"
+	        << (isKeyframes ? "#define STREAM_KEYFRAMES\n"
+	                        : "#define STREAM_NORMAL_INDICES\n")
+	        << "#define CAPTURE_VERTICES\n";
+	fw::build_glsl_program(program, "md2.glsl", options.str(), GL_FALSE);
+	const GLchar* varyings[] = {"oCapturePosition",
+	                            "oCaptureNormal",
+	                            "oCaptureTexCoord",
+	                            "oCaptureCharacter"};
+	glTransformFeedbackVaryings(program, 4, varyings, GL_INTERLEAVED_ATTRIBS);
+	fw::link_glsl_program(program, "md2.glsl");
+
+	// constant blocks
+	FrameBlock frameBlock = {{0.0f, 0.0f, 1.0f, 0.0f},
+	                         {0.0f, 0.0f, 0.0f, 0.0f},
+	                         {1, 0, 0, 0}};
+	InstanceBlock instanceBlock;
+	for(int i=0; i<16; ++i)
+		instanceBlock.modelViewProjection[i] = i%5 ? 0.0f : 1.0f;
+	std::vector<float> normals(4*162);
+	Md2::GenNormals(&normals[0]);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffers[BUFFER_FRAME]);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), &frameBlock,
+	             GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffers[BUFFER_INSTANCE]);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(InstanceBlock), NULL,
+	             GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffers[BUFFER_CHARACTER]);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CharacterBlock), NULL,
+	             GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffers[BUFFER_NORMAL]);
+	glBufferData(GL_UNIFORM_BUFFER, normals.size()*sizeof(float),
+	             &normals[0], GL_STATIC_DRAW);
+	bind_uniform_block(program, "FrameBlock", 0, buffers[BUFFER_FRAME],
+	                   sizeof(FrameBlock));
+	bind_uniform_block(program, "InstanceBlock", 1, buffers[BUFFER_INSTANCE],
+	                   sizeof(InstanceBlock));
+	bind_uniform_block(program, "CharacterBlock", 2,
+	                   buffers[BUFFER_CHARACTER], sizeof(CharacterBlock));
+	bind_uniform_block(program, "NormalBlock", 3, buffers[BUFFER_NORMAL],
+	                   normals.size()*sizeof(float));
+
+	// vertex inputs
+	glBindVertexArray(vertexArray);
+	glVertexAttribI4ui(3, 0, 0, 0, 0); // single instance
+	if(isKeyframes)
+	{
+		std::vector<uint32_t> packed(md2.FrameCount()*md2.VertexCount());
+		std::vector<Md2::Corner> corners(cornerCnt);
+		md2.GenPackedVertices(&packed[0]);
+		md2.GenCorners(&corners[0]);
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[BUFFER_KEYFRAMES]);
+		glBufferData(GL_TEXTURE_BUFFER, packed.size()*sizeof(uint32_t),
+		             &packed[0], GL_STATIC_DRAW);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, buffers[BUFFER_KEYFRAMES]);
+		glProgramUniform1i(program,
+		                   glGetUniformLocation(program, "sKeyframes"),
+		                   0);
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_VERTICES]);
+		glBufferData(GL_ARRAY_BUFFER, cornerCnt*sizeof(Md2::Corner),
+		             &corners[0], GL_STATIC_DRAW);
+		glEnableVertexAttribArray(2);
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Md2::Corner),
+		                      FW_BUFFER_OFFSET(0));
+		glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(Md2::Corner),
+		                       FW_BUFFER_OFFSET(2*sizeof(float)));
+	}
+	else
+	{
+		const GLsizei stride = sizeof(Md2::NormalIndexVertex);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_VERTICES]);
+		glBufferData(GL_ARRAY_BUFFER, cornerCnt*stride, NULL, GL_STREAM_DRAW);
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+		                      FW_BUFFER_OFFSET(0));
+		glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, stride,
+		                       FW_BUFFER_OFFSET(3*sizeof(float)));
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+		                      FW_BUFFER_OFFSET(3*sizeof(float)
+		                                       + sizeof(uint32_t)));
+	}
+
+	// capture every sample
+	const GLsizeiptr sampleSize = cornerCnt*sizeof(CapturedVertex);
+	std::vector<Md2::NormalIndexVertex> indexed(cornerCnt);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, buffers[BUFFER_CAPTURE]);
+	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER,
+	             fixture.samples.size()*sampleSize,
+	             NULL,
+	             GL_STREAM_READ);
+	glUseProgram(program);
+	glEnable(GL_RASTERIZER_DISCARD);
+	for(size_t i=0; i<fixture.samples.size(); ++i)
+	{
+		const Sample& sample = fixture.samples[i];
+		CharacterBlock characterBlock;
+		md2.GenFrameTransform(sample.frameA, &characterBlock.frameA);
+		md2.GenFrameTransform(sample.frameB, &characterBlock.frameB);
+		characterBlock.keyframes[0] = sample.frameA*md2.VertexCount();
+		characterBlock.keyframes[1] = sample.frameB*md2.VertexCount();
+		characterBlock.lerp         = sample.lerp;
+		characterBlock._reserved    = 0.0f;
+		instanceBlock.animation[0]  = sample.lerp;
+		instanceBlock.animation[1]  = sample.frameA;
+		instanceBlock.animation[2]  = sample.frameB;
+		instanceBlock.animation[3]  = 0.0f;
+		glBindBuffer(GL_UNIFORM_BUFFER, buffers[BUFFER_CHARACTER]);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CharacterBlock),
+		                &characterBlock);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffers[BUFFER_INSTANCE]);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(InstanceBlock),
+		                &instanceBlock);
+		if(!isKeyframes)
+		{
+			fixture.md2.SetActivePose(sample.pose);
+			fixture.md2.GenVertices(&indexed[0]);
+			glBufferSubData(GL_ARRAY_BUFFER, 0,
+			                cornerCnt*sizeof(Md2::NormalIndexVertex),
+			                &indexed[0]);
+		}
+
+		glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
+		                  0,
+		                  buffers[BUFFER_CAPTURE],
+		                  i*sampleSize,
+		                  sampleSize);
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, 0, cornerCnt);
+		glEndTransformFeedback();
+	}
+	glDisable(GL_RASTERIZER_DISCARD);
+	glUseProgram(0);
+
+	// read back
+	std::vector<CapturedVertex> captured(fixture.samples.size()*cornerCnt);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, buffers[BUFFER_CAPTURE]);
+	glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER,
+	                   0,
+	                   captured.size()*sizeof(CapturedVertex),
+	                   &captured[0]);
+	vertices.resize(captured.size());
+	for(size_t i=0; i<captured.size(); ++i)
+	{
+		for(int j=0; j<3; ++j)
+		{
+			vertices[i].p[j] = captured[i].p[j];
+			vertices[i].n[j] = captured[i].n[j];
+		}
+		vertices[i].st[0] = captured[i].st[0];
+		vertices[i].st[1] = captured[i].st[1];
+	}
+
+	// clean up
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteTextures(1, &texture);
+	glDeleteBuffers(BUFFER_COUNT, buffers);
+	glDeleteProgram(program);
+	fw::check_gl_error();
+}
+static bool gen_keyframes_tf(Fixture& fixture,
+                             std::vector<Md2::Vertex>& vertices)
+{
+	gen_captured(fixture, vertices, true);
+	return true;
+}
+static bool gen_normal_indices_tf(Fixture& fixture,
+                                  std::vector<Md2::Vertex>& vertices)
+{
+	gen_captured(fixture, vertices, false);
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Md2Decoder, read back from the storage buffer
+static bool gen_compute(Fixture& fixture, std::vector<Md2::Vertex>& vertices)
+{
+	if(!Md2Decoder::IsSupported())
+		return false;
+
+	// decode all the samples at once
+	const Md2* models[] = {&fixture.md2};
+	Md2Decoder decoder;
+	decoder.Load(models, 1);
+	std::vector<Md2Decoder::Instance> instances(fixture.samples.size());
+	for(size_t i=0; i<instances.size(); ++i)
+	{
+		instances[i].model       = 0;
+		instances[i].frameA      = fixture.samples[i].frameA;
+		instances[i].frameB      = fixture.samples[i].frameB;
+		instances[i].lerp        = fixture.samples[i].lerp;
+		instances[i].firstVertex = i*decoder.VertexCount(0);
+	}
+	vertices.resize(instances.size()*decoder.VertexCount(0));
+	GLuint buffer = 0;
+	fw::StateCache stateCache;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER,
+	             vertices.size()*sizeof(Md2::Vertex),
+	             NULL,
+	             GL_STREAM_READ);
+	decoder.Decode(&instances[0], instances.size(), buffer, stateCache);
+
+	// read back
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glGetBufferSubData(GL_ARRAY_BUFFER,
+	                   0,
+	                   vertices.size()*sizeof(Md2::Vertex),
+	                   &vertices[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDeleteBuffers(1, &buffer);
+	fw::check_gl_error();
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Paths and tolerances
+// The CPU paths evaluate the expressions of GenVertices (one ulp covers
+// a different contraction by the compiler); the GPU paths may fuse the
+// multiply-adds of mix, and normalize the normals.
+const Variant VARIANTS[] =
+{
+	{"normal_index", &gen_normal_index,
+	 {{TOLERANCE_ULP, 1.0}, {TOLERANCE_ULP, 1.0}, {TOLERANCE_ULP, 0.0}},
+	 false},
+	{"packed", &gen_packed,
+	 {{TOLERANCE_ULP, 1.0}, {TOLERANCE_ULP, 1.0}, {TOLERANCE_ULP, 0.0}},
+	 false},
+	{"threaded", &gen_threaded,
+	 {{TOLERANCE_ULP, 0.0}, {TOLERANCE_ULP, 0.0}, {TOLERANCE_ULP, 0.0}},
+	 false},
+	{"keyframes_tf", &gen_keyframes_tf,
+	 {{TOLERANCE_ULP, 2.0}, {TOLERANCE_ABSOLUTE, 1e-5}, {TOLERANCE_ULP, 0.0}},
+	 true},
+	{"normal_indices_tf", &gen_normal_indices_tf,
+	 {{TOLERANCE_ULP, 1.0}, {TOLERANCE_ABSOLUTE, 1e-5}, {TOLERANCE_ULP, 0.0}},
+	 true},
+	{"compute", &gen_compute,
+	 {{TOLERANCE_ULP, 2.0}, {TOLERANCE_ULP, 2.0}, {TOLERANCE_ULP, 0.0}},
+	 false}
+};
+const GLint VARIANT_COUNT = sizeof(VARIANTS)/sizeof(Variant);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Print an error line
+static void print_error(const char* name,
+                        GLint attribute,
+                        const Error& error,
+                        const Tolerance& tolerance)
+{
+	char line[256];
+	const char* unit = TOLERANCE_ULP == tolerance.type ? "ulp" : "abs";
+	sprintf(line, "%-18s %-9s %12.4g %s (<= %6.2g) %8d failures",
+	        name, ATTRIBUTE_NAMES[attribute], error.maxError, unit,
+	        tolerance.bound, error.failureCnt);
+	std::cout << line << std::endl;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Print a mismatch
+static void print_mismatch(const Fixture& fixture, const Mismatch& mismatch)
+{
+	char line[256];
+	const Sample& sample = fixture.samples[mismatch.vertex
+	                                       / fixture.cornerCnt];
+	sprintf(line, "  animation %2d frames %3d-%3d lerp %.4f corner %5u"
+	              " %s.%c: %.9g != %.9g (%.4g)",
+	        sample.pose.animation, sample.frameA, sample.frameB,
+	        sample.lerp, unsigned(mismatch.vertex % fixture.cornerCnt),
+	        ATTRIBUTE_NAMES[mismatch.attribute],
+	        COMPONENT_NAMES[mismatch.component],
+	        mismatch.value, mismatch.reference, mismatch.error);
+	std::cout << line << std::endl;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compare a path to the reference (returns the failure count)
+static int compare(const Fixture& fixture,
+                   const Variant& variant,
+                   const std::vector<Md2::Vertex>& vertices,
+                   const std::vector<Md2::Vertex>& reference,
+                   double positionScale)
+{
+	if(vertices.size() != reference.size())
+		throw std::runtime_error(std::string(variant.name)
+		                         + " has a wrong vertex count.");
+
+	Error errors[3];
+	std::vector<Mismatch> mismatches;
+	for(size_t i=0; i<reference.size(); ++i)
+	{
+		// normalized reference normal
+		double n[3], norm = 0.0;
+		for(int j=0; j<3; ++j)
+		{
+			n[j]  = reference[i].n[j];
+			norm += n[j]*n[j];
+		}
+		norm = variant.isNormalized && norm > 0.0 ? sqrt(norm) : 1.0;
+
+		// components
+		for(int j=0; j<8; ++j)
+		{
+			Mismatch mismatch;
+			mismatch.vertex    = i;
+			mismatch.attribute = j/3;
+			mismatch.component = j%3;
+			const int failureCnt = errors[j/3].failureCnt;
+			if(j < 3)
+				errors[0].Add(vertices[i].p[j], reference[i].p[j],
+				              positionScale, variant.tolerances[0],
+				              mismatch);
+			else if(j < 6)
+				errors[1].Add(vertices[i].n[j-3], n[j-3]/norm,
+				              1.0, variant.tolerances[1],
+				              mismatch);
+			else
+				errors[2].Add(vertices[i].st[j-6], reference[i].st[j-6],
+				              1.0, variant.tolerances[2],
+				              mismatch);
+			if(errors[j/3].failureCnt > failureCnt
+			&& GLint(mismatches.size()) < MISMATCH_DUMP_COUNT)
+				mismatches.push_back(mismatch);
+		}
+	}
+
+	// summary
+	int failureCnt = 0;
+	for(int i=0; i<3; ++i)
+	{
+		print_error(variant.name, i, errors[i], variant.tolerances[i]);
+		failureCnt += errors[i].failureCnt;
+	}
+	for(size_t i=0; i<mismatches.size(); ++i)
+		print_mismatch(fixture, mismatches[i]);
+	return failureCnt;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+//
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	Fixture fixture;
+	fixture.modelFile = "droid.md2";
+	std::string variantName;
+	int lerpCnt = 4;
+
+	// init glut (consumes the glut arguments)
+	glutInit(&argc, argv);
+
+	// parse arguments
+	bool isUsage = false;
+	for(int i=1; i<argc && !isUsage; ++i)
+	{
+		std::string arg(argv[i]);
+		if(arg == "--model" && i+1 < argc)
+			fixture.modelFile = argv[++i];
+		else if(arg == "--lerps" && i+1 < argc)
+			lerpCnt = std::max(1, atoi(argv[++i]));
+		else if(arg == "--variant" && i+1 < argc)
+			variantName = argv[++i];
+		else
+			isUsage = true;
+	}
+	bool isVariant = variantName.empty();
+	for(GLint i=0; i<VARIANT_COUNT; ++i)
+		isVariant|= variantName == VARIANTS[i].name;
+	if(isUsage || !isVariant)
+	{
+		std::cerr << "usage: " << argv[0]
+		          << " [--model file] [--lerps n] [--variant name]"
+		          << std::endl;
+		return 1;
+	}
+
+	// build a GL4.3 context
+	glutInitContextVersion(4, 3);
+	glutInitContextFlags(GLUT_DEBUG | GLUT_FORWARD_COMPATIBLE);
+	glutInitContextProfile(GLUT_CORE_PROFILE);
+	glutInitDisplayMode(GLUT_RGBA);
+	glutInitWindowSize(64, 64);
+	glutCreateWindow("md2DecodeCheck");
+	glutHideWindow();
+
+	// init glew
+	glewExperimental = GL_TRUE;
+	if(GLEW_OK != glewInit())
+	{
+		std::cerr << "glewInit() failed" << std::endl;
+		return 1;
+	}
+	glGetError();
+
+	// check_gl_error checks in release builds too
+	fw::DebugOutput::SetMode(fw::DebugOutput::MODE_FULL);
+
+	try
+	{
+		// resolve the dispatch entry point
+		Md2Decoder::SetDispatchFunction(
+		    reinterpret_cast<PFNGLDISPATCHCOMPUTEPROC>
+		    (glutGetProcAddress("glDispatchCompute")));
+
+		// load the model, sample the animations and build the reference
+		fw::JobSystem jobSystem;
+		fixture.md2.Load(fixture.modelFile);
+		fixture.cornerCnt = fixture.md2.TriangleCount()*3;
+		fixture.jobSystem = &jobSystem;
+		gen_samples(fixture, lerpCnt);
+		std::vector<Md2::Vertex> reference;
+		gen_reference(fixture, reference);
+		double positionScale = 0.0;
+		for(size_t i=0; i<reference.size(); ++i)
+			for(int j=0; j<3; ++j)
+				positionScale = std::max(positionScale,
+				                         std::abs(double(reference[i].p[j])));
+
+		std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+		std::cout << "samples:  " << fixture.samples.size()
+		          << " (" << reference.size() << " vertices, "
+		          << lerpCnt << " lerps per keyframe pair)" << std::endl;
+
+		// run the paths
+		int failureCnt = 0, variantCnt = 0;
+		for(GLint i=0; i<VARIANT_COUNT; ++i)
+		{
+			const Variant& variant = VARIANTS[i];
+			if(!variantName.empty() && variantName != variant.name)
+				continue;
+
+			std::vector<Md2::Vertex> vertices;
+			if(!(*variant.function)(fixture, vertices))
+			{
+				std::cout << variant.name << " is not supported, skipped"
+				          << std::endl;
+				continue;
+			}
+			failureCnt += compare(fixture,
+			                      variant,
+			                      vertices,
+			                      reference,
+			                      positionScale);
+			++variantCnt;
+		}
+
+		std::cout << variantCnt << " paths, "
+		          << (failureCnt ? "FAILED" : "passed") << std::endl;
+		return failureCnt ? 1 : 0;
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Fatal exception: " << e.what() << std::endl;
+		return 1;
+	}
+}
+
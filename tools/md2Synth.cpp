@@ -0,0 +1,518 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    md2Synth.cpp
+// \author  J. Dupuy
+// \brief   Writes synthetic md2 models, and benchmarks the Md2 paths over a
+//          sweep of model sizes up to the limits of the format.
+//          The geometry is a grid wrapped around a cylinder, which waves
+//          from frame to frame. Triangles follow the grid (neighbouring
+//          triangles share vertices, as in exported models), or are shuffled
+//          along with the vertices (no locality, the worst case for caches).
+//          Frames beyond the 198 of the animation table are written, loaded
+//          and packed, but never played.
+//          Usage: md2Synth --out <file> [options]
+//          --triangles <n>   triangle count (default 4096, at most 4096)
+//          --vertices <n>    vertex count (default 2048, at most 2048)
+//          --frames <n>      frame count (default 198, 198 to 512)
+//          --skins <n>       skin names (default 1, at most 32)
+//          --random          shuffled triangles and vertices
+//          --seed <n>        seed of the shuffles
+//          Usage: md2Synth --sweep [options]
+//          --dir <path>      directory of the temporary model (default .)
+//          --trials <n>      trials per measure (default 9)
+//          --json <file>     write the results as JSON
+//          No OpenGL context is created.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Md2.hpp"
+#include "Benchmark.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants
+//
+////////////////////////////////////////////////////////////////////////////////
+
+const int   TRIANGLE_COUNT_MAX = 4096;
+const int   VERTEX_COUNT_MAX   = 2048;
+const int   FRAME_COUNT_MIN    = 198;  // frames of the animation table
+const int   FRAME_COUNT_MAX    = 512;
+const int   SKIN_COUNT_MAX     = 32;
+const int   SKIN_SIZE          = 256;  // skin width and height
+const int   NORMAL_COUNT       = 162;
+const float RADIUS             = 16.0f;
+const float HEIGHT             = 56.0f;
+const float PI                 = 3.14159265358979f;
+const float UPDATE_STEP        = 1.0f/60.0f;
+
+// sweep
+const int SWEEP_SIZES[][2] = {{512, 256}, {1024, 512}, {2048, 1024},
+                              {4096, 2048}}; // triangles, vertices
+const int SWEEP_SIZE_COUNT = sizeof(SWEEP_SIZES) / sizeof(SWEEP_SIZES[0]);
+const int SWEEP_FRAMES[]   = {198, 512};
+const int SWEEP_FRAME_COUNT = sizeof(SWEEP_FRAMES) / sizeof(SWEEP_FRAMES[0]);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Model parameters
+struct Config
+{
+	Config() : triangleCnt(TRIANGLE_COUNT_MAX), vertexCnt(VERTEX_COUNT_MAX),
+	           frameCnt(FRAME_COUNT_MIN), skinCnt(1), isRandom(false),
+	           seed(2463534242u) {}
+
+	int      triangleCnt;
+	int      vertexCnt;
+	int      frameCnt;
+	int      skinCnt;
+	bool     isRandom;
+	uint32_t seed;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// File header (see Md2.cpp)
+struct Header
+{
+	int32_t ident, version;
+	int32_t skinWidth, skinHeight, frameSize;
+	int32_t skinCnt, vertexCnt, texCoordCnt, triangleCnt, glcmdCnt, frameCnt;
+	int32_t skinOffset, texCoordOffset, triangleOffset, frameOffset;
+	int32_t glcmdOffset, endOffset;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Append raw bytes to a file image
+template<typename T>
+static void append(std::vector<char>& image, const T* data, size_t count)
+{
+	const char* bytes = reinterpret_cast<const char*>(data);
+	image.insert(image.end(), bytes, bytes + sizeof(T)*count);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Index of the table normal closest to a unit vector
+static uint8_t nearest_normal(const float* normals, const float* n)
+{
+	int nearest = 0;
+	float nearestDot = -2.0f;
+	for(int i=0; i<NORMAL_COUNT; ++i)
+	{
+		const float* m = &normals[4*i];
+		float dot = m[0]*n[0] + m[1]*n[1] + m[2]*n[2];
+		if(dot > nearestDot)
+		{
+			nearest    = i;
+			nearestDot = dot;
+		}
+	}
+	return nearest;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Shuffle (Fisher-Yates)
+template<typename T>
+static void shuffle(std::vector<T>& values, bench::Random& random)
+{
+	for(size_t i=values.size(); i>1; --i)
+		std::swap(values[i-1], values[random.Next() % i]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Build the file image of a model
+static std::vector<char> build_model(const Config& config)
+{
+	bench::Random random(config.seed);
+	const int columnCnt = std::max(2, int(std::ceil(std::sqrt(
+	                                  float(config.vertexCnt)))));
+	const int rowCnt    = std::max(2, (config.vertexCnt + columnCnt - 1)
+	                                  / columnCnt);
+
+	// vertex order (identity, or a random permutation)
+	std::vector<uint16_t> order(config.vertexCnt);
+	for(int i=0; i<config.vertexCnt; ++i)
+		order[i] = i;
+	if(config.isRandom)
+		shuffle(order, random);
+
+	// triangles of the grid quads, repeated if needed
+	std::vector<uint16_t> corners; // 3 per triangle
+	for(int r=0; r+1<rowCnt; ++r)
+		for(int c=0; c+1<columnCnt; ++c)
+		{
+			int v00 = r*columnCnt + c, v01 = v00 + 1;
+			int v10 = v00 + columnCnt, v11 = v10 + 1;
+			if(v11 >= config.vertexCnt)
+				continue;
+			const int quad[6] = {v00, v10, v01, v01, v10, v11};
+			for(int i=0; i<6; ++i)
+				corners.push_back(order[quad[i]]);
+		}
+	if(corners.empty()) // fewer vertices than a quad
+		for(int i=0; i<3; ++i)
+			corners.push_back(order[i % config.vertexCnt]);
+	std::vector<uint16_t> triangles(config.triangleCnt*3);
+	for(int i=0; i<config.triangleCnt*3; ++i)
+		triangles[i] = corners[i % corners.size()];
+	if(config.isRandom)
+		for(size_t i=triangles.size()/3; i>1; --i)
+		{
+			size_t j = random.Next() % i;
+			for(int k=0; k<3; ++k)
+				std::swap(triangles[3*(i-1)+k], triangles[3*j+k]);
+		}
+
+	// header
+	Header header;
+	header.ident          = 'I'|'D'<<8|'P'<<16|'2'<<24;
+	header.version        = 8;
+	header.skinWidth      = SKIN_SIZE;
+	header.skinHeight     = SKIN_SIZE;
+	header.frameSize      = 40 + 4*config.vertexCnt;
+	header.skinCnt        = config.skinCnt;
+	header.vertexCnt      = config.vertexCnt;
+	header.texCoordCnt    = config.vertexCnt;
+	header.triangleCnt    = config.triangleCnt;
+	header.glcmdCnt       = 0;
+	header.frameCnt       = config.frameCnt;
+	header.skinOffset     = sizeof(Header);
+	header.texCoordOffset = header.skinOffset + 64*config.skinCnt;
+	header.triangleOffset = header.texCoordOffset + 4*config.vertexCnt;
+	header.frameOffset    = header.triangleOffset + 12*config.triangleCnt;
+	header.glcmdOffset    = header.frameOffset
+	                      + header.frameSize*config.frameCnt;
+	header.endOffset      = header.glcmdOffset;
+	std::vector<char> image;
+	image.reserve(header.endOffset);
+	append(image, &header, 1);
+
+	// skins
+	for(int i=0; i<config.skinCnt; ++i)
+	{
+		char name[64] = {0};
+		sprintf(name, "synth%02d.pcx", i);
+		append(image, name, 64);
+	}
+
+	// texture coordinates (one per vertex, in grid order)
+	std::vector<int16_t> texCoords(2*config.vertexCnt);
+	for(int i=0; i<config.vertexCnt; ++i)
+	{
+		texCoords[2*order[i]]   = (i % columnCnt) * (SKIN_SIZE-1)
+		                        / (columnCnt-1);
+		texCoords[2*order[i]+1] = (i / columnCnt) * (SKIN_SIZE-1)
+		                        / (rowCnt-1);
+	}
+	append(image, &texCoords[0], texCoords.size());
+
+	// triangles (texture coordinates share the vertex indices)
+	for(int i=0; i<config.triangleCnt; ++i)
+	{
+		append(image, &triangles[3*i], 3);
+		append(image, &triangles[3*i], 3);
+	}
+
+	// frames (the cylinder waves)
+	std::vector<float> normals(4*NORMAL_COUNT);
+	Md2::GenNormals(&normals[0]);
+	std::vector<float> positions(3*config.vertexCnt);
+	std::vector<uint8_t> vertices(4*config.vertexCnt);
+	for(int f=0; f<config.frameCnt; ++f)
+	{
+		float phase = 2.0f*PI*f/40.0f;
+		float minP[3] = { 1e9f,  1e9f,  1e9f};
+		float maxP[3] = {-1e9f, -1e9f, -1e9f};
+		for(int i=0; i<config.vertexCnt; ++i)
+		{
+			float theta  = 2.0f*PI*(i % columnCnt)/(columnCnt-1);
+			float height = float(i / columnCnt)/(rowCnt-1);
+			float radius = RADIUS*(1.0f + 0.15f*std::sin(4.0f*PI*height
+			                                               + phase));
+			float* p = &positions[3*order[i]];
+			p[0] = radius*std::cos(theta) + 4.0f*std::sin(phase)*height;
+			p[1] = radius*std::sin(theta);
+			p[2] = HEIGHT*(height - 0.5f);
+			const float n[3] = {std::cos(theta), std::sin(theta), 0.0f};
+			vertices[4*order[i]+3] = nearest_normal(&normals[0], n);
+			for(int j=0; j<3; ++j)
+			{
+				minP[j] = std::min(minP[j], p[j]);
+				maxP[j] = std::max(maxP[j], p[j]);
+			}
+		}
+		float scale[3], translation[3];
+		for(int j=0; j<3; ++j)
+		{
+			scale[j]       = std::max(maxP[j] - minP[j], 1e-6f) / 255.0f;
+			translation[j] = minP[j];
+		}
+		for(int i=0; i<config.vertexCnt; ++i)
+			for(int j=0; j<3; ++j)
+				vertices[4*i+j] = uint8_t((positions[3*i+j] - translation[j])
+				                          / scale[j] + 0.5f);
+		char name[16] = {0};
+		sprintf(name, "frame%03d", f);
+		append(image, scale, 3);
+		append(image, translation, 3);
+		append(image, name, 16);
+		append(image, &vertices[0], vertices.size());
+	}
+	return image;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Write the file image of a model
+static void write_model(const std::string& filename, const Config& config)
+{
+	std::vector<char> image = build_model(config);
+	std::ofstream file(filename.c_str(), std::ofstream::binary);
+	file.write(&image[0], image.size());
+	if(!file)
+	{
+		std::cerr << "Could not write " << filename << std::endl;
+		exit(1);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Sweep measures (median of the trials, in us)
+struct Measure
+{
+	Config config;
+	size_t arenaSize;
+	double loadUs;
+	double verticesUs;
+	double normalIndexVerticesUs;
+	double packedFramesUs;
+};
+
+static Measure measure(const Config& config,
+                       const std::string& filename,
+                       int trialCnt)
+{
+	Measure m;
+	m.config = config;
+	write_model(filename, config);
+	std::vector<double> load, verticesTimes, normalIndexTimes, packedTimes;
+	Md2 md2;
+	for(int t=0; t<trialCnt; ++t)
+	{
+		double start = bench::get_time();
+		md2.Load(filename);
+		load.push_back(bench::get_time() - start);
+	}
+	m.arenaSize = md2.ArenaSize();
+
+	// the animation moves between the calls
+	const int callCnt = 64;
+	std::vector<Md2::Vertex> vertices(md2.TriangleCount()*3);
+	std::vector<Md2::NormalIndexVertex> normalIndexVertices(vertices.size());
+	std::vector<uint32_t> keyframes(2*md2.VertexCount());
+	for(int t=0; t<trialCnt; ++t)
+	{
+		double start = bench::get_time();
+		for(int i=0; i<callCnt; ++i)
+		{
+			md2.Update(UPDATE_STEP);
+			md2.GenVertices(&vertices[0]);
+			bench::clobber_memory();
+		}
+		verticesTimes.push_back((bench::get_time() - start)/callCnt);
+
+		start = bench::get_time();
+		for(int i=0; i<callCnt; ++i)
+		{
+			md2.Update(UPDATE_STEP);
+			md2.GenVertices(&normalIndexVertices[0]);
+			bench::clobber_memory();
+		}
+		normalIndexTimes.push_back((bench::get_time() - start)/callCnt);
+
+		// every frame of the model is packed in turn
+		start = bench::get_time();
+		for(int i=0; i<callCnt; ++i)
+		{
+			int16_t frame = (t*callCnt + i) % (md2.FrameCount()-1);
+			md2.GenPackedFrame(frame, &keyframes[0]);
+			md2.GenPackedFrame(frame+1, &keyframes[md2.VertexCount()]);
+			bench::clobber_memory();
+		}
+		packedTimes.push_back((bench::get_time() - start)/callCnt);
+	}
+	m.loadUs                = bench::median(load)*1e6;
+	m.verticesUs            = bench::median(verticesTimes)*1e6;
+	m.normalIndexVerticesUs = bench::median(normalIndexTimes)*1e6;
+	m.packedFramesUs        = bench::median(packedTimes)*1e6;
+	return m;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Run the sweep
+static void run_sweep(const std::string& dir,
+                      int trialCnt,
+                      const std::string& jsonFile)
+{
+	const std::string filename = dir + "/md2Synth_sweep.md2";
+	char line[256];
+	sprintf(line, "%9s %8s %6s %7s %10s %10s %12s %12s %10s %9s",
+	        "triangles", "vertices", "frames", "order", "arena KB",
+	        "load us", "vertices us", "nrm idx us", "packed us", "MB/s");
+	std::cout << line << std::endl;
+
+	std::vector<Measure> measures;
+	for(int s=0; s<SWEEP_SIZE_COUNT; ++s)
+		for(int f=0; f<SWEEP_FRAME_COUNT; ++f)
+			for(int o=0; o<2; ++o)
+			{
+				Config config;
+				config.triangleCnt = SWEEP_SIZES[s][0];
+				config.vertexCnt   = SWEEP_SIZES[s][1];
+				config.frameCnt    = SWEEP_FRAMES[f];
+				config.isRandom    = 1 == o;
+				Measure m = measure(config, filename, trialCnt);
+				measures.push_back(m);
+
+				double bytes = config.triangleCnt*3.0*sizeof(Md2::Vertex);
+				sprintf(line,
+				        "%9d %8d %6d %7s %10.1f %10.1f %12.2f %12.2f %10.3f %9.0f",
+				        config.triangleCnt, config.vertexCnt, config.frameCnt,
+				        config.isRandom ? "random" : "grid",
+				        m.arenaSize/1024.0, m.loadUs, m.verticesUs,
+				        m.normalIndexVerticesUs, m.packedFramesUs,
+				        bytes/m.verticesUs/1.048576);
+				std::cout << line << std::endl;
+			}
+	std::remove(filename.c_str());
+
+	if(jsonFile.empty())
+		return;
+	std::ofstream file(jsonFile.c_str());
+	if(!file)
+	{
+		std::cerr << "Could not open " << jsonFile << std::endl;
+		exit(1);
+	}
+	bench::JsonWriter json(file);
+	json.BeginObject();
+	json.Write("trials", double(trialCnt));
+	json.BeginArray("models");
+	for(size_t i=0; i<measures.size(); ++i)
+	{
+		const Measure& m = measures[i];
+		json.BeginObject();
+		json.Write("triangles", double(m.config.triangleCnt));
+		json.Write("vertices", double(m.config.vertexCnt));
+		json.Write("frames", double(m.config.frameCnt));
+		json.Write("order", m.config.isRandom ? "random" : "grid");
+		json.Write("arenaBytes", double(m.arenaSize));
+		json.Write("loadUs", m.loadUs);
+		json.Write("genVerticesUs", m.verticesUs);
+		json.Write("genNormalIndexVerticesUs", m.normalIndexVerticesUs);
+		json.Write("genPackedFramesUs", m.packedFramesUs);
+		json.EndObject();
+	}
+	json.EndArray();
+	json.EndObject();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+//
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	Config config;
+	std::string outFile, jsonFile, dir = ".";
+	bool isSweep = false;
+	bool isUsage = false;
+	int trialCnt = 9;
+
+	// parse arguments
+	for(int i=1; i<argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if(arg == "--out" && i+1 < argc)
+			outFile = argv[++i];
+		else if(arg == "--triangles" && i+1 < argc)
+			config.triangleCnt = std::min(std::max(1, atoi(argv[++i])),
+			                              TRIANGLE_COUNT_MAX);
+		else if(arg == "--vertices" && i+1 < argc)
+			config.vertexCnt = std::min(std::max(3, atoi(argv[++i])),
+			                            VERTEX_COUNT_MAX);
+		else if(arg == "--frames" && i+1 < argc)
+			config.frameCnt = std::min(std::max(FRAME_COUNT_MIN,
+			                                    atoi(argv[++i])),
+			                           FRAME_COUNT_MAX);
+		else if(arg == "--skins" && i+1 < argc)
+			config.skinCnt = std::min(std::max(0, atoi(argv[++i])),
+			                          SKIN_COUNT_MAX);
+		else if(arg == "--random")
+			config.isRandom = true;
+		else if(arg == "--seed" && i+1 < argc)
+			config.seed = std::max(1u, uint32_t(strtoul(argv[++i], NULL, 10)));
+		else if(arg == "--sweep")
+			isSweep = true;
+		else if(arg == "--dir" && i+1 < argc)
+			dir = argv[++i];
+		else if(arg == "--trials" && i+1 < argc)
+			trialCnt = std::max(1, atoi(argv[++i]));
+		else if(arg == "--json" && i+1 < argc)
+			jsonFile = argv[++i];
+		else
+			isUsage = true;
+	}
+	if(isUsage || outFile.empty() == !isSweep)
+	{
+		std::cerr << "usage: " << argv[0]
+		          << " --out file [--triangles n] [--vertices n] [--frames n]"
+		          << " [--skins n] [--random] [--seed n]" << std::endl
+		          << "       " << argv[0]
+		          << " --sweep [--dir path] [--trials n] [--json file]"
+		          << std::endl;
+		return 1;
+	}
+
+	try
+	{
+		if(isSweep)
+		{
+			run_sweep(dir, trialCnt, jsonFile);
+			return 0;
+		}
+
+		// write, and check that the model loads
+		write_model(outFile, config);
+		Md2 md2(outFile);
+		std::cout << outFile << ": " << md2.TriangleCount() << " triangles, "
+		          << md2.VertexCount() << " vertices, "
+		          << md2.FrameCount() << " frames, "
+		          << md2.SkinCount() << " skins ("
+		          << (config.isRandom ? "random" : "grid") << " order)"
+		          << std::endl;
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Fatal exception: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
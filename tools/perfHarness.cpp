@@ -0,0 +1,440 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    perfHarness.cpp
+// \author  J. Dupuy
+// \brief   Performance regression harness for the CPU side of a frame: Md2
+//          loading, animation and vertex generation, the writes of the
+//          streaming modes into a ring buffer (plain memory, as a mapped
+//          range would be), and the instance transforms.
+//          Every benchmark is run several times (after a warm-up run); the
+//          median and the median absolute deviation (MAD) of the runs are
+//          reported, and saved as a JSON baseline. A benchmark regresses if
+//          its median exceeds the one of the baseline by more than the
+//          relative threshold AND by more than k times the combined noise
+//          of both runs (1.4826 MAD, a standard deviation estimate).
+//          Usage: perfHarness [options]
+//          --model <file>    md2 model (default droid.md2)
+//          --runs <n>        runs per benchmark (default 9)
+//          --filter <str>    only run benchmarks whose name contains str
+//          --json <file>     write the results (a baseline for --baseline)
+//          --baseline <file> compare against the results of a previous run
+//          --threshold <p>   relative slowdown tolerated (default 0.05)
+//          --sigmas <k>      noise multiple tolerated (default 3)
+//          The program returns 1 if a benchmark regresses.
+//          No OpenGL context is created.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Algebra.hpp"
+#include "Transform.hpp"
+#include "Md2.hpp"
+#include "Benchmark.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants
+//
+////////////////////////////////////////////////////////////////////////////////
+
+const int    CHARACTER_COUNT   = 16;       // characters streamed per frame
+const int    INSTANCE_COUNT    = 1024;     // instance transforms per frame
+const size_t STREAM_CAPACITY   = 1 << 22;  // ring buffer, in bytes
+const size_t STREAM_ALIGNMENT  = 256;      // offset alignment of a frame
+const float  UPDATE_STEP       = 1.0f/60.0f;
+const double MAD_TO_SIGMA      = 1.4826;   // normal distribution
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark fixture (the model is loaded once)
+struct Fixture
+{
+	std::string         modelFile;
+	Md2                 md2;
+	std::vector<char>   ring;   // stream buffer
+	size_t              offset; // first free byte of the ring
+	std::vector<float>  instances;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocate a range of the ring (wraps around, as an orphan would)
+static void* ring_alloc(Fixture& fixture, size_t size, size_t alignment)
+{
+	size_t offset = (fixture.offset + alignment - 1) / alignment * alignment;
+	if(offset + size > fixture.ring.size())
+		offset = 0;
+	fixture.offset = offset + size;
+	return &fixture.ring[offset];
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Workloads (one operation; the returned count is the bytes written, 0 if
+// not relevant)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static size_t md2_load(Fixture& fixture)
+{
+	Md2 md2(fixture.modelFile);
+	bench::clobber_memory();
+	return 0;
+}
+
+static size_t md2_update(Fixture& fixture)
+{
+	int16_t frameA, frameB;
+	float lerp;
+	fixture.md2.Update(UPDATE_STEP);
+	fixture.md2.ActiveFrames(frameA, frameB, lerp);
+	bench::clobber_memory();
+	return 0;
+}
+
+static size_t md2_gen_vertices(Fixture& fixture)
+{
+	size_t size = fixture.md2.TriangleCount()*3*sizeof(Md2::Vertex);
+	Md2::Vertex* vertices = reinterpret_cast<Md2::Vertex*>(
+	                        ring_alloc(fixture, size, sizeof(Md2::Vertex)));
+	fixture.md2.GenVertices(vertices);
+	bench::clobber_memory();
+	return size;
+}
+
+static size_t md2_gen_normal_index_vertices(Fixture& fixture)
+{
+	size_t size = fixture.md2.TriangleCount()*3
+	            * sizeof(Md2::NormalIndexVertex);
+	Md2::NormalIndexVertex* vertices =
+		reinterpret_cast<Md2::NormalIndexVertex*>(
+		ring_alloc(fixture, size, sizeof(Md2::NormalIndexVertex)));
+	fixture.md2.GenVertices(vertices);
+	bench::clobber_memory();
+	return size;
+}
+
+static size_t md2_gen_packed_frames(Fixture& fixture)
+{
+	int16_t frameA, frameB;
+	float lerp;
+	size_t size = 2*fixture.md2.VertexCount()*sizeof(uint32_t);
+	uint32_t* keyframes = reinterpret_cast<uint32_t*>(
+	                      ring_alloc(fixture, size, sizeof(uint32_t)));
+	fixture.md2.ActiveFrames(frameA, frameB, lerp);
+	fixture.md2.GenPackedFrame(frameA, keyframes);
+	fixture.md2.GenPackedFrame(frameB, keyframes + fixture.md2.VertexCount());
+	bench::clobber_memory();
+	return size;
+}
+
+// a frame of the vertex streaming mode (one animation step per character)
+static size_t stream_vertices(Fixture& fixture)
+{
+	size_t size = 0;
+	fixture.offset = (fixture.offset + STREAM_ALIGNMENT - 1)
+	               / STREAM_ALIGNMENT * STREAM_ALIGNMENT;
+	for(int i=0; i<CHARACTER_COUNT; ++i)
+	{
+		fixture.md2.Update(UPDATE_STEP / CHARACTER_COUNT);
+		size += md2_gen_vertices(fixture);
+	}
+	return size;
+}
+
+// a frame of the keyframe streaming modes
+static size_t stream_keyframes(Fixture& fixture)
+{
+	size_t size = 0;
+	fixture.offset = (fixture.offset + STREAM_ALIGNMENT - 1)
+	               / STREAM_ALIGNMENT * STREAM_ALIGNMENT;
+	for(int i=0; i<CHARACTER_COUNT; ++i)
+	{
+		fixture.md2.Update(UPDATE_STEP / CHARACTER_COUNT);
+		size += md2_gen_packed_frames(fixture);
+	}
+	return size;
+}
+
+// instance blocks of a frame (model view projection of a grid of instances)
+static size_t instance_transforms(Fixture& fixture)
+{
+	static ModelViewProjection sModelViewProjection(
+		Matrix4x4(0, 1, 0, 0, 0, 0,-1, 0, 1, 0, 0, 0, 0, 0, 0, 1));
+	static Affine sModel = Affine::Translation(Vector3(0, 0, -400));
+	static Projection sProjection =
+		Projection::Perspective(50.0f, 1.0f, 10.0f, 4000.0f);
+	sModel.RotateAboutLocalY(0.01f); // the model turns every frame
+	const Matrix4x4& mvp =
+		sModelViewProjection.ExtractTransformMatrix(sProjection, sModel);
+	const int columnCnt = int(std::ceil(std::sqrt(float(INSTANCE_COUNT))));
+	for(int i=0; i<INSTANCE_COUNT; ++i)
+	{
+		float y = (i % columnCnt - 0.5f*(columnCnt-1)) * 64.0f;
+		float z = (i / columnCnt - 0.5f*(columnCnt-1)) * 64.0f;
+		Matrix4x4 instance = mvp * Matrix4x4::Translation(Vector3(0, y, -z));
+		memcpy(&fixture.instances[16*i], &instance, sizeof(Matrix4x4));
+	}
+	bench::clobber_memory();
+	return INSTANCE_COUNT*sizeof(Matrix4x4);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark table
+struct Benchmark
+{
+	const char* name;
+	size_t (*function)(Fixture& fixture);
+	int         repeatCnt; // operations per run
+};
+
+static const Benchmark sBenchmarks[] = {
+	{"md2_load",                      &md2_load,                        16},
+	{"md2_update",                    &md2_update,                   65536},
+	{"md2_gen_vertices",              &md2_gen_vertices,               512},
+	{"md2_gen_normal_index_vertices", &md2_gen_normal_index_vertices,  512},
+	{"md2_gen_packed_frames",         &md2_gen_packed_frames,         2048},
+	{"stream_vertices",               &stream_vertices,                 32},
+	{"stream_keyframes",              &stream_keyframes,               128},
+	{"instance_transforms",           &instance_transforms,             64}
+};
+static const int BENCHMARK_COUNT = sizeof(sBenchmarks) / sizeof(Benchmark);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Result of a benchmark
+struct Result
+{
+	Result() : benchmark(NULL), median(0.0), mad(0.0), bytesPerSecond(0.0),
+	           hasBaseline(false), baselineMedian(0.0), baselineMad(0.0),
+	           isRegression(false), isImprovement(false) {}
+
+	const Benchmark*    benchmark;
+	std::vector<double> samples;  // us per operation, one per run
+	double              median;   // us
+	double              mad;      // us
+	double              bytesPerSecond;
+	bool                hasBaseline;
+	double              baselineMedian;
+	double              baselineMad;
+	bool                isRegression;
+	bool                isImprovement;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Run a benchmark (the first run is a warm-up)
+static Result run_benchmark(const Benchmark& benchmark,
+                            Fixture& fixture,
+                            int runCnt)
+{
+	Result result;
+	result.benchmark = &benchmark;
+	size_t bytes = 0;
+	for(int r=-1; r<runCnt; ++r)
+	{
+		bytes = 0;
+		double start = bench::get_time();
+		for(int i=0; i<benchmark.repeatCnt; ++i)
+			bytes += benchmark.function(fixture);
+		double time = bench::get_time() - start;
+		if(r >= 0)
+			result.samples.push_back(time*1e6 / benchmark.repeatCnt);
+	}
+	result.median = bench::median(result.samples);
+	result.mad    = bench::median_absolute_deviation(result.samples);
+	result.bytesPerSecond = result.median > 0.0
+	                      ? bytes / (result.median*1e-6*benchmark.repeatCnt)
+	                      : 0.0;
+	return result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compare with a baseline
+static void compare(Result& result,
+                    const bench::JsonValue& baseline,
+                    double threshold,
+                    double sigmaCnt)
+{
+	for(size_t i=0; i<baseline.Size(); ++i)
+	{
+		const bench::JsonValue& entry = baseline[i];
+		if(entry["name"].AsString() != result.benchmark->name)
+			continue;
+		result.hasBaseline    = true;
+		result.baselineMedian = entry["medianUs"].AsNumber();
+		result.baselineMad    = entry["madUs"].AsNumber();
+		double delta = result.median - result.baselineMedian;
+		double noise = MAD_TO_SIGMA * std::sqrt(result.mad*result.mad
+		             + result.baselineMad*result.baselineMad);
+		double bound = std::max(threshold*result.baselineMedian,
+		                        sigmaCnt*noise);
+		result.isRegression  = delta > bound;
+		result.isImprovement = -delta > bound;
+		return;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Export
+static void write_json(std::ostream& stream,
+                       const std::vector<Result>& results,
+                       const Fixture& fixture,
+                       int runCnt)
+{
+	bench::JsonWriter json(stream);
+	json.BeginObject();
+	json.Write("model", fixture.modelFile);
+	json.Write("runs", double(runCnt));
+	json.BeginArray("benchmarks");
+	for(size_t i=0; i<results.size(); ++i)
+	{
+		const Result& r = results[i];
+		json.BeginObject();
+		json.Write("name", r.benchmark->name);
+		json.Write("medianUs", r.median);
+		json.Write("madUs", r.mad);
+		json.Write("bytesPerSecond", r.bytesPerSecond);
+		json.BeginArray("samplesUs");
+		for(size_t j=0; j<r.samples.size(); ++j)
+			json.Write(r.samples[j]);
+		json.EndArray();
+		if(r.hasBaseline)
+		{
+			json.Write("baselineMedianUs", r.baselineMedian);
+			json.Write("baselineMadUs", r.baselineMad);
+			json.Write("regression", r.isRegression);
+		}
+		json.EndObject();
+	}
+	json.EndArray();
+	json.EndObject();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+//
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	std::string jsonFile, baselineFile, filter;
+	Fixture fixture;
+	fixture.modelFile = "droid.md2";
+	int runCnt       = 9;
+	double threshold = 0.05;
+	double sigmaCnt  = 3.0;
+
+	// parse arguments
+	for(int i=1; i<argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if(arg == "--model" && i+1 < argc)
+			fixture.modelFile = argv[++i];
+		else if(arg == "--runs" && i+1 < argc)
+			runCnt = std::max(1, atoi(argv[++i]));
+		else if(arg == "--filter" && i+1 < argc)
+			filter = argv[++i];
+		else if(arg == "--json" && i+1 < argc)
+			jsonFile = argv[++i];
+		else if(arg == "--baseline" && i+1 < argc)
+			baselineFile = argv[++i];
+		else if(arg == "--threshold" && i+1 < argc)
+			threshold = std::max(0.0, atof(argv[++i]));
+		else if(arg == "--sigmas" && i+1 < argc)
+			sigmaCnt = std::max(0.0, atof(argv[++i]));
+		else
+		{
+			std::cerr << "usage: " << argv[0]
+			          << " [--model file] [--runs n] [--filter string]"
+			          << " [--json file] [--baseline file]"
+			          << " [--threshold p] [--sigmas k]" << std::endl;
+			return 1;
+		}
+	}
+
+	try
+	{
+		// load the baseline and the model
+		bench::JsonValue baseline;
+		if(!baselineFile.empty())
+			baseline = bench::JsonValue::Load(baselineFile);
+		fixture.md2.Load(fixture.modelFile);
+		fixture.ring.resize(STREAM_CAPACITY);
+		fixture.offset = 0;
+		fixture.instances.resize(16*INSTANCE_COUNT);
+
+		// run
+		char line[256];
+		sprintf(line, "%-32s %12s %10s %10s %12s %8s",
+		        "benchmark", "median us", "mad us", "MB/s",
+		        "baseline us", "change");
+		std::cout << line << std::endl;
+		std::vector<Result> results;
+		int regressionCnt = 0;
+		for(int i=0; i<BENCHMARK_COUNT; ++i)
+		{
+			const Benchmark& benchmark = sBenchmarks[i];
+			if(!filter.empty() && std::string(benchmark.name).find(filter)
+			                      == std::string::npos)
+				continue;
+
+			Result result = run_benchmark(benchmark, fixture, runCnt);
+			if(!baselineFile.empty())
+				compare(result,
+				        baseline["benchmarks"],
+				        threshold,
+				        sigmaCnt);
+			results.push_back(result);
+			regressionCnt += result.isRegression ? 1 : 0;
+
+			sprintf(line, "%-32s %12.3f %10.3f %10.1f",
+			        benchmark.name, result.median, result.mad,
+			        result.bytesPerSecond/1048576.0);
+			std::cout << line;
+			if(result.hasBaseline)
+			{
+				sprintf(line, " %12.3f %+7.1f%%",
+				        result.baselineMedian,
+				        100.0*(result.median/result.baselineMedian - 1.0));
+				std::cout << line
+				          << (result.isRegression  ? "  REGRESSION"
+				            : result.isImprovement ? "  improved" : "");
+			}
+			std::cout << std::endl;
+		}
+
+		// export
+		if(!jsonFile.empty())
+		{
+			std::ofstream file(jsonFile.c_str());
+			if(!file)
+			{
+				std::cerr << "Could not open " << jsonFile << std::endl;
+				return 1;
+			}
+			write_json(file, results, fixture, runCnt);
+		}
+
+		std::cout << results.size() << " benchmarks, "
+		          << regressionCnt << " regressed." << std::endl;
+		return regressionCnt ? 1 : 0;
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Fatal exception: " << e.what() << std::endl;
+		return 1;
+	}
+}
+
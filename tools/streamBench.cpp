@@ -0,0 +1,511 @@
+////////////////////////////////////////////////////////////////////////////////
+// \file    streamBench.cpp
+// \author  J. Dupuy
+// \brief   Compares the buffer streaming strategies over synthetic payloads.
+//          Each frame writes a payload (1K to 64M) in 1 to 1000 chunks
+//          through one strategy:
+//          subdata        glBufferSubData per chunk
+//          orphan         glBufferData(NULL) per frame, then an
+//                         unsynchronized map per chunk
+//          unsynchronized a ring of three frame regions, mapped per chunk
+//                         with GL_MAP_UNSYNCHRONIZED_BIT
+//          storage        the same ring in an immutable store, persistently
+//                         mapped (GL4.4 or ARB_buffer_storage)
+//          The GPU consumes each payload with a copy to a sink buffer, and
+//          the frames are throttled by fences three frames deep (as a swap
+//          chain would). The CPU time is the time spent streaming a frame,
+//          the stall time the time spent waiting for the fences (the ring
+//          strategies reuse a region when its fence is signaled; the
+//          stalls of the other strategies happen inside the driver and
+//          are part of their CPU time). The throughput is measured up to
+//          the completion of the last copy. The sink is read back after the
+//          last frame and compared to its payload, so a run under Mesa
+//          (e.g. LIBGL_ALWAYS_SOFTWARE=1) validates the strategies; the
+//          timings are only meaningful on real drivers.
+//          Usage: streamBench [options]
+//          --frames <n>      measured frames per run (default 32)
+//          --min-size <n>    smallest payload, K/M suffixes (default 1K)
+//          --max-size <n>    largest payload, K/M suffixes (default 64M)
+//          --strategy <str>  only run the given strategy
+//          --json <file>     write the results
+//          The program returns 1 if a read back payload is corrupted.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "glew.hpp"
+#include "GL/freeglut.h"
+#include "Framework.hpp"
+#include "Benchmark.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#	define GL_MAP_PERSISTENT_BIT                  0x0040
+#	define GL_MAP_COHERENT_BIT                    0x0080
+#endif
+typedef void (GLAPIENTRY * PFNGLBUFFERSTORAGEPROC) (GLenum target,
+                                                    GLsizeiptr size,
+                                                    const GLvoid* data,
+                                                    GLbitfield flags);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants
+//
+////////////////////////////////////////////////////////////////////////////////
+
+enum
+{
+	STRATEGY_SUBDATA = 0,
+	STRATEGY_ORPHAN,
+	STRATEGY_UNSYNCHRONIZED,
+	STRATEGY_STORAGE,
+	STRATEGY_COUNT
+};
+
+const char* STRATEGY_NAMES[STRATEGY_COUNT] =
+	{"subdata", "orphan", "unsynchronized", "storage"};
+
+const GLint      CHUNK_COUNTS[]     = {1, 10, 100, 1000};
+const GLint      CHUNK_COUNT_COUNT  = sizeof(CHUNK_COUNTS)/sizeof(GLint);
+const GLint      REGION_COUNT       = 3;    // frames in flight
+const GLint      WARMUP_FRAME_COUNT = 4;
+const GLint      PATTERN_PERIOD     = 256;  // source offsets of the frames
+const GLsizeiptr REGION_ALIGNMENT   = 256;  // map alignment of the regions
+const GLsizeiptr CHUNK_ALIGNMENT    = 4;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Run of a strategy
+struct Result
+{
+	GLint      strategy;
+	GLsizeiptr payload;    // bytes per frame
+	GLint      chunkCnt;
+	GLsizeiptr chunkSize;
+	double     cpuUs;      // median per frame
+	double     stallUs;    // median per frame
+	double     gigabytesPerSecond;
+	GLsizeiptr errorCnt;   // corrupted bytes
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Globals
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static PFNGLBUFFERSTORAGEPROC sBufferStorage = NULL;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Functions
+//
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Check for buffer storage support
+static bool is_buffer_storage_supported()
+{
+	GLint major = 0, minor = 0, extensionCnt = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if(major > 4 || (4 == major && minor >= 4))
+		return true;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCnt);
+	for(GLint i=0; i<extensionCnt; ++i)
+		if(!strcmp("GL_ARB_buffer_storage",
+		           reinterpret_cast<const char*>(
+		           glGetStringi(GL_EXTENSIONS, i))))
+			return true;
+	return false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Parse a size (with an optional K or M suffix)
+static GLsizeiptr parse_size(const char* str)
+{
+	char* end = NULL;
+	GLsizeiptr size = strtol(str, &end, 10);
+	if('K' == *end || 'k' == *end)
+		size*= 1024;
+	else if('M' == *end || 'm' == *end)
+		size*= 1024*1024;
+	return size;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Format a size
+static std::string format_size(GLsizeiptr size)
+{
+	char str[32];
+	if(size >= 1024*1024 && 0 == size%(1024*1024))
+		sprintf(str, "%ldM", long(size/(1024*1024)));
+	else if(size >= 1024 && 0 == size%1024)
+		sprintf(str, "%ldK", long(size/1024));
+	else
+		sprintf(str, "%ld", long(size));
+	return str;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Map a range (throws on failure)
+static GLvoid* map_range(GLintptr offset, GLsizeiptr size, GLbitfield access)
+{
+	GLvoid* ptr = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, access);
+	if(NULL == ptr)
+		throw std::runtime_error("glMapBufferRange failed");
+	return ptr;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Wait for a fence and delete it (returns the time spent waiting)
+static double wait_fence(GLsync& fence)
+{
+	if(NULL == fence)
+		return 0.0;
+	double start = bench::get_time();
+	GLenum status = GL_TIMEOUT_EXPIRED;
+	while(GL_TIMEOUT_EXPIRED == status)
+		status = glClientWaitSync(fence,
+		                          GL_SYNC_FLUSH_COMMANDS_BIT,
+		                          1000000000); // 1s
+	glDeleteSync(fence);
+	fence = NULL;
+	return bench::get_time() - start;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Stream a payload for a number of frames
+static Result run_strategy(GLint strategy,
+                           GLsizeiptr payload,
+                           GLint chunkCnt,
+                           GLint frameCnt,
+                           const std::vector<char>& source)
+{
+	Result result;
+	result.strategy  = strategy;
+	result.chunkSize = std::max(CHUNK_ALIGNMENT,
+	                            payload/chunkCnt/CHUNK_ALIGNMENT
+	                                            *CHUNK_ALIGNMENT);
+	result.chunkCnt  = payload/result.chunkSize; // small payloads
+	result.payload   = result.chunkCnt*result.chunkSize;
+	result.errorCnt  = 0;
+
+	const GLsizeiptr chunkSize = result.chunkSize;
+	const GLsizeiptr bytes     = result.payload;
+	const bool       isRing    = STRATEGY_UNSYNCHRONIZED == strategy
+	                          || STRATEGY_STORAGE == strategy;
+	const GLsizeiptr region    = (bytes + REGION_ALIGNMENT - 1)
+	                           / REGION_ALIGNMENT * REGION_ALIGNMENT;
+	const GLsizeiptr capacity  = isRing ? region*REGION_COUNT : region;
+
+	// create the buffers
+	GLuint buffers[2] = {0, 0}; // stream, sink
+	char* persistent  = NULL;
+	glGenBuffers(2, buffers);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[1]);
+	glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	if(STRATEGY_STORAGE == strategy)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT
+		                       | GL_MAP_PERSISTENT_BIT
+		                       | GL_MAP_COHERENT_BIT;
+		sBufferStorage(GL_ARRAY_BUFFER, capacity, NULL, flags);
+		persistent = reinterpret_cast<char*>(map_range(0, capacity, flags));
+	}
+	else
+		glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+
+	// stream
+	GLsync fences[REGION_COUNT] = {NULL, NULL, NULL};
+	std::vector<double> cpuTimes, stallTimes;
+	double start = 0.0;
+	const GLint lastFrame = WARMUP_FRAME_COUNT + frameCnt - 1;
+	for(GLint i=0; i<=lastFrame; ++i)
+	{
+		if(WARMUP_FRAME_COUNT == i)
+			start = bench::get_time();
+
+		const GLint    r      = i%REGION_COUNT;
+		const GLintptr offset = isRing ? r*region : 0;
+		const char*    src    = &source[i%PATTERN_PERIOD];
+		double frameStart = bench::get_time();
+		double stall      = wait_fence(fences[r]);
+
+		switch(strategy)
+		{
+		case STRATEGY_SUBDATA:
+			for(GLint j=0; j<result.chunkCnt; ++j)
+				glBufferSubData(GL_ARRAY_BUFFER,
+				                j*chunkSize,
+				                chunkSize,
+				                src + j*chunkSize);
+			break;
+		case STRATEGY_ORPHAN:
+			glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+			// fall through: the orphaned store is not in use
+		case STRATEGY_UNSYNCHRONIZED:
+			for(GLint j=0; j<result.chunkCnt; ++j)
+			{
+				memcpy(map_range(offset + j*chunkSize,
+				                 chunkSize,
+				                 GL_MAP_WRITE_BIT
+				                 | GL_MAP_INVALIDATE_RANGE_BIT
+				                 | GL_MAP_UNSYNCHRONIZED_BIT),
+				       src + j*chunkSize,
+				       chunkSize);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+			break;
+		case STRATEGY_STORAGE:
+			for(GLint j=0; j<result.chunkCnt; ++j)
+				memcpy(persistent + offset + j*chunkSize,
+				       src + j*chunkSize,
+				       chunkSize);
+			break;
+		}
+
+		// consume the payload
+		glCopyBufferSubData(GL_ARRAY_BUFFER,
+		                    GL_COPY_WRITE_BUFFER,
+		                    offset,
+		                    0,
+		                    bytes);
+		fences[r] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		if(i >= WARMUP_FRAME_COUNT)
+		{
+			cpuTimes.push_back(bench::get_time() - frameStart - stall);
+			stallTimes.push_back(stall);
+		}
+	}
+	glFinish();
+	double elapsed = bench::get_time() - start;
+
+	// check the last payload
+	std::vector<char> sink(bytes);
+	glGetBufferSubData(GL_COPY_WRITE_BUFFER, 0, bytes, &sink[0]);
+	const char* expected = &source[lastFrame%PATTERN_PERIOD];
+	for(GLsizeiptr i=0; i<bytes; ++i)
+		result.errorCnt += sink[i] != expected[i] ? 1 : 0;
+
+	// clean up
+	for(GLint i=0; i<REGION_COUNT; ++i)
+		if(NULL != fences[i])
+			glDeleteSync(fences[i]);
+	if(NULL != persistent)
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(2, buffers);
+	fw::check_gl_error();
+
+	result.cpuUs   = 1e6*bench::median(cpuTimes);
+	result.stallUs = 1e6*bench::median(stallTimes);
+	result.gigabytesPerSecond = double(bytes)*frameCnt/elapsed*1e-9;
+	return result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Export
+static void write_json(std::ostream& stream,
+                        const std::vector<Result>& results,
+                        GLint frameCnt)
+{
+	bench::JsonWriter json(stream);
+	json.BeginObject();
+	json.Write("renderer",
+	           reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+	json.Write("version",
+	           reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+	json.Write("frames", double(frameCnt));
+	json.Write("bufferStorage", NULL != sBufferStorage);
+	json.BeginArray("results");
+	for(size_t i=0; i<results.size(); ++i)
+	{
+		const Result& r = results[i];
+		json.BeginObject();
+		json.Write("strategy", STRATEGY_NAMES[r.strategy]);
+		json.Write("payloadBytes", double(r.payload));
+		json.Write("chunks", double(r.chunkCnt));
+		json.Write("chunkBytes", double(r.chunkSize));
+		json.Write("cpuUs", r.cpuUs);
+		json.Write("stallUs", r.stallUs);
+		json.Write("gigabytesPerSecond", r.gigabytesPerSecond);
+		json.Write("corruptedBytes", double(r.errorCnt));
+		json.EndObject();
+	}
+	json.EndArray();
+	json.EndObject();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+//
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	std::string jsonFile, strategyName;
+	GLint frameCnt     = 32;
+	GLsizeiptr minSize = 1024;
+	GLsizeiptr maxSize = 64*1024*1024;
+
+	// init glut (consumes the glut arguments)
+	glutInit(&argc, argv);
+
+	// parse arguments
+	bool isUsage = false;
+	for(int i=1; i<argc && !isUsage; ++i)
+	{
+		std::string arg(argv[i]);
+		if(arg == "--frames" && i+1 < argc)
+			frameCnt = std::max(1, atoi(argv[++i]));
+		else if(arg == "--min-size" && i+1 < argc)
+			minSize = std::max(GLsizeiptr(CHUNK_ALIGNMENT),
+			                   parse_size(argv[++i]));
+		else if(arg == "--max-size" && i+1 < argc)
+			maxSize = parse_size(argv[++i]);
+		else if(arg == "--strategy" && i+1 < argc)
+			strategyName = argv[++i];
+		else if(arg == "--json" && i+1 < argc)
+			jsonFile = argv[++i];
+		else
+			isUsage = true;
+	}
+	GLint strategyFilter = -1;
+	for(GLint i=0; i<STRATEGY_COUNT; ++i)
+		if(strategyName == STRATEGY_NAMES[i])
+			strategyFilter = i;
+	if(isUsage || (!strategyName.empty() && strategyFilter < 0))
+	{
+		std::cerr << "usage: " << argv[0]
+		          << " [--frames n] [--min-size n] [--max-size n]"
+		          << " [--strategy subdata|orphan|unsynchronized|storage]"
+		          << " [--json file]" << std::endl;
+		return 1;
+	}
+
+	// build a GL4.3 context
+	glutInitContextVersion(4, 3);
+	glutInitContextFlags(GLUT_DEBUG | GLUT_FORWARD_COMPATIBLE);
+	glutInitContextProfile(GLUT_CORE_PROFILE);
+	glutInitDisplayMode(GLUT_RGBA);
+	glutInitWindowSize(64, 64);
+	glutCreateWindow("streamBench");
+	glutHideWindow();
+
+	// init glew
+	glewExperimental = GL_TRUE;
+	if(GLEW_OK != glewInit())
+	{
+		std::cerr << "glewInit() failed" << std::endl;
+		return 1;
+	}
+	glGetError();
+
+	// check_gl_error checks in release builds too
+	fw::DebugOutput::SetMode(fw::DebugOutput::MODE_FULL);
+
+	try
+	{
+		// resolve the buffer storage entry point
+		if(is_buffer_storage_supported())
+			sBufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>
+			                 (glutGetProcAddress("glBufferStorage"));
+		if(NULL == sBufferStorage)
+			std::cout << "glBufferStorage is not available, "
+			          << "skipping the storage strategy" << std::endl;
+
+		// synthetic source
+		std::vector<char> source(maxSize + PATTERN_PERIOD);
+		bench::Random random(1);
+		for(size_t i=0; i<source.size(); ++i)
+			source[i] = char(random.Next());
+
+		// run
+		char line[256];
+		std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+		sprintf(line, "%8s %6s %8s  %-15s %10s %10s %8s",
+		        "payload", "chunks", "chunk", "strategy",
+		        "cpu us", "stall us", "GB/s");
+		std::cout << line << std::endl;
+		std::vector<Result> results;
+		GLsizeiptr errorCnt = 0;
+		for(GLsizeiptr size=minSize; size<=maxSize; size*=4)
+		for(GLint i=0; i<CHUNK_COUNT_COUNT; ++i)
+		{
+			// run the strategies and mark the fastest
+			size_t first = results.size();
+			size_t best  = first;
+			for(GLint j=0; j<STRATEGY_COUNT; ++j)
+			{
+				if((strategyFilter >= 0 && strategyFilter != j)
+				|| (STRATEGY_STORAGE == j && NULL == sBufferStorage))
+					continue;
+				results.push_back(run_strategy(j,
+				                               size,
+				                               CHUNK_COUNTS[i],
+				                               frameCnt,
+				                               source));
+				if(results.back().gigabytesPerSecond
+				   > results[best].gigabytesPerSecond)
+					best = results.size() - 1;
+			}
+			for(size_t j=first; j<results.size(); ++j)
+			{
+				const Result& r = results[j];
+				sprintf(line, "%8s %6d %8s %c%-15s %10.1f %10.1f %8.3f",
+				        format_size(r.payload).c_str(),
+				        r.chunkCnt,
+				        format_size(r.chunkSize).c_str(),
+				        j == best ? '*' : ' ',
+				        STRATEGY_NAMES[r.strategy],
+				        r.cpuUs,
+				        r.stallUs,
+				        r.gigabytesPerSecond);
+				std::cout << line
+				          << (r.errorCnt ? "  CORRUPTED" : "") << std::endl;
+				errorCnt += r.errorCnt;
+			}
+		}
+
+		// export
+		if(!jsonFile.empty())
+		{
+			std::ofstream file(jsonFile.c_str());
+			if(!file)
+			{
+				std::cerr << "Could not open " << jsonFile << std::endl;
+				return 1;
+			}
+			write_json(file, results, frameCnt);
+		}
+
+		std::cout << results.size() << " runs, "
+		          << (errorCnt ? "FAILED" : "passed") << std::endl;
+		return errorCnt ? 1 : 0;
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Fatal exception: " << e.what() << std::endl;
+		return 1;
+	}
+}
+